@@ -0,0 +1,326 @@
+#include "LoraMesherBenchmark.h"
+
+#include "LoraMesher.h"
+
+#include <cstdio>
+
+#if defined(LM_HOST_BUILD)
+#include <malloc.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#elif !defined(ARDUINO)
+#include <esp_cpu.h>
+#endif
+
+namespace {
+
+// Sizes of the structures measured
+const size_t structureSizes[] = { 16, 64, 256 };
+
+// Number of packets of the sequences joined
+const size_t sequenceSizes[] = { 2, 8, 32 };
+
+// Payload sizes of the packets created
+const size_t payloadSizes[] = { 10, 50, 90 };
+
+// Routes advertised by every neighbour, every neighbour adds itself and its routes to the routing table
+const size_t ROUTES_PER_NEIGHBOUR = 15;
+
+const uint16_t NEIGHBOUR_ADDRESS = 0x1000;
+const uint16_t ROUTE_ADDRESS = 0x2000;
+
+struct BenchmarkElement {
+    uint32_t value;
+};
+
+uint32_t randomState = 0x12345678;
+
+/**
+ * @brief Deterministic xorshift, the benchmarks do the same operations on every run
+ *
+ */
+uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+/**
+ * @brief Measure an operation, the heap is read outside of the cycles measured
+ *
+ */
+template <typename Operation>
+void measure(LoraMesherBenchmark::Measurement& measurement, Operation operation) {
+    int64_t heapBefore = LoraMesherBenchmark::getHeapInUse();
+    uint32_t start = LoraMesherBenchmark::getCycles();
+
+    operation();
+
+    uint32_t cycles = LoraMesherBenchmark::getCycles() - start;
+    measurement.heapDelta += LoraMesherBenchmark::getHeapInUse() - heapBefore;
+
+    measurement.operations++;
+    measurement.totalCycles += cycles;
+    if (cycles < measurement.minCycles)
+        measurement.minCycles = cycles;
+}
+
+/**
+ * @brief Hello packet of a neighbour advertising its routes
+ *
+ */
+RoutePacket* createNeighbourHello(size_t neighbour, size_t routes) {
+    NetworkNode nodes[ROUTES_PER_NEIGHBOUR];
+    for (size_t i = 0; i < routes; i++)
+        nodes[i] = NetworkNode(ROUTE_ADDRESS + neighbour * ROUTES_PER_NEIGHBOUR + i, 1, ROLE_DEFAULT);
+
+    return PacketService::createRoutingPacket(NEIGHBOUR_ADDRESS + neighbour, nodes, routes, ROLE_DEFAULT);
+}
+
+}
+
+uint32_t LoraMesherBenchmark::getCycles() {
+#if defined(LM_HOST_BUILD)
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t) __rdtsc();
+#else
+    return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+#elif defined(ARDUINO)
+    return ESP.getCycleCount();
+#else
+    return (uint32_t) esp_cpu_get_cycle_count();
+#endif
+}
+
+int64_t LoraMesherBenchmark::getHeapInUse() {
+#if defined(LM_HOST_BUILD)
+    return (int64_t) mallinfo2().uordblks;
+#else
+    return -(int64_t) getFreeHeap();
+#endif
+}
+
+void LoraMesherBenchmark::runAll(uint32_t iterations) {
+    esp_log_level_set(LM_TAG, ESP_LOG_WARN);
+    PacketFactory::setMaxPacketSize(LM_MAX_PACKET_SIZE);
+
+    printHeader();
+
+    benchmarkLinkedList(iterations);
+    benchmarkAddOrdered(iterations);
+    benchmarkRoutingTable(iterations);
+    benchmarkDuplicatePacket(iterations);
+    benchmarkJoinPackets(iterations);
+    benchmarkCreatePacket(iterations);
+}
+
+void LoraMesherBenchmark::benchmarkLinkedList(uint32_t iterations) {
+    for (size_t size : structureSizes) {
+        LM_LinkedList<BenchmarkElement> list;
+
+        // One more element, it is outside of the list between the operations
+        BenchmarkElement* elements = new BenchmarkElement[size + 1];
+        for (size_t i = 0; i < size; i++) {
+            elements[i].value = i;
+            list.Append(&elements[i]);
+        }
+
+        BenchmarkElement* spare = &elements[size];
+
+        Measurement append, search, pop;
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            measure(append, [&]() { list.Append(spare); });
+            spare = list.Pop();
+        }
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            BenchmarkElement* element = &elements[nextRandom() % (size + 1)];
+            if (element == spare)
+                element = element == &elements[size] ? &elements[0] : element + 1;
+
+            measure(search, [&]() { list.Search(element); });
+        }
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            measure(pop, [&]() { spare = list.Pop(); });
+            list.Append(spare);
+        }
+
+        printResult("LM_LinkedList::Append", size, append);
+        printResult("LM_LinkedList::Search", size, search);
+        printResult("LM_LinkedList::Pop", size, pop);
+
+        list.Clear();
+        delete[] elements;
+    }
+}
+
+void LoraMesherBenchmark::benchmarkAddOrdered(uint32_t iterations) {
+    // The queue only orders the queue packets, all of them share the packet
+    Packet<uint8_t>* packet = PacketService::createEmptyPacket(sizeof(Packet<uint8_t>));
+
+    for (size_t size : structureSizes) {
+        LM_PriorityQueue<QueuePacket<Packet<uint8_t>>, MAX_PRIORITY> queue;
+
+        for (size_t i = 0; i < size; i++)
+            queue.Append(PacketQueueService::createQueuePacket(packet, nextRandom() % (MAX_PRIORITY + 1)));
+
+        Measurement addOrdered;
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            QueuePacket<Packet<uint8_t>>* qp = PacketQueueService::createQueuePacket(packet, nextRandom() % (MAX_PRIORITY + 1));
+
+            measure(addOrdered, [&]() { PacketQueueService::addOrdered(&queue, qp); });
+
+            delete queue.Extract([qp](QueuePacket<Packet<uint8_t>>* element) { return element == qp; });
+        }
+
+        printResult("PacketQueueService::addOrdered", size, addOrdered);
+
+        while (QueuePacket<Packet<uint8_t>>* qp = queue.Pop())
+            delete qp;
+    }
+
+    LoraMesher::deletePacket(packet);
+}
+
+void LoraMesherBenchmark::benchmarkRoutingTable(uint32_t iterations) {
+    size_t routesPerNeighbour = ROUTES_PER_NEIGHBOUR;
+    size_t maxNodesPerPacket = (PacketFactory::getMaxPacketSize() - sizeof(RoutePacket)) / sizeof(NetworkNode);
+    if (routesPerNeighbour > maxNodesPerPacket)
+        routesPerNeighbour = maxNodesPerPacket;
+
+    size_t neighbours = 0;
+
+    for (size_t size : structureSizes) {
+        // The routing table grows from the previous size
+        while (RoutingTableService::routingTableSize() < size && neighbours * (routesPerNeighbour + 1) < RTMAXSIZE) {
+            RoutePacket* hello = createNeighbourHello(neighbours, routesPerNeighbour);
+            RoutingTableService::processRoute(hello, 10);
+            LoraMesher::deletePacket(reinterpret_cast<Packet<uint8_t>*>(hello));
+            neighbours++;
+        }
+
+        size_t tableSize = RoutingTableService::routingTableSize();
+
+        Measurement findNode, processRoute;
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            size_t neighbour = nextRandom() % neighbours;
+            size_t route = nextRandom() % (routesPerNeighbour + 1);
+            uint16_t address = route == 0 ?
+                NEIGHBOUR_ADDRESS + neighbour :
+                ROUTE_ADDRESS + neighbour * ROUTES_PER_NEIGHBOUR + route - 1;
+
+            measure(findNode, [&]() { RoutingTableService::findNode(address); });
+        }
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            // Processing the packet adds the link cost to the metrics, a new copy is processed every time
+            RoutePacket* hello = createNeighbourHello(nextRandom() % neighbours, routesPerNeighbour);
+
+            measure(processRoute, [&]() { RoutingTableService::processRoute(hello, 10); });
+
+            LoraMesher::deletePacket(reinterpret_cast<Packet<uint8_t>*>(hello));
+        }
+
+        printResult("RoutingTableService::findNode", tableSize, findNode);
+        printResult("RoutingTableService::processRoute", tableSize, processRoute);
+    }
+}
+
+void LoraMesherBenchmark::benchmarkDuplicatePacket(uint32_t iterations) {
+    LoraMesher& radio = LoraMesher::getInstance();
+
+    uint8_t payload[20] = { 0 };
+
+    Measurement newPacket, repeatedPacket;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        // A different payload is a different key
+        uint32_t value = nextRandom();
+        memcpy(payload, &value, sizeof(value));
+
+        Packet<uint8_t>* p = reinterpret_cast<Packet<uint8_t>*>(
+            PacketService::createDataPacket(BROADCAST_ADDR, NEIGHBOUR_ADDRESS, DATA_P, payload, sizeof(payload)));
+
+        measure(newPacket, [&]() { radio.isDuplicatePacket(p); });
+        measure(repeatedPacket, [&]() { radio.isDuplicatePacket(p); });
+
+        LoraMesher::deletePacket(p);
+    }
+
+    printResult("LoraMesher::isDuplicatePacket new", LM_DUPLICATE_CACHE_SIZE, newPacket);
+    printResult("LoraMesher::isDuplicatePacket repeated", LM_DUPLICATE_CACHE_SIZE, repeatedPacket);
+}
+
+void LoraMesherBenchmark::benchmarkJoinPackets(uint32_t iterations) {
+    LoraMesher& radio = LoraMesher::getInstance();
+
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+    RouteNode* node = RoutingTableService::findNode(NEIGHBOUR_ADDRESS);
+
+    for (size_t size : sequenceSizes) {
+        Measurement join;
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            // The sequence as processSyncPacket creates it, with all the payload copied
+            AppPacket<uint8_t>* appPacket = static_cast<AppPacket<uint8_t>*>(
+                PacketPoolService::allocatePayload(sizeof(AppPacket<uint8_t>) + size * maxPayloadSize));
+            appPacket->payloadSize = size * maxPayloadSize;
+            appPacket->next = nullptr;
+
+            LoraMesher::listConfiguration* listConfig = new LoraMesher::listConfiguration();
+            listConfig->config = new LoraMesher::sequencePacketConfig((LM_SeqId) i, NEIGHBOUR_ADDRESS, size, node);
+            listConfig->list = new LM_LinkedList<QueuePacket<ControlPacket>>();
+            listConfig->appPacket = appPacket;
+
+            radio.q_WRP->setInUse();
+            radio.q_WRP->Append(listConfig);
+            radio.indexSequence(listConfig);
+            radio.q_WRP->releaseInUse();
+
+            measure(join, [&]() { radio.joinPacketsAndNotifyUser(listConfig); });
+        }
+
+        printResult("LoraMesher::joinPacketsAndNotifyUser", size, join);
+    }
+}
+
+void LoraMesherBenchmark::benchmarkCreatePacket(uint32_t iterations) {
+    uint8_t payload[LM_MAX_PACKET_SIZE] = { 0 };
+
+    for (size_t size : payloadSizes) {
+        Measurement create;
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            Packet<uint8_t>* p = nullptr;
+
+            measure(create, [&]() { p = PacketFactory::createPacket<Packet<uint8_t>>(payload, size); });
+
+            LoraMesher::deletePacket(p);
+        }
+
+        printResult("PacketFactory::createPacket", size, create);
+    }
+}
+
+void LoraMesherBenchmark::printHeader() {
+    printf("%-40s %6s %8s %12s %12s %12s\n", "Operation", "Size", "Ops", "Cycles/op", "Min cycles", "Heap B/op");
+}
+
+void LoraMesherBenchmark::printResult(const char* name, size_t size, const Measurement& measurement) {
+    if (measurement.operations == 0)
+        return;
+
+    printf("%-40s %6u %8u %12llu %12u %12.1f\n", name, (unsigned) size, (unsigned) measurement.operations,
+        (unsigned long long) (measurement.totalCycles / measurement.operations), (unsigned) measurement.minCycles,
+        (double) measurement.heapDelta / measurement.operations);
+}
@@ -0,0 +1,76 @@
+#ifndef _LORAMESHER_BENCHMARK_H
+#define _LORAMESHER_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Microbenchmarks of the data structures and the packet services of LoraMesher. Every operation is timed
+ * with the cycle counter of the CPU and the heap is read before and after it. The setup and the cleanup of every
+ * operation are not measured.
+ *
+ * The private members of LoraMesher are reached by building with LM_GOD_MODE.
+ *
+ */
+class LoraMesherBenchmark {
+public:
+    /**
+     * @brief Measurement of an operation
+     *
+     */
+    struct Measurement {
+        uint32_t operations{ 0 };
+        uint64_t totalCycles{ 0 };
+        uint32_t minCycles{ UINT32_MAX };
+        int64_t heapDelta{ 0 }; // Bytes of heap taken by all the operations, negative if freed
+    };
+
+    /**
+     * @brief Run all the benchmarks and print a table with the results
+     *
+     * @param iterations Operations measured for every benchmark and size
+     */
+    static void runAll(uint32_t iterations);
+
+    /**
+     * @brief Cycle counter of the CPU, the differences are valid while they fit in 32 bits
+     *
+     */
+    static uint32_t getCycles();
+
+    /**
+     * @brief Bytes of heap in use
+     *
+     */
+    static int64_t getHeapInUse();
+
+private:
+    static void benchmarkLinkedList(uint32_t iterations);
+
+    static void benchmarkAddOrdered(uint32_t iterations);
+
+    static void benchmarkRoutingTable(uint32_t iterations);
+
+    static void benchmarkDuplicatePacket(uint32_t iterations);
+
+    static void benchmarkJoinPackets(uint32_t iterations);
+
+    static void benchmarkCreatePacket(uint32_t iterations);
+
+    /**
+     * @brief Print the header of the table
+     *
+     */
+    static void printHeader();
+
+    /**
+     * @brief Print a row of the table
+     *
+     * @param name Name of the operation
+     * @param size Number of elements of the structure or bytes of the payload
+     * @param measurement Measurement
+     */
+    static void printResult(const char* name, size_t size, const Measurement& measurement);
+};
+
+#endif
@@ -0,0 +1,21 @@
+#include <Arduino.h>
+#include "LoraMesher.h"
+#include "LoraMesherBenchmark.h"
+
+// Operations measured for every benchmark and size
+#define BENCHMARK_ITERATIONS 1000
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("LoraMesher benchmarks");
+
+    LoraMesherBenchmark::runAll(BENCHMARK_ITERATIONS);
+
+    Serial.println("Benchmarks finished");
+}
+
+void loop() {
+    vTaskDelay(portMAX_DELAY);
+}
@@ -171,26 +171,20 @@ void printAddressDisplay() {
  */
 void printRoutingTableToDisplay() {
 
-    //Set the routing table list that is being used and cannot be accessed (Remember to release use after usage)
-    LM_LinkedList<RouteNode>* routingTableList = radio.routingTableListCopy();
-
-    routingTableList->setInUse();
-
-    Screen.changeSizeRouting(radio.routingTableSize());
+    size_t routingTableSize = radio.routingTableSize();
+    Screen.changeSizeRouting(routingTableSize);
 
+    //The routing table is locked while the visitor is called, it only writes the text of the display
     char text[15];
-    for (int i = 0; i < radio.routingTableSize(); i++) {
-        RouteNode* rNode = (*routingTableList)[i];
+    size_t i = 0;
+    radio.forEachRoute([&](const RouteNode* rNode) {
+        if (i >= routingTableSize)
+            return;
+
         NetworkNode node = rNode->networkNode;
         snprintf(text, 15, ("|%X(%d)->%X"), node.address, node.metric, rNode->via);
-        Screen.changeRoutingText(text, i);
-    }
-
-    //Release routing table list usage.
-    routingTableList->releaseInUse();
-
-    //Delete the routing table list
-    delete routingTableList;
+        Screen.changeRoutingText(text, i++);
+    });
 
     Screen.changeLineFour();
 }
@@ -213,9 +207,14 @@ void sendLoRaMessage(void*) {
         if (radio.routingTableSize() <= dataTablePosition)
             dataTablePosition = 0;
 
-        LM_LinkedList<RouteNode>* routingTableList = radio.routingTableListCopy();
+        //Copy of the route, it is valid even if the route expires
+        RouteNode route;
+        if (radio.getRoutingTable(&route, 1, dataTablePosition) == 0) {
+            dataTablePosition = 0;
+            continue;
+        }
 
-        uint16_t addr = (*routingTableList)[dataTablePosition]->networkNode.address;
+        uint16_t addr = route.networkNode.address;
 
         Serial.printf("Send data packet nº %d to %X (%d)\n", dataCounter, addr, dataTablePosition);
 
@@ -237,9 +236,6 @@ void sendLoRaMessage(void*) {
         //Print routing Table to Display
         printRoutingTableToDisplay();
 
-        //Release routing table list usage.
-        delete routingTableList;
-
         break;
 
         //Wait 120 seconds to send the next packet
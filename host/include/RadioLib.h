@@ -0,0 +1,23 @@
+#pragma once
+
+/**
+ * @brief Status codes of RadioLib used by LoraMesher. The host build has no RadioLib, the radio is the simulated
+ * LM_Module of the simulator.
+ *
+ */
+
+#include <cstdint>
+#include <cstddef>
+
+#define RADIOLIB_ERR_NONE (0)
+#define RADIOLIB_ERR_UNKNOWN (-1)
+#define RADIOLIB_ERR_TX_TIMEOUT (-5)
+#define RADIOLIB_ERR_RX_TIMEOUT (-6)
+#define RADIOLIB_ERR_CRC_MISMATCH (-7)
+#define RADIOLIB_ERR_PREAMBLE_DETECTED (-14)
+#define RADIOLIB_PREAMBLE_DETECTED RADIOLIB_ERR_PREAMBLE_DETECTED
+#define RADIOLIB_ERR_SPI_WRITE_FAILED (-16)
+#define RADIOLIB_CHANNEL_FREE (-702)
+#define RADIOLIB_LORA_DETECTED (-701)
+
+class RadioLibHal;
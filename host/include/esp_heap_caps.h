@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+/**
+ * @brief The host has no heap capabilities, the memory is allocated with malloc. The free size is a fixed value
+ * of the heap of an ESP32, so the code that adapts to the free memory behaves as in the device.
+ *
+ */
+size_t heap_caps_get_free_size(uint32_t caps);
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) {
+    (void) caps;
+    return malloc(size);
+}
+
+inline void heap_caps_free(void* ptr) {
+    free(ptr);
+}
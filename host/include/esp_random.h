@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Deterministic random numbers, the simulator seeds them so a run can be repeated
+ *
+ */
+uint32_t esp_random(void);
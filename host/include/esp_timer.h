@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Virtual time of the simulator in microseconds
+ *
+ */
+int64_t esp_timer_get_time();
@@ -0,0 +1,61 @@
+#pragma once
+
+/**
+ * @brief FreeRTOS API of the host build. The tasks are coroutines run by the discrete-event scheduler of the
+ * simulator in virtual time, see host/src/HostScheduler.h. Only one task runs at the same time and a task only
+ * stops running when it blocks or a higher priority task becomes ready. The critical sections only delay the
+ * preemption until they end.
+ *
+ */
+
+#include <cstdint>
+#include <cstddef>
+
+typedef struct HostTask* TaskHandle_t;
+typedef struct HostSemaphore* SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE ((BaseType_t) 1)
+#define pdFALSE ((BaseType_t) 0)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t) 1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms) * configTICK_RATE_HZ / 1000)
+#define configMAX_PRIORITIES 25
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+#define IRAM_ATTR
+
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+
+void vPortEnterCritical();
+void vPortExitCritical();
+
+#define portENTER_CRITICAL(mux) ((void) (mux), vPortEnterCritical())
+#define portEXIT_CRITICAL(mux) ((void) (mux), vPortExitCritical())
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL(mux) portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux) portEXIT_CRITICAL(mux)
+
+// The interrupts run outside any task, the woken task runs when the interrupt returns to the scheduler
+#define portYIELD_FROM_ISR(...) ((void) 0)
+
+void* pvPortMalloc(size_t size);
+void vPortFree(void* pv);
+
+// Like the Arduino core, the task and semaphore API is available with this header
+#include "freertos/task.h"
+#include "freertos/semphr.h"
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief MAC of the node that is running, 02:00:00:00 followed by the address given by the simulator
+ *
+ */
+void efuse_hal_get_mac(uint8_t* mac);
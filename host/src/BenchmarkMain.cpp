@@ -0,0 +1,70 @@
+#include "HostScheduler.h"
+
+#include "LoraMesherBenchmark.h"
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+// Address of the node running the benchmarks
+static const uint16_t BENCHMARK_ADDRESS = 0x0001;
+
+static void benchmarkTask(void* parameters) {
+    uint32_t iterations = *static_cast<uint32_t*>(parameters);
+
+    LoraMesherBenchmark::runAll(iterations);
+
+    vTaskDelete(NULL);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --iterations N   Operations measured for every benchmark and size (1000)\n"
+        "  --quick          Measure 50 operations, to check that the benchmarks run\n",
+        program);
+}
+
+int main(int argc, char** argv) {
+    // The heap deltas come from mallinfo2, that counts the chunks cached by the tcache and the fastbins as in use.
+    // The benchmarks run again without them
+    if (getenv("GLIBC_TUNABLES") == nullptr) {
+        setenv("GLIBC_TUNABLES", "glibc.malloc.tcache_count=0:glibc.malloc.mxfast=0", 1);
+        execv("/proc/self/exe", argv);
+    }
+
+    uint32_t iterations = 1000;
+
+    static const option longOptions[] = {
+        { "iterations", required_argument, nullptr, 'i' },
+        { "quick", no_argument, nullptr, 'q' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+        switch (option) {
+            case 'i':
+                iterations = (uint32_t) strtoul(optarg, nullptr, 10);
+                break;
+            case 'q':
+                iterations = 50;
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+
+    // The benchmarks run inside a task, like on the device, and the local address is the one of the node
+    HostScheduler::createTask(benchmarkTask, "benchmark", 4096, &iterations, 1, BENCHMARK_ADDRESS);
+    HostScheduler::run(HostScheduler::FOREVER);
+
+    fflush(stdout);
+
+    // The services of LoraMesher are not destroyed, they are static and their tasks have not been created
+    _exit(0);
+}
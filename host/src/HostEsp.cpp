@@ -0,0 +1,147 @@
+#include "HostScheduler.h"
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <hal/efuse_hal.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// Free heap reported to the nodes, the heap of an ESP32 after the WiFi stack
+#ifndef LM_HOST_FREE_HEAP
+#define LM_HOST_FREE_HEAP (200 * 1024)
+#endif
+
+static esp_log_level_t logLevel = ESP_LOG_WARN;
+
+static uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    (void) tag;
+    logLevel = level;
+}
+
+esp_log_level_t esp_log_level_get(const char* tag) {
+    (void) tag;
+    return logLevel;
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    static const char levels[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+
+    uint64_t now = HostScheduler::now();
+    fprintf(stderr, "%6llu.%06llu %04X %c (%s) ",
+        (unsigned long long) (now / 1000000), (unsigned long long) (now % 1000000),
+        HostScheduler::getCurrentNode(), levels[level], tag);
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+
+    fputc('\n', stderr);
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t) HostScheduler::now();
+}
+
+/**
+ * @brief Seed esp_random and the rand of the C library used by random
+ *
+ */
+void hostSeedRandom(uint64_t seed) {
+    randomState = seed != 0 ? seed : 0x9E3779B97F4A7C15ULL;
+    srand((unsigned int) seed);
+}
+
+uint32_t esp_random(void) {
+    // xorshift64*
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (uint32_t) ((randomState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+void efuse_hal_get_mac(uint8_t* mac) {
+    uint16_t address = HostScheduler::getCurrentNode();
+
+    mac[0] = 0x02;
+    mac[1] = 0;
+    mac[2] = 0;
+    mac[3] = 0;
+    mac[4] = address >> 8;
+    mac[5] = address & 0xFF;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    (void) caps;
+    return LM_HOST_FREE_HEAP;
+}
+
+// NVS of every node, by the node and the namespace of the handle and the key. It is kept while the simulator runs
+static std::map<std::string, std::vector<uint8_t>> nvsEntries;
+static std::vector<std::string> nvsHandles;
+
+static std::string nvsEntry(nvs_handle_t handle, const char* key) {
+    return nvsHandles[handle - 1] + "/" + key;
+}
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    std::string prefix = std::to_string(HostScheduler::getCurrentNode()) + "/" + name;
+
+    // Like the devices, a namespace without entries cannot be opened to read it
+    if (open_mode == NVS_READONLY) {
+        auto entry = nvsEntries.lower_bound(prefix + "/");
+        if (entry == nvsEntries.end() || entry->first.compare(0, prefix.size() + 1, prefix + "/") != 0)
+            return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    nvsHandles.push_back(prefix);
+    *out_handle = nvsHandles.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+    auto entry = nvsEntries.find(nvsEntry(handle, key));
+    if (entry == nvsEntries.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    const std::vector<uint8_t>& value = entry->second;
+    if (out_value != nullptr) {
+        if (*length < value.size())
+            return ESP_ERR_INVALID_SIZE;
+
+        memcpy(out_value, value.data(), value.size());
+    }
+
+    *length = value.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    const uint8_t* data = static_cast<const uint8_t*>(value);
+    nvsEntries[nvsEntry(handle, key)].assign(data, data + length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    (void) handle;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    (void) handle;
+}
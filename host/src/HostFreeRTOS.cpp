@@ -0,0 +1,274 @@
+#include "HostScheduler.h"
+
+#include <cstdlib>
+
+static uint64_t getDeadline(TickType_t ticks) {
+    if (ticks == portMAX_DELAY)
+        return HostScheduler::FOREVER;
+
+    return HostScheduler::now() + (uint64_t) ticks * 1000000 / configTICK_RATE_HZ;
+}
+
+static HostTask* getTask(TaskHandle_t task) {
+    return task != nullptr ? task : HostScheduler::getCurrentTask();
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters,
+    UBaseType_t uxPriority, TaskHandle_t* pxCreatedTask) {
+
+    HostTask* task = HostScheduler::createTask(
+        pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, HostScheduler::getCurrentNode());
+
+    if (pxCreatedTask != nullptr)
+        *pxCreatedTask = task;
+
+    return task != nullptr ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pxTaskCode, const char* pcName, uint32_t usStackDepth,
+    void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pxCreatedTask, BaseType_t xCoreID) {
+    // The simulated nodes have a single core
+    (void) xCoreID;
+    return xTaskCreate(pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask);
+}
+
+void vTaskDelete(TaskHandle_t xTask) {
+    HostTask* task = getTask(xTask);
+    if (task != nullptr)
+        HostScheduler::deleteTask(task);
+}
+
+void vTaskSuspend(TaskHandle_t xTask) {
+    HostTask* task = getTask(xTask);
+    if (task != nullptr)
+        HostScheduler::suspend(task);
+}
+
+void vTaskResume(TaskHandle_t xTask) {
+    if (xTask != nullptr && xTask->state == HostTask::SUSPENDED)
+        HostScheduler::makeReady(xTask);
+}
+
+eTaskState eTaskGetState(TaskHandle_t xTask) {
+    if (xTask == nullptr)
+        return eInvalid;
+
+    switch (xTask->state) {
+        case HostTask::READY: return eReady;
+        case HostTask::RUNNING: return eRunning;
+        case HostTask::SUSPENDED: return eSuspended;
+        case HostTask::DELETED: return eDeleted;
+        default: return eBlocked;
+    }
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+    if (HostScheduler::getCurrentTask() == nullptr)
+        return;
+
+    if (xTicksToDelay == 0)
+        HostScheduler::yield();
+    else
+        HostScheduler::block(HostTask::DELAYED, getDeadline(xTicksToDelay));
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t xTask) {
+    HostTask* task = getTask(xTask);
+    return task != nullptr ? task->priority : 0;
+}
+
+void vTaskPrioritySet(TaskHandle_t xTask, UBaseType_t uxNewPriority) {
+    HostTask* task = getTask(xTask);
+    if (task != nullptr)
+        HostScheduler::setPriority(task, uxNewPriority);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+    // The host stacks are not measured, the requested depth is returned
+    HostTask* task = getTask(xTask);
+    return task != nullptr ? task->stackDepth : 0;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return HostScheduler::getCurrentTask();
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t) (HostScheduler::now() * configTICK_RATE_HZ / 1000000);
+}
+
+BaseType_t xTaskNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction) {
+    if (xTaskToNotify == nullptr || xTaskToNotify->state == HostTask::DELETED)
+        return pdFAIL;
+
+    HostTask* task = xTaskToNotify;
+
+    switch (eAction) {
+        case eSetBits:
+            task->notificationValue |= ulValue;
+            break;
+        case eIncrement:
+            task->notificationValue++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notificationValue = ulValue;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notificationPending)
+                return pdFAIL;
+            task->notificationValue = ulValue;
+            break;
+        case eNoAction:
+            break;
+    }
+
+    task->notificationPending = true;
+
+    if (task->state == HostTask::WAITING_NOTIFICATION)
+        HostScheduler::makeReady(task);
+
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction,
+    BaseType_t* pxHigherPriorityTaskWoken) {
+
+    if (pxHigherPriorityTaskWoken != nullptr)
+        *pxHigherPriorityTaskWoken = pdFALSE;
+
+    return xTaskNotify(xTaskToNotify, ulValue, eAction);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+    return xTaskNotify(xTaskToNotify, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken) {
+    xTaskNotifyFromISR(xTaskToNotify, 0, eIncrement, pxHigherPriorityTaskWoken);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t* pulNotificationValue,
+    TickType_t xTicksToWait) {
+
+    HostTask* task = HostScheduler::getCurrentTask();
+
+    if (!task->notificationPending) {
+        task->notificationValue &= ~ulBitsToClearOnEntry;
+
+        if (xTicksToWait > 0)
+            HostScheduler::block(HostTask::WAITING_NOTIFICATION, getDeadline(xTicksToWait));
+    }
+
+    if (pulNotificationValue != nullptr)
+        *pulNotificationValue = task->notificationValue;
+
+    if (!task->notificationPending)
+        return pdFALSE;
+
+    task->notificationValue &= ~ulBitsToClearOnExit;
+    task->notificationPending = false;
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    HostTask* task = HostScheduler::getCurrentTask();
+
+    // As in FreeRTOS any notification wakes the task, even if the value stays 0
+    if (task->notificationValue == 0 && xTicksToWait > 0)
+        HostScheduler::block(HostTask::WAITING_NOTIFICATION, getDeadline(xTicksToWait));
+
+    uint32_t value = task->notificationValue;
+    if (value != 0)
+        task->notificationValue = xClearCountOnExit != pdFALSE ? 0 : value - 1;
+
+    task->notificationPending = false;
+    return value;
+}
+
+static SemaphoreHandle_t createSemaphore(bool recursive) {
+    HostSemaphore* semaphore = new HostSemaphore();
+    semaphore->recursive = recursive;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return createSemaphore(false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return createSemaphore(true);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore) {
+    delete xSemaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait) {
+    // Outside the tasks, the simulator and the events only take the free mutexes
+    static HostTask outsideTasks;
+
+    HostTask* task = HostScheduler::getCurrentTask();
+    HostTask* owner = task != nullptr ? task : &outsideTasks;
+
+    if (xSemaphore->count == 0 || (xSemaphore->recursive && xSemaphore->owner == owner)) {
+        xSemaphore->owner = owner;
+        xSemaphore->count++;
+        return pdTRUE;
+    }
+
+    if (task == nullptr || xTicksToWait == 0)
+        return pdFALSE;
+
+    xSemaphore->waiting.push_back(task);
+    task->waitingSemaphore = xSemaphore;
+    HostScheduler::block(HostTask::WAITING_SEMAPHORE, getDeadline(xTicksToWait));
+
+    // The ownership is given by xSemaphoreGive before making the task ready
+    return xSemaphore->owner == task ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
+    if (xSemaphore->count == 0)
+        return pdFALSE;
+
+    if (--xSemaphore->count > 0)
+        return pdTRUE;
+
+    xSemaphore->owner = nullptr;
+
+    if (!xSemaphore->waiting.empty()) {
+        HostTask* next = xSemaphore->waiting.front();
+        xSemaphore->waiting.pop_front();
+        next->waitingSemaphore = nullptr;
+
+        xSemaphore->owner = next;
+        xSemaphore->count = 1;
+        HostScheduler::makeReady(next);
+    }
+
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait) {
+    return xSemaphoreTake(xSemaphore, xTicksToWait);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t xSemaphore) {
+    return xSemaphoreGive(xSemaphore);
+}
+
+void* pvPortMalloc(size_t size) {
+    return malloc(size);
+}
+
+void vPortFree(void* pv) {
+    free(pv);
+}
+
+void vPortEnterCritical() {
+    HostScheduler::enterCritical();
+}
+
+void vPortExitCritical() {
+    HostScheduler::exitCritical();
+}
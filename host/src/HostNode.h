@@ -0,0 +1,99 @@
+#ifndef _LORAMESHER_HOST_NODE_H
+#define _LORAMESHER_HOST_NODE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class LM_Module;
+
+/**
+ * @brief Traffic counters of the application of a node
+ *
+ */
+struct HostNodeStats {
+    uint32_t sent;              // Payloads sent by the application
+    uint32_t received;          // Payloads received by the application
+    uint32_t receivedBytes;
+    uint64_t latencySum;        // Sum of the latencies of the received payloads in microseconds
+    uint64_t latencyMax;
+    uint16_t routes;            // Routing table size at the end
+    uint64_t sentPackets;       // Packets sent by LoraMesher
+    uint64_t receivedPackets;   // Data packets received by LoraMesher
+    uint64_t helloPackets;      // Hello packets sent by LoraMesher
+    uint64_t forwardedPackets;
+    uint32_t multicastReceived; // Multicast payloads received complete and without errors
+    uint64_t suppressedFloods;  // Flooded packets not forwarded because enough neighbours forwarded them
+    uint64_t deadlineDrops;     // Packets dropped in the send queue because they reached their max age
+    uint64_t queueDrops;        // Packets and payloads dropped because the send or the received queue was full
+    uint64_t coalescedAcks;     // ACKs coalesced with another ACK or carried by an aggregated packet
+    uint64_t parityPackets;     // Parity packets sent by the reliable payloads
+    uint64_t recoveredPackets;  // Packets of the reliable payloads rebuilt with a parity packet
+    uint64_t congestionDecreases; // Decreases of the congestion windows of the next hops of the reliable payloads
+    uint64_t compactHeaders;    // Packets sent with a compact header
+    uint64_t compactHeaderSavedBytes; // Bytes of header not sent by the packets with a compact header
+    uint64_t slottedPackets;    // Packets sent inside the slots of the slotted access
+};
+
+/**
+ * @brief Parameters of a node. Every node is a copy of the node library with its own LoraMesher, the simulator
+ * creates its main task with lmHostNodeMain and these parameters.
+ *
+ */
+struct HostNodeParameters {
+    LM_Module* module;
+    LM_Module* dataModule;      // Module of the data channels, nullptr if the node has one module
+    uint16_t address;
+
+    // Configuration of LoraMesher
+    uint8_t spreadingFactor;
+    int8_t power;
+    bool listenBeforeTalk;
+    bool adaptiveDataRate;
+    bool compactHello;
+    bool aggregation;
+    bool flooding;
+    bool reliable;              // The payloads are sent with sendReliablePacket
+    uint8_t dataChannels;
+    uint16_t ackDelay;
+    bool fec;
+    bool congestionControl;
+    bool gateway;               // The node has the gateway role
+    bool gatewayLoad;
+    bool compactHeader;
+    bool slottedAccess;
+    bool appPayloadHandler;     // The payloads are given to a payload handler instead of the received queue
+
+    // Traffic of the application, a payload to a random node every sendPeriod ms after trafficStart ms,
+    // to the broadcast address if flooding
+    uint32_t trafficStart;
+    uint32_t trafficEnd;
+    uint32_t sendPeriod;
+    uint16_t payloadSize;
+    uint32_t maxAge;            // Max age of the payloads in the send queue in ms, 0 without limit
+    uint16_t sendQueueSize;     // Packets in the send queue, 0 without limit
+    const uint16_t* destinations;
+    size_t numDestinations;
+    bool uplink;                // The payloads are sent to the closest gateway instead of the destinations, the gateways do not send
+
+    // Bytes of a reliable payload sent by the first destination to the broadcast address at trafficStart, 0 none
+    uint32_t multicastSize;
+
+    HostNodeStats stats;
+};
+
+/**
+ * @brief Main task of a node
+ *
+ */
+typedef void (*HostNodeMain)(void* parameters);
+
+/**
+ * @brief Update the counters of LoraMesher inside the stats of a node
+ *
+ */
+typedef void (*HostNodeCollect)(HostNodeParameters* parameters);
+
+#define LM_HOST_NODE_MAIN "lmHostNodeMain"
+#define LM_HOST_NODE_COLLECT "lmHostNodeCollect"
+
+#endif
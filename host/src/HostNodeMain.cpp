@@ -0,0 +1,194 @@
+#include "LoraMesher.h"
+
+#include "HostNode.h"
+
+#include <vector>
+
+/**
+ * @brief Payload of the traffic of the simulator
+ *
+ */
+struct HostPayload {
+    uint32_t sequence;
+    uint64_t sentTime;
+} __attribute__((packed));
+
+static HostNodeParameters* node = nullptr;
+
+/**
+ * @brief Byte of the multicast payload at a position, it is not compressible and the order of the packets is checked
+ *
+ */
+static uint8_t getMulticastByte(uint32_t position) {
+    return (uint8_t) ((position * 2654435761u) >> 24);
+}
+
+static bool isMulticastPayload(const uint8_t* payload, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) {
+        if (payload[i] != getMulticastByte(i))
+            return false;
+    }
+
+    return true;
+}
+
+static void sendMulticast(LoraMesher& radio) {
+    std::vector<uint8_t> payload(node->multicastSize);
+    for (uint32_t i = 0; i < node->multicastSize; i++)
+        payload[i] = getMulticastByte(i);
+
+    radio.sendReliablePacket(BROADCAST_ADDR, payload.data(), payload.size());
+}
+
+static void receivePayload(uint16_t src, uint16_t dst, const uint8_t* payload, uint32_t payloadSize) {
+    (void) src;
+
+    if (dst == BROADCAST_ADDR && payloadSize == node->multicastSize) {
+        if (isMulticastPayload(payload, payloadSize))
+            node->stats.multicastReceived++;
+
+        return;
+    }
+
+    node->stats.received++;
+    node->stats.receivedBytes += payloadSize;
+
+    if (payloadSize >= sizeof(HostPayload)) {
+        HostPayload hostPayload;
+        memcpy(&hostPayload, payload, sizeof(HostPayload));
+
+        uint64_t latency = esp_timer_get_time() - hostPayload.sentTime;
+        node->stats.latencySum += latency;
+        if (latency > node->stats.latencyMax)
+            node->stats.latencyMax = latency;
+    }
+}
+
+static void receiveTask(void* parameters) {
+    (void) parameters;
+    LoraMesher& radio = LoraMesher::getInstance();
+
+    AppPacket<uint8_t>* packets[16];
+
+    for (;;) {
+        ulTaskNotifyTake(pdPASS, portMAX_DELAY);
+
+        size_t numPackets;
+        while ((numPackets = radio.getNextAppPackets(packets, 16)) > 0) {
+            for (size_t i = 0; i < numPackets; i++)
+                receivePayload(packets[i]->src, packets[i]->dst, packets[i]->payload, packets[i]->payloadSize);
+
+            radio.deletePackets(packets, numPackets);
+        }
+    }
+}
+
+extern "C" void lmHostNodeMain(void* parameters) {
+    node = static_cast<HostNodeParameters*>(parameters);
+
+    LoraMesher& radio = LoraMesher::getInstance();
+
+    LoraMesher::LoraMesherConfig config;
+    config.radioModule = node->module;
+    config.dataRadioModule = node->dataModule;
+    config.dataChannels = node->dataChannels;
+    config.sf = node->spreadingFactor;
+    config.power = node->power;
+    config.listenBeforeTalk = node->listenBeforeTalk;
+    config.adaptiveDataRate = node->adaptiveDataRate;
+    config.compactHello = node->compactHello;
+    config.aggregation = node->aggregation;
+    config.flooding = node->flooding;
+    config.ackDelay = node->ackDelay;
+    config.fec = node->fec;
+    config.congestionControl = node->congestionControl;
+    config.gatewayLoad = node->gatewayLoad;
+    config.compactHeader = node->compactHeader;
+    config.slottedAccess = node->slottedAccess;
+    config.sendQueueSize = node->sendQueueSize;
+
+    if (node->gateway)
+        radio.addRole(ROLE_GATEWAY);
+
+    radio.begin(config);
+
+    if (node->appPayloadHandler)
+        radio.setAppPayloadHandler(receivePayload);
+    else {
+        TaskHandle_t receiveHandle = nullptr;
+        xTaskCreate(receiveTask, "Receive App", 4096, nullptr, 2, &receiveHandle);
+        radio.setReceiveAppDataTaskHandle(receiveHandle);
+    }
+
+    radio.start();
+
+    bool multicast = node->multicastSize > 0 && node->numDestinations > 0 && node->destinations[0] == node->address;
+
+    if (!multicast && (node->sendPeriod == 0 || node->numDestinations == 0 || (node->uplink && node->gateway))) {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    //The reliable payloads can be larger than a packet
+    std::vector<uint8_t> payload(std::max<size_t>(node->payloadSize, sizeof(HostPayload)));
+
+    while (millis() < node->trafficStart)
+        vTaskDelay((node->trafficStart - millis()) / portTICK_PERIOD_MS + 1);
+
+    if (multicast)
+        sendMulticast(radio);
+
+    if (node->sendPeriod == 0) {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    for (uint32_t sequence = 0; millis() < node->trafficEnd; sequence++) {
+        // Random phase inside every period, the nodes do not send at the same time
+        vTaskDelay(random(node->sendPeriod / 2, node->sendPeriod * 3 / 2) / portTICK_PERIOD_MS + 1);
+
+        uint16_t dst = node->flooding ? BROADCAST_ADDR : node->destinations[random(0, node->numDestinations)];
+        if (node->uplink) {
+            RouteNode* gateway = radio.getClosestGateway();
+            if (gateway == nullptr)
+                continue;
+
+            dst = gateway->networkNode.address;
+        }
+
+        if (dst == node->address)
+            continue;
+
+        HostPayload header = {sequence, (uint64_t) esp_timer_get_time()};
+        memcpy(payload.data(), &header, sizeof(HostPayload));
+
+        if (node->reliable)
+            radio.sendReliablePacket(dst, payload.data(), payload.size(), LM_QoS(LM_QoSClass::NORMAL, node->maxAge));
+        else
+            radio.createPacketAndSend(dst, payload.data(), payload.size(), LM_QoS(LM_QoSClass::NORMAL, node->maxAge));
+        node->stats.sent++;
+    }
+
+    vTaskDelete(NULL);
+}
+
+extern "C" void lmHostNodeCollect(HostNodeParameters* parameters) {
+    LoraMesher& radio = LoraMesher::getInstance();
+    StatsSnapshot snapshot = radio.getStatsSnapshot();
+
+    parameters->stats.routes = radio.routingTableSize();
+    parameters->stats.sentPackets = snapshot.sentPackets;
+    parameters->stats.receivedPackets = snapshot.receivedDataPackets;
+    parameters->stats.helloPackets = snapshot.sentHelloPackets;
+    parameters->stats.forwardedPackets = snapshot.forwardedPackets;
+    parameters->stats.suppressedFloods = snapshot.suppressedFloods;
+    parameters->stats.deadlineDrops = snapshot.deadlineDrops;
+    parameters->stats.queueDrops = snapshot.sendQueueDrops + snapshot.appQueueDrops;
+    parameters->stats.coalescedAcks = snapshot.coalescedAcks;
+    parameters->stats.parityPackets = snapshot.parityPackets;
+    parameters->stats.recoveredPackets = snapshot.recoveredPackets;
+    parameters->stats.congestionDecreases = snapshot.congestionDecreases;
+    parameters->stats.compactHeaders = snapshot.compactHeaders;
+    parameters->stats.compactHeaderSavedBytes = snapshot.compactHeaderSavedBytes;
+    parameters->stats.slottedPackets = snapshot.slottedPackets;
+}
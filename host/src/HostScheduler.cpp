@@ -0,0 +1,305 @@
+#include "HostScheduler.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Stack of every task. The stacks are reserved without backing memory, so only the used pages take memory
+#ifndef LM_HOST_STACK_SIZE
+#define LM_HOST_STACK_SIZE (256 * 1024)
+#endif
+
+void HostScheduler::schedule(uint64_t time, uint16_t node, std::function<void()> action) {
+    events.push({std::max(time, currentTime), eventSequence++, node, std::move(action)});
+}
+
+HostTask* HostScheduler::createTask(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameters,
+    UBaseType_t priority, uint16_t node) {
+
+    HostTask* task = new HostTask();
+    task->function = function;
+    task->parameters = parameters;
+    task->stackDepth = stackDepth;
+    task->priority = std::min<UBaseType_t>(priority, configMAX_PRIORITIES - 1);
+    task->node = node;
+    strncpy(task->name, name != nullptr ? name : "", sizeof(task->name) - 1);
+
+    task->stackSize = LM_HOST_STACK_SIZE;
+    task->stack = mmap(nullptr, task->stackSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+
+    if (task->stack == MAP_FAILED) {
+        delete task;
+        return nullptr;
+    }
+
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = task->stack;
+    task->context.uc_stack.ss_size = task->stackSize;
+    task->context.uc_link = nullptr;
+    makecontext(&task->context, taskEntry, 0);
+
+    task->state = HostTask::SUSPENDED;
+    makeReady(task);
+    return task;
+}
+
+void HostScheduler::run(uint64_t until) {
+    for (;;) {
+        HostTask* task = popReadyTask();
+        if (task != nullptr) {
+            switchTo(task);
+            freeDeletedTasks();
+            continue;
+        }
+
+        if (events.empty() || events.top().time > until)
+            break;
+
+        // The action is moved out before removing the event, it can schedule new events
+        Event event = std::move(const_cast<Event&>(events.top()));
+        events.pop();
+
+        currentTime = event.time;
+        currentNode = event.node;
+        executedEvents++;
+
+        event.action();
+
+        currentNode = 0;
+    }
+
+    currentTime = std::max(currentTime, until);
+}
+
+bool HostScheduler::block(HostTask::State state, uint64_t deadline) {
+    HostTask* task = currentTask;
+    task->state = state;
+    task->timedOut = false;
+
+    if (deadline != FOREVER) {
+        uint64_t blockId = task->blockId;
+        schedule(deadline, task->node, [task, blockId]() {
+            if (task->blockId != blockId || task->state == HostTask::DELETED)
+                return;
+
+            task->timedOut = true;
+            makeReady(task);
+        });
+    }
+
+    switchToScheduler();
+
+    return !task->timedOut;
+}
+
+void HostScheduler::makeReady(HostTask* task) {
+    // Only the blocked and suspended tasks can be made ready
+    if (task->state == HostTask::READY || task->state == HostTask::RUNNING || task->state == HostTask::DELETED)
+        return;
+
+    if (task->waitingSemaphore != nullptr) {
+        std::deque<HostTask*>& waiting = task->waitingSemaphore->waiting;
+        waiting.erase(std::remove(waiting.begin(), waiting.end(), task), waiting.end());
+        task->waitingSemaphore = nullptr;
+    }
+
+    task->blockId++;
+    task->state = HostTask::READY;
+    readyTasks[task->priority].push_back(task);
+
+    if (currentTask != nullptr && task->priority > currentTask->priority)
+        preemptionPending = true;
+
+    preempt();
+}
+
+void HostScheduler::yield() {
+    if (currentTask == nullptr)
+        return;
+
+    currentTask->state = HostTask::READY;
+    readyTasks[currentTask->priority].push_back(currentTask);
+    switchToScheduler();
+}
+
+void HostScheduler::suspend(HostTask* task) {
+    if (task->state == HostTask::DELETED)
+        return;
+
+    if (task->state == HostTask::READY)
+        removeReadyTask(task);
+
+    if (task->waitingSemaphore != nullptr) {
+        std::deque<HostTask*>& waiting = task->waitingSemaphore->waiting;
+        waiting.erase(std::remove(waiting.begin(), waiting.end(), task), waiting.end());
+        task->waitingSemaphore = nullptr;
+    }
+
+    task->blockId++;
+    task->state = HostTask::SUSPENDED;
+
+    if (task == currentTask)
+        switchToScheduler();
+}
+
+void HostScheduler::deleteTask(HostTask* task) {
+    if (task->state == HostTask::DELETED)
+        return;
+
+    if (task->state == HostTask::READY)
+        removeReadyTask(task);
+
+    if (task->waitingSemaphore != nullptr) {
+        std::deque<HostTask*>& waiting = task->waitingSemaphore->waiting;
+        waiting.erase(std::remove(waiting.begin(), waiting.end(), task), waiting.end());
+        task->waitingSemaphore = nullptr;
+    }
+
+    task->blockId++;
+    task->state = HostTask::DELETED;
+    deletedTasks.push_back(task);
+
+    if (task == currentTask) {
+        switchToScheduler();
+        // A deleted task is never switched to again
+        abort();
+    }
+}
+
+void HostScheduler::setPriority(HostTask* task, UBaseType_t priority) {
+    priority = std::min<UBaseType_t>(priority, configMAX_PRIORITIES - 1);
+    if (task->priority == priority)
+        return;
+
+    bool ready = task->state == HostTask::READY;
+    if (ready)
+        removeReadyTask(task);
+
+    task->priority = priority;
+
+    if (ready)
+        readyTasks[priority].push_back(task);
+
+    if (currentTask != nullptr && getHighestReadyPriority() > (int) currentTask->priority)
+        preemptionPending = true;
+
+    preempt();
+}
+
+void HostScheduler::exitCritical() {
+    if (criticalNesting > 0)
+        criticalNesting--;
+
+    preempt();
+}
+
+HostTask* HostScheduler::popReadyTask() {
+    int priority = getHighestReadyPriority();
+    if (priority < 0)
+        return nullptr;
+
+    HostTask* task = readyTasks[priority].front();
+    readyTasks[priority].pop_front();
+    return task;
+}
+
+int HostScheduler::getHighestReadyPriority() {
+    for (int priority = configMAX_PRIORITIES - 1; priority >= 0; priority--)
+        if (!readyTasks[priority].empty())
+            return priority;
+
+    return -1;
+}
+
+void HostScheduler::removeReadyTask(HostTask* task) {
+    std::deque<HostTask*>& ready = readyTasks[task->priority];
+    ready.erase(std::remove(ready.begin(), ready.end(), task), ready.end());
+}
+
+void HostScheduler::preempt() {
+    if (!preemptionPending || criticalNesting > 0 || currentTask == nullptr)
+        return;
+
+    preemptionPending = false;
+
+    if (getHighestReadyPriority() <= (int) currentTask->priority)
+        return;
+
+    // The preempted task continues before the other tasks of its priority
+    currentTask->state = HostTask::READY;
+    readyTasks[currentTask->priority].push_front(currentTask);
+    switchToScheduler();
+}
+
+void HostScheduler::switchTo(HostTask* task) {
+    HostTask* previousTask = currentTask;
+    uint16_t previousNode = currentNode;
+
+    currentTask = task;
+    currentNode = task->node;
+    task->state = HostTask::RUNNING;
+    taskSwitches++;
+
+    swapcontext(&schedulerContext, &task->context);
+
+    currentTask = previousTask;
+    currentNode = previousNode;
+}
+
+void HostScheduler::switchToScheduler() {
+    HostTask* task = currentTask;
+
+    // A critical section ends when the task blocks
+    criticalNesting = 0;
+    preemptionPending = false;
+
+    swapcontext(&task->context, &schedulerContext);
+}
+
+void HostScheduler::freeDeletedTasks() {
+    for (HostTask* task : deletedTasks) {
+        munmap(task->stack, task->stackSize);
+        task->stack = nullptr;
+    }
+
+    // The tasks are not freed, a timeout event can still reference them
+    deletedTasks.clear();
+}
+
+void HostScheduler::taskEntry() {
+    HostTask* task = currentTask;
+    task->function(task->parameters);
+
+    // A FreeRTOS task must not return, it is deleted
+    fprintf(stderr, "Task %s of the node %X returned\n", task->name, task->node);
+    deleteTask(task);
+}
+
+uint64_t HostScheduler::currentTime = 0;
+
+uint64_t HostScheduler::eventSequence = 0;
+
+uint64_t HostScheduler::taskSwitches = 0;
+
+uint64_t HostScheduler::executedEvents = 0;
+
+uint16_t HostScheduler::currentNode = 0;
+
+HostTask* HostScheduler::currentTask = nullptr;
+
+uint32_t HostScheduler::criticalNesting = 0;
+
+bool HostScheduler::preemptionPending = false;
+
+ucontext_t HostScheduler::schedulerContext;
+
+std::priority_queue<HostScheduler::Event, std::vector<HostScheduler::Event>, std::greater<HostScheduler::Event>>
+HostScheduler::events;
+
+std::deque<HostTask*> HostScheduler::readyTasks[configMAX_PRIORITIES];
+
+std::vector<HostTask*> HostScheduler::deletedTasks;
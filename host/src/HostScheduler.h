@@ -0,0 +1,251 @@
+#ifndef _LORAMESHER_HOST_SCHEDULER_H
+#define _LORAMESHER_HOST_SCHEDULER_H
+
+#include <freertos/FreeRTOS.h>
+
+#include <ucontext.h>
+
+#include <deque>
+#include <functional>
+#include <queue>
+#include <vector>
+
+/**
+ * @brief Task of the host FreeRTOS, a coroutine with its own stack
+ *
+ */
+struct HostTask {
+    enum State : uint8_t {
+        READY = 0,
+        RUNNING,
+        DELAYED,
+        WAITING_NOTIFICATION,
+        WAITING_SEMAPHORE,
+        SUSPENDED,
+        DELETED
+    };
+
+    ucontext_t context;
+    void* stack = nullptr;
+    size_t stackSize = 0;
+
+    TaskFunction_t function = nullptr;
+    void* parameters = nullptr;
+    char name[16] = {};
+    uint32_t stackDepth = 0;
+
+    UBaseType_t priority = 0;
+    uint16_t node = 0;
+    State state = READY;
+
+    // Incremented every time the task leaves a blocked state, the timeouts of the previous blocks are ignored
+    uint64_t blockId = 0;
+    bool timedOut = false;
+    HostSemaphore* waitingSemaphore = nullptr;
+
+    uint32_t notificationValue = 0;
+    bool notificationPending = false;
+};
+
+/**
+ * @brief Mutex of the host FreeRTOS. The ownership is given to the first waiting task when it is released.
+ *
+ */
+struct HostSemaphore {
+    HostTask* owner = nullptr;
+    uint32_t count = 0;
+    bool recursive = false;
+    std::deque<HostTask*> waiting;
+};
+
+/**
+ * @brief Discrete-event scheduler of the simulator. It keeps the virtual time in microseconds, the events ordered by
+ * time and the tasks of all the nodes. The ready tasks run by priority until they block, the code takes no virtual
+ * time. When no task is ready the next event is executed, moving the virtual time forward. The events run outside
+ * any task, like the interrupts of the radio, with the node of the event as the current node.
+ *
+ */
+class HostScheduler {
+public:
+    static constexpr uint64_t FOREVER = UINT64_MAX;
+
+    /**
+     * @brief Virtual time in microseconds
+     *
+     */
+    static uint64_t now() { return currentTime; }
+
+    /**
+     * @brief Schedule an event
+     *
+     * @param time Virtual time in microseconds, if it is in the past it is executed now
+     * @param node Node of the event, 0 for the simulator
+     * @param action Action of the event
+     */
+    static void schedule(uint64_t time, uint16_t node, std::function<void()> action);
+
+    /**
+     * @brief Create a task
+     *
+     * @param function Function of the task
+     * @param name Name of the task
+     * @param stackDepth Stack depth requested by the code, the host stacks are always of LM_HOST_STACK_SIZE bytes
+     * @param parameters Parameters of the function
+     * @param priority Priority
+     * @param node Node of the task, the tasks created by the task belong to the same node
+     * @return HostTask* Task
+     */
+    static HostTask* createTask(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameters,
+        UBaseType_t priority, uint16_t node);
+
+    /**
+     * @brief Run the tasks and the events until the virtual time or until there is nothing to run
+     *
+     * @param until Virtual time in microseconds
+     */
+    static void run(uint64_t until);
+
+    /**
+     * @brief Task running, nullptr inside the events
+     *
+     */
+    static HostTask* getCurrentTask() { return currentTask; }
+
+    /**
+     * @brief Node of the task or event running
+     *
+     */
+    static uint16_t getCurrentNode() { return currentNode; }
+
+    /**
+     * @brief Block the current task until it is made ready or the deadline passes
+     *
+     * @param state Blocked state
+     * @param deadline Virtual time in microseconds or FOREVER
+     * @return true If it has been made ready before the deadline
+     */
+    static bool block(HostTask::State state, uint64_t deadline);
+
+    /**
+     * @brief Make a task ready to run, it preempts the current task when the critical sections end if
+     * it has a higher priority
+     *
+     */
+    static void makeReady(HostTask* task);
+
+    /**
+     * @brief Yield the current task to the other ready tasks of the same or higher priority
+     *
+     */
+    static void yield();
+
+    /**
+     * @brief Suspend a task, it is removed from the ready tasks and its timeouts are ignored
+     *
+     */
+    static void suspend(HostTask* task);
+
+    /**
+     * @brief Delete a task. If it is the current task it does not return.
+     *
+     */
+    static void deleteTask(HostTask* task);
+
+    /**
+     * @brief Change the priority of a task
+     *
+     */
+    static void setPriority(HostTask* task, UBaseType_t priority);
+
+    static void enterCritical() { criticalNesting++; }
+
+    static void exitCritical();
+
+    /**
+     * @brief Number of task switches executed
+     *
+     */
+    static uint64_t getTaskSwitches() { return taskSwitches; }
+
+    /**
+     * @brief Number of events executed
+     *
+     */
+    static uint64_t getExecutedEvents() { return executedEvents; }
+
+private:
+    struct Event {
+        uint64_t time;
+        uint64_t sequence;
+        uint16_t node;
+        std::function<void()> action;
+
+        bool operator>(const Event& other) const {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    static uint64_t currentTime;
+    static uint64_t eventSequence;
+    static uint64_t taskSwitches;
+    static uint64_t executedEvents;
+    static uint16_t currentNode;
+    static HostTask* currentTask;
+    static uint32_t criticalNesting;
+    static bool preemptionPending;
+
+    static ucontext_t schedulerContext;
+    static std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    static std::deque<HostTask*> readyTasks[configMAX_PRIORITIES];
+    static std::vector<HostTask*> deletedTasks;
+
+    /**
+     * @brief Highest priority ready task, removed from the ready tasks
+     *
+     */
+    static HostTask* popReadyTask();
+
+    /**
+     * @brief Priority of the highest priority ready task, -1 if none
+     *
+     */
+    static int getHighestReadyPriority();
+
+    /**
+     * @brief Remove a task from the ready tasks
+     *
+     */
+    static void removeReadyTask(HostTask* task);
+
+    /**
+     * @brief Preempt the current task if a higher priority task is ready
+     *
+     */
+    static void preempt();
+
+    /**
+     * @brief Switch from the scheduler to a task until it blocks
+     *
+     */
+    static void switchTo(HostTask* task);
+
+    /**
+     * @brief Switch from the current task to the scheduler
+     *
+     */
+    static void switchToScheduler();
+
+    /**
+     * @brief Free the stacks of the deleted tasks, they are never running
+     *
+     */
+    static void freeDeletedTasks();
+
+    /**
+     * @brief First function of every task
+     *
+     */
+    static void taskEntry();
+};
+
+#endif
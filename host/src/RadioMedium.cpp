@@ -0,0 +1,151 @@
+#include "RadioMedium.h"
+
+#include "HostScheduler.h"
+#include "SimModule.h"
+
+#include <algorithm>
+#include <cmath>
+
+void RadioMedium::configure(const Config& configuration) {
+    config = configuration;
+    generator.seed(config.seed);
+}
+
+void RadioMedium::addModule(SimModule* module) {
+    module->index = modules.size();
+    modules.push_back(module);
+}
+
+void RadioMedium::startTransmission(SimModule* sender, const uint8_t* data, size_t length, uint64_t duration) {
+    Transmission* transmission = new Transmission();
+    transmission->sender = sender;
+    transmission->start = HostScheduler::now();
+    transmission->end = transmission->start + duration;
+    transmission->frequency = sender->frequency;
+    transmission->bandwidth = sender->bandwidth;
+    transmission->spreadingFactor = sender->spreadingFactor;
+    transmission->syncWord = sender->syncWord;
+    transmission->data.assign(data, data + length);
+    transmission->receivedPower.resize(modules.size());
+
+    stats.transmissions++;
+    stats.airtime += duration;
+
+    std::normal_distribution<double> shadowing(0, config.shadowing);
+    double noiseFloor = getNoiseFloor(transmission->bandwidth);
+    double snrThreshold = getSnrThreshold(transmission->spreadingFactor);
+
+    for (SimModule* receiver : modules) {
+        if (receiver == sender)
+            continue;
+
+        double power = getMeanReceivedPower(sender, receiver);
+        if (config.shadowing > 0)
+            power += shadowing(generator);
+
+        transmission->receivedPower[receiver->index] = (float) power;
+
+        // The packet interferes with the packet being received
+        SimModule::Reception& reception = receiver->reception;
+        if (reception.transmission != nullptr && isSameChannel(*transmission, *reception.transmission) &&
+            reception.rssi - power < config.captureThreshold)
+            reception.corrupted = true;
+
+        double snr = power - noiseFloor;
+        if (snr < snrThreshold || !isSameChannel(*transmission, receiver))
+            continue;
+
+        if (receiver->mode != SimModule::Mode::RECEIVE) {
+            stats.notListening++;
+            continue;
+        }
+
+        if (reception.transmission != nullptr)
+            continue;
+
+        // The packets already on the air interfere with it
+        bool corrupted = false;
+        for (Transmission* other : active)
+            if (isSameChannel(*transmission, *other) &&
+                power - other->receivedPower[receiver->index] < config.captureThreshold)
+                corrupted = true;
+
+        reception = {transmission, (float) power, (float) snr, corrupted};
+    }
+
+    active.push_back(transmission);
+
+    HostScheduler::schedule(transmission->end, sender->getNode(), [transmission]() {
+        endTransmission(transmission);
+    });
+}
+
+bool RadioMedium::isChannelBusy(SimModule* listener) {
+    double floor = getNoiseFloor(listener->bandwidth) + getSnrThreshold(listener->spreadingFactor);
+
+    for (Transmission* transmission : active)
+        if (transmission->sender != listener && isSameChannel(*transmission, listener) &&
+            transmission->receivedPower[listener->index] >= floor)
+            return true;
+
+    return false;
+}
+
+double RadioMedium::getMeanReceivedPower(const SimModule* sender, const SimModule* receiver) {
+    double distance = std::hypot(sender->getX() - receiver->getX(), sender->getY() - receiver->getY());
+    double pathLoss = config.referenceLoss + 10 * config.pathLossExponent * std::log10(std::max(distance, 1.0));
+    return sender->power - pathLoss;
+}
+
+double RadioMedium::getNoiseFloor(float bandwidth) {
+    return -174 + 10 * std::log10(bandwidth * 1000.0) + config.noiseFigure;
+}
+
+double RadioMedium::getSnrThreshold(uint8_t spreadingFactor) {
+    // -7.5 dB at SF7 and 2.5 dB less for every spreading factor, as in the datasheets
+    return -7.5 - 2.5 * (spreadingFactor - 7);
+}
+
+void RadioMedium::endTransmission(Transmission* transmission) {
+    active.erase(std::find(active.begin(), active.end(), transmission));
+
+    for (SimModule* receiver : modules) {
+        SimModule::Reception& reception = receiver->reception;
+        if (reception.transmission != transmission)
+            continue;
+
+        reception.transmission = nullptr;
+
+        if (reception.corrupted) {
+            stats.collisions++;
+            continue;
+        }
+
+        stats.delivered++;
+        receiver->packetReceived(*transmission, reception.rssi, reception.snr);
+    }
+
+    transmission->sender->transmissionDone();
+    delete transmission;
+}
+
+bool RadioMedium::isSameChannel(const Transmission& transmission, const SimModule* module) {
+    return std::fabs(transmission.frequency - module->frequency) * 1000 < transmission.bandwidth / 2 &&
+        transmission.bandwidth == module->bandwidth && transmission.spreadingFactor == module->spreadingFactor &&
+        transmission.syncWord == module->syncWord;
+}
+
+bool RadioMedium::isSameChannel(const Transmission& a, const Transmission& b) {
+    return std::fabs(a.frequency - b.frequency) * 1000 < a.bandwidth / 2 && a.bandwidth == b.bandwidth &&
+        a.spreadingFactor == b.spreadingFactor;
+}
+
+RadioMedium::Config RadioMedium::config;
+
+MediumStats RadioMedium::stats = {};
+
+std::vector<SimModule*> RadioMedium::modules;
+
+std::list<Transmission*> RadioMedium::active;
+
+std::mt19937_64 RadioMedium::generator;
@@ -0,0 +1,134 @@
+#ifndef _LORAMESHER_HOST_RADIO_MEDIUM_H
+#define _LORAMESHER_HOST_RADIO_MEDIUM_H
+
+#include <cstdint>
+#include <list>
+#include <random>
+#include <vector>
+
+class SimModule;
+
+/**
+ * @brief Packet on the air
+ *
+ */
+struct Transmission {
+    SimModule* sender;
+    uint64_t start;
+    uint64_t end;
+    float frequency;
+    float bandwidth;
+    uint8_t spreadingFactor;
+    uint8_t syncWord;
+    std::vector<uint8_t> data;
+
+    // Power received by every module in dBm, by the index of the module
+    std::vector<float> receivedPower;
+};
+
+/**
+ * @brief Statistics of the medium
+ *
+ */
+struct MediumStats {
+    uint64_t transmissions;     // Packets transmitted
+    uint64_t airtime;           // Time on air of all the packets in microseconds
+    uint64_t delivered;         // Packets received without errors, for every receiver
+    uint64_t collisions;        // Receptions lost by the interference of another packet
+    uint64_t notListening;      // Packets over the sensitivity of a receiver that was not receiving
+    uint64_t aborted;           // Receptions aborted because the receiver transmitted or changed its configuration
+};
+
+/**
+ * @brief Shared medium of the simulated modules. The power at a receiver has a log-distance path loss and a normal
+ * shadowing for every packet. A receiver in receive mode with the same frequency, bandwidth, spreading factor and
+ * sync word locks to a packet at its start if its SNR is over the demodulation floor of the spreading factor.
+ * The packet is lost if another packet of the same channel overlaps it without being captureThreshold dB weaker.
+ * The packets of different channels or spreading factors do not interfere.
+ *
+ */
+class RadioMedium {
+public:
+    struct Config {
+        double pathLossExponent = 2.7;      // Exponent of the log-distance path loss
+        double referenceLoss = 31.2;        // Path loss at 1 m in dB, free space at 868 MHz
+        double shadowing = 0;               // Standard deviation of the shadowing of every packet in dB
+        double noiseFigure = 6;             // Noise figure of the receivers in dB
+        double captureThreshold = 6;        // A packet survives an overlapping packet that is this dB weaker
+        uint64_t seed = 1;                  // Seed of the shadowing
+    };
+
+    static void configure(const Config& config);
+
+    /**
+     * @brief Add a module, it is the index of the received powers
+     *
+     */
+    static void addModule(SimModule* module);
+
+    /**
+     * @brief Put a packet on the air, the receivers lock to it now and get it at the end
+     *
+     * @param sender Module
+     * @param data Packet
+     * @param length Length in bytes
+     * @param duration Time on air in microseconds
+     */
+    static void startTransmission(SimModule* sender, const uint8_t* data, size_t length, uint64_t duration);
+
+    /**
+     * @brief Any packet of the channel of the module is received over the demodulation floor
+     *
+     */
+    static bool isChannelBusy(SimModule* listener);
+
+    /**
+     * @brief Mean power received between two modules in dBm
+     *
+     */
+    static double getMeanReceivedPower(const SimModule* sender, const SimModule* receiver);
+
+    /**
+     * @brief Thermal noise with the noise figure in dBm
+     *
+     * @param bandwidth Bandwidth in kHz
+     */
+    static double getNoiseFloor(float bandwidth);
+
+    /**
+     * @brief Minimum SNR to demodulate a spreading factor in dB
+     *
+     */
+    static double getSnrThreshold(uint8_t spreadingFactor);
+
+    /**
+     * @brief A module has stopped receiving a packet
+     *
+     */
+    static void receptionAborted() { stats.aborted++; }
+
+    static const MediumStats& getStats() { return stats; }
+
+private:
+    static Config config;
+    static MediumStats stats;
+    static std::vector<SimModule*> modules;
+    static std::list<Transmission*> active;
+    static std::mt19937_64 generator;
+
+    /**
+     * @brief The packet ends, it is given to the receivers locked to it and the sender is notified
+     *
+     */
+    static void endTransmission(Transmission* transmission);
+
+    /**
+     * @brief The module would receive the packet with its configuration
+     *
+     */
+    static bool isSameChannel(const Transmission& transmission, const SimModule* module);
+
+    static bool isSameChannel(const Transmission& a, const Transmission& b);
+};
+
+#endif
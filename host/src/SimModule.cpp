@@ -0,0 +1,277 @@
+#include "SimModule.h"
+
+#include "HostScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+SimModule::SimModule(uint16_t node, double x, double y): node(node), x(x), y(y) {
+    RadioMedium::addModule(this);
+}
+
+int16_t SimModule::begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t syncWord, int8_t power,
+    int16_t preambleLength) {
+
+    abortReception();
+    mode = Mode::STANDBY;
+
+    frequency = freq;
+    bandwidth = bw;
+    spreadingFactor = sf;
+    codingRate = cr;
+    this->syncWord = syncWord;
+    this->power = power;
+    this->preambleLength = preambleLength;
+
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::receive(uint8_t* data, size_t len) {
+    // LoraMesher only receives with interrupts
+    (void) data;
+    (void) len;
+    return RADIOLIB_ERR_UNKNOWN;
+}
+
+int16_t SimModule::startReceive() {
+    if (mode == Mode::TRANSMIT)
+        return RADIOLIB_ERR_UNKNOWN;
+
+    // A reception in progress continues
+    mode = Mode::RECEIVE;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::scanChannel() {
+    abortReception();
+    mode = Mode::SCAN;
+
+    bool busy = RadioMedium::isChannelBusy(this);
+    vTaskDelay((getScanTime() + 999) / 1000 / portTICK_PERIOD_MS);
+    busy = busy || RadioMedium::isChannelBusy(this);
+
+    mode = Mode::STANDBY;
+    return busy ? RADIOLIB_PREAMBLE_DETECTED : RADIOLIB_CHANNEL_FREE;
+}
+
+int16_t SimModule::startChannelScan() {
+    abortReception();
+    mode = Mode::SCAN;
+
+    HostScheduler::schedule(HostScheduler::now() + getScanTime(), node, [this]() {
+        if (mode != Mode::SCAN)
+            return;
+
+        mode = Mode::STANDBY;
+        if (scanAction != nullptr)
+            scanAction();
+    });
+
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::standby() {
+    if (mode == Mode::TRANSMIT)
+        return RADIOLIB_ERR_NONE;
+
+    abortReception();
+    mode = Mode::STANDBY;
+    return RADIOLIB_ERR_NONE;
+}
+
+void SimModule::reset() {
+    standby();
+}
+
+int16_t SimModule::setCRC(bool crc) {
+    this->crc = crc;
+    return RADIOLIB_ERR_NONE;
+}
+
+size_t SimModule::getPacketLength() {
+    return rxLength;
+}
+
+float SimModule::getRSSI() {
+    return rxRssi;
+}
+
+float SimModule::getSNR() {
+    return rxSnr;
+}
+
+int16_t SimModule::readData(uint8_t* buffer, size_t numBytes) {
+    memcpy(buffer, rxBuffer, std::min(numBytes, rxLength));
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::transmit(uint8_t* buffer, size_t length) {
+    int16_t res = startTransmit(buffer, length);
+    if (res != RADIOLIB_ERR_NONE)
+        return res;
+
+    while (mode == Mode::TRANSMIT)
+        vTaskDelay(1);
+
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::startTransmit(uint8_t* buffer, size_t length) {
+    if (mode == Mode::TRANSMIT || length == 0 || length > sizeof(rxBuffer))
+        return RADIOLIB_ERR_UNKNOWN;
+
+    // Half duplex, the packet being received is lost
+    abortReception();
+    mode = Mode::TRANSMIT;
+
+    uint64_t duration = getTimeOnAir(length);
+    stats.txPackets++;
+    stats.txAirtime += duration;
+
+    RadioMedium::startTransmission(this, buffer, length, duration);
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::finishTransmit() {
+    if (mode == Mode::TRANSMIT)
+        return RADIOLIB_ERR_UNKNOWN;
+
+    mode = Mode::STANDBY;
+    return RADIOLIB_ERR_NONE;
+}
+
+uint32_t SimModule::getTimeOnAir(size_t length) {
+    // Semtech AN1200.13, explicit header
+    double symbolTime = (double) (1 << spreadingFactor) / (bandwidth * 1000.0);
+    int lowDataRateOptimize = symbolTime > 0.016 ? 1 : 0;
+    int cr = std::clamp<int>(codingRate - 4, 1, 4);
+
+    double numerator = 8.0 * length - 4.0 * spreadingFactor + 28 + (crc ? 16 : 0);
+    double denominator = 4.0 * (spreadingFactor - 2 * lowDataRateOptimize);
+    double payloadSymbols = 8 + std::max(std::ceil(numerator / denominator) * (cr + 4), 0.0);
+
+    double preambleTime = (preambleLength + 4.25) * symbolTime;
+    return (uint32_t) std::lround((preambleTime + payloadSymbols * symbolTime) * 1e6);
+}
+
+void SimModule::setDioActionForReceiving(void (*action)()) {
+    receiveAction = action;
+}
+
+void SimModule::setDioActionForTransmitting(void (*action)()) {
+    transmitAction = action;
+}
+
+void SimModule::setDioActionForReceivingTimeout(void (*action)()) {
+    // There are no receive timeouts, the module receives continuously
+    (void) action;
+}
+
+void SimModule::setDioActionForScanning(void (*action)()) {
+    scanAction = action;
+}
+
+void SimModule::setDioActionForScanningTimeout(void (*action)()) {
+    (void) action;
+}
+
+void SimModule::clearDioActions() {
+    receiveAction = nullptr;
+    transmitAction = nullptr;
+    scanAction = nullptr;
+}
+
+int16_t SimModule::setFrequency(float freq) {
+    if (freq != frequency)
+        abortReception();
+
+    frequency = freq;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::setBandwidth(float bw) {
+    if (bw != bandwidth)
+        abortReception();
+
+    bandwidth = bw;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::setSpreadingFactor(uint8_t sf) {
+    if (sf != spreadingFactor)
+        abortReception();
+
+    spreadingFactor = sf;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::setCodingRate(uint8_t cr) {
+    codingRate = cr;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::setSyncWord(uint8_t syncWord) {
+    if (syncWord != this->syncWord)
+        abortReception();
+
+    this->syncWord = syncWord;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::setOutputPower(int8_t power) {
+    this->power = power;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::setPreambleLength(int16_t preambleLength) {
+    this->preambleLength = preambleLength;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::setGain(uint8_t gain) {
+    (void) gain;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SimModule::setOutputPower(int8_t power, int8_t useRfo) {
+    (void) useRfo;
+    return setOutputPower(power);
+}
+
+void SimModule::abortReception() {
+    if (reception.transmission == nullptr)
+        return;
+
+    reception.transmission = nullptr;
+    RadioMedium::receptionAborted();
+}
+
+uint64_t SimModule::getScanTime() {
+    // Two symbols and the processing of the detection, about half a symbol
+    return (uint64_t) (2.5 * (1 << spreadingFactor) * 1000.0 / bandwidth);
+}
+
+void SimModule::packetReceived(const Transmission& transmission, float rssi, float snr) {
+    size_t length = std::min(transmission.data.size(), sizeof(rxBuffer));
+    memcpy(rxBuffer, transmission.data.data(), length);
+    rxLength = length;
+    rxRssi = rssi;
+    rxSnr = snr;
+
+    stats.rxPackets++;
+    interrupt(receiveAction);
+}
+
+void SimModule::transmissionDone() {
+    mode = Mode::STANDBY;
+    interrupt(transmitAction);
+}
+
+void SimModule::interrupt(void (*action)()) {
+    if (action == nullptr)
+        return;
+
+    // The action runs as an event of the node, like an interrupt of its radio
+    HostScheduler::schedule(HostScheduler::now(), node, action);
+}
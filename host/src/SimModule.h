@@ -0,0 +1,155 @@
+#ifndef _LORAMESHER_HOST_SIM_MODULE_H
+#define _LORAMESHER_HOST_SIM_MODULE_H
+
+#include "modules/LM_Module.h"
+
+#include "RadioMedium.h"
+
+/**
+ * @brief Simulated LoRa module of a node. The time on air is the one of the Semtech datasheets, the packets are
+ * sent and received through the RadioMedium and the interrupts are events of the node in virtual time.
+ *
+ */
+class SimModule : public LM_Module {
+public:
+    /**
+     * @brief Statistics of the module
+     *
+     */
+    struct Stats {
+        uint32_t txPackets;
+        uint32_t rxPackets;
+        uint64_t txAirtime;     // In microseconds
+    };
+
+    /**
+     * @brief Create a simulated module
+     *
+     * @param node Node of the module, its interrupts are events of this node
+     * @param x Position in meters
+     * @param y Position in meters
+     */
+    SimModule(uint16_t node, double x, double y);
+
+    int16_t begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t syncWord, int8_t power,
+        int16_t preambleLength) override;
+
+    int16_t receive(uint8_t* data, size_t len) override;
+    int16_t startReceive() override;
+    int16_t scanChannel() override;
+    int16_t startChannelScan() override;
+    int16_t standby() override;
+    void reset() override;
+    int16_t setCRC(bool crc) override;
+    size_t getPacketLength() override;
+    float getRSSI() override;
+    float getSNR() override;
+    int16_t readData(uint8_t* buffer, size_t numBytes) override;
+    int16_t transmit(uint8_t* buffer, size_t length) override;
+    int16_t startTransmit(uint8_t* buffer, size_t length) override;
+    int16_t finishTransmit() override;
+    uint32_t getTimeOnAir(size_t length) override;
+
+    void setDioActionForReceiving(void (*action)()) override;
+    void setDioActionForTransmitting(void (*action)()) override;
+    void setDioActionForReceivingTimeout(void (*action)()) override;
+    void setDioActionForScanning(void (*action)()) override;
+    void setDioActionForScanningTimeout(void (*action)()) override;
+    void clearDioActions() override;
+
+    int16_t setFrequency(float freq) override;
+    int16_t setBandwidth(float bw) override;
+    int16_t setSpreadingFactor(uint8_t sf) override;
+    int16_t setCodingRate(uint8_t cr) override;
+    int16_t setSyncWord(uint8_t syncWord) override;
+    int16_t setOutputPower(int8_t power) override;
+    int16_t setPreambleLength(int16_t preambleLength) override;
+    int16_t setGain(uint8_t gain) override;
+    int16_t setOutputPower(int8_t power, int8_t useRfo) override;
+
+    uint16_t getNode() const { return node; }
+    double getX() const { return x; }
+    double getY() const { return y; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    friend class RadioMedium;
+
+    enum class Mode : uint8_t {
+        STANDBY = 0,
+        RECEIVE,
+        TRANSMIT,
+        SCAN
+    };
+
+    /**
+     * @brief Packet that the module is receiving
+     *
+     */
+    struct Reception {
+        const Transmission* transmission;
+        float rssi;
+        float snr;
+        bool corrupted;
+    };
+
+    uint16_t node;
+    double x;
+    double y;
+    size_t index = 0;
+
+    Mode mode = Mode::STANDBY;
+    float frequency = 868;
+    float bandwidth = 125;
+    uint8_t spreadingFactor = 7;
+    uint8_t codingRate = 7;
+    uint8_t syncWord = 0x12;
+    int8_t power = 10;
+    int16_t preambleLength = 8;
+    bool crc = true;
+
+    Reception reception = {};
+
+    uint8_t rxBuffer[256];
+    size_t rxLength = 0;
+    float rxRssi = 0;
+    float rxSnr = 0;
+
+    void (*receiveAction)() = nullptr;
+    void (*transmitAction)() = nullptr;
+    void (*scanAction)() = nullptr;
+
+    Stats stats = {};
+
+    /**
+     * @brief Stop the reception in progress, the module leaves the receive mode or changes its channel
+     *
+     */
+    void abortReception();
+
+    /**
+     * @brief Duration of a channel activity detection in microseconds
+     *
+     */
+    uint64_t getScanTime();
+
+    /**
+     * @brief A packet has been received, called by the medium
+     *
+     */
+    void packetReceived(const Transmission& transmission, float rssi, float snr);
+
+    /**
+     * @brief The transmission has ended, called by the medium
+     *
+     */
+    void transmissionDone();
+
+    /**
+     * @brief Call an interrupt action as an event of the node
+     *
+     */
+    void interrupt(void (*action)());
+};
+
+#endif
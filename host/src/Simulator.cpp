@@ -0,0 +1,521 @@
+#include "HostNode.h"
+#include "HostScheduler.h"
+#include "RadioMedium.h"
+#include "SimModule.h"
+
+#include <esp_log.h>
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef LM_HOST_NODE_LIBRARY
+#define LM_HOST_NODE_LIBRARY "libloramesher_node.so"
+#endif
+
+void hostSeedRandom(uint64_t seed);
+
+/**
+ * @brief Options of the simulation
+ *
+ */
+struct SimulatorOptions {
+    uint32_t nodes = 25;
+    std::string topology = "grid";
+    double spacing = 3000;
+    uint32_t duration = 3600;
+    uint32_t bootTime = 10;
+    uint32_t trafficStart = 1200;
+    uint32_t sendPeriod = 60;
+    uint16_t payloadSize = 20;
+    uint32_t maxAge = 0;
+    uint16_t sendQueueSize = LM_SEND_QUEUE_SIZE;
+    uint32_t multicastSize = 0;
+    uint8_t spreadingFactor = 7;
+    int8_t power = 6;
+    bool listenBeforeTalk = false;
+    bool adaptiveDataRate = false;
+    bool compactHello = false;
+    bool aggregation = false;
+    bool flooding = false;
+    bool reliable = false;
+    uint8_t dataChannels = 0;
+    uint16_t ackDelay = LM_ACK_DELAY;
+    bool fec = false;
+    bool congestionControl = false;
+    uint32_t gateways = 0;
+    bool gatewayLoad = false;
+    bool compactHeader = false;
+    bool slottedAccess = false;
+    bool appPayloadHandler = false;
+    bool dataRadio = false;
+    RadioMedium::Config medium;
+    uint64_t seed = 1;
+    int logLevel = ESP_LOG_NONE;
+    std::string library = LM_HOST_NODE_LIBRARY;
+    std::string csv;
+    double checkDelivery = -1;
+    double checkCompactHeader = -1;
+    bool checkRoutes = false;
+    bool checkMulticast = false;
+};
+
+/**
+ * @brief Node of the simulation
+ *
+ */
+struct SimulatorNode {
+    SimModule* module;
+    SimModule* dataModule;
+    HostNodeParameters parameters;
+    HostNodeMain main;
+    HostNodeCollect collect;
+};
+
+static void printUsage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --nodes N                Number of nodes (25)\n"
+        "  --topology T             grid, line or random (grid)\n"
+        "  --spacing M              Distance between the nodes of the grid and the line, in meters (3000)\n"
+        "  --duration S             Virtual seconds to simulate (3600)\n"
+        "  --boot S                 The nodes start at a random time of the first S seconds (10)\n"
+        "  --traffic-start S        Second when the nodes start sending payloads (1200)\n"
+        "  --send-period S          Average seconds between the payloads of every node, 0 no traffic (60)\n"
+        "  --payload B              Bytes of every payload, larger than a packet only with --reliable (20)\n"
+        "  --max-age MS             The payloads are dropped after MS ms in the send queue (no limit)\n"
+        "  --send-queue N           Packets in the send queue of every node, 0 no limit (%d)\n"
+        "  --multicast B            The first node sends a reliable payload of B bytes to all the nodes at the traffic start\n"
+        "  --sf SF                  Spreading factor (7)\n"
+        "  --power DBM              Output power (6)\n"
+        "  --lbt                    Listen before talk\n"
+        "  --adr                    Adaptive data rate, the HELLO packets carry the link reports\n"
+        "  --compact-hello          Compact HELLO packets\n"
+        "  --aggregation            Aggregation of the data packets\n"
+        "  --flood                  The payloads are sent to the broadcast address and flooded to every node\n"
+        "  --reliable               The payloads are sent as reliable payloads, with SYNC and ACK packets\n"
+        "  --data-channels N        Data channels of the reliable payloads (0)\n"
+        "  --data-radio             Every node has a second module for the data channels\n"
+        "  --ack-delay MS           Milliseconds that the ACKs wait to be coalesced (%d)\n"
+        "  --fec                    Parity packets in the reliable payloads\n"
+        "  --congestion-control     Congestion windows of the next hops shared by the reliable payloads\n"
+        "  --gateways N             N nodes spread over the topology are gateways, the others send the payloads to the closest one\n"
+        "  --gateway-load           The HELLO packets advertise the load of the gateways\n"
+        "  --compact-header         The data packets to the neighbours are sent with the compact header\n"
+        "  --slotted                The nodes in range of a gateway send in the control channel only inside their slots\n"
+        "  --payload-handler        The payloads are given to a payload handler instead of the received queue\n"
+        "  --path-loss-exponent N   Exponent of the log-distance path loss (2.7)\n"
+        "  --shadowing DB           Standard deviation of the shadowing of every packet (0)\n"
+        "  --seed N                 Seed of the simulation (1)\n"
+        "  --log-level L            Log level of the nodes, 0 none to 5 verbose (0)\n"
+        "  --library PATH           Node library (%s)\n"
+        "  --csv FILE               Write the statistics of every node\n"
+        "  --check-delivery R       Fail if the delivery ratio is lower than R\n"
+        "  --check-compact-header R Fail if the ratio of the packets without HELLO sent with the compact header is lower than R\n"
+        "  --check-routes           Fail if any node has not a route to every other node\n"
+        "  --check-multicast        Fail if any node has not received the multicast payload\n",
+        program, LM_SEND_QUEUE_SIZE, LM_ACK_DELAY, LM_HOST_NODE_LIBRARY);
+}
+
+static bool parseOptions(int argc, char** argv, SimulatorOptions& options) {
+    enum {
+        NODES = 1, TOPOLOGY, SPACING, DURATION, BOOT, TRAFFIC_START, SEND_PERIOD, PAYLOAD, MAX_AGE, SEND_QUEUE, MULTICAST, SF, POWER, LBT,
+        ADR, COMPACT_HELLO, AGGREGATION, FLOOD, RELIABLE, DATA_CHANNELS, DATA_RADIO, ACK_DELAY, FEC, CONGESTION_CONTROL, GATEWAYS, GATEWAY_LOAD, COMPACT_HEADER, SLOTTED, PAYLOAD_HANDLER, PATH_LOSS_EXPONENT, SHADOWING, SEED, LOG_LEVEL, LIBRARY, CSV, CHECK_DELIVERY,
+        CHECK_COMPACT_HEADER, CHECK_ROUTES, CHECK_MULTICAST, HELP
+    };
+
+    static const option longOptions[] = {
+        {"nodes", required_argument, nullptr, NODES},
+        {"topology", required_argument, nullptr, TOPOLOGY},
+        {"spacing", required_argument, nullptr, SPACING},
+        {"duration", required_argument, nullptr, DURATION},
+        {"boot", required_argument, nullptr, BOOT},
+        {"traffic-start", required_argument, nullptr, TRAFFIC_START},
+        {"send-period", required_argument, nullptr, SEND_PERIOD},
+        {"payload", required_argument, nullptr, PAYLOAD},
+        {"max-age", required_argument, nullptr, MAX_AGE},
+        {"send-queue", required_argument, nullptr, SEND_QUEUE},
+        {"multicast", required_argument, nullptr, MULTICAST},
+        {"sf", required_argument, nullptr, SF},
+        {"power", required_argument, nullptr, POWER},
+        {"lbt", no_argument, nullptr, LBT},
+        {"adr", no_argument, nullptr, ADR},
+        {"compact-hello", no_argument, nullptr, COMPACT_HELLO},
+        {"aggregation", no_argument, nullptr, AGGREGATION},
+        {"flood", no_argument, nullptr, FLOOD},
+        {"reliable", no_argument, nullptr, RELIABLE},
+        {"data-channels", required_argument, nullptr, DATA_CHANNELS},
+        {"data-radio", no_argument, nullptr, DATA_RADIO},
+        {"ack-delay", required_argument, nullptr, ACK_DELAY},
+        {"fec", no_argument, nullptr, FEC},
+        {"gateways", required_argument, nullptr, GATEWAYS},
+        {"gateway-load", no_argument, nullptr, GATEWAY_LOAD},
+        {"compact-header", no_argument, nullptr, COMPACT_HEADER},
+        {"slotted", no_argument, nullptr, SLOTTED},
+        {"payload-handler", no_argument, nullptr, PAYLOAD_HANDLER},
+        {"congestion-control", no_argument, nullptr, CONGESTION_CONTROL},
+        {"path-loss-exponent", required_argument, nullptr, PATH_LOSS_EXPONENT},
+        {"shadowing", required_argument, nullptr, SHADOWING},
+        {"seed", required_argument, nullptr, SEED},
+        {"log-level", required_argument, nullptr, LOG_LEVEL},
+        {"library", required_argument, nullptr, LIBRARY},
+        {"csv", required_argument, nullptr, CSV},
+        {"check-delivery", required_argument, nullptr, CHECK_DELIVERY},
+        {"check-compact-header", required_argument, nullptr, CHECK_COMPACT_HEADER},
+        {"check-routes", no_argument, nullptr, CHECK_ROUTES},
+        {"check-multicast", no_argument, nullptr, CHECK_MULTICAST},
+        {"help", no_argument, nullptr, HELP},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+        switch (option) {
+            case NODES: options.nodes = strtoul(optarg, nullptr, 10); break;
+            case TOPOLOGY: options.topology = optarg; break;
+            case SPACING: options.spacing = strtod(optarg, nullptr); break;
+            case DURATION: options.duration = strtoul(optarg, nullptr, 10); break;
+            case BOOT: options.bootTime = strtoul(optarg, nullptr, 10); break;
+            case TRAFFIC_START: options.trafficStart = strtoul(optarg, nullptr, 10); break;
+            case SEND_PERIOD: options.sendPeriod = strtoul(optarg, nullptr, 10); break;
+            case PAYLOAD: options.payloadSize = strtoul(optarg, nullptr, 10); break;
+            case MAX_AGE: options.maxAge = strtoul(optarg, nullptr, 10); break;
+            case SEND_QUEUE: options.sendQueueSize = strtoul(optarg, nullptr, 10); break;
+            case MULTICAST: options.multicastSize = strtoul(optarg, nullptr, 10); break;
+            case SF: options.spreadingFactor = strtoul(optarg, nullptr, 10); break;
+            case POWER: options.power = strtol(optarg, nullptr, 10); break;
+            case LBT: options.listenBeforeTalk = true; break;
+            case ADR: options.adaptiveDataRate = true; break;
+            case COMPACT_HELLO: options.compactHello = true; break;
+            case AGGREGATION: options.aggregation = true; break;
+            case FLOOD: options.flooding = true; break;
+            case RELIABLE: options.reliable = true; break;
+            case DATA_CHANNELS: options.dataChannels = strtoul(optarg, nullptr, 10); break;
+            case DATA_RADIO: options.dataRadio = true; break;
+            case ACK_DELAY: options.ackDelay = strtoul(optarg, nullptr, 10); break;
+            case FEC: options.fec = true; break;
+            case GATEWAYS: options.gateways = strtoul(optarg, nullptr, 10); break;
+            case GATEWAY_LOAD: options.gatewayLoad = true; break;
+            case COMPACT_HEADER: options.compactHeader = true; break;
+            case SLOTTED: options.slottedAccess = true; break;
+            case PAYLOAD_HANDLER: options.appPayloadHandler = true; break;
+            case CONGESTION_CONTROL: options.congestionControl = true; break;
+            case PATH_LOSS_EXPONENT: options.medium.pathLossExponent = strtod(optarg, nullptr); break;
+            case SHADOWING: options.medium.shadowing = strtod(optarg, nullptr); break;
+            case SEED: options.seed = strtoull(optarg, nullptr, 10); break;
+            case LOG_LEVEL: options.logLevel = strtol(optarg, nullptr, 10); break;
+            case LIBRARY: options.library = optarg; break;
+            case CSV: options.csv = optarg; break;
+            case CHECK_DELIVERY: options.checkDelivery = strtod(optarg, nullptr); break;
+            case CHECK_COMPACT_HEADER: options.checkCompactHeader = strtod(optarg, nullptr); break;
+            case CHECK_ROUTES: options.checkRoutes = true; break;
+            case CHECK_MULTICAST: options.checkMulticast = true; break;
+            default: return false;
+        }
+    }
+
+    if (options.nodes == 0 || options.nodes > UINT16_MAX - 1) {
+        fprintf(stderr, "The number of nodes must be between 1 and %d\n", UINT16_MAX - 1);
+        return false;
+    }
+
+    if (options.topology != "grid" && options.topology != "line" && options.topology != "random") {
+        fprintf(stderr, "Unknown topology %s\n", options.topology.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Load a copy of the node library. Every copy has its own static services and LoraMesher instance,
+ * the dynamic loader only loads a file once, so every copy is loaded from its own memory file.
+ *
+ */
+static void* loadNodeLibrary(const std::vector<char>& image) {
+    int fd = memfd_create("loramesher_node", MFD_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    size_t written = 0;
+    while (written < image.size()) {
+        ssize_t res = write(fd, image.data() + written, image.size() - written);
+        if (res <= 0) {
+            close(fd);
+            return nullptr;
+        }
+        written += res;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+
+    void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (library == nullptr) {
+        fprintf(stderr, "Could not load the node library: %s\n", dlerror());
+        close(fd);
+    }
+
+    // The file stays open, the loader also compares the paths and a new file could reuse the descriptor
+    return library;
+}
+
+static void placeNode(const SimulatorOptions& options, uint32_t index, double& x, double& y) {
+    if (options.topology == "line") {
+        x = index * options.spacing;
+        y = 0;
+    }
+    else if (options.topology == "grid") {
+        uint32_t side = (uint32_t) std::ceil(std::sqrt((double) options.nodes));
+        x = (index % side) * options.spacing;
+        y = (index / side) * options.spacing;
+    }
+    else {
+        // Same density as the grid
+        double side = options.spacing * std::sqrt((double) options.nodes);
+        x = (double) rand() / RAND_MAX * side;
+        y = (double) rand() / RAND_MAX * side;
+    }
+}
+
+static void writeCsv(const std::string& file, const std::vector<SimulatorNode>& nodes) {
+    FILE* out = fopen(file.c_str(), "w");
+    if (out == nullptr) {
+        fprintf(stderr, "Could not open %s\n", file.c_str());
+        return;
+    }
+
+    fprintf(out, "address,x,y,routes,sent,received,avgLatencyUs,maxLatencyUs,"
+        "sentPackets,helloPackets,forwardedPackets,receivedPackets,txAirtimeUs\n");
+
+    for (const SimulatorNode& node : nodes) {
+        const HostNodeStats& stats = node.parameters.stats;
+        fprintf(out, "%u,%.1f,%.1f,%u,%u,%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+            node.parameters.address, node.module->getX(), node.module->getY(), stats.routes, stats.sent,
+            stats.received, (unsigned long long) (stats.received > 0 ? stats.latencySum / stats.received : 0),
+            (unsigned long long) stats.latencyMax, (unsigned long long) stats.sentPackets,
+            (unsigned long long) stats.helloPackets, (unsigned long long) stats.forwardedPackets,
+            (unsigned long long) stats.receivedPackets, (unsigned long long) node.module->getStats().txAirtime);
+    }
+
+    fclose(out);
+}
+
+int main(int argc, char** argv) {
+    SimulatorOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    esp_log_level_set("*", (esp_log_level_t) options.logLevel);
+    hostSeedRandom(options.seed);
+    options.medium.seed = options.seed;
+    RadioMedium::configure(options.medium);
+
+    std::ifstream file(options.library, std::ios::binary);
+    std::vector<char> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (image.empty()) {
+        fprintf(stderr, "Could not read the node library %s\n", options.library.c_str());
+        return 2;
+    }
+
+    std::vector<uint16_t> addresses(options.nodes);
+    for (uint32_t i = 0; i < options.nodes; i++)
+        addresses[i] = i + 1;
+
+    // The gateways are spread over the nodes, the middle node of every group of nodes / gateways
+    std::vector<bool> isGateway(options.nodes, false);
+    for (uint32_t g = 0; g < options.gateways && g < options.nodes; g++)
+        isGateway[(2 * g + 1) * options.nodes / (2 * options.gateways)] = true;
+
+    std::vector<SimulatorNode> nodes(options.nodes);
+
+    for (uint32_t i = 0; i < options.nodes; i++) {
+        SimulatorNode& node = nodes[i];
+        uint16_t address = addresses[i];
+
+        double x, y;
+        placeNode(options, i, x, y);
+        node.module = new SimModule(address, x, y);
+        node.dataModule = options.dataRadio ? new SimModule(address, x, y) : nullptr;
+
+        void* library = loadNodeLibrary(image);
+        if (library == nullptr)
+            return 2;
+
+        node.main = reinterpret_cast<HostNodeMain>(dlsym(library, LM_HOST_NODE_MAIN));
+        node.collect = reinterpret_cast<HostNodeCollect>(dlsym(library, LM_HOST_NODE_COLLECT));
+        if (node.main == nullptr || node.collect == nullptr) {
+            fprintf(stderr, "The node library has no %s or %s\n", LM_HOST_NODE_MAIN, LM_HOST_NODE_COLLECT);
+            return 2;
+        }
+
+        HostNodeParameters& parameters = node.parameters;
+        parameters = {};
+        parameters.module = node.module;
+        parameters.dataModule = node.dataModule;
+        parameters.address = address;
+        parameters.spreadingFactor = options.spreadingFactor;
+        parameters.power = options.power;
+        parameters.listenBeforeTalk = options.listenBeforeTalk;
+        parameters.adaptiveDataRate = options.adaptiveDataRate;
+        parameters.compactHello = options.compactHello;
+        parameters.aggregation = options.aggregation;
+        parameters.flooding = options.flooding;
+        parameters.reliable = options.reliable;
+        parameters.dataChannels = options.dataChannels;
+        parameters.ackDelay = options.ackDelay;
+        parameters.fec = options.fec;
+        parameters.congestionControl = options.congestionControl;
+        parameters.gateway = isGateway[i];
+        parameters.gatewayLoad = options.gatewayLoad;
+        parameters.compactHeader = options.compactHeader;
+        parameters.slottedAccess = options.slottedAccess;
+        parameters.appPayloadHandler = options.appPayloadHandler;
+        parameters.uplink = options.gateways > 0;
+        parameters.trafficStart = options.trafficStart * 1000;
+        // The last payloads have time to arrive
+        parameters.trafficEnd = options.duration > 60 ? (options.duration - 60) * 1000 : 0;
+        parameters.sendPeriod = options.sendPeriod * 1000;
+        parameters.payloadSize = options.payloadSize;
+        parameters.maxAge = options.maxAge;
+        parameters.sendQueueSize = options.sendQueueSize;
+        parameters.destinations = addresses.data();
+        parameters.numDestinations = addresses.size();
+        parameters.multicastSize = options.multicastSize;
+
+        uint64_t boot = options.bootTime > 0 ? (uint64_t) rand() % (options.bootTime * 1000000ULL) : 0;
+        HostScheduler::schedule(boot, address, [&node, address]() {
+            HostScheduler::createTask(node.main, "main", 4096, &node.parameters, 1, address);
+        });
+    }
+
+    auto wallStart = std::chrono::steady_clock::now();
+    HostScheduler::run(options.duration * 1000000ULL);
+    double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    uint64_t sent = 0, received = 0, latencySum = 0, latencyMax = 0, routes = 0;
+    uint64_t sentPackets = 0, helloPackets = 0, forwardedPackets = 0, suppressedFloods = 0, deadlineDrops = 0;
+    uint64_t queueDrops = 0, coalescedAcks = 0, parityPackets = 0, recoveredPackets = 0,
+        congestionDecreases = 0, compactHeaders = 0, compactHeaderSavedBytes = 0, slottedPackets = 0;
+    uint32_t convergedNodes = 0, multicastNodes = 0;
+
+    for (SimulatorNode& node : nodes) {
+        node.collect(&node.parameters);
+
+        const HostNodeStats& stats = node.parameters.stats;
+        sent += stats.sent;
+        received += stats.received;
+        latencySum += stats.latencySum;
+        latencyMax = std::max(latencyMax, stats.latencyMax);
+        routes += stats.routes;
+        sentPackets += stats.sentPackets;
+        helloPackets += stats.helloPackets;
+        forwardedPackets += stats.forwardedPackets;
+        suppressedFloods += stats.suppressedFloods;
+        deadlineDrops += stats.deadlineDrops;
+        queueDrops += stats.queueDrops;
+        coalescedAcks += stats.coalescedAcks;
+        parityPackets += stats.parityPackets;
+        recoveredPackets += stats.recoveredPackets;
+        congestionDecreases += stats.congestionDecreases;
+        compactHeaders += stats.compactHeaders;
+        compactHeaderSavedBytes += stats.compactHeaderSavedBytes;
+        slottedPackets += stats.slottedPackets;
+
+        if (stats.routes >= options.nodes - 1)
+            convergedNodes++;
+
+        if (stats.multicastReceived > 0)
+            multicastNodes++;
+    }
+
+    const MediumStats& medium = RadioMedium::getStats();
+    // A flooded payload is received by all the other nodes
+    uint64_t expected = options.flooding ? sent * (options.nodes - 1) : sent;
+    double delivery = expected > 0 ? (double) received / expected : 1;
+
+    printf("Simulation: %u nodes, %s topology, %u s, seed %llu\n", options.nodes, options.topology.c_str(),
+        options.duration, (unsigned long long) options.seed);
+    printf("Application: sent %llu, received %llu, delivery ratio %.3f, average latency %.1f ms, max latency %.1f ms\n",
+        (unsigned long long) sent, (unsigned long long) received, delivery,
+        received > 0 ? latencySum / 1000.0 / received : 0.0, latencyMax / 1000.0);
+    printf("Routes: average %.1f of %u, converged nodes %u of %u\n",
+        (double) routes / options.nodes, options.nodes - 1, convergedNodes, options.nodes);
+    if (options.multicastSize > 0)
+        printf("Multicast: %u bytes, received by %u of %u nodes\n", options.multicastSize, multicastNodes, options.nodes - 1);
+    if (options.fec)
+        printf("FEC: parity packets %llu, packets rebuilt %llu\n", (unsigned long long) parityPackets,
+            (unsigned long long) recoveredPackets);
+    if (options.congestionControl)
+        printf("Congestion: window decreases %llu\n", (unsigned long long) congestionDecreases);
+    // The HELLO packets are always sent with the default header
+    uint64_t nonHelloPackets = sentPackets > helloPackets ? sentPackets - helloPackets : 0;
+    double compactRatio = nonHelloPackets > 0 ? (double) compactHeaders / nonHelloPackets : 0;
+    if (options.compactHeader)
+        printf("Compact headers: %llu packets, ratio %.3f, %llu bytes saved\n", (unsigned long long) compactHeaders,
+            compactRatio, (unsigned long long) compactHeaderSavedBytes);
+    if (options.slottedAccess)
+        printf("Slots: packets sent inside the slots %llu of %llu\n", (unsigned long long) slottedPackets,
+            (unsigned long long) sentPackets);
+    if (options.gateways > 0) {
+        printf("Gateways:");
+        for (uint32_t i = 0; i < options.nodes; i++) {
+            if (isGateway[i])
+                printf(" %X received %u", addresses[i], nodes[i].parameters.stats.received);
+        }
+        printf("\n");
+    }
+    printf("LoraMesher: sent packets %llu, hello packets %llu, forwarded packets %llu, suppressed floods %llu, "
+        "deadline drops %llu, queue drops %llu, coalesced ACKs %llu\n", (unsigned long long) sentPackets,
+        (unsigned long long) helloPackets, (unsigned long long) forwardedPackets, (unsigned long long) suppressedFloods,
+        (unsigned long long) deadlineDrops, (unsigned long long) queueDrops, (unsigned long long) coalescedAcks);
+    printf("Radio: transmissions %llu, airtime %.1f s, delivered %llu, collisions %llu, not listening %llu, aborted %llu\n",
+        (unsigned long long) medium.transmissions, medium.airtime / 1e6, (unsigned long long) medium.delivered,
+        (unsigned long long) medium.collisions, (unsigned long long) medium.notListening,
+        (unsigned long long) medium.aborted);
+    printf("Simulator: events %llu, task switches %llu, wall time %.2f s, %.0f times real time\n",
+        (unsigned long long) HostScheduler::getExecutedEvents(), (unsigned long long) HostScheduler::getTaskSwitches(),
+        wallTime, wallTime > 0 ? options.duration / wallTime : 0.0);
+
+    if (!options.csv.empty())
+        writeCsv(options.csv, nodes);
+
+    int result = 0;
+    if (options.checkDelivery >= 0 && delivery < options.checkDelivery) {
+        printf("FAILED: delivery ratio %.3f lower than %.3f\n", delivery, options.checkDelivery);
+        result = 1;
+    }
+
+    if (options.checkCompactHeader >= 0 && compactRatio < options.checkCompactHeader) {
+        printf("FAILED: compact header ratio %.3f lower than %.3f\n", compactRatio, options.checkCompactHeader);
+        result = 1;
+    }
+
+    if (options.checkRoutes && convergedNodes < options.nodes) {
+        printf("FAILED: %u nodes without a route to every other node\n", options.nodes - convergedNodes);
+        result = 1;
+    }
+
+    if (options.checkMulticast && multicastNodes < options.nodes - 1) {
+        printf("FAILED: %u nodes without the multicast payload\n", options.nodes - 1 - multicastNodes);
+        result = 1;
+    }
+
+    // The nodes are not destroyed, their tasks are still blocked inside LoraMesher
+    fflush(stdout);
+    fflush(stderr);
+    _exit(result);
+}
@@ -27,6 +27,16 @@ using namespace std;
 #define SPI_MISO 11
 #endif
 
+// SPI transfers of up to LM_SPI_POLLING_SIZE bytes are polled, the longer ones block the task until the DMA is done.
+// They are copied into DMA buffers of LM_SPI_DMA_BUFFER_SIZE bytes, enough for a whole FIFO read or write
+#ifndef LM_SPI_POLLING_SIZE
+#define LM_SPI_POLLING_SIZE 32
+#endif
+
+#ifndef LM_SPI_DMA_BUFFER_SIZE
+#define LM_SPI_DMA_BUFFER_SIZE 320
+#endif
+
 
 #define LOW (0x0)
 #define HIGH (0x1)
@@ -60,6 +70,139 @@ extern const char* LM_VERSION;
 #define LM_POWER 6
 #define LM_DUTY_CYCLE 100
 
+//Sliding window of the airtime accounting in seconds, and number of buckets of the window
+#ifndef LM_AIRTIME_WINDOW
+#define LM_AIRTIME_WINDOW 3600
+#endif
+
+#ifndef LM_AIRTIME_BUCKETS
+#define LM_AIRTIME_BUCKETS 60
+#endif
+
+//Percent of the airtime budget reserved to the packets with a priority of at least LM_AIRTIME_HIGH_PRIORITY (ACKs, SYNC and HELLO)
+#ifndef LM_AIRTIME_RESERVE
+#define LM_AIRTIME_RESERVE 10
+#endif
+
+#ifndef LM_AIRTIME_HIGH_PRIORITY
+#define LM_AIRTIME_HIGH_PRIORITY (DEFAULT_PRIORITY + 2)
+#endif
+
+//Listen before talk, maximum number of channel scans, maximum backoff exponent and slots of the backoff per maximum time on air
+#ifndef LM_LBT_MAX_ATTEMPTS
+#define LM_LBT_MAX_ATTEMPTS 8
+#endif
+
+#ifndef LM_LBT_MAX_BACKOFF_EXP
+#define LM_LBT_MAX_BACKOFF_EXP 5
+#endif
+
+#ifndef LM_LBT_SLOTS_PER_PACKET
+#define LM_LBT_SLOTS_PER_PACKET 4
+#endif
+
+//Slotted access, guard time in ms between two slots, maximum number of slots of a frame and seconds without beacon
+//after which a node goes back to the random access
+#ifndef LM_SLOT_GUARD_TIME
+#define LM_SLOT_GUARD_TIME 20
+#endif
+
+#ifndef LM_SLOT_MAX_SLOTS
+#define LM_SLOT_MAX_SLOTS 32
+#endif
+
+#ifndef LM_SLOT_SYNC_TIMEOUT
+#define LM_SLOT_SYNC_TIMEOUT (HELLO_PACKETS_DELAY * 3)
+#endif
+
+//Maximum milliseconds that a data packet waits for other data packets to the same next hop to be aggregated with
+#ifndef LM_AGGREGATION_HOLD_TIME
+#define LM_AGGREGATION_HOLD_TIME 200
+#endif
+
+//Flooding of the data packets to a group address. A node forwards a packet at a random time between half the interval
+//and the interval, in ms, after receiving it, unless it has heard the redundancy number of copies from other nodes meanwhile
+#ifndef LM_FLOOD_INTERVAL
+#define LM_FLOOD_INTERVAL 4000
+#endif
+
+#ifndef LM_FLOOD_REDUNDANCY
+#define LM_FLOOD_REDUNDANCY 2
+#endif
+
+//Flooded packets waiting to be forwarded at the same time, the new ones are not forwarded when it is full
+#ifndef LM_FLOOD_PENDING
+#define LM_FLOOD_PENDING 8
+#endif
+
+//Flooded packets remembered and time in s to remember them. The copies can wait long in the queues of a busy network,
+//a copy heard after it is forgotten is flooded again
+#ifndef LM_FLOOD_CACHE_SIZE
+#define LM_FLOOD_CACHE_SIZE 64
+#endif
+
+#ifndef LM_FLOOD_CACHE_TIMEOUT
+#define LM_FLOOD_CACHE_TIMEOUT 600
+#endif
+
+//Adaptive transmission power, SNR margin in dB kept over the demodulation floor, minimum power in dBm
+//and maximum number of neighbours reported inside every HELLO packet
+#ifndef LM_ADR_SNR_MARGIN
+#define LM_ADR_SNR_MARGIN 10
+#endif
+
+#ifndef LM_ADR_MIN_POWER
+#define LM_ADR_MIN_POWER 2
+#endif
+
+#ifndef LM_ADR_MAX_REPORTS
+#define LM_ADR_MAX_REPORTS 8
+#endif
+
+//Maximum gateways whose load is advertised inside every HELLO packet
+#ifndef LM_MAX_LOAD_REPORTS
+#define LM_MAX_LOAD_REPORTS 8
+#endif
+
+//Gateway selection: the routes whose metric is at most LM_GATEWAY_METRIC_MARGIN above the nearest gateway are equally reachable,
+//and the loads at most LM_GATEWAY_LOAD_MARGIN above the least loaded of them are equal. The nodes spread between the equal gateways
+#ifndef LM_GATEWAY_METRIC_MARGIN
+#define LM_GATEWAY_METRIC_MARGIN 0
+#endif
+
+#ifndef LM_GATEWAY_LOAD_MARGIN
+#define LM_GATEWAY_LOAD_MARGIN 32
+#endif
+
+//Multi-channel mode, spacing in MHz between the control channel and the data channels and time in ms a finished
+//sequence keeps its data channel to send the last ACK
+#ifndef LM_CHANNEL_SPACING
+#define LM_CHANNEL_SPACING 0.2F
+#endif
+
+#ifndef LM_CHANNEL_LINGER_TIME
+#define LM_CHANNEL_LINGER_TIME 2000
+#endif
+
+//Maximum distance in bytes of the repeated data found by the payload compression, up to 4096
+#ifndef LM_COMPRESSION_WINDOW
+#define LM_COMPRESSION_WINDOW 1024
+#endif
+
+//Payload encryption, bytes of the truncated tag (4, 6, 8, ... 16) and of the frame counter of the nonce (up to 4)
+#ifndef LM_ENCRYPTION_TAG_SIZE
+#define LM_ENCRYPTION_TAG_SIZE 4
+#endif
+
+#ifndef LM_ENCRYPTION_COUNTER_SIZE
+#define LM_ENCRYPTION_COUNTER_SIZE 4
+#endif
+
+//Milliseconds added to twice the time on air before giving up waiting for the transmit done interrupt
+#ifndef LM_TRANSMIT_DONE_MARGIN
+#define LM_TRANSMIT_DONE_MARGIN 100
+#endif
+
 //Syncronization Word that identifies the mesh network
 #define LM_SYNC_WORD 19U
 
@@ -69,6 +212,11 @@ extern const char* LM_VERSION;
 // Routing table max size
 #define RTMAXSIZE 256
 
+//Nodes with a role indexed to find the gateways without scanning the routing table, the routing table is scanned while some do not fit
+#ifndef LM_ROLE_INDEX_SIZE
+#define LM_ROLE_INDEX_SIZE 16
+#endif
+
 //MAX packet size per packet in bytes. It could be changed between 13 and 255 bytes. Recommended 100 or less bytes.
 //If exceed it will be automatically separated through multiple packets 
 //In bytes (226 bytes [UE max allowed with SF7 and 125khz])
@@ -77,6 +225,53 @@ extern const char* LM_VERSION;
 //MAX payload size for reliable and large packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via - 3 of control packet
 #define LM_MAX_PACKET_SIZE 100
 
+//Packet buffers are taken from a pool of fixed size blocks to avoid the heap fragmentation.
+//Packets greater than the block size, or allocated when the pool is empty, will use the heap.
+#ifndef LM_PACKET_POOL_BLOCK_SIZE
+#define LM_PACKET_POOL_BLOCK_SIZE LM_MAX_PACKET_SIZE
+#endif
+
+#ifndef LM_PACKET_POOL_BLOCKS
+#define LM_PACKET_POOL_BLOCKS 32
+#endif
+
+//Maximum number of received packets waiting to be processed, it must be a power of two
+#ifndef LM_RECEIVED_QUEUE_SIZE
+#define LM_RECEIVED_QUEUE_SIZE 32
+#endif
+
+//Default capacities of the queues and the heap budget of the LoraMesherConfig, 0 without limit. The received payloads,
+//the sequences being received and the heap are not limited by default, the existing applications keep every payload
+#ifndef LM_SEND_QUEUE_SIZE
+#define LM_SEND_QUEUE_SIZE 64
+#endif
+
+#ifndef LM_APP_QUEUE_SIZE
+#define LM_APP_QUEUE_SIZE 0
+#endif
+
+#ifndef LM_MAX_SEND_SEQUENCES
+#define LM_MAX_SEND_SEQUENCES 8
+#endif
+
+#ifndef LM_MAX_RECEIVE_SEQUENCES
+#define LM_MAX_RECEIVE_SEQUENCES 0
+#endif
+
+#ifndef LM_HEAP_BUDGET
+#define LM_HEAP_BUDGET 0
+#endif
+
+//Maximum number of handlers of user packet types, see LoraMesher::setPacketHandler
+#ifndef LM_MAX_PACKET_HANDLERS
+#define LM_MAX_PACKET_HANDLERS 4
+#endif
+
+//Number of queue packets preallocated, they wrap every packet inside the queues
+#ifndef LM_QUEUE_PACKET_POOL_BLOCKS
+#define LM_QUEUE_PACKET_POOL_BLOCKS 32
+#endif
+
 // Packet types
 #define NEED_ACK_P 0b00000011
 #define DATA_P     0b00000010
@@ -85,19 +280,260 @@ extern const char* LM_VERSION;
 #define XL_DATA_P  0b00010010
 #define LOST_P     0b00100010
 #define SYNC_P     0b01000010
+// Selective ACK: cumulative ACK with a bitmap of the packets received after it
+#define SACK_P     0b00101010
+// Delta HELLO: only the routes changed since the last HELLO, the routes not included have not changed
+#define HELLO_DELTA_P 0b00001100
+// Compact HELLO: the routes are grouped by role and the addresses delta encoded, it can be combined with HELLO_DELTA_P
+#define HELLO_COMPACT_P 0b00010100
+// Data packet with multiple data records, DATA_P with the ACK and XL bits. It needs to be checked before them
+#define AGGREGATED_P 0b00011010
+// Aggregated packet whose first record is an ACK, the ACK is carried by the data packets to the same next hop
+#define AGGREGATED_ACK_P 0b00111010
+// HELLO with the SNR of the neighbours at the end, it can be combined with the other HELLO types
+#define HELLO_LINK_REPORT_P 0b00100100
+// Route solicitation: a HELLO that asks the neighbours to send their whole routing table, it can be combined with the other HELLO types
+#define HELLO_SOLICIT_P 0b01000100
+// HELLO with the load of the gateways at the end, after the link reports. It can be combined with the other HELLO types
+#define HELLO_LOAD_P 0b10000100
+// HELLO of a node that receives the compact headers, its short address is unique. It can be combined with the other HELLO types
+#define HELLO_COMPACT_HEADER_P 0b00000101
+// HELLO of the time reference of the slotted access, with the slots at the end after the load reports. It can be combined with the other HELLO types.
+// No other bit is free, it has the DATA_P bit: the data predicates of PacketService and the type table exclude the HELLO types
+#define HELLO_BEACON_P 0b00000110
+// Compressed payload, it can be combined with DATA_P and SYNC_P. The payload of a sequence is compressed as a whole
+#define COMPRESSED_P 0b10000000
+// Multicast packets of a group sequence, XL_DATA_P and SYNC_P without NEED_ACK_P sent to a group address
+#define MC_DATA_P XL_DATA_P
+#define MC_SYNC_P (SYNC_P | XL_DATA_P)
+// Multicast NACK: the packets missing of a group sequence, sent to the neighbour that forwarded the sequence
+#define MC_NACK_P 0b01100010
+// Parity of a block of packets of a reliable payload, XL_DATA_P with the LOST bit. It needs to be checked before LOST_P
+#define XL_PARITY_P 0b00110010
+// The types without the DATA_P and HELLO_P bits are not used by LoraMesher, the application can send them to its neighbours
+// with LoraMesher::sendCustomPacket and receive them with LoraMesher::setPacketHandler
 
 // Packet configuration
 #define BROADCAST_ADDR 0xFFFF
+
+//Group addresses, from LM_GROUP_ADDR_FIRST to BROADCAST_ADDR, that is the group of all the nodes.
+//A node whose address is inside the range cannot receive unicast packets
+#ifndef LM_GROUP_ADDR_FIRST
+#define LM_GROUP_ADDR_FIRST 0xFFF0
+#endif
+
+//Groups that a node can join, besides the broadcast group
+#ifndef LM_MAX_GROUPS
+#define LM_MAX_GROUPS 4
+#endif
 #define DEFAULT_PRIORITY 20
 #define MAX_PRIORITY 40
 
+//Priorities of the QoS classes of the payloads. The urgent payloads go before the normal ones, the packets of the
+//sequences and the routing go before them
+#ifndef LM_QOS_BACKGROUND_PRIORITY
+#define LM_QOS_BACKGROUND_PRIORITY (DEFAULT_PRIORITY - 10)
+#endif
+
+#ifndef LM_QOS_URGENT_PRIORITY
+#define LM_QOS_URGENT_PRIORITY (DEFAULT_PRIORITY + 1)
+#endif
+
+//Priority of the packets that have reached their max age and are demoted instead of dropped
+#ifndef LM_QOS_DEMOTED_PRIORITY
+#define LM_QOS_DEMOTED_PRIORITY 0
+#endif
+
+//Resolution in ms of the deadlines of the queued packets. They are stored in 16 bits, the max age is limited to
+//half their range
+#ifndef LM_QOS_DEADLINE_TICK
+#define LM_QOS_DEADLINE_TICK 100
+#endif
+
+#define LM_QOS_MAX_AGE (INT16_MAX * LM_QOS_DEADLINE_TICK)
+
 //Definition Times in seconds
 #define HELLO_PACKETS_DELAY 120
 #define DEFAULT_TIMEOUT HELLO_PACKETS_DELAY*5
 #define MIN_TIMEOUT 20
 
+//Every LM_HELLO_FULL_REFRESH HELLO packets the whole routing table is sent, the others only include the changed routes.
+//LM_HELLO_FULL_REFRESH * HELLO_PACKETS_DELAY must be lower than DEFAULT_TIMEOUT, the nodes without delta HELLO refresh only the routes received
+#ifndef LM_HELLO_FULL_REFRESH
+#define LM_HELLO_FULL_REFRESH 4
+#endif
+
+//Seconds waited after a route change before sending the triggered HELLO packet, the changes meanwhile are sent together
+#ifndef LM_HELLO_TRIGGERED_DELAY
+#define LM_HELLO_TRIGGERED_DELAY 2
+#endif
+
+//Maximum milliseconds waited before sending the HELLO packet of a node that starts or the answer to a route solicitation,
+//the neighbours that answer the same solicitation choose a random time in it
+#ifndef LM_HELLO_SOLICIT_JITTER
+#define LM_HELLO_SOLICIT_JITTER 1500
+#endif
+
+//Minimum seconds between two whole HELLO packets sent to answer the route solicitations, the solicitations received meanwhile
+//are answered together
+#ifndef LM_HELLO_SOLICIT_HOLDOFF
+#define LM_HELLO_SOLICIT_HOLDOFF 10
+#endif
+
+//Cost of a perfect link in the ETX link metric, the resolution of the metric is 1 / LM_ETX_COST_UNIT transmissions
+#ifndef LM_ETX_COST_UNIT
+#define LM_ETX_COST_UNIT 4
+#endif
+
+//Maximum cost of a link in the ETX link metric
+#ifndef LM_ETX_MAX_LINK_COST
+#define LM_ETX_MAX_LINK_COST 40
+#endif
+
+//Alternate next hops stored for every route, the route fails over to them when it expires
+#ifndef LM_ROUTE_ALTERNATES
+#define LM_ROUTE_ALTERNATES 2
+#endif
+
+//If 1 the packets are spread across the next hops with the same metric
+#ifndef LM_ROUTE_LOAD_BALANCE
+#define LM_ROUTE_LOAD_BALANCE 0
+#endif
+
+//NVS namespace where the routing table is persisted
+#ifndef LM_PERSIST_NAMESPACE
+#define LM_PERSIST_NAMESPACE "loramesher"
+#endif
+
+//Minimum seconds between two writes of the routing table, it is only written if it has changed
+#ifndef LM_PERSIST_INTERVAL
+#define LM_PERSIST_INTERVAL 1800
+#endif
+
+//Seconds that a restored route is kept without being advertised by its next hop. It must be higher than
+//LM_HELLO_FULL_REFRESH * HELLO_PACKETS_DELAY, the delta HELLO packets do not validate the restored routes
+#ifndef LM_PERSIST_ROUTE_TIMEOUT
+#define LM_PERSIST_ROUTE_TIMEOUT DEFAULT_TIMEOUT
+#endif
+
+//Duplicate packets cache, number of packets remembered and time in seconds until they are forgotten. The packets
+//waiting in the send queue are remembered until they leave it
+#define LM_DUPLICATE_CACHE_SIZE 32
+#define LM_DUPLICATE_CACHE_TIMEOUT 30
+
+//Number of large payload packets that can be sent without waiting for their ACK. 1 is stop and wait
+#define LM_RELIABLE_WINDOW_SIZE 4
+
+//Congestion window of the reliable payloads through a next hop: initial, minimum and maximum packets
+#ifndef LM_CONGESTION_INITIAL_WINDOW
+#define LM_CONGESTION_INITIAL_WINDOW 4
+#endif
+
+#ifndef LM_CONGESTION_MIN_WINDOW
+#define LM_CONGESTION_MIN_WINDOW 1
+#endif
+
+#ifndef LM_CONGESTION_MAX_WINDOW
+#define LM_CONGESTION_MAX_WINDOW 32
+#endif
+
+//Milliseconds that a packet of a reliable payload waits inside the send queue above which the window of its next hop is decreased
+#ifndef LM_CONGESTION_QUEUE_DELAY
+#define LM_CONGESTION_QUEUE_DELAY 5000
+#endif
+
+//Maximum bytes of the selective ACK bitmap, every byte covers 8 packets after the cumulative ACK
+#define LM_SACK_BITMAP_SIZE 8
+
+//Milliseconds that an ACK waits inside the send queue for the next ACKs to the same node to be coalesced with it
+#ifndef LM_ACK_DELAY
+#define LM_ACK_DELAY 0
+#endif
+
+//Packets of a reliable payload covered by every parity packet, the block is smaller for the destinations with more loss
+#ifndef LM_FEC_MIN_BLOCK
+#define LM_FEC_MIN_BLOCK 2
+#endif
+
+#ifndef LM_FEC_MAX_BLOCK
+#define LM_FEC_MAX_BLOCK 16
+#endif
+
+//Maximum ACKs of other sequences carried inside the payload of an ACK packet
+#ifndef LM_MAX_ACK_RECORDS
+#define LM_MAX_ACK_RECORDS 8
+#endif
+
+//Milliseconds without new packets of a multicast sequence before requesting the missing ones to the neighbour
+#ifndef LM_MULTICAST_NACK_TIMEOUT
+#define LM_MULTICAST_NACK_TIMEOUT 8000
+#endif
+
+//Milliseconds that a complete multicast sequence is kept to repair the neighbours that are missing packets
+#ifndef LM_MULTICAST_LINGER
+#define LM_MULTICAST_LINGER 60000
+#endif
+
+//Multicast sequences sent, received or forwarded at the same time
+#ifndef LM_MULTICAST_MAX_SEQUENCES
+#define LM_MULTICAST_MAX_SEQUENCES 4
+#endif
+
 //Maximum times that a sequence of packets reach the timeout
 #define MAX_TIMEOUTS 10
+
+//Sequence id of the reliable payloads. With LM_SEQUENCE_ID_16BIT a node can have 65536 sequences with every other node
+//instead of 256, the control packets have one byte more. All the nodes of the network must use the same size
+#ifdef LM_SEQUENCE_ID_16BIT
+typedef uint16_t LM_SeqId;
+#else
+typedef uint8_t LM_SeqId;
+#endif
+
+//Priority classes of the send queue latency statistics: below DEFAULT_PRIORITY, DEFAULT_PRIORITY, one class for each of the
+//following priorities and the last one for the rest above
+#ifndef LM_LATENCY_PRIORITY_CLASSES
+#define LM_LATENCY_PRIORITY_CLASSES 7
+#endif
+
+//Records of the ring of the SimulatorService, allocated when it is created. The oldest records are overwritten when it is full
+#ifndef LM_SIMULATOR_STATES
+#define LM_SIMULATOR_STATES 256
+#endif
+
+//Level of the deferred trace of the receive and send paths, the levels of ESP_LOG: 0 none, 3 info, 4 debug.
+//The trace calls above it are removed when compiling
+#ifndef LM_TRACE_LEVEL
+#define LM_TRACE_LEVEL 3
+#endif
+
+//Stack in bytes of the tasks of LoraMesher. The trace task only formats the trace records
+#ifndef LM_TASK_STACK_SIZE
+#define LM_TASK_STACK_SIZE 4096
+#endif
+
+#ifndef LM_TRACE_TASK_STACK_SIZE
+#define LM_TRACE_TASK_STACK_SIZE 3072
+#endif
+
+//Core of the tasks of LoraMesher. In a dual core ESP32 they run in the APP core, the WiFi and Bluetooth stacks run in the PRO core
+#ifndef LM_TASK_CORE
+#if CONFIG_FREERTOS_UNICORE || !defined(ESP32)
+#define LM_TASK_CORE tskNO_AFFINITY
+#else
+#define LM_TASK_CORE 1
+#endif
+#endif
+
+//Records of the trace ring, it must be a power of two
+#ifndef LM_TRACE_RECORDS
+#define LM_TRACE_RECORDS 128
+#endif
+
+//Milliseconds between the drains of the trace task, 0 does not create the task and the application drains the trace
+#ifndef LM_TRACE_DRAIN_PERIOD
+#define LM_TRACE_DRAIN_PERIOD 100
+#endif
 #define MAX_RESEND_PACKET 3
 #define MAX_TRY_BEFORE_SEND 5
 
@@ -52,7 +52,7 @@ void EspHal::init() {
         .data5_io_num = -1,
         .data6_io_num = -1,
         .data7_io_num = -1,
-        .max_transfer_sz = 0,
+        .max_transfer_sz = 0, // Driver default, the transfers longer than the DMA buffers take the blocking path
         .flags = 0,
         .isr_cpu_id = ESP_INTR_CPU_AFFINITY_AUTO, // INTR_CPU_ID_AUTO,
         .intr_flags = 0};
@@ -66,11 +66,24 @@ void EspHal::init() {
     devcfg.flags = SPI_DEVICE_NO_DUMMY;
     std::lock_guard guard(_mutex);
     ESP_ERROR_CHECK_WITHOUT_ABORT(spi_bus_add_device(HOST_ID, &devcfg, &_handle));
+
+    if (_dmaTx == nullptr)
+        _dmaTx = static_cast<uint8_t*>(heap_caps_malloc(LM_SPI_DMA_BUFFER_SIZE, MALLOC_CAP_DMA));
+    if (_dmaRx == nullptr)
+        _dmaRx = static_cast<uint8_t*>(heap_caps_malloc(LM_SPI_DMA_BUFFER_SIZE, MALLOC_CAP_DMA));
+
+    if (_dmaTx == nullptr || _dmaRx == nullptr)
+        ESP_LOGW(LM_TAG, "SPI DMA buffers could not be allocated");
 }
 
 void EspHal::term() {
     std::lock_guard guard(_mutex);
     spi_bus_remove_device(_handle);
+
+    heap_caps_free(_dmaTx);
+    heap_caps_free(_dmaRx);
+    _dmaTx = nullptr;
+    _dmaRx = nullptr;
 }
 
 // GPIO-related methods (pinMode, digitalWrite etc.) should check
@@ -178,9 +191,52 @@ void EspHal::spiTransfer(uint8_t* out, size_t len, uint8_t* in) {
     spi_transaction_t SPITransaction;
     memset(&SPITransaction, 0, sizeof(spi_transaction_t));
     SPITransaction.length = len * 8;
-    SPITransaction.tx_buffer = out;
-    SPITransaction.rx_buffer = in;
-    spi_device_transmit(_handle, &SPITransaction);
+
+    // Up to 4 bytes fit inside the transaction, without DMA
+    if (len <= 4) {
+        SPITransaction.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+        if (out != nullptr)
+            memcpy(SPITransaction.tx_data, out, len);
+
+        spi_device_polling_transmit(_handle, &SPITransaction);
+
+        if (in != nullptr)
+            memcpy(in, SPITransaction.rx_data, len);
+        return;
+    }
+
+    if (len > LM_SPI_DMA_BUFFER_SIZE || _dmaTx == nullptr || _dmaRx == nullptr) {
+        SPITransaction.tx_buffer = out;
+        SPITransaction.rx_buffer = in;
+        spi_device_transmit(_handle, &SPITransaction);
+        return;
+    }
+
+    // The whole command and FIFO data of RadioLib is sent in a single DMA transaction
+    if (out != nullptr)
+        memcpy(_dmaTx, out, len);
+    else
+        memset(_dmaTx, 0, len);
+
+    SPITransaction.tx_buffer = _dmaTx;
+    SPITransaction.rx_buffer = _dmaRx;
+
+    if (len <= LM_SPI_POLLING_SIZE) {
+        // Busy waiting is faster than the interrupt for the register accesses
+        spi_device_polling_transmit(_handle, &SPITransaction);
+    }
+    else if (spi_device_queue_trans(_handle, &SPITransaction, portMAX_DELAY) != ESP_OK) {
+        ESP_LOGE(LM_TAG, "SPI transaction could not be queued");
+        return;
+    }
+    else {
+        // The task is blocked while the DMA transfers the FIFO
+        spi_transaction_t* done;
+        spi_device_get_trans_result(_handle, &done, portMAX_DELAY);
+    }
+
+    if (in != nullptr)
+        memcpy(in, _dmaRx, len);
 }
 
 #endif
\ No newline at end of file
@@ -32,6 +32,7 @@ public:
 
     void spiBegin() override {}
     void spiBeginTransaction() override {}
+    // register accesses are polled, FIFO reads and writes use DMA
     void spiTransfer(uint8_t* out, size_t len, uint8_t* in) override;
     void spiEndTransaction() override {}
     void spiEnd() override {}
@@ -43,6 +44,10 @@ private:
     int8_t spiMOSI;
     spi_device_handle_t _handle;
     std::mutex _mutex;
+
+    // DMA capable and word aligned buffers, the driver would allocate them for every transfer otherwise
+    uint8_t* _dmaTx = nullptr;
+    uint8_t* _dmaRx = nullptr;
 };
 
 #endif
@@ -1,6 +1,6 @@
 #include "LoraMesher.h"
 
-#ifndef ARDUINO
+#if !defined(ARDUINO) && !defined(LM_HOST_BUILD)
 #include "EspHal.h"
 #endif
 
@@ -13,6 +13,9 @@ void LoraMesher::begin(LoraMesherConfig config) {
     *loraMesherConfig = config;
     initConfiguration();
 
+    // Restore the routes of the previous boot, they are validated by the HELLO packets
+    PersistenceService::restoreRoutingTable();
+
     // Initialize the radio
     initializeLoRa();
 
@@ -24,21 +27,27 @@ void LoraMesher::begin(LoraMesherConfig config) {
 }
 
 void LoraMesher::standby() {
+    //Write the routing table before suspending the tasks, one of them could have it locked
+    PersistenceService::saveRoutingTable(true);
+
     //Get actual priority
     UBaseType_t prevPriority = uxTaskPriorityGet(NULL);
 
     //Set max priority
     vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
 
-    int res = radio->standby();
-    if (res != 0)
-        ESP_LOGE(LM_TAG, "Standby gave error: %d", res);
+    for (uint8_t i = 0; i < numRadios; i++) {
+        int res = radios[i].module->standby();
+        if (res != 0)
+            ESP_LOGE(LM_TAG, "Standby of radio %d gave error: %d", i, res);
+    }
 
     //Clear Dio Actions
     clearDioActions();
 
     //Suspend all tasks
-    vTaskSuspend(ReceivePacket_TaskHandle);
+    for (uint8_t i = 0; i < numRadios; i++)
+        vTaskSuspend(radios[i].receiveTask);
     vTaskSuspend(Hello_TaskHandle);
     vTaskSuspend(ReceiveData_TaskHandle);
     vTaskSuspend(SendData_TaskHandle);
@@ -57,7 +66,8 @@ void LoraMesher::start() {
     vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
 
     // Resume all tasks
-    vTaskResume(ReceivePacket_TaskHandle);
+    for (uint8_t i = 0; i < numRadios; i++)
+        vTaskResume(radios[i].receiveTask);
     vTaskResume(Hello_TaskHandle);
     vTaskResume(ReceiveData_TaskHandle);
     vTaskResume(SendData_TaskHandle);
@@ -65,24 +75,42 @@ void LoraMesher::start() {
     vTaskResume(QueueManager_TaskHandle);
 
     // Start Receiving
-    startReceiving();
+    for (uint8_t i = 0; i < numRadios; i++)
+        startReceiving(radios[i]);
+
+    // Send the first HELLO packet and ask the neighbours for their routes
+    xTaskNotify(Hello_TaskHandle, HELLO_NOTIFY_STARTED, eSetBits);
 
     // Set previous priority
     vTaskPrioritySet(NULL, prevPriority);
 }
 
 LoraMesher::~LoraMesher() {
-    vTaskDelete(ReceivePacket_TaskHandle);
+    for (RadioState& radioState : radios)
+        if (radioState.receiveTask != nullptr)
+            vTaskDelete(radioState.receiveTask);
     vTaskDelete(Hello_TaskHandle);
     vTaskDelete(ReceiveData_TaskHandle);
     vTaskDelete(SendData_TaskHandle);
     vTaskDelete(RoutingTableManager_TaskHandle);
     vTaskDelete(QueueManager_TaskHandle);
+    if (Trace_TaskHandle != nullptr)
+        vTaskDelete(Trace_TaskHandle);
 
     ToSendPackets->Clear();
     delete ToSendPackets;
-    ReceivedPackets->Clear();
+    QueuePacket<Packet<uint8_t>>* rx;
+    while ((rx = ReceivedPackets->pop()) != nullptr)
+        PacketQueueService::deleteQueuePacketAndPacket(rx);
     delete ReceivedPackets;
+    delete sendDuplicateCache;
+    delete receivedDuplicateCache;
+    for (floodPacket& flood : pendingFloods)
+        if (flood.used && flood.packet != nullptr)
+            deletePacket(flood.packet);
+    delete floodDuplicateCache;
+    delete sequenceTimeouts;
+    delete sequencesIndex;
     ReceivedAppPackets->Clear();
     delete ReceivedAppPackets;
 
@@ -90,6 +118,11 @@ LoraMesher::~LoraMesher() {
     radio->reset();
 
     delete radio;
+
+    if (dataRadio != nullptr) {
+        dataRadio->reset();
+        delete dataRadio;
+    }
 }
 
 void LoraMesher::setConfig(LoraMesherConfig config) {
@@ -101,13 +134,23 @@ void LoraMesher::setConfig(LoraMesherConfig config) {
 
     restartRadio();
 
+    //The new configuration can add the data channels of the data radio
+    initializeDataReceiveTask();
+
     start();
 }
 
 void LoraMesher::restartRadio() {
     radio->reset();
+    if (dataRadio != nullptr)
+        dataRadio->reset();
+
     initializeLoRa();
 
+    //The radios are configured with the control channel
+    for (RadioState& radioState : radios)
+        radioState.channel = 0;
+
     ESP_LOGI(LM_TAG, "Restarting radio DONE");
 }
 
@@ -115,6 +158,18 @@ void LoraMesher::initConfiguration() {
     ESP_LOGV(LM_TAG, "Initializing Configuration");
 
     PacketFactory::setMaxPacketSize(loraMesherConfig->max_packet_size);
+    AirtimeService::setRegulatoryDutyCycle(loraMesherConfig->regulatoryDutyCycle);
+    AirtimeService::setFrequency(loraMesherConfig->freq);
+    CryptoService::setNetworkKey(loraMesherConfig->networkKey);
+    ChannelService::configure(loraMesherConfig->freq, loraMesherConfig->channelSpacing, loraMesherConfig->dataChannels);
+    SlotService::configure(loraMesherConfig->slottedAccess);
+    PersistenceService::configure(loraMesherConfig->persistRoutes, loraMesherConfig->persistInterval);
+
+    txPower = loraMesherConfig->power;
+    for (RadioState& radioState : radios) {
+        radioState.channel = 0;
+        radioState.actualTxPower = loraMesherConfig->power;
+    }
 }
 
 void LoraMesher::initializeLoRa() {
@@ -129,7 +184,12 @@ void LoraMesher::initializeLoRa() {
     ESP_LOGI(LM_TAG, "LoRa RST: %d", config.loraRst);
     ESP_LOGI(LM_TAG, "LoRa IO1: %d", config.loraIo1);
 
-#ifdef ARDUINO
+    if (radio == nullptr)
+        radio = config.radioModule;
+
+#if defined(LM_HOST_BUILD)
+    // There are no hardware modules in the host build, the radio module is given by the configuration
+#elif defined(ARDUINO)
     if (config.spi == nullptr) {
 #ifdef LORA_MISO
         // SPI.begin which picks up SCK MISO, MOSI, CS rather than LORA_MISO etc
@@ -176,13 +236,13 @@ void LoraMesher::initializeLoRa() {
     }
 
 #else
-    if (config.hal == nullptr)
+    if (radio == nullptr && config.hal == nullptr)
         config.hal = new EspHal(SPI_SCK, SPI_MISO, SPI_MOSI);
 
-    if (config.hal == nullptr)
-        ESP_LOGE(LM_TAG, "Could not create SPI HAL");
-
     if (radio == nullptr) {
+        if (config.hal == nullptr)
+            ESP_LOGE(LM_TAG, "Could not create SPI HAL");
+
         Module* mod = new Module(config.hal, config.loraCs, config.loraIrq, config.loraRst, config.loraIo1);
 
         switch (config.module) {
@@ -223,51 +283,85 @@ void LoraMesher::initializeLoRa() {
         ESP_LOGE(LM_TAG, "RadioLib not initialized properly");
     }
 
+    radios[CONTROL_RADIO].module = radio;
+
+    //The data radio only carries the sessions of the data channels
+    if (dataRadio == nullptr)
+        dataRadio = config.dataRadioModule;
+
+    radios[DATA_RADIO].module = dataRadio;
+
+    if (dataRadio != nullptr && !ChannelService::isEnabled())
+        ESP_LOGW(LM_TAG, "The data radio is not used without data channels");
+
+    numRadios = dataRadio != nullptr && ChannelService::isEnabled() ? 2 : 1;
+
     // Set up the radio parameters
-    ESP_LOGV(LM_TAG, "Initializing radio");
-    int res = radio->begin(config.freq, config.bw, config.sf, config.cr, config.syncWord, config.power, config.preambleLength);
-    if (res != 0) {
-        ESP_LOGE(LM_TAG, "Radio module gave error: %d", res);
-    }
+    for (uint8_t i = 0; i < numRadios; i++) {
+        ESP_LOGV(LM_TAG, "Initializing radio %d", i);
+        int res = radios[i].module->begin(config.freq, config.bw, config.sf, config.cr, config.syncWord, config.power, config.preambleLength);
+        if (res != 0) {
+            ESP_LOGE(LM_TAG, "Radio module %d gave error: %d", i, res);
+        }
 
 #ifdef LM_ADDCRC_PAYLOAD
-    radio->setCRC(true);
+        radios[i].module->setCRC(true);
 #endif
-    ESP_LOGI(LM_TAG, "LoRa module initialization DONE");
+    }
+
+    ESP_LOGI(LM_TAG, "LoRa module initialization DONE, %d radios", numRadios);
 }
 
-void LoraMesher::setDioActionsForScanChannel() {
+void LoraMesher::setDioActionsForScanChannel(RadioState& radioState) {
     // set the function that will be called
     // when LoRa preamble is detected
-    clearDioActions();
+    radioState.module->clearDioActions();
     // radio->setDioActionForScanning(onReceive);
 }
 
-void LoraMesher::setDioActionsForReceivePacket() {
-    clearDioActions();
+void LoraMesher::setDioActionsForReceivePacket(RadioState& radioState) {
+    radioState.module->clearDioActions();
 
-    radio->setDioActionForReceiving(onReceive);
+    radioState.module->setDioActionForReceiving(&radioState == &radios[DATA_RADIO] ? onDataReceive : onReceive);
 }
 
 void LoraMesher::clearDioActions() {
-    radio->clearDioActions();
+    for (uint8_t i = 0; i < numRadios; i++)
+        radios[i].module->clearDioActions();
+}
+
+uint8_t LoraMesher::getListenChannel(const RadioState& radioState) {
+    if (numRadios == 1)
+        return ChannelService::getListenChannel();
+
+    if (&radioState == &radios[CONTROL_RADIO])
+        return 0;
+
+    //Without session the data radio does not listen to the control channel, it would receive every packet twice
+    uint8_t channel = ChannelService::getListenChannel();
+    if (channel != 0)
+        return channel;
+
+    return radioState.channel != 0 ? radioState.channel : 1;
 }
 
 //TODO: Retry start receiving if it fails
-int LoraMesher::startReceiving() {
-    setDioActionsForReceivePacket();
+int LoraMesher::startReceiving(RadioState& radioState) {
+    setRadioChannel(radioState, getListenChannel(radioState));
+
+    setDioActionsForReceivePacket(radioState);
 
-    int res = radio->startReceive();
+    int res = radioState.module->startReceive();
     if (res != 0) {
         ESP_LOGE(LM_TAG, "Starting receiving gave error: %d", res);
         restartRadio();
-        return startReceiving();
+        return startReceiving(radioState);
     }
     return res;
 }
 
 void LoraMesher::channelScan() {
-    setDioActionsForScanChannel();
+    setDioActionsForScanChannel(radios[CONTROL_RADIO]);
 
     int res = radio->scanChannel();
 
@@ -280,7 +374,7 @@ void LoraMesher::channelScan() {
 
 //TODO: Retry start channel scan if it fails
 int LoraMesher::startChannelScan() {
-    setDioActionsForScanChannel();
+    setDioActionsForScanChannel(radios[CONTROL_RADIO]);
 
     int state = radio->startChannelScan();
     if (state != RADIOLIB_ERR_NONE) {
@@ -293,78 +387,84 @@ int LoraMesher::startChannelScan() {
 
 void LoraMesher::initializeSchedulers() {
     ESP_LOGV(LM_TAG, "Setting up Schedulers");
-    int res = xTaskCreate(
-        [](void* o) { static_cast<LoraMesher*>(o)->receivingRoutine(); },
-        "Receiving routine",
-        4096,
-        this,
-        6,
-        &ReceivePacket_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Receiving routine creation gave error: %d", res);
-    }
-    res = xTaskCreate(
-        [](void* o) { static_cast<LoraMesher*>(o)->sendPackets(); },
-        "Sending routine",
-        4096,
-        this,
-        5,
-        &SendData_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Sending Task creation gave error: %d", res);
-    }
-    res = xTaskCreate(
-        [](void* o) { static_cast<LoraMesher*>(o)->sendHelloPacket(); },
-        "Hello routine",
-        4096,
-        this,
-        4,
-        &Hello_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Process Task creation gave error: %d", res);
-    }
-    res = xTaskCreate(
-        [](void* o) { static_cast<LoraMesher*>(o)->processPackets(); },
-        "Process routine",
-        4096,
-        this,
-        3,
-        &ReceiveData_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Process Task creation gave error: %d", res);
-    }
-    res = xTaskCreate(
-        [](void* o) { static_cast<LoraMesher*>(o)->routingTableManager(); },
-        "Routing Table Manager routine",
-        4096,
-        this,
-        2,
-        &RoutingTableManager_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Routing Table Manager Task creation gave error: %d", res);
-    }
-    res = xTaskCreate(
-        [](void* o) { static_cast<LoraMesher*>(o)->queueManager(); },
-        "Queue Manager routine",
-        4096,
-        this,
-        2,
-        &QueueManager_TaskHandle);
+
+    createTask([](void* o) { LoraMesher* lm = static_cast<LoraMesher*>(o); lm->receivingRoutine(lm->radios[CONTROL_RADIO]); },
+        "Receiving routine", loraMesherConfig->receiveTask, &radios[CONTROL_RADIO].receiveTask);
+    initializeDataReceiveTask();
+    createTask([](void* o) { static_cast<LoraMesher*>(o)->sendPackets(); },
+        "Sending routine", loraMesherConfig->sendTask, &SendData_TaskHandle);
+    createTask([](void* o) { static_cast<LoraMesher*>(o)->sendHelloPacket(); },
+        "Hello routine", loraMesherConfig->helloTask, &Hello_TaskHandle);
+    createTask([](void* o) { static_cast<LoraMesher*>(o)->processPackets(); },
+        "Process routine", loraMesherConfig->processTask, &ReceiveData_TaskHandle);
+    createTask([](void* o) { static_cast<LoraMesher*>(o)->routingTableManager(); },
+        "Routing Table Manager routine", loraMesherConfig->routingTableManagerTask, &RoutingTableManager_TaskHandle);
+    createTask([](void* o) { static_cast<LoraMesher*>(o)->queueManager(); },
+        "Queue Manager routine", loraMesherConfig->queueManagerTask, &QueueManager_TaskHandle);
+#if LM_TRACE_LEVEL > 0 && LM_TRACE_DRAIN_PERIOD > 0
+    createTask([](void* o) { static_cast<LoraMesher*>(o)->traceRoutine(); },
+        "Trace routine", loraMesherConfig->traceTask, &Trace_TaskHandle);
+#endif
+
+    // The tasks are ready when they wait for start, a resume before their suspension would be lost
+    for (uint8_t i = 0; i < numRadios; i++)
+        waitTaskSuspended(radios[i].receiveTask);
+    waitTaskSuspended(SendData_TaskHandle);
+    waitTaskSuspended(Hello_TaskHandle);
+    waitTaskSuspended(ReceiveData_TaskHandle);
+    waitTaskSuspended(RoutingTableManager_TaskHandle);
+    waitTaskSuspended(QueueManager_TaskHandle);
+}
+
+void LoraMesher::initializeDataReceiveTask() {
+    if (numRadios == 1 || radios[DATA_RADIO].receiveTask != nullptr)
+        return;
+
+    createTask([](void* o) { LoraMesher* lm = static_cast<LoraMesher*>(o); lm->receivingRoutine(lm->radios[DATA_RADIO]); },
+        "Data receiving routine", loraMesherConfig->receiveTask, &radios[DATA_RADIO].receiveTask);
+    waitTaskSuspended(radios[DATA_RADIO].receiveTask);
+}
+
+void LoraMesher::createTask(TaskFunction_t function, const char* name, const TaskConfig& config, TaskHandle_t* handle) {
+    int res = xTaskCreatePinnedToCore(function, name, config.stackSize, this, config.priority, handle, config.core);
     if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Queue Manager Task creation gave error: %d", res);
+        ESP_LOGE(LM_TAG, "%s creation gave error: %d", name, res);
+        *handle = nullptr;
     }
+}
+
+void LoraMesher::waitTaskSuspended(TaskHandle_t task) {
+    if (task == nullptr)
+        return;
 
-    vTaskDelay(5000 / portTICK_PERIOD_MS);
+    while (eTaskGetState(task) != eSuspended)
+        vTaskDelay(1);
 }
 
 #if defined(ESP8266) || defined(ESP32)
 ICACHE_RAM_ATTR
 #endif
 void LoraMesher::onReceive(void) {
+    receiveInterrupt(LoraMesher::getInstance().radios[CONTROL_RADIO]);
+}
+
+#if defined(ESP8266) || defined(ESP32)
+ICACHE_RAM_ATTR
+#endif
+void LoraMesher::onDataReceive(void) {
+    receiveInterrupt(LoraMesher::getInstance().radios[DATA_RADIO]);
+}
+
+#if defined(ESP8266) || defined(ESP32)
+ICACHE_RAM_ATTR
+#endif
+void LoraMesher::receiveInterrupt(RadioState& radioState) {
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
+    radioState.receiveInterruptTime = LatencyService::now();
+
     xHigherPriorityTaskWoken = xTaskNotifyFromISR(
-        LoraMesher::getInstance().ReceivePacket_TaskHandle,
+        radioState.receiveTask,
         0,
         eSetValueWithoutOverwrite,
         &xHigherPriorityTaskWoken);
@@ -373,7 +473,36 @@ void LoraMesher::onReceive(void) {
         portYIELD_FROM_ISR();
 }
 
-void LoraMesher::receivingRoutine() {
+#if defined(ESP8266) || defined(ESP32)
+ICACHE_RAM_ATTR
+#endif
+void LoraMesher::onTransmitDone(void) {
+    transmitDoneInterrupt(LoraMesher::getInstance().radios[CONTROL_RADIO]);
+}
+
+#if defined(ESP8266) || defined(ESP32)
+ICACHE_RAM_ATTR
+#endif
+void LoraMesher::onDataTransmitDone(void) {
+    transmitDoneInterrupt(LoraMesher::getInstance().radios[DATA_RADIO]);
+}
+
+#if defined(ESP8266) || defined(ESP32)
+ICACHE_RAM_ATTR
+#endif
+void LoraMesher::transmitDoneInterrupt(RadioState& radioState) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    radioState.transmitDoneTime = LatencyService::now();
+    radioState.transmitDone = true;
+
+    vTaskNotifyGiveFromISR(LoraMesher::getInstance().SendData_TaskHandle, &xHigherPriorityTaskWoken);
+
+    if (xHigherPriorityTaskWoken == pdTRUE)
+        portYIELD_FROM_ISR();
+}
+
+void LoraMesher::receivingRoutine(RadioState& radioState) {
     ESP_LOGV(LM_TAG, "Receiving routine started");
     vTaskSuspend(NULL);
 
@@ -381,6 +510,7 @@ void LoraMesher::receivingRoutine() {
     size_t packetSize;
     int8_t rssi, snr;
     int16_t state;
+    PacketView view;
 
     for (;;) {
         TWres = xTaskNotifyWait(
@@ -390,21 +520,18 @@ void LoraMesher::receivingRoutine() {
             portMAX_DELAY);
 
         if (TWres == pdPASS) {
-            ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-            ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+                ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
 
-            hasReceivedMessage = true;
+            radioState.hasReceivedMessage = true;
 
-            packetSize = radio->getPacketLength();
+            packetSize = radioState.module->getPacketLength();
             if (packetSize == 0)
                 ESP_LOGW(LM_TAG, "Empty packet received");
             else {
-                Packet<uint8_t>* rx = PacketService::createEmptyPacket(packetSize);
+                rssi = (int8_t)round(radioState.module->getRSSI());
+                snr = (int8_t)round(radioState.module->getSNR());
 
-                rssi = (int8_t)round(radio->getRSSI());
-                snr = (int8_t)round(radio->getSNR());
-
-                ESP_LOGI(LM_TAG, "Receiving LoRa packet: Size: %d bytes RSSI: %d SNR: %d", packetSize, rssi, snr);
+                LM_TRACE_I(TraceEvent::PACKET_RECEIVING, packetSize, rssi, snr);
 
                 size_t max_packet_size = PacketFactory::getMaxPacketSize();
                 if (packetSize > max_packet_size) {
@@ -412,7 +539,15 @@ void LoraMesher::receivingRoutine() {
                     packetSize = max_packet_size;
                 }
 
-                state = radio->readData(reinterpret_cast<uint8_t*>(rx), packetSize);
+                //The FIFO of the radio is read directly into the pool block of the packet
+                Packet<uint8_t>* rx = PacketService::createEmptyPacket(packetSize);
+                if (rx == nullptr) {
+                    ESP_LOGW(LM_TAG, "No memory to receive the packet, discarding it");
+                    startReceiving(radioState);
+                    continue;
+                }
+
+                state = radioState.module->readData(reinterpret_cast<uint8_t*>(rx), packetSize);
 
                 if (state != RADIOLIB_ERR_NONE) {
                     ESP_LOGW(LM_TAG, "Reading packet data gave error: %d", state);
@@ -424,27 +559,44 @@ void LoraMesher::receivingRoutine() {
                     // TODO: Set a count to get the number of CRC errors
                     deletePacket(rx);
                 }
-                else if (packetSize != rx->packetSize) {
-                    ESP_LOGW(LM_TAG, "Packet size is different from the size read");
+                //The size of the default header is not the size read, the frame has a compact header or it is malformed
+                else if (PacketService::isCompactFrame(reinterpret_cast<uint8_t*>(rx), packetSize) && !readCompactFrame(rx, packetSize)) {
+                    deletePacket(rx);
+                }
+                else if (!PacketService::parsePacket(rx, view)) {
+                    ESP_LOGW(LM_TAG, "Packet smaller than its header, %d bytes", packetSize);
                     deletePacket(rx);
                 }
                 else {
-                    //Create a Packet Queue element containing the Packet
+                    //Create a Packet Queue element containing the Packet and its view
                     QueuePacket<Packet<uint8_t>>* pq = PacketQueueService::createQueuePacket(rx, 0, 0, rssi, snr);
+                    pq->view = view;
+                    pq->timestamp = LatencyService::now();
+
+                    LatencyService::record(LatencyStage::RX_READ, radioState.receiveInterruptTime, pq->timestamp);
+
+                    //Add the Packet Queue element created into the ReceivedPackets ring
+                    if (numRadios > 1)
+                        portENTER_CRITICAL(&receivedMux);
+
+                    bool pushed = ReceivedPackets->push(pq);
 
-                    //Add the Packet Queue element created into the ReceivedPackets List
-                    ReceivedPackets->Append(pq);
+                    if (numRadios > 1)
+                        portEXIT_CRITICAL(&receivedMux);
 
-                    //Notify that a packet needs to be process
-                    TWres = xTaskNotifyFromISR(
-                        ReceiveData_TaskHandle,
-                        0,
-                        eSetValueWithoutOverwrite,
-                        &TWres);
+                    if (!pushed) {
+                        ESP_LOGW(LM_TAG, "Received packets queue full, deleting packet");
+                        incReceivedQueueFull();
+                        PacketQueueService::deleteQueuePacketAndPacket(pq);
+                    }
+                    else {
+                        //Notify that a packet needs to be process
+                        xTaskNotifyGive(ReceiveData_TaskHandle);
+                    }
                 }
             }
 
-            startReceiving();
+            startReceiving(radioState);
         }
     }
 }
@@ -453,16 +605,48 @@ uint16_t LoraMesher::getLocalAddress() {
     return WiFiService::getLocalAddress();
 }
 
+StatsSnapshot LoraMesher::getStatsSnapshot(bool reset) {
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&statsMux);
+
+    StatsSnapshot snapshot = stats;
+    if (reset) {
+        stats = {};
+        stats.startTime = now;
+    }
+
+    portEXIT_CRITICAL(&statsMux);
+
+    snapshot.snapshotTime = now;
+    return snapshot;
+}
+
+TaskStats LoraMesher::getTaskStats() {
+    auto stackFree = [](TaskHandle_t task) -> uint32_t { return task != nullptr ? uxTaskGetStackHighWaterMark(task) : 0; };
+
+    TaskStats taskStats;
+    taskStats.receiveStackFree = stackFree(radios[CONTROL_RADIO].receiveTask);
+    taskStats.dataReceiveStackFree = stackFree(radios[DATA_RADIO].receiveTask);
+    taskStats.sendStackFree = stackFree(SendData_TaskHandle);
+    taskStats.helloStackFree = stackFree(Hello_TaskHandle);
+    taskStats.processStackFree = stackFree(ReceiveData_TaskHandle);
+    taskStats.routingTableManagerStackFree = stackFree(RoutingTableManager_TaskHandle);
+    taskStats.queueManagerStackFree = stackFree(QueueManager_TaskHandle);
+    taskStats.traceStackFree = stackFree(Trace_TaskHandle);
+    return taskStats;
+}
+
 /**
  *  Region Packet Service
 **/
 
-void LoraMesher::waitBeforeSend(uint8_t repeatedDetectPreambles) {
+void LoraMesher::waitBeforeSend(RadioState& radioState, uint8_t repeatedDetectPreambles) {
     // TODO: Why did I set this if?
     if (repeatedDetectPreambles > RoutingTableService::routingTableSize())
         return;
 
-    hasReceivedMessage = false;
+    radioState.hasReceivedMessage = false;
 
     //Random delay, to avoid some collisions.
     uint32_t randomDelay = getPropagationTimeWithRandom(repeatedDetectPreambles);
@@ -472,707 +656,2624 @@ void LoraMesher::waitBeforeSend(uint8_t repeatedDetectPreambles) {
     //Set a random delay, to avoid some collisions.
     vTaskDelay(randomDelay / portTICK_PERIOD_MS);
 
-    if (hasReceivedMessage) {
-        startReceiving();
+    if (radioState.hasReceivedMessage) {
+        startReceiving(radioState);
         ESP_LOGV(LM_TAG, "Preamble detected while waiting %d", repeatedDetectPreambles);
-        waitBeforeSend(repeatedDetectPreambles + 1);
+        waitBeforeSend(radioState, repeatedDetectPreambles + 1);
+    }
+}
+
+bool LoraMesher::waitChannelFree(RadioState& radioState) {
+    // Slot of the backoff, a fraction of the longest packet
+    uint32_t slot = getMaxPropagationTime() / LM_LBT_SLOTS_PER_PACKET + 1;
+
+    // Initial jitter, the nodes that forward the same packet do not scan at the same time
+    vTaskDelay(random(0, slot) / portTICK_PERIOD_MS + 1);
+
+    for (uint8_t attempt = 0; attempt < LM_LBT_MAX_ATTEMPTS; attempt++) {
+        setDioActionsForScanChannel(radioState);
+
+        int res = radioState.module->scanChannel();
+        if (res == RADIOLIB_CHANNEL_FREE)
+            return true;
+
+        // Receive the packet detected while waiting
+        startReceiving(radioState);
+
+        uint8_t exponent = attempt < LM_LBT_MAX_BACKOFF_EXP ? attempt + 1 : LM_LBT_MAX_BACKOFF_EXP;
+        uint32_t backoff = random(1, (1 << exponent) + 1) * slot;
+
+        ESP_LOGV(LM_TAG, "Channel busy (%d), backoff %d ms", res, (int)backoff);
+
+        vTaskDelay(backoff / portTICK_PERIOD_MS + 1);
     }
+
+    ESP_LOGW(LM_TAG, "Channel busy after %d scans, sending anyway", LM_LBT_MAX_ATTEMPTS);
+    return false;
 }
 
 uint32_t LoraMesher::getMaxPropagationTime() {
     return maxTimeOnAir;
 }
 
-bool LoraMesher::sendPacket(Packet<uint8_t>* p) {
-    waitBeforeSend(1);
-
-    clearDioActions();
+void LoraMesher::waitBeforeSendPacket(Packet<uint8_t>* p) {
+    uint8_t channel = getPacketChannel(p);
+    RadioState& radioState = getSendRadio(channel);
 
-    // Print the packet to be sent
-    printHeaderPacket(p, "send");
+    // The previous packet of the radio must have been sent
+    finishTransmit(radioState, true);
 
-    //Blocking transmit, it is necessary due to deleting the packet after sending it. 
-    int resT = radio->transmit(reinterpret_cast<uint8_t*>(p), p->packetSize);
+    uint32_t backoffStart = LatencyService::now();
 
-    //Start receiving again after sending a packet
-    startReceiving();
+    //Inside its slot the node is the only one that sends, the data channels keep the random access
+    if (channel == 0 && SlotService::isSynchronized()) {
+        uint32_t wait = SlotService::getWaitTime(radioState.module->getTimeOnAir(getFrameLength(p)) / 1000);
+        if (wait > 0)
+            vTaskDelay(wait / portTICK_PERIOD_MS);
 
-    if (resT != RADIOLIB_ERR_NONE) {
-        ESP_LOGE(LM_TAG, "Transmit gave error: %d", resT);
-        return false;
+        incSlottedPackets();
     }
-    return true;
+    else if (loraMesherConfig->listenBeforeTalk) {
+        setRadioChannel(radioState, channel);
+        waitChannelFree(radioState);
+    }
+    else
+        waitBeforeSend(radioState, 1);
+
+    LatencyService::record(LatencyStage::TX_BACKOFF, backoffStart);
 }
 
-void LoraMesher::sendPackets() {
-    ESP_LOGV(LM_TAG, "Send routine started");
-    vTaskSuspend(NULL);
+bool LoraMesher::sendPacket(Packet<uint8_t>* p, const PacketView& view) {
+    //The session could have ended while waiting, the packet is sent by the radio of its channel now
+    uint8_t channel = getPacketChannel(p);
+    RadioState& radioState = getSendRadio(channel);
+    finishTransmit(radioState, true);
 
-    int sendCounter = 0;
-    uint8_t sendId = 0;
-    uint8_t resendMessage = 0;
+    radioState.module->clearDioActions();
 
-#ifdef ARDUINO
-    randomSeed(getLocalAddress());
-#else
-    srand(getLocalAddress());
-#endif
-    const uint8_t dutyCycleEvery = (100 - LM_DUTY_CYCLE) / portTICK_PERIOD_MS;
+    setRadioChannel(radioState, channel);
 
-    for (;;) {
-        /* Wait for the notification of new packet has to be sent and enter blocking */
-        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    //The channels can be in different sub-bands with different duty cycles
+    if (ChannelService::isEnabled())
+        AirtimeService::setFrequency(ChannelService::getFrequency(channel));
 
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+    if (loraMesherConfig->adaptiveDataRate)
+        setTransmitPower(radioState, getLinkTransmitPower(p));
 
-        while (ToSendPackets->getLength() > 0) {
+    // Trace the packet to be sent
+    traceHeaderPacket(p, view, TraceEvent::PACKET_SENT);
 
-            ToSendPackets->setInUse();
+    //The packets to the neighbours that receive them are sent with the compact header, written in another pool block
+    uint8_t* frame = reinterpret_cast<uint8_t*>(p);
+    size_t frameLength = p->packetSize;
+    uint8_t* compactFrame = nullptr;
 
-            ESP_LOGI(LM_TAG, "Size of Send Packets Queue: %d", ToSendPackets->getLength());
+    size_t compactLength = getCompactFrameLength(p);
+    if (compactLength > 0) {
+        compactFrame = static_cast<uint8_t*>(PacketPoolService::allocate(compactLength));
 
-            QueuePacket<Packet<uint8_t>>* tx = ToSendPackets->Pop();
+        if (compactFrame != nullptr && (compactLength = PacketService::writeCompactFrame(p, compactFrame)) > 0) {
+            frame = compactFrame;
+            frameLength = compactLength;
+            incCompactHeaders(p->packetSize - frameLength);
+        }
+    }
 
-            ToSendPackets->releaseInUse();
+    radioState.transmitDone = false;
+    radioState.transmitting = true;
+    radioState.transmitDeadline = millis() + 2 * radioState.module->getTimeOnAir(frameLength) / 1000 + LM_TRANSMIT_DONE_MARGIN;
 
-            if (tx) {
-                ESP_LOGV(LM_TAG, "Send n. %d", sendCounter);
+    radioState.module->setDioActionForTransmitting(&radioState == &radios[DATA_RADIO] ? onDataTransmitDone : onTransmitDone);
 
-                if (tx->packet->src == getLocalAddress())
-                    tx->packet->id = sendId++;
+    radioState.transmitStartTime = LatencyService::now();
 
-                //If the packet has a data packet and its destination is not broadcast add the via to the packet and forward the packet
-                if (PacketService::isDataPacket(tx->packet->type) && tx->packet->dst != BROADCAST_ADDR) {
-                    uint16_t nextHop = RoutingTableService::getNextHop(tx->packet->dst);
+    //The packet is copied into the radio buffer, it can be deleted while it is being transmitted
+    int resT = radioState.module->startTransmit(frame, frameLength);
 
-                    //Next hop not found
-                    if (nextHop == 0) {
-                        ESP_LOGE(LM_TAG, "NextHop Not found from %X, destination %X", tx->packet->src, tx->packet->dst);
-                        PacketQueueService::deleteQueuePacketAndPacket(tx);
-                        incDestinyUnreachable();
-                        continue;
-                    }
+    if (compactFrame != nullptr)
+        PacketPoolService::release(compactFrame);
 
-                    (reinterpret_cast<DataPacket*>(tx->packet))->via = nextHop;
-                }
+    if (resT != RADIOLIB_ERR_NONE) {
+        radioState.transmitting = false;
+        startReceiving(radioState);
 
-                recordState(LM_StateType::STATE_TYPE_SENT, tx->packet);
+        ESP_LOGE(LM_TAG, "Transmit gave error: %d", resT);
+        return false;
+    }
 
-                //Send packet
-                bool hasSend = sendPacket(tx->packet);
+    //The last ACK of a finished sequence has been sent in its data channel
+    if (channel != 0)
+        ChannelService::packetSent(reinterpret_cast<DataPacket*>(p)->via);
 
-                sendCounter++;
+    return true;
+}
 
-                if (hasSend) {
-                    incSendPackets();
-                    incSentPayloadBytes(PacketService::getPacketPayloadLengthWithoutControl(tx->packet));
-                    incSentControlBytes(PacketService::getControlLength(tx->packet));
-                    if (tx->packet->src != getLocalAddress())
-                        incForwardedPackets();
-                }
+size_t LoraMesher::getCompactFrameLength(Packet<uint8_t>* p) {
+    if (!loraMesherConfig->compactHeader)
+        return 0;
 
-                //TODO: If the packet has not been send, add it to the queue and send it again
-                if (!hasSend && resendMessage < MAX_RESEND_PACKET) {
-                    tx->priority = MAX_PRIORITY;
-                    PacketQueueService::addOrdered(ToSendPackets, tx);
+    size_t length = PacketService::getCompactFrameLength(p);
+    if (length == 0)
+        return 0;
 
-                    resendMessage++;
-                    continue;
-                }
+    //The next hop resolves the short addresses with its routing table, they must identify the same nodes in this one
+    uint16_t via = reinterpret_cast<DataPacket*>(p)->via;
+    if (!RoutingTableService::hasCompactHeader(via) || !RoutingTableService::hasUniqueShortAddresses() ||
+        !RoutingTableService::hasShortAddress(p->dst) || !RoutingTableService::hasShortAddress(p->src))
+        return 0;
 
-                resendMessage = 0;
+    return length;
+}
 
-                uint32_t timeOnAir = radio->getTimeOnAir(tx->packet->packetSize) / 1000;
+size_t LoraMesher::getFrameLength(Packet<uint8_t>* p) {
+    size_t compactLength = getCompactFrameLength(p);
+    return compactLength > 0 ? compactLength : p->packetSize;
+}
 
-                TickType_t delayBetweenSend = timeOnAir * dutyCycleEvery;
+bool LoraMesher::readCompactFrame(Packet<uint8_t>*& frame, size_t frameLength) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(frame);
 
-                ESP_LOGV(LM_TAG, "TimeOnAir %d ms, next message in %d ms", (int)timeOnAir, (int)delayBetweenSend);
+    PacketService::CompactHeader header;
+    if (!PacketService::readCompactHeader(bytes, frameLength, header)) {
+        ESP_LOGW(LM_TAG, "Packet size is different from the size read and it is not a compact header");
+        return false;
+    }
 
-                PacketQueueService::deleteQueuePacketAndPacket(tx);
+    uint16_t dst, src, via;
+    if (!RoutingTableService::resolveShortAddress(header.dst, dst) || !RoutingTableService::resolveShortAddress(header.src, src) ||
+        !RoutingTableService::resolveShortAddress(header.via, via)) {
+        //The packets overheard from other neighbours can have addresses that this node does not know
+        ESP_LOGV(LM_TAG, "Compact header with unknown short addresses, %X to %X via %X", header.src, header.dst, header.via);
+        return false;
+    }
 
-                vTaskDelay(delayBetweenSend / portTICK_PERIOD_MS);
-            }
-        }
+    Packet<uint8_t>* p = PacketService::expandCompactFrame(bytes, header, dst, src, via);
+    if (p == nullptr) {
+        ESP_LOGW(LM_TAG, "No memory to expand the compact header");
+        return false;
     }
+
+    deletePacket(frame);
+    frame = p;
+
+    return true;
 }
 
-void LoraMesher::sendHelloPacket() {
-    ESP_LOGV(LM_TAG, "Send Hello Packet routine started");
+uint8_t LoraMesher::getPacketChannel(Packet<uint8_t>* p) {
+    //All the nodes listen to the control channel
+    if (!ChannelService::isEnabled() || !PacketService::isDataPacket(p->type) || p->dst == BROADCAST_ADDR ||
+        PacketService::isSyncPacket(p->type))
+        return 0;
 
-    vTaskSuspend(NULL);
+    return ChannelService::getSendChannel(reinterpret_cast<DataPacket*>(p)->via);
+}
 
-    size_t maxNodesPerPacket = (PacketFactory::getMaxPacketSize() - sizeof(RoutePacket)) / sizeof(NetworkNode);
+void LoraMesher::setRadioChannel(RadioState& radioState, uint8_t channel) {
+    if (channel == radioState.channel)
+        return;
 
-    ESP_LOGV(LM_TAG, "Max routing nodes per packet: %d", maxNodesPerPacket);
+    float freq = ChannelService::getFrequency(channel);
 
-    //Wait an initial 2 second
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
+    int16_t res = radioState.module->setFrequency(freq);
+    if (res != RADIOLIB_ERR_NONE) {
+        ESP_LOGE(LM_TAG, "Channel %d could not be set: %d", channel, res);
+        return;
+    }
 
-    for (;;) {
-        ESP_LOGV(LM_TAG, "Creating Routing Packet");
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+    ESP_LOGV(LM_TAG, "Channel set to %d, %.3f MHz", channel, freq);
+    radioState.channel = channel;
+}
 
-        incSentHelloPackets();
+void LoraMesher::setFrequency(float freq) {
+    radio->setFrequency(freq);
+    recalculateMaxTimeOnAir();
+    AirtimeService::setFrequency(freq);
+
+    //The data channels are spaced from the new control channel, the data radio is tuned again when it starts receiving
+    loraMesherConfig->freq = freq;
+    ChannelService::configure(freq, loraMesherConfig->channelSpacing, loraMesherConfig->dataChannels);
+    for (RadioState& radioState : radios)
+        radioState.channel = 0;
+    if (dataRadio != nullptr)
+        dataRadio->setFrequency(freq);
+}
 
-        NetworkNode* nodes = RoutingTableService::getAllNetworkNodes();
-        size_t numOfNodes = RoutingTableService::routingTableSize();
+int8_t LoraMesher::getLinkTransmitPower(Packet<uint8_t>* p) {
+    //The broadcasts and the HELLO packets must reach all the neighbours
+    if (!PacketService::isDataPacket(p->type) || p->dst == BROADCAST_ADDR)
+        return txPower;
 
-        size_t numPackets = (numOfNodes + maxNodesPerPacket - 1) / maxNodesPerPacket;
-        numPackets = (numPackets == 0) ? 1 : numPackets;
+    uint16_t via = reinterpret_cast<DataPacket*>(p)->via;
+    RouteNode* neighbour = RoutingTableService::findNode(via);
 
-        for (size_t i = 0; i < numPackets; ++i) {
-            size_t startIndex = i * maxNodesPerPacket;
-            size_t endIndex = startIndex + maxNodesPerPacket;
-            if (endIndex > numOfNodes) {
-                endIndex = numOfNodes;
-            }
+    //The SNR at which the neighbour receives this node is unknown
+    if (neighbour == nullptr || neighbour->via != via || neighbour->sentSNR == 0)
+        return txPower;
 
-            size_t nodesInThisPacket = endIndex - startIndex;
+    //Margin over the demodulation floor of the spreading factor in dB, from -7.5 dB at SF7 to -20 dB at SF12
+    int16_t margin = (neighbour->sentSNR * 10 - (100 - 25 * (int16_t) loraMesherConfig->sf)) / 10;
+    int16_t reduction = margin - LM_ADR_SNR_MARGIN;
 
-            // Create and send the packet
-            RoutePacket* tx = PacketService::createRoutingPacket(
-                getLocalAddress(), &nodes[startIndex], nodesInThisPacket, RoleService::getRole()
-            );
+    if (reduction <= 0 || txPower <= LM_ADR_MIN_POWER)
+        return txPower;
 
-            setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(tx), DEFAULT_PRIORITY + 4);
-        }
+    return txPower - reduction < LM_ADR_MIN_POWER ? LM_ADR_MIN_POWER : txPower - reduction;
+}
 
-        // Delete the nodes array
-        if (numOfNodes > 0)
-            delete[] nodes;
+void LoraMesher::setTransmitPower(RadioState& radioState, int8_t power) {
+    if (power == radioState.actualTxPower)
+        return;
 
-        // Wait for HELLO_PACKETS_DELAY seconds to send the next hello packet
-        vTaskDelay(HELLO_PACKETS_DELAY * 1000 / portTICK_PERIOD_MS);
+    LM_Module* module = radioState.module;
+    int16_t res = txUseRfo ? module->setOutputPower(power, true) : module->setOutputPower(power);
+    if (res != RADIOLIB_ERR_NONE) {
+        ESP_LOGE(LM_TAG, "Transmission power %d dBm could not be set: %d", power, res);
+        return;
     }
+
+    ESP_LOGV(LM_TAG, "Transmission power set to %d dBm", power);
+    radioState.actualTxPower = power;
 }
 
-void LoraMesher::processPackets() {
-    ESP_LOGV(LM_TAG, "Process routine started");
-    vTaskSuspend(NULL);
+void LoraMesher::setOutputPower(int8_t power, bool useRfo) {
+    radio->setOutputPower(power, useRfo);
+    if (dataRadio != nullptr)
+        dataRadio->setOutputPower(power, useRfo);
 
-    for (;;) {
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+    txPower = power;
+    for (RadioState& radioState : radios)
+        radioState.actualTxPower = power;
+    txUseRfo = useRfo;
+}
 
-        /* Wait for the notification of receivingRoutine and enter blocking */
-        ulTaskNotifyTake(pdPASS, portMAX_DELAY);
+QueuePacket<Packet<uint8_t>>* LoraMesher::aggregatePackets(QueuePacket<Packet<uint8_t>>* tx, uint16_t nextHop, uint8_t& sendId) {
+    const size_t maxPayloadSize = PacketService::getMaximumPayloadLength(AGGREGATED_P);
+    const size_t maxRecords = std::min(maxPayloadSize / PacketService::AGGREGATED_RECORD_HEADER_SIZE, PacketService::MAX_AGGREGATED_RECORDS);
 
-        ESP_LOGV(LM_TAG, "Size of Received Packets Queue: %d", ReceivedPackets->getLength());
+    DataPacket* first = reinterpret_cast<DataPacket*>(tx->packet);
+    size_t payloadSize = PacketService::getAggregatedRecordSize(first);
+    if (payloadSize > maxPayloadSize)
+        return tx;
 
-        while (ReceivedPackets->getLength() > 0) {
-            QueuePacket<Packet<uint8_t>>* rx = ReceivedPackets->Pop();
+    QueuePacket<Packet<uint8_t>>* records[PacketService::MAX_AGGREGATED_RECORDS];
+    records[0] = tx;
+    size_t numRecords = 1;
 
-            if (rx) {
-                uint8_t type = rx->packet->type;
+    //The ACK is not delayed waiting for data packets
+    bool isAck = first->type == ACK_P;
+    unsigned long holdUntil = millis() + (isAck ? 0 : loraMesherConfig->aggregationHoldTime);
 
-#ifdef LM_TESTING
-                if (!shouldProcessPacket(rx->packet)) {
-                    PacketQueueService::deleteQueuePacketAndPacket(rx);
-                    ESP_LOGV(LM_TAG, "TESTING: Packet not for me, deleting it");
-                    continue;
-                }
-#endif
+    for (;;) {
+        ToSendPackets->setInUse();
+
+        // Take all the queued data packets to the same next hop that fit inside the frame
+        QueuePacket<Packet<uint8_t>>* next;
+        while (numRecords < maxRecords && (next = ToSendPackets->Extract([&](QueuePacket<Packet<uint8_t>>* qp) {
+            Packet<uint8_t>* p = qp->packet;
+            return PacketService::isOnlyDataPacket(p->type) && !PacketService::isCompressedPacket(p->type) && p->dst != BROADCAST_ADDR &&
+                payloadSize + PacketService::getAggregatedRecordSize(reinterpret_cast<DataPacket*>(p)) <= maxPayloadSize &&
+                RoutingTableService::isNextHop(p->dst, nextHop);
+        })) != nullptr) {
+            payloadSize += PacketService::getAggregatedRecordSize(reinterpret_cast<DataPacket*>(next->packet));
+            records[numRecords++] = next;
+            sendDuplicateCache->remove(PacketService::getPacketKey(next->packet, false));
+        }
 
-                printHeaderPacket(rx->packet, "received");
+        // Do not hold the packets with higher priority
+        QueuePacket<Packet<uint8_t>>* waiting = ToSendPackets->First();
+        bool urgent = waiting != nullptr && waiting->priority > DEFAULT_PRIORITY;
 
+        ToSendPackets->releaseInUse();
 
-                recordState(LM_StateType::STATE_TYPE_RECEIVED, rx->packet);
+        long remaining = (long) (holdUntil - millis());
+        if (urgent || remaining <= 0 || numRecords == maxRecords ||
+            payloadSize + PacketService::AGGREGATED_RECORD_HEADER_SIZE >= maxPayloadSize)
+            break;
 
-                incReceivedPayloadBytes(PacketService::getPacketPayloadLengthWithoutControl(rx->packet));
-                incReceivedControlBytes(PacketService::getControlLength(rx->packet));
+        // Wait for new packets
+        ulTaskNotifyTake(pdFALSE, remaining / portTICK_PERIOD_MS + 1);
+        finishTransmit(false);
+    }
 
-                if (PacketService::isHelloPacket(type)) {
-                    incRecHelloPackets();
+    QueuePacket<Packet<uint8_t>>* aggregated = tx;
 
-                    RoutingTableService::processRoute(reinterpret_cast<RoutePacket*>(rx->packet), rx->snr);
-                    PacketQueueService::deleteQueuePacketAndPacket(rx);
-                }
-                else if (PacketService::isDataPacket(type))
-                    processDataPacket(reinterpret_cast<QueuePacket<DataPacket>*>(rx));
-                else {
-                    ESP_LOGV(LM_TAG, "Packet not identified, deleting it");
-                    incReceivedNotForMe();
-                    PacketQueueService::deleteQueuePacketAndPacket(rx);
-                }
-            }
+    if (numRecords > 1) {
+        DataPacket* packets[PacketService::MAX_AGGREGATED_RECORDS];
+        for (size_t i = 0; i < numRecords; i++) {
+            Packet<uint8_t>* p = records[i]->packet;
+            if (p->src == getLocalAddress())
+                p->id = records[i] == tx ? p->id : sendId++;
+            packets[i] = reinterpret_cast<DataPacket*>(p);
         }
-    }
-}
 
-void LoraMesher::routingTableManager() {
-    ESP_LOGV(LM_TAG, "Routing Table Manager routine started");
-    vTaskSuspend(NULL);
+        DataPacket* frame = PacketService::createAggregatedPacket(nextHop, getLocalAddress(), packets, numRecords);
 
-    for (;;) {
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+        LM_TRACE_I(TraceEvent::PACKETS_AGGREGATED, numRecords, nextHop, frame->packetSize);
+        incAggregatedPackets(isAck ? numRecords - 1 : numRecords);
+        if (isAck)
+            incCoalescedAcks();
 
-        // TODO: If the routing table removes a node, remove the nodes from the Q_WSP and Q_WRP
-        ESP_LOGI(LM_TAG, "Checking routes timeout");
+        for (size_t i = 0; i < numRecords; i++)
+            PacketQueueService::deleteQueuePacketAndPacket(records[i]);
 
-        RoutingTableService::routingTableList->setInUse();
+        aggregated = PacketQueueService::createQueuePacket(reinterpret_cast<Packet<uint8_t>*>(frame), DEFAULT_PRIORITY);
+    }
 
-        if (RoutingTableService::routingTableList->moveToStart()) {
-            do {
-                RouteNode* node = RoutingTableService::routingTableList->getCurrent();
+    return aggregated;
+}
 
-                if (node->timeout < millis()) {
-                    ESP_LOGW(LM_TAG, "Route timeout %X via %X", node->networkNode.address, node->via);
-                    removeNodeFromQSPandQWP(node->networkNode.address);
+void LoraMesher::finishTransmit(bool wait) {
+    for (uint8_t i = 0; i < numRadios; i++)
+        finishTransmit(radios[i], wait);
+}
 
-                    delete node;
-                    RoutingTableService::routingTableList->DeleteCurrent();
-                }
+void LoraMesher::finishTransmit(RadioState& radioState, bool wait) {
+    if (!radioState.transmitting || (!radioState.transmitDone && !wait))
+        return;
 
-            } while (RoutingTableService::routingTableList->next());
+    // The notifications of new packets can be consumed, the send loop checks the queue length
+    while (!radioState.transmitDone) {
+        long remaining = (long) (radioState.transmitDeadline - millis());
+        if (remaining <= 0) {
+            ESP_LOGE(LM_TAG, "Transmit done not received");
+            break;
         }
 
-        RoutingTableService::routingTableList->releaseInUse();
+        ulTaskNotifyTake(pdFALSE, remaining / portTICK_PERIOD_MS + 1);
+    }
+
+    radioState.transmitting = false;
+
+    if (radioState.transmitDone)
+        LatencyService::record(LatencyStage::TX_AIR, radioState.transmitStartTime, radioState.transmitDoneTime);
+
+    int res = radioState.module->finishTransmit();
+    if (res != RADIOLIB_ERR_NONE)
+        ESP_LOGW(LM_TAG, "Finish transmit gave error: %d", res);
+
+    //Start receiving again after sending a packet
+    startReceiving(radioState);
+}
+
+void LoraMesher::sendPackets() {
+    ESP_LOGV(LM_TAG, "Send routine started");
+    vTaskSuspend(NULL);
+
+    int sendCounter = 0;
+    uint8_t sendId = 0;
+    uint8_t resendMessage = 0;
+
+#ifdef ARDUINO
+    randomSeed(getLocalAddress());
+#else
+    srand(getLocalAddress());
+#endif
+    for (;;) {
+        /* Wait for the notification of new packet has to be sent or the transmit done and enter blocking */
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+        finishTransmit(false);
+
+        //A session has started or ended, listen to its channel
+        for (uint8_t i = 0; i < numRadios; i++) {
+            if (!radios[i].transmitting && radios[i].channel != getListenChannel(radios[i]))
+                startReceiving(radios[i]);
+        }
+
+        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+        while (ToSendPackets->getLength() > 0) {
+            finishTransmit(false);
+
+            ToSendPackets->setInUse();
+
+            LM_TRACE_I(TraceEvent::SEND_QUEUE_SIZE, ToSendPackets->getLength());
+
+            QueuePacket<Packet<uint8_t>>* first = ToSendPackets->First();
+
+            // The ACKs wait for the next ACKs to the same node to be coalesced with them, the packets behind them are sent meanwhile
+            if (loraMesherConfig->ackDelay > 0) {
+                uint32_t ackWait = UINT32_MAX;
+                first = nullptr;
+
+                if (ToSendPackets->moveToStart()) {
+                    do {
+                        QueuePacket<Packet<uint8_t>>* qp = ToSendPackets->getCurrent();
+                        uint32_t waited = (LatencyService::now() - qp->timestamp) / 1000;
+                        if (qp->packet->type != ACK_P || waited >= loraMesherConfig->ackDelay) {
+                            first = qp;
+                            break;
+                        }
+
+                        ackWait = std::min<uint32_t>(ackWait, loraMesherConfig->ackDelay - waited);
+                    } while (ToSendPackets->next());
+                }
+
+                // Only ACKs waiting, a new packet wakes the task up
+                if (first == nullptr) {
+                    ToSendPackets->releaseInUse();
+
+                    ulTaskNotifyTake(pdFALSE, ackWait / portTICK_PERIOD_MS + 1);
+                    continue;
+                }
+            }
+
+            // Wait until the airtime budget allows to send the first packet, a new packet wakes the task up
+            uint32_t airtimeWait = first == nullptr ? 0 : AirtimeService::getTimeUntilAvailable(
+                radio->getTimeOnAir(getFrameLength(first->packet)) / 1000, first->priority);
+
+            if (airtimeWait > 0) {
+                ToSendPackets->releaseInUse();
+
+                LM_TRACE_I(TraceEvent::AIRTIME_WAIT, airtimeWait);
+                AirtimeService::incDelayed();
+                ulTaskNotifyTake(pdFALSE, airtimeWait / portTICK_PERIOD_MS + 1);
+                continue;
+            }
+
+            QueuePacket<Packet<uint8_t>>* tx = first == ToSendPackets->First() ? ToSendPackets->Pop() :
+                ToSendPackets->Extract([first](QueuePacket<Packet<uint8_t>>* qp) { return qp == first; });
+
+            ToSendPackets->releaseInUse();
+
+            if (tx) {
+                LatencyService::recordQueue(tx->priority, tx->timestamp);
+
+                ESP_LOGV(LM_TAG, "Send n. %d", sendCounter);
+
+                //The packet is not waiting in the send queue anymore
+                sendDuplicateCache->remove(PacketService::getPacketKey(tx->packet, false));
+
+                //The payload is too old to be useful, it is dropped or it only takes the airtime left by the others
+                if (PacketQueueService::isExpired(tx)) {
+                    if (tx->demote) {
+                        ESP_LOGV(LM_TAG, "Packet to %X reached its deadline, demoted", tx->packet->dst);
+                        incDeadlineDemotions();
+
+                        tx->deadline = 0;
+                        tx->priority = LM_QOS_DEMOTED_PRIORITY;
+
+                        //It goes back through the duplicate cache and the capacity of the queue like a new packet
+                        if (isDuplicatePacket(tx->packet))
+                            PacketQueueService::deleteQueuePacketAndPacket(tx);
+                        else
+                            addToSendOrderedAndNotify(tx);
+                        continue;
+                    }
+
+                    ESP_LOGV(LM_TAG, "Packet to %X reached its deadline, dropped", tx->packet->dst);
+                    incDeadlineDrops();
+                    PacketQueueService::deleteQueuePacketAndPacket(tx);
+                    continue;
+                }
+
+                //Every forwarder identifies its transmissions of a multicast packet, the repairs are not taken as duplicates
+                bool isGroup = tx->packet->isGroupDestination();
+                if (tx->packet->src == getLocalAddress() || (isGroup && PacketService::isMulticastPacket(tx->packet->type)))
+                    tx->packet->id = sendId++;
+
+                //If the packet has a data packet and its destination is not a group add the via to the packet and forward the packet
+                if (PacketService::isDataPacket(tx->packet->type) && !isGroup) {
+                    uint16_t nextHop = RoutingTableService::getNextHop(tx->packet->dst);
+
+                    //Next hop not found
+                    if (nextHop == 0) {
+                        ESP_LOGE(LM_TAG, "NextHop Not found from %X, destination %X", tx->packet->src, tx->packet->dst);
+                        PacketQueueService::deleteQueuePacketAndPacket(tx);
+                        incDestinyUnreachable();
+                        continue;
+                    }
+
+                    (reinterpret_cast<DataPacket*>(tx->packet))->via = nextHop;
+
+                    if (tx->packet->src == getLocalAddress() && PacketTypeTable::get(tx->packet->type).kind == PacketKind::XL_DATA)
+                        addCongestionQueueDelay(tx, nextHop);
+
+                    if (loraMesherConfig->aggregation && ((PacketService::isOnlyDataPacket(tx->packet->type) &&
+                        !PacketService::isCompressedPacket(tx->packet->type)) || tx->packet->type == ACK_P)) {
+                        QueuePacket<Packet<uint8_t>>* aggregated = aggregatePackets(tx, nextHop, sendId);
+                        if (aggregated != tx) {
+                            tx = aggregated;
+                            tx->packet->id = sendId++;
+                        }
+                    }
+                }
+
+                //The header is final, parse it once for the logs, the statistics and the simulator
+                PacketService::parsePacket(tx->packet, tx->view);
+
+                recordState(LM_StateType::STATE_TYPE_SENT, tx);
+
+                waitBeforeSendPacket(tx->packet);
+
+                //The neighbours could have forwarded the flooded packet while it was waiting
+                if (isFloodSuppressed(tx->packet)) {
+                    ESP_LOGV(LM_TAG, "Flooded packet from %X suppressed before sending it", tx->packet->src);
+                    incSuppressedFloods();
+                    resendMessage = 0;
+                    PacketQueueService::deleteQueuePacketAndPacket(tx);
+                    continue;
+                }
+
+                //The beacon carries the time at which it is sent inside the frame
+                if (tx->view.isRoute() && PacketService::isHelloBeaconPacket(tx->packet->type))
+                    PacketService::setSlotBeaconOffset(reinterpret_cast<RoutePacket*>(tx->packet), SlotService::getFrameOffset());
+
+                //Send packet
+                bool hasSend = sendPacket(tx->packet, tx->view);
+
+                sendCounter++;
+
+                //Next hop of the unicast packets, used by the link counters
+                uint16_t via = tx->view.isData() && !isGroup ?
+                    reinterpret_cast<DataPacket*>(tx->packet)->via : 0;
+
+                if (hasSend) {
+                    if (via != 0)
+                        RoutingTableService::incLinkCounter(via, &LinkCounters::txPackets);
+
+                    AirtimeService::addAirtime(radio->getTimeOnAir(getFrameLength(tx->packet)) / 1000);
+                    incSendPackets();
+                    incSentPayloadBytes(tx->view.getUserPayloadLength());
+                    incSentControlBytes(tx->view.getControlLength());
+                    if (tx->packet->src != getLocalAddress())
+                        incForwardedPackets();
+                }
+
+                //TODO: If the packet has not been send, add it to the queue and send it again
+                if (!hasSend && resendMessage < MAX_RESEND_PACKET) {
+                    if (via != 0)
+                        RoutingTableService::incLinkCounter(via, &LinkCounters::retries);
+
+                    tx->priority = MAX_PRIORITY;
+                    tx->timestamp = LatencyService::now();
+                    PacketQueueService::addOrdered(ToSendPackets, tx);
+
+                    resendMessage++;
+                    continue;
+                }
+
+                if (!hasSend && via != 0)
+                    RoutingTableService::incLinkCounter(via, &LinkCounters::lost);
+
+                resendMessage = 0;
+
+                PacketQueueService::deleteQueuePacketAndPacket(tx);
+            }
+        }
+    }
+}
+
+void LoraMesher::sendHelloPacket() {
+    ESP_LOGV(LM_TAG, "Send Hello Packet routine started");
+
+    vTaskSuspend(NULL);
+
+    size_t maxNodesPerPacket = (PacketFactory::getMaxPacketSize() - sizeof(RoutePacket)) / sizeof(NetworkNode);
+
+    ESP_LOGV(LM_TAG, "Max routing nodes per packet: %d", maxNodesPerPacket);
+
+    //The first HELLO packet includes the whole routing table
+    uint8_t hellosSinceFullRefresh = LM_HELLO_FULL_REFRESH;
+    unsigned long nextHello = millis() + HELLO_PACKETS_DELAY * 1000;
+    unsigned long lastSolicitedHello = millis() - LM_HELLO_SOLICIT_HOLDOFF * 1000;
+    bool solicit = false;
+
+    for (;;) {
+        long remaining = (long) (nextHello - millis());
+        uint32_t notification = 0;
+
+        // Wait for the next periodic HELLO packet, for a route change, a route solicitation or the start
+        if (remaining > 0 && xTaskNotifyWait(0, UINT32_MAX, &notification, remaining / portTICK_PERIOD_MS + 1) == pdTRUE) {
+            if (notification & HELLO_NOTIFY_CHANGED) {
+                // Wait to send the changes of the next moments together
+                vTaskDelay(LM_HELLO_TRIGGERED_DELAY * 1000 / portTICK_PERIOD_MS);
+
+                uint32_t meanwhile = 0;
+                xTaskNotifyWait(0, UINT32_MAX, &meanwhile, 0);
+                notification |= meanwhile & ~HELLO_NOTIFY_CHANGED;
+
+                ESP_LOGV(LM_TAG, "Sending triggered HELLO packet");
+                sendRoutingPackets(true, false);
+            }
+
+            unsigned long solicitedHello = nextHello;
+
+            // The node has started, it does not wait for the periodic HELLO packets of its neighbours
+            if (notification & HELLO_NOTIFY_STARTED) {
+                solicitedHello = millis() + random(0, LM_HELLO_SOLICIT_JITTER);
+                solicit = true;
+            }
+            // Answer with the whole routing table at a random time, the neighbours that answer too do not collide
+            else if (notification & HELLO_NOTIFY_SOLICITED) {
+                solicitedHello = millis() + random(0, LM_HELLO_SOLICIT_JITTER);
+
+                unsigned long holdoff = lastSolicitedHello + LM_HELLO_SOLICIT_HOLDOFF * 1000;
+                if ((long) (holdoff - solicitedHello) > 0)
+                    solicitedHello = holdoff;
+            }
+
+            if ((long) (solicitedHello - nextHello) < 0) {
+                ESP_LOGV(LM_TAG, "Sending the whole routing table in %d ms", (int) (solicitedHello - millis()));
+                nextHello = solicitedHello;
+                hellosSinceFullRefresh = LM_HELLO_FULL_REFRESH;
+                lastSolicitedHello = solicitedHello;
+            }
+
+            continue;
+        }
+
+        ESP_LOGV(LM_TAG, "Creating Routing Packet");
+        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+        bool fullRefresh = hellosSinceFullRefresh >= LM_HELLO_FULL_REFRESH;
+        hellosSinceFullRefresh = fullRefresh ? 1 : hellosSinceFullRefresh + 1;
+
+        // A node without routes keeps asking for them, its neighbours could have started after it
+        solicit = solicit || RoutingTableService::routingTableSize() == 0;
+
+        // The periodic HELLO packet is sent even without changes, the neighbors refresh the routes through this node
+        sendRoutingPackets(!fullRefresh, true, solicit);
+        solicit = false;
+
+        // Wait for HELLO_PACKETS_DELAY seconds to send the next hello packet
+        nextHello = millis() + HELLO_PACKETS_DELAY * 1000;
+    }
+}
+
+void LoraMesher::sendRoutingPackets(bool onlyChanged, bool sendEmpty, bool solicit) {
+    size_t maxNodesPerPacket = (PacketFactory::getMaxPacketSize() - sizeof(RoutePacket)) / sizeof(NetworkNode);
+
+    size_t numOfNodes = RoutingTableService::getNetworkNodesToAdvertise(onlyChanged, advertisedNodes, RTMAXSIZE);
+    NetworkNode* nodes = numOfNodes == 0 ? nullptr : advertisedNodes;
+
+    if (numOfNodes == 0 && !sendEmpty)
+        return;
+
+    incSentHelloPackets();
+
+    uint8_t type = onlyChanged ? HELLO_DELTA_P : HELLO_P;
+    if (solicit)
+        type |= HELLO_SOLICIT_P;
+
+    // The neighbours send the compact headers to this node while its short address and the ones it knows are unique
+    if (loraMesherConfig->compactHeader && RoutingTableService::hasUniqueShortAddresses())
+        type |= HELLO_COMPACT_HEADER_P;
+
+    // The receivers update the compact headers and the solicitation with every HELLO, also the ones with only the reports
+    uint8_t overflowType = HELLO_DELTA_P | (type & (HELLO_COMPACT_HEADER_P | HELLO_SOLICIT_P));
+
+    if (loraMesherConfig->compactHello) {
+        type |= HELLO_COMPACT_P;
+
+        size_t sentNodes = 0;
+        size_t encodedNodes;
+        do {
+
+            // Create and send the packet with all the nodes that fit inside it
+            RoutePacket* tx = PacketService::createCompactRoutingPacket(
+                getLocalAddress(), nodes == nullptr ? nullptr : &nodes[sentNodes], numOfNodes - sentNodes, RoleService::getRole(), type, encodedNodes
+            );
+
+            sentNodes += encodedNodes;
+
+            setRoutingPacketForSend(tx, encodedNodes == 0 || sentNodes >= numOfNodes, overflowType);
+        } while (encodedNodes > 0 && sentNodes < numOfNodes);
+
+        return;
+    }
+
+    size_t numPackets = (numOfNodes + maxNodesPerPacket - 1) / maxNodesPerPacket;
+    numPackets = (numPackets == 0) ? 1 : numPackets;
+
+    for (size_t i = 0; i < numPackets; ++i) {
+        size_t startIndex = i * maxNodesPerPacket;
+        size_t endIndex = startIndex + maxNodesPerPacket;
+        if (endIndex > numOfNodes) {
+            endIndex = numOfNodes;
+        }
+
+        size_t nodesInThisPacket = endIndex - startIndex;
+
+        // Create and send the packet
+        RoutePacket* tx = PacketService::createRoutingPacket(
+            getLocalAddress(), nodes == nullptr ? nullptr : &nodes[startIndex], nodesInThisPacket, RoleService::getRole(), type
+        );
+
+        setRoutingPacketForSend(tx, i == numPackets - 1, overflowType);
+    }
+}
+
+void LoraMesher::setRoutingPacketForSend(RoutePacket* tx, bool last, uint8_t overflowType) {
+    if (!last || tx == nullptr) {
+        setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(tx), DEFAULT_PRIORITY + 4);
+        return;
+    }
+
+    //The neighbours adapt their transmission power to the SNR at which this node receives them
+    LinkReport reports[LM_ADR_MAX_REPORTS];
+    size_t numOfReports = loraMesherConfig->adaptiveDataRate ? RoutingTableService::getLinkReports(reports, LM_ADR_MAX_REPORTS) : 0;
+
+    if (numOfReports > 0) {
+        //Without space, the reports are sent inside a delta HELLO packet without routes
+        if (tx->packetSize + PacketService::getLinkReportsSize(numOfReports) > PacketFactory::getMaxPacketSize()) {
+            setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(tx), DEFAULT_PRIORITY + 4);
+            tx = PacketService::createRoutingPacket(getLocalAddress(), nullptr, 0, RoleService::getRole(), overflowType);
+        }
+
+        tx = PacketService::addLinkReports(tx, reports, numOfReports);
+    }
+
+    //The neighbours choose between the gateways with the same metric by their load
+    LoadReport loads[LM_MAX_LOAD_REPORTS];
+    size_t numOfLoads = loraMesherConfig->gatewayLoad ? RoutingTableService::getLoadReports(loads, LM_MAX_LOAD_REPORTS, getLoad()) : 0;
+
+    if (numOfLoads > 0) {
+        if (tx->packetSize + PacketService::getLoadReportsSize(numOfLoads) > PacketFactory::getMaxPacketSize()) {
+            setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(tx), DEFAULT_PRIORITY + 4);
+            tx = PacketService::createRoutingPacket(getLocalAddress(), nullptr, 0, RoleService::getRole(), overflowType);
+        }
+
+        tx = PacketService::addLoadReports(tx, loads, numOfLoads);
+    }
+
+    //The time reference of the slotted access sends the slots after the reports, a slot fits the longest packet
+    uint16_t owners[LM_SLOT_MAX_SLOTS];
+    uint16_t slotLength = maxTimeOnAir + LM_SLOT_GUARD_TIME;
+    size_t numOfSlots = SlotService::isReference() ? SlotService::getBeaconSlots(slotLength, owners, LM_SLOT_MAX_SLOTS) : 0;
+
+    if (numOfSlots > 0) {
+        if (tx->packetSize + PacketService::getSlotBeaconSize(numOfSlots) > PacketFactory::getMaxPacketSize()) {
+            setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(tx), DEFAULT_PRIORITY + 4);
+            tx = PacketService::createRoutingPacket(getLocalAddress(), nullptr, 0, RoleService::getRole(), overflowType);
+        }
+
+        tx = PacketService::addSlotBeacon(tx, slotLength, owners, numOfSlots);
+    }
+
+    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(tx), DEFAULT_PRIORITY + 4);
+}
+
+uint8_t LoraMesher::getLoad() {
+    //Without limit the send queue is compared with its default size
+    uint32_t capacity = loraMesherConfig->sendQueueSize > 0 ? loraMesherConfig->sendQueueSize : LM_SEND_QUEUE_SIZE;
+    uint32_t queueLoad = std::min<uint32_t>(ToSendPackets->getLength() * UINT8_MAX / capacity, UINT8_MAX);
+
+    AirtimeStats airtime = AirtimeService::getStats();
+    uint32_t airtimeLoad = airtime.budget > 0 ? std::min<uint32_t>(airtime.used * UINT8_MAX / airtime.budget, UINT8_MAX) : 0;
+
+    return std::max(queueLoad, airtimeLoad);
+}
+
+void LoraMesher::processPackets() {
+    ESP_LOGV(LM_TAG, "Process routine started");
+    vTaskSuspend(NULL);
+
+    for (;;) {
+        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+        /* Wait for the notification of receivingRoutine and enter blocking */
+        ulTaskNotifyTake(pdPASS, portMAX_DELAY);
+
+        ESP_LOGV(LM_TAG, "Size of Received Packets Queue: %d", ReceivedPackets->getLength());
+
+        QueuePacket<Packet<uint8_t>>* rx;
+
+        while ((rx = ReceivedPackets->pop()) != nullptr) {
+            uint8_t type = rx->packet->type;
+            const PacketView& view = rx->view;
+
+            uint32_t processStart = LatencyService::now();
+            LatencyService::record(LatencyStage::RX_QUEUE, rx->timestamp, processStart);
+
+#ifdef LM_TESTING
+            if (!shouldProcessPacket(rx->packet)) {
+                PacketQueueService::deleteQueuePacketAndPacket(rx);
+                ESP_LOGV(LM_TAG, "TESTING: Packet not for me, deleting it");
+                continue;
+            }
+#endif
+
+            if (!receivedDuplicateCache->add(PacketService::getPacketKey(rx->packet, true), LM_DUPLICATE_CACHE_TIMEOUT * 1000)) {
+                ESP_LOGV(LM_TAG, "Duplicate packet from %X, deleting it", rx->packet->src);
+                incReceivedDuplicates();
+                PacketQueueService::deleteQueuePacketAndPacket(rx);
+                continue;
+            }
+
+            traceHeaderPacket(rx->packet, view, TraceEvent::PACKET_RECEIVED);
+
+            recordState(LM_StateType::STATE_TYPE_RECEIVED, rx);
+
+            incReceivedPayloadBytes(view.getUserPayloadLength());
+            incReceivedControlBytes(view.getControlLength());
+            RoutingTableService::countReceivedPacket(rx->packet->src);
+
+            if (view.isRoute()) {
+                incRecHelloPackets();
+
+                RoutePacket* routePacket = reinterpret_cast<RoutePacket*>(rx->packet);
+
+                // The slots are at the end, after the load reports
+                uint16_t slotOwners[LM_SLOT_MAX_SLOTS];
+                uint16_t slotOffset = 0, slotLength = 0;
+                size_t numOfSlots = 0;
+                size_t receivedSize = routePacket->packetSize;
+                if (PacketService::isHelloBeaconPacket(type) &&
+                    !PacketService::removeSlotBeacon(routePacket, slotOffset, slotLength, slotOwners, LM_SLOT_MAX_SLOTS, numOfSlots)) {
+                    ESP_LOGE(LM_TAG, "Invalid slot beacon from %X", routePacket->src);
+                    PacketQueueService::deleteQueuePacketAndPacket(rx);
+                    continue;
+                }
+
+                // The load of the gateways is at the end, after the link reports
+                LoadReport loads[LM_MAX_LOAD_REPORTS];
+                size_t numOfLoads = 0;
+                if (PacketService::isHelloLoadPacket(type) &&
+                    !PacketService::removeLoadReports(routePacket, loads, LM_MAX_LOAD_REPORTS, numOfLoads)) {
+                    ESP_LOGE(LM_TAG, "Invalid load reports from %X", routePacket->src);
+                    PacketQueueService::deleteQueuePacketAndPacket(rx);
+                    continue;
+                }
+
+                // The SNR at which the sender receives this node, the link reports are removed before processing the routes
+                int8_t sentSNR = 0;
+                bool hasLinkReport = false;
+                if (PacketService::isHelloLinkReportPacket(type) &&
+                    !PacketService::removeLinkReports(routePacket, getLocalAddress(), sentSNR, hasLinkReport)) {
+                    ESP_LOGE(LM_TAG, "Invalid link reports from %X", routePacket->src);
+                    PacketQueueService::deleteQueuePacketAndPacket(rx);
+                    continue;
+                }
+
+                // Advertise the changes without waiting for the next HELLO packet
+                if (RoutingTableService::processRoute(routePacket, rx->snr))
+                    xTaskNotify(Hello_TaskHandle, HELLO_NOTIFY_CHANGED, eSetBits);
+
+                // A neighbour that starts asks for the routing table
+                if (PacketService::isHelloSolicitPacket(type))
+                    xTaskNotify(Hello_TaskHandle, HELLO_NOTIFY_SOLICITED, eSetBits);
+
+                if (hasLinkReport)
+                    RoutingTableService::resetSentSNRRoutePacket(routePacket->src, sentSNR);
+
+                if (numOfLoads > 0)
+                    RoutingTableService::updateLoads(routePacket->src, loads, numOfLoads);
+
+                RoutingTableService::setCompactHeader(routePacket->src, PacketService::isHelloCompactHeaderPacket(type));
+
+                // The beacon started to be sent one time on air before being received
+                if (PacketService::isHelloBeaconPacket(type)) {
+                    unsigned long beaconStart = millis() - (LatencyService::now() - rx->timestamp) / 1000 -
+                        radio->getTimeOnAir(receivedSize) / 1000;
+                    SlotService::processBeacon(routePacket->src, beaconStart, slotOffset, slotLength, slotOwners, numOfSlots);
+                }
+
+                PacketQueueService::deleteQueuePacketAndPacket(rx);
+            }
+            else if (view.isData())
+                processDataPacket(reinterpret_cast<QueuePacket<DataPacket>*>(rx));
+            else
+                processCustomPacket(rx);
+
+            LatencyService::record(LatencyStage::RX_PROCESS, processStart);
+        }
+    }
+}
+
+bool LoraMesher::setPacketHandler(uint8_t type, PacketHandler handler) {
+    if (PacketTypeTable::get(type).packetClass != PacketClass::UNKNOWN)
+        return false;
+
+    for (uint8_t i = 0; i < numPacketHandlers; i++) {
+        if (packetHandlers[i].type != type)
+            continue;
+
+        if (handler != nullptr)
+            packetHandlers[i].handler = handler;
+        else
+            packetHandlers[i] = packetHandlers[--numPacketHandlers];
+
+        return true;
+    }
+
+    if (handler == nullptr)
+        return true;
+
+    if (numPacketHandlers >= LM_MAX_PACKET_HANDLERS)
+        return false;
+
+    packetHandlers[numPacketHandlers++] = {type, handler};
+    return true;
+}
+
+void LoraMesher::processCustomPacket(QueuePacket<Packet<uint8_t>>* rx) {
+    Packet<uint8_t>* p = rx->packet;
+
+    PacketHandler handler = nullptr;
+    for (uint8_t i = 0; i < numPacketHandlers; i++) {
+        if (packetHandlers[i].type == p->type)
+            handler = packetHandlers[i].handler;
+    }
+
+    if (handler == nullptr || (p->dst != getLocalAddress() && p->dst != BROADCAST_ADDR)) {
+        ESP_LOGV(LM_TAG, "Packet not identified, deleting it");
+        incReceivedNotForMe();
+    }
+    else
+        handler(p, rx->rssi, rx->snr);
+
+    PacketQueueService::deleteQueuePacketAndPacket(rx);
+}
+
+void LoraMesher::routingTableManager() {
+    ESP_LOGV(LM_TAG, "Routing Table Manager routine started");
+    vTaskSuspend(NULL);
+
+    for (;;) {
+        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+        ESP_LOGI(LM_TAG, "Checking routes timeout");
+
+        // Remove the routes expired and their sequences in the Q_WSP and Q_WRP
+        uint16_t address;
+        bool removed = false;
+
+        while (RoutingTableService::popExpiredNode(address)) {
+            removeNodeFromQSPandQWP(address);
+            RoutingTableService::removeNodeIfExpired(address);
+            removed = true;
+        }
+
+        if (removed)
+            LM_TRACE_I(TraceEvent::ROUTING_TABLE_CHANGED, routingTableSize());
+
+        // Write the routing table if the persist interval has passed
+        PersistenceService::saveRoutingTable();
+
+        // Record the state for the simulation
+        recordState(LM_StateType::STATE_TYPE_MANAGER);
+
+        // if (q_WRP->getLength() != 0 || q_WSP->getLength() != 0) {
+        //     vTaskDelay(randomDelay * 1000 / portTICK_PERIOD_MS);
+        //     continue;
+        // }
+
+        // Wait until the next route timeout. A timeout is always reset to DEFAULT_TIMEOUT, it cannot expire before this wait
+        unsigned long wait = RoutingTableService::getTimeUntilNextTimeout(DEFAULT_TIMEOUT * 1000);
+        vTaskDelay(wait / portTICK_PERIOD_MS + 1);
+    }
+}
+
+void LoraMesher::traceRoutine() {
+    ESP_LOGV(LM_TAG, "Trace routine started");
+
+    for (;;) {
+        TraceService::drain();
+        vTaskDelay(LM_TRACE_DRAIN_PERIOD / portTICK_PERIOD_MS + 1);
+    }
+}
+
+void LoraMesher::queueManager() {
+    ESP_LOGV(LM_TAG, "Queue Manager routine started");
+    vTaskSuspend(NULL);
+
+    for (;;) {
+        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+        // Record the state for the simulation
+        recordState(LM_StateType::STATE_TYPE_MANAGER);
+
+        if (q_WSP->getLength() == 0 && q_WRP->getLength() == 0 && q_WMP->getLength() == 0 && numPendingFloods == 0) {
+            ESP_LOGV(LM_TAG, "No packets to send or received");
+
+            // Wait for the notification of send or receive reliable message and enter blocking
+            ulTaskNotifyTake(
+                pdTRUE,
+                portMAX_DELAY);
+            continue;
+        }
+
+        managerTimeouts();
+        manageFloods();
+
+        // Wait until the earliest timeout or until a timeout is set before it
+        unsigned long wait = getTimeUntilNextFlood(sequenceTimeouts->getTimeUntilFirst(millis(), MIN_TIMEOUT * 1000));
+        ulTaskNotifyTake(pdTRUE, wait / portTICK_PERIOD_MS + 1);
+    }
+}
+
+void LoraMesher::traceHeaderPacket(Packet<uint8_t>* p, const PacketView& view, TraceEvent event) {
+    LM_TRACE_I(event,
+        p->packetSize | p->id << 8 | p->type << 16,
+        p->src | (uint32_t) p->dst << 16,
+        (view.isData() ? (reinterpret_cast<DataPacket*>(p))->via : 0) |
+        (uint32_t) (view.isControl() ? (reinterpret_cast<ControlPacket*>(p))->seq_id : 0) << 16,
+        view.isControl() ? (reinterpret_cast<ControlPacket*>(p))->number : 0);
+}
+
+DataPacket* LoraMesher::createSendDataPacket(uint16_t dst, const uint8_t* payload, uint32_t payloadSize) {
+    uint32_t compressedSize;
+    uint8_t* compressed = compressSendPayload(payload, payloadSize, compressedSize);
+
+    uint8_t type = DATA_P;
+    if (compressed != nullptr) {
+        type |= COMPRESSED_P;
+        payload = compressed;
+        payloadSize = compressedSize;
+    }
+
+    //The payload is encrypted in place, inside the space reserved after it
+    uint8_t overhead = CryptoService::getOverhead(type);
+    DataPacket* dPacket = PacketService::createDataPacket(dst, getLocalAddress(), type, nullptr, payloadSize + overhead);
+
+    if (dPacket != nullptr) {
+        memcpy(dPacket->payload, payload, PacketService::getPacketPayloadLength(dPacket) - overhead);
+
+        if (!CryptoService::encryptPacket(reinterpret_cast<Packet<uint8_t>*>(dPacket))) {
+            deletePacket(reinterpret_cast<Packet<uint8_t>*>(dPacket));
+            dPacket = nullptr;
+        }
+    }
+
+    if (compressed != nullptr)
+        vPortFree(compressed);
+
+    return dPacket;
+}
+
+uint8_t* LoraMesher::compressSendPayload(const uint8_t* payload, uint32_t payloadSize, uint32_t& compressedSize) {
+    if (!loraMesherConfig->compression)
+        return nullptr;
+
+    uint8_t* compressed = PacketService::compressPayload(payload, payloadSize, compressedSize);
+
+    incCompressionBytes(payloadSize, compressed == nullptr ? payloadSize : compressedSize);
+
+    ESP_LOGV(LM_TAG, "Payload of %d bytes compressed to %d bytes", (int)payloadSize, compressed == nullptr ? (int)payloadSize : (int)compressedSize);
+
+    return compressed;
+}
+
+LM_SendStatus LoraMesher::sendCustomPacket(uint16_t dst, uint8_t type, const uint8_t* payload, uint8_t payloadSize, const LM_QoS& qos) {
+    //The types of LoraMesher would be processed as its own packets by the neighbours
+    if (PacketTypeTable::get(type).packetClass != PacketClass::UNKNOWN ||
+        sizeof(Packet<uint8_t>) + payloadSize > PacketFactory::getMaxPacketSize())
+        return LM_SendStatus::INVALID;
+
+    Packet<uint8_t>* p = PacketFactory::createPacket<Packet<uint8_t>>(payload, payloadSize);
+    if (p == nullptr)
+        return LM_SendStatus::NO_MEMORY;
+
+    p->dst = dst;
+    p->src = getLocalAddress();
+    p->type = type;
+    p->packetSize = sizeof(Packet<uint8_t>) + payloadSize;
+
+    return setPackedForSend(p, qos.getPriority(), qos.maxAge, qos.demote);
+}
+
+LM_SendStatus LoraMesher::sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize, const LM_QoS& qos) {
+    // Cannot send an empty packet
+    if (payloadSize == 0)
+        return LM_SendStatus::INVALID;
+
+    //Reject it before compressing it, the producer should wait for a sequence to end
+    bool group = PacketService::isGroupAddress(dst);
+    LM_SendStatus status = group ?
+        checkSendSequenceLimits(q_WMP, LM_MULTICAST_MAX_SEQUENCES, payloadSize) :
+        checkSendSequenceLimits(q_WSP, loraMesherConfig->maxSendSequences, payloadSize);
+    if (status != LM_SendStatus::OK)
+        return status;
+
+    //Compress the whole payload before splitting it, every packet has the same maximum payload
+    uint32_t compressedSize;
+    uint8_t* compressed = compressSendPayload(payload, payloadSize, compressedSize);
+
+    const uint8_t* payloadToSend = compressed == nullptr ? payload : compressed;
+    uint32_t payloadSizeToSend = compressed == nullptr ? payloadSize : compressedSize;
+
+    //The payload is sent once to all the members of the group
+    if (group)
+        status = sendMulticastSequence(dst, payloadToSend, payloadSizeToSend, compressed != nullptr);
+    else
+        status = sendReliableSequence(dst, payloadToSend, payloadSizeToSend, compressed != nullptr, qos);
+
+    if (compressed != nullptr)
+        vPortFree(compressed);
+
+    return status;
+}
+
+LM_SendStatus LoraMesher::checkSendSequenceLimits(LM_LinkedList<listConfiguration>* queue, uint16_t maxSequences, uint32_t payloadSize) {
+    if (maxSequences > 0 && queue->getLength() >= maxSequences) {
+        ESP_LOGW(LM_TAG, "Sequence not started, there are %d sequences", (int)queue->getLength());
+        incSequencesRejected();
+        return LM_SendStatus::QUEUE_FULL;
+    }
+
+    if (isOverHeapBudget(payloadSize)) {
+        ESP_LOGW(LM_TAG, "Sequence not started, %d bytes would be over the heap budget", (int)payloadSize);
+        incSequencesRejected();
+        return LM_SendStatus::NO_MEMORY;
+    }
+
+    return LM_SendStatus::OK;
+}
+
+LM_SendStatus LoraMesher::sendReliableSequence(uint16_t dst, const uint8_t* payload, uint32_t payloadSize, bool compressed, const LM_QoS& qos) {
+    ESP_LOGV(LM_TAG, "Sending reliable payload with %d bytes to %X", (int)payloadSize, dst);
+
+    // Get the Routing Table node of the destination
+    RouteNode* node = RoutingTableService::findNode(dst);
+
+    if (node == NULL) {
+        ESP_LOGV(LM_TAG, "Destination not found in the routing table");
+        return LM_SendStatus::NO_ROUTE;
+    }
+
+    //Generate a sequence Id for this list of packets
+    LM_SeqId seq_id = getSequenceId();
+
+    //Get the Type of the packet
+    uint8_t type = NEED_ACK_P | XL_DATA_P;
+
+    //Max payload size per packet
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(type);
+
+    //Number of packets
+    uint32_t numOfPackets = payloadSize / maxPayloadSize + (payloadSize % maxPayloadSize > 0);
+    if (numOfPackets > UINT16_MAX) {
+        ESP_LOGE(LM_TAG, "Payload too large to be sent reliable, %d bytes", (int)payloadSize);
+        return LM_SendStatus::INVALID;
+    }
+
+    uint8_t lastPacketSize = payloadSize - maxPayloadSize * (numOfPackets - 1);
+    uint8_t fecBlock = getFecBlock(node);
+
+    //Create a new Linked list to store the QueuePackets and the payload
+    LM_LinkedList<QueuePacket<ControlPacket>>* packetList = new LM_LinkedList<QueuePacket<ControlPacket>>();
+
+    //Add the SYNC configuration packet
+    packetList->Append(getStartSequencePacketQueue(dst, seq_id, numOfPackets, compressed, fecBlock, lastPacketSize));
+
+
+    //The counter is wider than the number of packets, it cannot wrap around at the last one
+    for (uint32_t i = 1; i <= numOfPackets; i++) {
+        //Get the position of the payload
+        const uint8_t* payloadToSend = payload + (i - 1) * maxPayloadSize;
+
+        //Get the payload Size in bytes
+        size_t payloadSizeToSend = maxPayloadSize;
+        if (i == numOfPackets)
+            payloadSizeToSend = payloadSize - (maxPayloadSize * (numOfPackets - 1));
+
+        ESP_LOGV(LM_TAG, "Payload Size: %d", payloadSizeToSend);
+
+        //Create a new packet with the previous payload and the space to encrypt it
+        ControlPacket* cPacket = PacketService::createControlPacket(dst, getLocalAddress(), type, nullptr, payloadSizeToSend + CryptoService::getOverhead(type));
+        if (cPacket != nullptr) {
+            memcpy(cPacket->payload, payloadToSend, payloadSizeToSend);
+            cPacket->number = i;
+            cPacket->seq_id = seq_id;
+        }
+
+        if (cPacket == nullptr || !CryptoService::encryptPacket(reinterpret_cast<Packet<uint8_t>*>(cPacket))) {
+            ESP_LOGE(LM_TAG, "Sequence not sent, packet %d could not be created or encrypted", (int)i);
+            if (cPacket != nullptr)
+                deletePacket(reinterpret_cast<Packet<uint8_t>*>(cPacket));
+
+            packetList->setInUse();
+            while (packetList->moveToStart())
+                PacketQueueService::deleteQueuePacketAndPacket(packetList->Pop());
+            packetList->releaseInUse();
+
+            delete packetList;
+            return LM_SendStatus::NO_MEMORY;
+        }
+
+        //Create a packet queue
+        QueuePacket<ControlPacket>* pq = PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY + 1, i);
+
+        //Append the packet queue in the linked list
+        packetList->Append(pq);
+    }
+
+    //Create the pair of configuration
+    listConfiguration* listConfig = new listConfiguration();
+    listConfig->config = new sequencePacketConfig(seq_id, dst, numOfPackets, node);
+    listConfig->list = packetList;
+    listConfig->fecBlock = fecBlock;
+    listConfig->lastPacketSize = lastPacketSize;
+
+    //The parity packets are created with the payload, the packets are encrypted
+    for (uint16_t i = 1; fecBlock > 0 && i <= numOfPackets; i++)
+        addParityPacket(listConfig, i, payload + (i - 1) * maxPayloadSize, i == numOfPackets ? lastPacketSize : maxPayloadSize);
+
+    startSendSequence(listConfig, qos);
+
+    return LM_SendStatus::OK;
+}
+
+LM_SendStatus LoraMesher::sendReliablePacket(uint16_t dst, SequenceSource* source, uint32_t payloadSize, const LM_QoS& qos) {
+    // Cannot send an empty packet
+    if (payloadSize == 0 || source == nullptr)
+        return LM_SendStatus::INVALID;
+
+    if (PacketService::isGroupAddress(dst)) {
+        ESP_LOGE(LM_TAG, "A source cannot be sent to a group address");
+        return LM_SendStatus::INVALID;
+    }
+
+    //The source is read when the packets are sent, only the window of packets takes memory
+    LM_SendStatus status = checkSendSequenceLimits(q_WSP, loraMesherConfig->maxSendSequences, 0);
+    if (status != LM_SendStatus::OK)
+        return status;
+
+    ESP_LOGV(LM_TAG, "Sending reliable source with %d bytes to %X", (int)payloadSize, dst);
+
+    // Get the Routing Table node of the destination
+    RouteNode* node = RoutingTableService::findNode(dst);
+
+    if (node == NULL) {
+        ESP_LOGV(LM_TAG, "Destination not found in the routing table");
+        return LM_SendStatus::NO_ROUTE;
+    }
+
+    //Max payload size per packet
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+
+    //Number of packets
+    uint32_t numOfPackets = payloadSize / maxPayloadSize + (payloadSize % maxPayloadSize > 0);
+    if (numOfPackets > UINT16_MAX) {
+        ESP_LOGE(LM_TAG, "Payload too large to be sent reliable, %d bytes", (int)payloadSize);
+        return LM_SendStatus::INVALID;
+    }
+
+    //Generate a sequence Id for this list of packets
+    LM_SeqId seq_id = getSequenceId();
+
+    uint8_t lastPacketSize = payloadSize - maxPayloadSize * (numOfPackets - 1);
+    uint8_t fecBlock = getFecBlock(node);
+
+    //Only the SYNC packet is created, the other packets are created when they can be sent
+    LM_LinkedList<QueuePacket<ControlPacket>>* packetList = new LM_LinkedList<QueuePacket<ControlPacket>>();
+    packetList->Append(getStartSequencePacketQueue(dst, seq_id, numOfPackets, false, fecBlock, lastPacketSize));
+
+    //Create the pair of configuration
+    listConfiguration* listConfig = new listConfiguration();
+    listConfig->config = new sequencePacketConfig(seq_id, dst, numOfPackets, node);
+    listConfig->list = packetList;
+    listConfig->source = source;
+    listConfig->sourcePayloadSize = payloadSize;
+    listConfig->fecBlock = fecBlock;
+    listConfig->lastPacketSize = lastPacketSize;
+
+    startSendSequence(listConfig, qos);
+
+    return LM_SendStatus::OK;
+}
+
+void LoraMesher::startSendSequence(listConfiguration* listConfig, const LM_QoS& qos) {
+    listConfig->config->queueType = QueueType::WSP;
+    listConfig->config->window = loraMesherConfig->reliableWindowSize > 0 ? loraMesherConfig->reliableWindowSize : 1;
+
+    listConfig->priority = qos.getPriority();
+    if (qos.maxAge > 0)
+        // 0 is reserved to the sequences without deadline
+        listConfig->config->deadline = (millis() + qos.maxAge) | 1;
+
+    // Set the RTT of the first packet of the sequence
+    listConfig->config->calculatingRTT = millis();
+
+    // Set the timeout of the first packet of the sequence
+    addTimeout(listConfig->config);
+
+    //Move the sequence to a data channel if the destination is a neighbour. The SYNC packet is sent in the control channel
+    uint16_t dst = listConfig->config->source;
+    if (ChannelService::isEnabled() && RoutingTableService::getNextHop(dst) == dst)
+        setSequenceChannel(listConfig, ChannelService::startSession(dst, listConfig->config->seq_id));
+
+    //Add dataList pair to the waiting send packets queue
+    q_WSP->setInUse();
+    q_WSP->Append(listConfig);
+    indexSequence(listConfig);
+    q_WSP->releaseInUse();
+
+    //Send the first packet of the sequence (SYNC packet)
+    sendPacketSequence(listConfig, 0);
+
+    // Notify the queueManager that a new sequence has been started
+    notifyNewSequenceStarted();
+}
+
+void LoraMesher::processDataPacket(QueuePacket<DataPacket>* pq) {
+    DataPacket* packet = pq->packet;
+
+    incReceivedDataPackets();
+
+    LM_TRACE_I(TraceEvent::DATA_PACKET, packet->src, packet->dst, packet->via);
+
+    RoutingTableService::aMessageHasBeenReceivedBy(packet->src);
+
+    if (packet->dst == getLocalAddress()) {
+        ESP_LOGV(LM_TAG, "Data packet from %X for me", packet->src);
+        incDataPacketForMe();
+
+        processDataPacketForMe(pq);
+        return;
+
+    }
+    else if (packet->isGroupDestination()) {
+        //The multicast sequences are stored and forwarded encrypted
+        if (PacketService::isMulticastPacket(packet->type)) {
+            ESP_LOGV(LM_TAG, "Multicast packet from %X for group %X", packet->src, packet->dst);
+            processMulticastPacket(reinterpret_cast<QueuePacket<ControlPacket>*>(pq));
+            return;
+        }
+
+        //The members of the group could be anywhere, the data packets are flooded to the whole network
+        if (loraMesherConfig->flooding && PacketService::isOnlyDataPacket(packet->type) && !processFloodPacket(pq))
+            return;
+
+        if (isGroupMember(packet->dst)) {
+            ESP_LOGV(LM_TAG, "Data packet from %X for group %X", packet->src, packet->dst);
+            incReceivedBroadcast();
+            processDataPacketForMe(pq);
+            return;
+        }
+    }
+    else if (packet->via == getLocalAddress()) {
+        ESP_LOGV(LM_TAG, "Data Packet from %X for %X. Via is me. Forwarding it", packet->src, packet->dst);
+        incReceivedIAmVia();
+        addToSendOrderedAndNotify(reinterpret_cast<QueuePacket<Packet<uint8_t>>*>(pq));
+        return;
+    }
+
+    ESP_LOGV(LM_TAG, "Packet not for me, deleting it");
+    incReceivedNotForMe();
+    PacketQueueService::deleteQueuePacketAndPacket(pq);
+}
+
+void LoraMesher::processAggregatedPacket(QueuePacket<DataPacket>* pq) {
+    size_t offset = 0;
+    DataPacket* record;
+
+    // Every record is processed as a data packet received with this node as via
+    while ((record = PacketService::getAggregatedRecord(pq->packet, offset)) != nullptr) {
+        processDataPacket(PacketQueueService::createQueuePacket(record, pq->priority, 0, pq->rssi, pq->snr));
+    }
+
+    if (offset != PacketService::getPacketPayloadLength(pq->packet))
+        ESP_LOGW(LM_TAG, "Malformed aggregated packet from %X", pq->packet->src);
+
+    PacketQueueService::deleteQueuePacketAndPacket(pq);
+}
+
+bool LoraMesher::processFloodPacket(QueuePacket<DataPacket>* pq) {
+    DataPacket* p = pq->packet;
+
+    //The packets sent by this node come back from the neighbours
+    if (p->src == getLocalAddress()) {
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return false;
+    }
+
+    uint32_t key = PacketService::getFloodKey(p);
+
+    if (!floodDuplicateCache->add(key, LM_FLOOD_CACHE_TIMEOUT * 1000)) {
+        //Another node has forwarded it, it is counted if this node has not forwarded it yet
+        portENTER_CRITICAL(&floodsMux);
+        for (floodPacket& flood : pendingFloods) {
+            if (flood.used && flood.key == key && flood.copies < UINT8_MAX)
+                flood.copies++;
+        }
+        portEXIT_CRITICAL(&floodsMux);
+
+        ESP_LOGV(LM_TAG, "Flooded packet from %X heard again, via %X", p->src, p->via);
+        incReceivedDuplicates();
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return false;
+    }
+
+    //The copy is forwarded as received, it is decrypted by every destination
+    Packet<uint8_t>* copy = PacketService::copyPacket(p, p->packetSize);
+    if (copy == nullptr)
+        return true;
+
+    //The first half of the interval listens to the nodes that have received it before
+    uint16_t interval = loraMesherConfig->floodInterval;
+    unsigned long deadline = millis() + random(interval / 2, interval);
+
+    bool added = false;
+
+    portENTER_CRITICAL(&floodsMux);
+    for (floodPacket& flood : pendingFloods) {
+        //The entries of the packets that left the send queue without being transmitted expire
+        if (!flood.used || (flood.packet == nullptr && (long) (millis() - flood.deadline) >= 0)) {
+            flood.used = true;
+            flood.packet = copy;
+            flood.key = key;
+            flood.deadline = deadline;
+            flood.copies = 0;
+            numPendingFloods++;
+            added = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&floodsMux);
+
+    if (!added) {
+        ESP_LOGW(LM_TAG, "Flooded packet from %X not forwarded, too many flooded packets waiting", p->src);
+        deletePacket(copy);
+        return true;
+    }
+
+    // The queue manager could be sleeping until a later timeout
+    if (QueueManager_TaskHandle)
+        xTaskNotifyGive(QueueManager_TaskHandle);
+
+    return true;
+}
+
+void LoraMesher::manageFloods() {
+    for (floodPacket& flood : pendingFloods) {
+        Packet<uint8_t>* packet = nullptr;
+        uint8_t copies = 0;
+
+        portENTER_CRITICAL(&floodsMux);
+        if (flood.used && flood.packet != nullptr && (long) (millis() - flood.deadline) >= 0) {
+            packet = flood.packet;
+            copies = flood.copies;
+            flood.packet = nullptr;
+            numPendingFloods--;
+
+            //The copies are counted until it is transmitted
+            flood.used = copies < loraMesherConfig->floodRedundancy;
+            flood.deadline = millis() + LM_DUPLICATE_CACHE_TIMEOUT * 1000;
+        }
+        portEXIT_CRITICAL(&floodsMux);
+
+        if (packet == nullptr)
+            continue;
+
+        //Enough neighbours have forwarded it, the nodes around have received it
+        if (copies >= loraMesherConfig->floodRedundancy) {
+            ESP_LOGV(LM_TAG, "Flooded packet from %X suppressed, heard %d times", packet->src, copies);
+            incSuppressedFloods();
+            deletePacket(packet);
+            continue;
+        }
+
+        //The via identifies the forwarder, the neighbours count the copies of the different nodes
+        reinterpret_cast<DataPacket*>(packet)->via = getLocalAddress();
+
+        ESP_LOGV(LM_TAG, "Forwarding flooded packet from %X, heard %d times", packet->src, copies);
+        setPackedForSend(packet, DEFAULT_PRIORITY);
+    }
+}
+
+unsigned long LoraMesher::getTimeUntilNextFlood(unsigned long maxWait) {
+    unsigned long now = millis();
+    unsigned long wait = maxWait;
+
+    portENTER_CRITICAL(&floodsMux);
+    for (const floodPacket& flood : pendingFloods) {
+        if (!flood.used || flood.packet == nullptr)
+            continue;
+
+        long remaining = (long) (flood.deadline - now);
+        if (remaining <= 0)
+            wait = 0;
+        else if ((unsigned long) remaining < wait)
+            wait = remaining;
+    }
+    portEXIT_CRITICAL(&floodsMux);
+
+    return wait;
+}
+
+bool LoraMesher::isFloodSuppressed(Packet<uint8_t>* p) {
+    if (!loraMesherConfig->flooding || !p->isGroupDestination() || !PacketService::isOnlyDataPacket(p->type) ||
+        p->src == getLocalAddress())
+        return false;
+
+    uint32_t key = PacketService::getFloodKey(reinterpret_cast<DataPacket*>(p));
+    bool suppressed = false;
+
+    portENTER_CRITICAL(&floodsMux);
+    for (floodPacket& flood : pendingFloods) {
+        if (flood.used && flood.packet == nullptr && flood.key == key) {
+            suppressed = flood.copies >= loraMesherConfig->floodRedundancy;
+            flood.used = false;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&floodsMux);
+
+    return suppressed;
+}
+
+void LoraMesher::processDataPacketForMe(QueuePacket<DataPacket>* pq) {
+    DataPacket* p = pq->packet;
+    ControlPacket* cPacket = reinterpret_cast<ControlPacket*>(p);
+
+    //By default, delete the packet queue at the finish of this function
+    bool deleteQueuePacket = true;
 
-        RoutingTableService::printRoutingTable();
+    //Only the destination decrypts the payload, the relays forward it encrypted
+    if (!CryptoService::decryptPacket(reinterpret_cast<Packet<uint8_t>*>(p))) {
+        incDecryptionFailed();
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
 
-        // Record the state for the simulation
-        recordState(LM_StateType::STATE_TYPE_MANAGER);
+    const PacketTypeInfo& info = PacketTypeTable::get(p->type);
+    bool needAck = info.needAck;
 
-        // if (q_WRP->getLength() != 0 || q_WSP->getLength() != 0) {
-        //     vTaskDelay(randomDelay * 1000 / portTICK_PERIOD_MS);
-        //     continue;
-        // }
+    switch (info.kind) {
+    case PacketKind::AGGREGATED:
+        ESP_LOGV(LM_TAG, "Aggregated Packet received");
+        processAggregatedPacket(pq);
+        return;
+
+    case PacketKind::DATA: {
+        ESP_LOGV(LM_TAG, "Data Packet received");
+        //The handler reads the payload inside the received packet, the compressed ones are decompressed into a user packet
+        AppPayloadHandler handler = appPayloadHandler;
+        if (handler != nullptr && !PacketService::isCompressedPacket(p->type)) {
+            handler(p->src, p->dst, p->payload, PacketService::getPacketPayloadLength(p));
+            break;
+        }
+
+        //Convert the packet into a user packet
+        AppPacket<uint8_t>* appPacket = PacketService::convertPacket(p);
+
+        // Handle validation failure
+        if (appPacket == nullptr) {
+            ESP_LOGE(LM_TAG, "Failed to convert packet, discarding corrupted packet");
+            PacketQueueService::deleteQueuePacketAndPacket(pq);
+            return;
+        }
+
+        //Add and notify the user of this packet
+        notifyUserReceivedPacket(appPacket);
+        break;
+    }
+
+    case PacketKind::MULTICAST_NACK:
+        ESP_LOGV(LM_TAG, "Multicast NACK Packet received");
+        processMulticastNack(cPacket);
+        break;
+
+    case PacketKind::SACK:
+        ESP_LOGV(LM_TAG, "Selective ACK Packet received");
+        processSackPacket(cPacket);
+        break;
+
+    case PacketKind::ACK:
+        ESP_LOGV(LM_TAG, "ACK Packet received");
+        processAckPacket(cPacket);
+        break;
+
+    case PacketKind::LOST:
+        ESP_LOGV(LM_TAG, "Lost Packet received");
+        processLostPacket(p->src, cPacket->seq_id, cPacket->number);
+        break;
+
+    case PacketKind::SYNC: {
+        ESP_LOGV(LM_TAG, "Synchronization Packet received");
+        size_t optionsSize = PacketService::getPacketPayloadLength(cPacket);
+        uint8_t channel = optionsSize > 0 ? cPacket->payload[0] : 0;
+        uint8_t fecBlock = optionsSize > 2 ? cPacket->payload[1] : 0;
+        uint8_t lastPacketSize = optionsSize > 2 ? cPacket->payload[2] : 0;
+        processSyncPacket(p->src, cPacket->seq_id, cPacket->number, PacketService::isCompressedPacket(p->type), channel,
+            fecBlock, lastPacketSize);
+
+        needAck = false;
+        break;
+    }
+
+    case PacketKind::XL_DATA:
+        ESP_LOGV(LM_TAG, "Large payload Packet received");
+        processLargePayloadPacket(reinterpret_cast<QueuePacket<ControlPacket>*>(pq));
+        needAck = false;
+        deleteQueuePacket = false;
+        break;
+
+    case PacketKind::XL_PARITY:
+        ESP_LOGV(LM_TAG, "Parity Packet received");
+        processParityPacket(reinterpret_cast<QueuePacket<ControlPacket>*>(pq));
+        deleteQueuePacket = false;
+        break;
+
+    default:
+        break;
+    }
+
+    //Need ack
+    if (needAck) {
+        //TODO: All packets with this ack will ack?
+        ESP_LOGV(LM_TAG, "Previous packet need an ACK");
+        sendAckPacket(p->src, cPacket->seq_id, cPacket->number);
+    }
+
+    if (deleteQueuePacket)
+        //Delete packet queue
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+}
+
+void LoraMesher::notifyUserReceivedPacket(AppPacket<uint8_t>* appPacket) {
+    AppPayloadHandler handler = appPayloadHandler;
+    if (handler != nullptr) {
+        handler(appPacket->src, appPacket->dst, appPacket->payload, appPacket->payloadSize);
+        deletePacket(appPacket);
+    }
+    else if (ReceiveAppData_TaskHandle) {
+        AppPacket<uint8_t>* dropped = nullptr;
+
+        ReceivedAppPackets->setInUse();
+
+        uint16_t capacity = loraMesherConfig->appQueueSize;
+        bool full = capacity > 0 && ReceivedAppPackets->getLength() >= capacity;
+
+        //The payloads have no priority, the oldest one is dropped unless the policy drops the new one
+        if ((full || isOverHeapBudget()) && ReceivedAppPackets->getLength() > 0)
+            dropped = loraMesherConfig->dropPolicy == LM_DropPolicy::TAIL_DROP ? appPacket : ReceivedAppPackets->Pop();
+
+        //Add the packet inside the receivedUsers Queue
+        if (dropped != appPacket) {
+            appPacket->timestamp = LatencyService::now();
+            ReceivedAppPackets->Append(appPacket);
+        }
+
+        ReceivedAppPackets->releaseInUse();
+
+        if (dropped != nullptr) {
+            ESP_LOGW(LM_TAG, "Received queue %s, payload from %X dropped", full ? "full" : "over the heap budget", dropped->src);
+            incAppQueueDrops();
+            deletePacket(dropped);
+        }
+
+        //Notify the received user task handle
+        xTaskNotify(
+            ReceiveAppData_TaskHandle,
+            0,
+            eSetValueWithOverwrite);
+
+    }
+    else
+        deletePacket(appPacket);
+}
+
+uint32_t LoraMesher::getPropagationTimeWithRandom(uint8_t multiplayer) {
+    // TODO: Use the RTT or other congestion metrics to calculate the time, timeouts...
+    uint32_t time = getMaxPropagationTime();
+    uint32_t randomTime = random(time, time * 3 + (multiplayer + routingTableSize()) * 100);
+    return randomTime;
+}
+
+void LoraMesher::recalculateMaxTimeOnAir() {
+    maxTimeOnAir = radio->getTimeOnAir(PacketFactory::getMaxPacketSize()) / 1000;
+    ESP_LOGV(LM_TAG, "Max Time on Air changed %d ms", (int)maxTimeOnAir);
+}
+
+void LoraMesher::recordState(LM_StateType type, QueuePacket<Packet<uint8_t>>* pq) {
+    if (simulatorService == nullptr)
+        return;
+
+    simulatorService->addState(ReceivedPackets->getLength(), getSendQueueSize(),
+        getReceivedQueueSize(), routingTableSize(), q_WRP->getLength(), q_WSP->getLength(),
+        type, pq != nullptr ? pq->packet : nullptr, pq != nullptr ? &pq->view : nullptr);
+}
+
+#ifdef LM_TESTING
+bool LoraMesher::canReceivePacket(uint16_t source) {
+	return true;
+}
+#endif
+
+#ifdef LM_TESTING
+bool LoraMesher::isDataPacketAndLocal(DataPacket* packet, uint16_t localAddress) {
+    return PacketService::isDataPacket(packet->type) && packet->via == localAddress;
+}
+
+bool LoraMesher::shouldProcessPacket(Packet<uint8_t>* packet) {
+    return isDataPacketAndLocal(reinterpret_cast<DataPacket*>(packet), getLocalAddress()) || canReceivePacket(packet->src);
+}
+#endif
+
+/**
+ *  End Region Packet Service
+**/
+
+
+/**
+ *  Region Routing Table
+**/
+
+size_t LoraMesher::routingTableSize() {
+    return RoutingTableService::routingTableSize();
+}
+
+/**
+ *  End Region Routing Table
+**/
+
+
+/**
+ *  Region PacketQueue
+**/
+
+size_t LoraMesher::getReceivedQueueSize() {
+    return ReceivedAppPackets->getLength();
+}
+
+size_t LoraMesher::getSendQueueSize() {
+    return ToSendPackets->getLength();
+}
+
+LM_SendStatus LoraMesher::addToSendOrderedAndNotify(QueuePacket<Packet<uint8_t>>* qp) {
+    qp->timestamp = LatencyService::now();
+
+    QueuePacket<Packet<uint8_t>>* dropped = nullptr;
+    LM_SendStatus status = LM_SendStatus::OK;
+
+    ToSendPackets->setInUse();
+
+    uint16_t capacity = loraMesherConfig->sendQueueSize;
+    bool full = capacity > 0 && ToSendPackets->getLength() >= capacity;
+    bool overBudget = isOverHeapBudget();
+
+    if (full || overBudget) {
+        status = full ? LM_SendStatus::QUEUE_FULL : LM_SendStatus::NO_MEMORY;
+
+        switch (loraMesherConfig->dropPolicy) {
+            case LM_DropPolicy::OLDEST: {
+                QueuePacket<Packet<uint8_t>>* oldest = nullptr;
+                if (ToSendPackets->moveToStart()) {
+                    do {
+                        QueuePacket<Packet<uint8_t>>* current = ToSendPackets->getCurrent();
+                        if (oldest == nullptr || (int32_t) (current->timestamp - oldest->timestamp) < 0)
+                            oldest = current;
+                    } while (ToSendPackets->next());
+                }
+
+                if (oldest != nullptr)
+                    dropped = ToSendPackets->Extract([oldest](QueuePacket<Packet<uint8_t>>* current) { return current == oldest; });
+                break;
+            }
+            case LM_DropPolicy::LOWEST_PRIORITY: {
+                QueuePacket<Packet<uint8_t>>* lowest = ToSendPackets->Lowest();
+                if (lowest != nullptr && lowest->priority <= qp->priority)
+                    dropped = ToSendPackets->PopLowest();
+                break;
+            }
+            default:
+                break;
+        }
+
+        //The new packet takes the place of the dropped one
+        if (dropped != nullptr)
+            status = LM_SendStatus::OK;
+    }
+
+    if (status == LM_SendStatus::OK)
+        ToSendPackets->Append(qp);
+
+    ToSendPackets->releaseInUse();
+
+    if (status != LM_SendStatus::OK)
+        dropped = qp;
+
+    if (dropped != nullptr) {
+        ESP_LOGW(LM_TAG, "Send queue %s, packet to %X dropped", full ? "full" : "over the heap budget", dropped->packet->dst);
+        incSendQueueDrops();
+
+        sendDuplicateCache->remove(PacketService::getPacketKey(dropped->packet, false));
+        PacketQueueService::deleteQueuePacketAndPacket(dropped);
+    }
+
+    if (status != LM_SendStatus::OK)
+        return status;
+
+    LM_TRACE_I(TraceEvent::SEND_QUEUE_ADDED);
+
+    //Notify the sendData task handle
+    xTaskNotify(SendData_TaskHandle, 0, eSetValueWithOverwrite);
+
+    return LM_SendStatus::OK;
+}
+
+bool LoraMesher::isOverHeapBudget(size_t size) {
+    uint32_t budget = loraMesherConfig->heapBudget;
+    return budget > 0 && PacketPoolService::getHeapInUse() + size > budget;
+}
+
+void LoraMesher::notifyNewSequenceStarted() {
+    //Notify the sendData task handle
+    xTaskNotify(QueueManager_TaskHandle, 0, eSetValueWithOverwrite);
+}
+
+/**
+ *  End Region PacketQueue
+**/
+
+
+/**
+ * Large and Reliable payloads
+ */
+
+QueuePacket<ControlPacket>* LoraMesher::getStartSequencePacketQueue(uint16_t destination, LM_SeqId seq_id, uint16_t num_packets, bool compressed,
+    uint8_t fecBlock, uint8_t lastPacketSize) {
+    uint8_t type = SYNC_P | NEED_ACK_P | XL_DATA_P;
+    if (compressed)
+        type |= COMPRESSED_P;
+
+    //Create the packet
+    ControlPacket* cPacket;
+    if (ChannelService::isEnabled() || fecBlock > 0) {
+        //The data channel is set when the sequence starts
+        uint8_t options[3] = { 0, fecBlock, lastPacketSize };
+        cPacket = PacketService::createControlPacket(destination, getLocalAddress(), type, options, fecBlock > 0 ? sizeof(options) : 1);
+        cPacket->seq_id = seq_id;
+        cPacket->number = num_packets;
+    }
+    else
+        cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, num_packets);
+
+    //Create a packet queue
+    return PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY, 0);
+}
+
+void LoraMesher::sendAckPacket(uint16_t destination, LM_SeqId seq_id, uint16_t seq_num) {
+    if (coalesceAck(destination, seq_id, seq_num)) {
+        ESP_LOGV(LM_TAG, "ACK to %X of seq_Id: %d coalesced", destination, seq_id);
+        incCoalescedAcks();
+        return;
+    }
+
+    uint8_t type = ACK_P;
+
+    //Create the packet
+    ControlPacket* cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, seq_num);
+
+    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), DEFAULT_PRIORITY + 3);
+}
+
+bool LoraMesher::coalesceAck(uint16_t destination, LM_SeqId seq_id, uint16_t seq_num) {
+    bool coalesced = false;
+
+    ToSendPackets->setInUse();
+
+    QueuePacket<Packet<uint8_t>>* queued = nullptr;
+    if (ToSendPackets->moveToStart()) {
+        do {
+            Packet<uint8_t>* p = ToSendPackets->getCurrent()->packet;
+            if (p->type == ACK_P && p->dst == destination && p->src == getLocalAddress()) {
+                queued = ToSendPackets->getCurrent();
+                break;
+            }
+        } while (ToSendPackets->next());
+    }
+
+    if (queued != nullptr) {
+        ControlPacket* ack = reinterpret_cast<ControlPacket*>(queued->packet);
+        AckRecord* records = reinterpret_cast<AckRecord*>(ack->payload);
+        size_t numRecords = PacketService::getPacketPayloadLength(ack) / sizeof(AckRecord);
+
+        //The key changes with the number and the records, the cache entry is replaced
+        sendDuplicateCache->remove(PacketService::getPacketKey(queued->packet, false));
+
+        //The ACKs are cumulative, the number is only raised
+        if (ack->seq_id == seq_id) {
+            ack->number = std::max(ack->number, seq_num);
+            coalesced = true;
+        }
+
+        for (size_t i = 0; i < numRecords && !coalesced; i++) {
+            if (records[i].seq_id == seq_id) {
+                records[i].number = std::max(records[i].number, seq_num);
+                coalesced = true;
+            }
+        }
+
+        //The ACK of a new sequence is added at the end, the packet is created again with one more record
+        if (!coalesced && numRecords < LM_MAX_ACK_RECORDS) {
+            ControlPacket* extended = PacketService::createControlPacket(destination, ack->src, ACK_P, nullptr,
+                (numRecords + 1) * sizeof(AckRecord));
+
+            if (extended != nullptr) {
+                extended->id = ack->id;
+                extended->seq_id = ack->seq_id;
+                extended->number = ack->number;
+                memcpy(extended->payload, records, numRecords * sizeof(AckRecord));
+
+                AckRecord record = {seq_id, seq_num};
+                memcpy(extended->payload + numRecords * sizeof(AckRecord), &record, sizeof(AckRecord));
+
+                deletePacket(queued->packet);
+                queued->packet = reinterpret_cast<Packet<uint8_t>*>(extended);
+                coalesced = true;
+            }
+        }
+
+        sendDuplicateCache->add(PacketService::getPacketKey(queued->packet, false), 0);
+    }
+
+    ToSendPackets->releaseInUse();
+
+    return coalesced;
+}
+
+void LoraMesher::sendLostPacket(uint16_t destination, LM_SeqId seq_id, uint16_t seq_num) {
+    uint8_t type = LOST_P;
+
+    //Create the packet
+    ControlPacket* cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, seq_num);
+
+    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), DEFAULT_PRIORITY + 2);
+}
+
+void LoraMesher::sendSackPacket(listConfiguration* listConfig) {
+    sequencePacketConfig* config = listConfig->config;
+
+    uint8_t bitmap[LM_SACK_BITMAP_SIZE] = { 0 };
+    size_t bitmapSize = 0;
+    const size_t maxBits = LM_SACK_BITMAP_SIZE * 8;
+
+    listConfig->list->setInUse();
+    if (listConfig->list->moveToStart()) {
+        do {
+            uint16_t number = listConfig->list->getCurrent()->number;
+            if (number <= config->lastAck + 1)
+                continue;
+
+            size_t bit = number - config->lastAck - 1;
+            if (bit >= maxBits)
+                break;
 
-        vTaskDelay(DEFAULT_TIMEOUT * 1000 / portTICK_PERIOD_MS);
+            bitmap[bit / 8] |= 1 << (bit % 8);
+            bitmapSize = bit / 8 + 1;
+        } while (listConfig->list->next());
     }
+    listConfig->list->releaseInUse();
+
+    //Create the packet
+    ControlPacket* cPacket = PacketService::createControlPacket(config->source, getLocalAddress(), SACK_P, bitmap, bitmapSize);
+    cPacket->seq_id = config->seq_id;
+    cPacket->number = config->lastAck;
+
+    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), DEFAULT_PRIORITY + 2);
 }
 
-void LoraMesher::queueManager() {
-    ESP_LOGV(LM_TAG, "Queue Manager routine started");
-    vTaskSuspend(NULL);
+uint8_t LoraMesher::getFecBlock(RouteNode* node) {
+    if (!loraMesherConfig->fec || node == nullptr)
+        return 0;
 
-    for (;;) {
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+    //A block of 1 / (2 * loss) packets usually loses one packet at most
+    uint8_t loss = node->lossRate;
+    if (loss == 0)
+        return LM_FEC_MAX_BLOCK;
 
-        // Record the state for the simulation
-        recordState(LM_StateType::STATE_TYPE_MANAGER);
+    return std::max(LM_FEC_MIN_BLOCK, std::min(LM_FEC_MAX_BLOCK, 50 / loss));
+}
 
-        if (q_WSP->getLength() == 0 && q_WRP->getLength() == 0) {
-            ESP_LOGV(LM_TAG, "No packets to send or received");
+void LoraMesher::updateLossRate(listConfiguration* lstConfig) {
+    sequencePacketConfig* config = lstConfig->config;
+    RouteNode* node = config->node;
 
-            // Wait for the notification of send or receive reliable message and enter blocking
-            ulTaskNotifyTake(
-                pdTRUE,
-                portMAX_DELAY);
-            continue;
-        }
+    if (node == nullptr || lstConfig->sentPackets == 0)
+        return;
 
-        managerReceivedQueue();
-        managerSendQueue();
+    uint32_t resent = lstConfig->sentPackets > config->number ? lstConfig->sentPackets - config->number : 0;
+    uint32_t loss = resent * 100 / lstConfig->sentPackets;
 
-        // TODO: Calculate the min timeout for the queue manager, get the min timeout from the queues
-        vTaskDelay(MIN_TIMEOUT * 1000 / portTICK_PERIOD_MS);
-    }
+    node->lossRate = (node->lossRate * 3 + loss) / 4;
 }
 
-void LoraMesher::printHeaderPacket(Packet<uint8_t>* p, String title) {
-    bool isDataPacket = PacketService::isDataPacket(p->type);
-    bool isControlPacket = PacketService::isControlPacket(p->type);
+void LoraMesher::addParityPacket(listConfiguration* lstConfig, uint16_t seq_num, const uint8_t* payload, size_t payloadSize) {
+    sequencePacketConfig* config = lstConfig->config;
+    uint8_t block = lstConfig->fecBlock;
 
-    ESP_LOGI(LM_TAG, "Packet %s -- Size: %d Src: %X Dst: %X Id: %d Type: %d Via: %X Seq_Id: %d Num: %d",
-        title.c_str(),
-        p->packetSize,
-        p->src,
-        p->dst,
-        p->id,
-        p->type,
-        isDataPacket ? (reinterpret_cast<DataPacket*>(p))->via : 0,
-        isControlPacket ? (reinterpret_cast<ControlPacket*>(p))->seq_id : 0,
-        isControlPacket ? (reinterpret_cast<ControlPacket*>(p))->number : 0);
-}
+    if (block == 0 || seq_num != lstConfig->fecNext)
+        return;
 
-void LoraMesher::sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize) {
-    // Cannot send an empty packet
-    if (payloadSize == 0)
+    lstConfig->fecNext++;
+
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+    if (lstConfig->fecParity == nullptr)
+        lstConfig->fecParity = new uint8_t[maxPayloadSize];
+
+    uint16_t blockStart = seq_num - (seq_num - 1) % block;
+    if (seq_num == blockStart)
+        memset(lstConfig->fecParity, 0, maxPayloadSize);
+
+    LM_Parity::add(lstConfig->fecParity, payload, payloadSize);
+
+    if (seq_num - blockStart + 1 < block && seq_num != config->number)
         return;
-    if (dst == BROADCAST_ADDR) {
-        ESP_LOGW(LM_TAG, "Be aware of sending a reliable packet to the broadcast address");
-        size_t numOfNodes = RoutingTableService::routingTableSize();
-        if (numOfNodes > 0) {
-            NetworkNode* nodes = RoutingTableService::getAllNetworkNodes();
-            for (size_t i = 0; i < numOfNodes; i++) {
-                NetworkNode* node = &nodes[i];
-                sendReliablePacket(node->address, payload, payloadSize);
-            }
-            delete[] nodes;
-        }
+
+    //The parity is as long as the first packet of the block, all the packets but the last one are full
+    uint8_t type = XL_PARITY_P;
+    size_t paritySize = blockStart == config->number ? payloadSize : maxPayloadSize;
+
+    ControlPacket* cPacket = PacketService::createControlPacket(config->source, getLocalAddress(), type, nullptr, paritySize + CryptoService::getOverhead(type));
+    if (cPacket == nullptr)
         return;
-    }
-    ESP_LOGV(LM_TAG, "Sending reliable payload with %d bytes to %X", (int)payloadSize, dst);
 
-    // Get the Routing Table node of the destination
-    RouteNode* node = RoutingTableService::findNode(dst);
+    memcpy(cPacket->payload, lstConfig->fecParity, paritySize);
+    cPacket->number = blockStart;
+    cPacket->seq_id = config->seq_id;
 
-    if (node == NULL) {
-        ESP_LOGV(LM_TAG, "Destination not found in the routing table");
+    if (!CryptoService::encryptPacket(reinterpret_cast<Packet<uint8_t>*>(cPacket))) {
+        ESP_LOGE(LM_TAG, "Parity packet could not be encrypted Seq_id: %d, Num: %d", config->seq_id, blockStart);
+        delete cPacket;
         return;
     }
 
-    //Generate a sequence Id for this list of packets
-    uint8_t seq_id = getSequenceId();
+    if (lstConfig->parityList == nullptr)
+        lstConfig->parityList = new LM_LinkedList<QueuePacket<ControlPacket>>();
 
-    //Get the Type of the packet
-    uint8_t type = NEED_ACK_P | XL_DATA_P;
+    lstConfig->parityList->setInUse();
+    lstConfig->parityList->Append(PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY + 1, blockStart));
+    lstConfig->parityList->releaseInUse();
+}
 
-    //Max payload size per packet
-    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(type);
+void LoraMesher::sendParityPacket(listConfiguration* lstConfig, uint16_t seq_num) {
+    sequencePacketConfig* config = lstConfig->config;
 
-    //Number of packets
-    uint16_t numOfPackets = payloadSize / maxPayloadSize + (payloadSize % maxPayloadSize > 0);
+    if (lstConfig->parityList == nullptr || (seq_num % lstConfig->fecBlock != 0 && seq_num != config->number))
+        return;
 
-    //Create a new Linked list to store the QueuePackets and the payload
-    LM_LinkedList<QueuePacket<ControlPacket>>* packetList = new LM_LinkedList<QueuePacket<ControlPacket>>();
+    uint16_t blockStart = seq_num - (seq_num - 1) % lstConfig->fecBlock;
 
-    //Add the SYNC configuration packet
-    packetList->Append(getStartSequencePacketQueue(dst, seq_id, numOfPackets));
+    //The blocks are completed in order, the parity packet of the block is the first one
+    QueuePacket<ControlPacket>* pq = nullptr;
+    lstConfig->parityList->setInUse();
+    if (lstConfig->parityList->moveToStart() && lstConfig->parityList->getCurrent()->number == blockStart)
+        pq = lstConfig->parityList->Pop();
+    lstConfig->parityList->releaseInUse();
 
+    if (pq == nullptr)
+        return;
 
-    for (uint16_t i = 1; i <= numOfPackets; i++) {
-        //Get the position of the payload
-        uint8_t* payloadToSend = reinterpret_cast<uint8_t*>((unsigned long)payload + ((i - 1) * maxPayloadSize));
+    uint32_t maxAge = 0;
+    if (config->deadline != 0) {
+        long remaining = (long) (config->deadline - millis());
+        maxAge = remaining > 0 ? remaining : 1;
+    }
 
-        //Get the payload Size in bytes
-        size_t payloadSizeToSend = maxPayloadSize;
-        if (i == numOfPackets)
-            payloadSizeToSend = payloadSize - (maxPayloadSize * (numOfPackets - 1));
+    ESP_LOGV(LM_TAG, "Sending parity packet Seq_id: %d, Num: %d", config->seq_id, blockStart);
+    incParityPackets();
 
-        ESP_LOGV(LM_TAG, "Payload Size: %d", payloadSizeToSend);
+    setPackedForSend(PacketService::sharePacket(pq->packet, pq->packet->getPacketLength()), lstConfig->priority, maxAge);
+    PacketQueueService::deleteQueuePacketAndPacket(pq);
+}
 
-        //Create a new packet with the previous payload
-        ControlPacket* cPacket = PacketService::createControlPacket(dst, getLocalAddress(), type, payloadToSend, payloadSizeToSend);
-        cPacket->number = i;
-        cPacket->seq_id = seq_id;
+void LoraMesher::processParityPacket(QueuePacket<ControlPacket>* pq) {
+    ControlPacket* cPacket = pq->packet;
 
-        //Create a packet queue
-        QueuePacket<ControlPacket>* pq = PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY + 1, i);
+    listConfiguration* listConfig = findSequenceList(q_WRP, cPacket->seq_id, cPacket->src);
 
-        //Append the packet queue in the linked list
-        packetList->Append(pq);
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+    size_t paritySize = PacketService::getPacketPayloadLength(cPacket);
+
+    if (listConfig == nullptr || listConfig->fecBlock == 0 || cPacket->number == 0 || cPacket->number > listConfig->config->number ||
+        (cPacket->number - 1) % listConfig->fecBlock != 0 || paritySize == 0 || paritySize > maxPayloadSize) {
+        ESP_LOGW(LM_TAG, "Parity packet not valid in seq_Id: %d, Num: %d", cPacket->seq_id, cPacket->number);
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
     }
 
-    //Create the pair of configuration
-    listConfiguration* listConfig = new listConfiguration();
-    listConfig->config = new sequencePacketConfig(seq_id, dst, numOfPackets, node);
-    listConfig->list = packetList;
+    sequencePacketConfig* config = listConfig->config;
+    listConfig->lastParity = cPacket->number;
 
-    // Set the RTT of the first packet of the sequence
-    listConfig->config->calculatingRTT = millis();
+    if (listConfig->parityList == nullptr)
+        listConfig->parityList = new LM_LinkedList<QueuePacket<ControlPacket>>();
 
-    // Set the timeout of the first packet of the sequence
-    addTimeout(listConfig->config);
+    pq->number = cPacket->number;
+    if (!PacketQueueService::addOrderedByNumber(listConfig->parityList, pq)) {
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
 
-    //Add dataList pair to the waiting send packets queue
-    q_WSP->setInUse();
-    q_WSP->Append(listConfig);
-    q_WSP->releaseInUse();
+    if (recoverWithParity(listConfig))
+        return;
 
-    //Send the first packet of the sequence (SYNC packet)
-    sendPacketSequence(listConfig, 0);
+    //The parity packet could not rebuild the block, the missing packets are requested
+    listConfig->list->setInUse();
+    bool hasGap = listConfig->list->getLength() > 0;
+    listConfig->list->releaseInUse();
 
-    // Notify the queueManager that a new sequence has been started
-    notifyNewSequenceStarted();
+    if (hasGap && config->lastLostRequested != config->lastAck + 1) {
+        ESP_LOGW(LM_TAG, "Missing packets in seq_Id: %d, requesting from: %d", config->seq_id, config->lastAck + 1);
+        config->lastLostRequested = config->lastAck + 1;
+        sendSackPacket(listConfig);
+    }
 }
 
-void LoraMesher::processDataPacket(QueuePacket<DataPacket>* pq) {
-    DataPacket* packet = pq->packet;
+bool LoraMesher::recoverWithParity(listConfiguration* listConfig) {
+    sequencePacketConfig* config = listConfig->config;
+    LM_LinkedList<QueuePacket<ControlPacket>>* parities = listConfig->parityList;
+    uint16_t missing = config->lastAck + 1;
+
+    //The parity packets of the blocks completed are not needed anymore
+    QueuePacket<ControlPacket>* parity = nullptr;
+    parities->setInUse();
+    while (parities->moveToStart()) {
+        QueuePacket<ControlPacket>* first = parities->getCurrent();
+        if (first->number + listConfig->fecBlock > missing) {
+            parity = first;
+            break;
+        }
 
-    incReceivedDataPackets();
+        PacketQueueService::deleteQueuePacketAndPacket(parities->Pop());
+    }
+    parities->releaseInUse();
 
-    ESP_LOGI(LM_TAG, "Data packet from %X, destination %X, via %X", packet->src, packet->dst, packet->via);
+    //A previous block is not completed yet
+    if (parity == nullptr || parity->number > missing)
+        return false;
 
-    RoutingTableService::aMessageHasBeenReceivedBy(packet->src);
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+    uint16_t blockStart = parity->number;
+    uint32_t blockEnd = std::min<uint32_t>(blockStart + listConfig->fecBlock - 1, config->number);
 
-    if (packet->dst == getLocalAddress()) {
-        ESP_LOGV(LM_TAG, "Data packet from %X for me", packet->src);
-        incDataPacketForMe();
+    uint8_t* payload = new uint8_t[maxPayloadSize]();
+    memcpy(payload, parity->packet->payload, PacketService::getPacketPayloadLength(parity->packet));
 
-        processDataPacketForMe(pq);
-        return;
+    //The packets of the block before the missing one have been received in order
+    if (missing > blockStart)
+        LM_Parity::add(payload, listConfig->fecParity, maxPayloadSize);
 
-    }
-    else if (packet->dst == BROADCAST_ADDR) {
-        ESP_LOGV(LM_TAG, "Data packet from %X BROADCAST", packet->src);
-        incReceivedBroadcast();
-        processDataPacketForMe(pq);
-        return;
+    //Every packet of the block after the missing one must have been received
+    uint32_t received = 0;
+    listConfig->list->setInUse();
+    if (listConfig->list->moveToStart()) {
+        do {
+            QueuePacket<ControlPacket>* current = listConfig->list->getCurrent();
+            if (current->number > blockEnd)
+                break;
 
+            size_t size = current->number == config->number ? listConfig->lastPacketSize : maxPayloadSize;
+            const uint8_t* packetPayload = current->packet != nullptr ? current->packet->payload :
+                listConfig->appPacket->payload + (current->number - 1) * maxPayloadSize;
+
+            LM_Parity::add(payload, packetPayload, size);
+            received++;
+        } while (listConfig->list->next());
     }
-    else if (packet->via == getLocalAddress()) {
-        ESP_LOGV(LM_TAG, "Data Packet from %X for %X. Via is me. Forwarding it", packet->src, packet->dst);
-        incReceivedIAmVia();
-        addToSendOrderedAndNotify(reinterpret_cast<QueuePacket<Packet<uint8_t>>*>(pq));
-        return;
+    listConfig->list->releaseInUse();
+
+    //More than one packet is missing, the parity packet is kept until the others are resent
+    if (received != blockEnd - missing) {
+        delete[] payload;
+        return false;
     }
 
-    ESP_LOGV(LM_TAG, "Packet not for me, deleting it");
-    incReceivedNotForMe();
-    PacketQueueService::deleteQueuePacketAndPacket(pq);
-}
+    parities->setInUse();
+    PacketQueueService::deleteQueuePacketAndPacket(parities->Pop());
+    parities->releaseInUse();
 
-void LoraMesher::processDataPacketForMe(QueuePacket<DataPacket>* pq) {
-    DataPacket* p = pq->packet;
-    ControlPacket* cPacket = reinterpret_cast<ControlPacket*>(p);
+    size_t size = missing == config->number ? listConfig->lastPacketSize : maxPayloadSize;
+    ControlPacket* cPacket = PacketService::createControlPacket(getLocalAddress(), config->source, NEED_ACK_P | XL_DATA_P, payload, size);
+    delete[] payload;
 
-    //By default, delete the packet queue at the finish of this function
-    bool deleteQueuePacket = true;
+    if (cPacket == nullptr)
+        return false;
 
-    bool needAck = PacketService::isNeedAckPacket(p->type);
+    cPacket->seq_id = config->seq_id;
+    cPacket->number = missing;
+    cPacket->via = getLocalAddress();
 
-    if (PacketService::isOnlyDataPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "Data Packet received");
-        //Convert the packet into a user packet
-        AppPacket<uint8_t>* appPacket = PacketService::convertPacket(p);
+    ESP_LOGI(LM_TAG, "Packet rebuilt with the parity packet in seq_Id: %d, Num: %d", config->seq_id, missing);
+    incRecoveredPackets();
 
-        // Handle validation failure
-        if (appPacket == nullptr) {
-            ESP_LOGE(LM_TAG, "Failed to convert packet, discarding corrupted packet");
-            PacketQueueService::deleteQueuePacketAndPacket(pq);
-            return;
-        }
+    processLargePayloadPacket(PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY + 1, missing));
+    return true;
+}
 
-        //Add and notify the user of this packet
-        notifyUserReceivedPacket(appPacket);
-    }
-    else if (PacketService::isAckPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "ACK Packet received");
-        addAck(p->src, cPacket->seq_id, cPacket->number);
-    }
-    else if (PacketService::isLostPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "Lost Packet received");
-        processLostPacket(p->src, cPacket->seq_id, cPacket->number);
+bool LoraMesher::sendPacketSequence(listConfiguration* lstConfig, uint16_t seq_num) {
+    // Check if the sequence number requested is valid
+    if (lstConfig->config->lastAck > seq_num) {
+        ESP_LOGE(LM_TAG, "Trying to send packet sequence previously acknowledged Seq_id: %d, Num: %d", lstConfig->config->seq_id, seq_num);
+        return false;
     }
-    else if (PacketService::isSyncPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "Synchronization Packet received");
-        processSyncPacket(p->src, cPacket->seq_id, cPacket->number);
 
-        needAck = false;
-    }
-    else if (PacketService::isXLPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "Large payload Packet received");
-        processLargePayloadPacket(reinterpret_cast<QueuePacket<ControlPacket>*>(pq));
-        needAck = false;
-        deleteQueuePacket = false;
+    //Get the packet queue with the sequence number
+    QueuePacket<ControlPacket>* pq = PacketQueueService::findPacketQueue(lstConfig->list, seq_num);
+
+    //The packets of a source are created when they are sent
+    if (pq == nullptr && lstConfig->source != nullptr && seq_num > 0)
+        pq = createSourcePacket(lstConfig, seq_num);
+
+    if (pq == nullptr) {
+        ESP_LOGE(LM_TAG, "NOT FOUND the packet queue with Seq_id: %d, Num: %d", lstConfig->config->seq_id, seq_num);
+        return false;
     }
 
-    //Need ack
-    if (needAck) {
-        //TODO: All packets with this ack will ack?
-        ESP_LOGV(LM_TAG, "Previous packet need an ACK");
-        sendAckPacket(p->src, cPacket->seq_id, cPacket->number);
+    //Share the packet with the send queue, the buffer is only copied if it is not inside the packet pool
+    Packet<uint8_t>* p = PacketService::sharePacket(pq->packet, pq->packet->getPacketLength());
+
+    //Add the packet to the send queue, it is not sent after the deadline of the sequence
+    uint32_t maxAge = 0;
+    if (lstConfig->config->deadline != 0) {
+        long remaining = (long) (lstConfig->config->deadline - millis());
+        maxAge = remaining > 0 ? remaining : 1;
     }
 
-    if (deleteQueuePacket)
-        //Delete packet queue
-        PacketQueueService::deleteQueuePacketAndPacket(pq);
+    setPackedForSend(p, lstConfig->priority, maxAge);
+
+    if (seq_num > 0)
+        lstConfig->sentPackets++;
+
+    return true;
 }
 
-void LoraMesher::notifyUserReceivedPacket(AppPacket<uint8_t>* appPacket) {
-    if (ReceiveAppData_TaskHandle) {
-        ReceivedAppPackets->setInUse();
-        //Add the packet inside the receivedUsers Queue
-        ReceivedAppPackets->Append(appPacket);
+QueuePacket<ControlPacket>* LoraMesher::createSourcePacket(listConfiguration* lstConfig, uint16_t seq_num) {
+    sequencePacketConfig* config = lstConfig->config;
 
-        ReceivedAppPackets->releaseInUse();
+    if (seq_num > config->number)
+        return nullptr;
 
-        //Notify the received user task handle
-        xTaskNotify(
-            ReceiveAppData_TaskHandle,
-            0,
-            eSetValueWithOverwrite);
+    uint8_t type = NEED_ACK_P | XL_DATA_P;
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(type);
 
+    uint32_t offset = (uint32_t) (seq_num - 1) * maxPayloadSize;
+    size_t payloadSize = maxPayloadSize;
+    if (seq_num == config->number)
+        payloadSize = lstConfig->sourcePayloadSize - offset;
+
+    //Create a new packet and read the payload directly into it, with the space to encrypt it
+    ControlPacket* cPacket = PacketService::createControlPacket(config->source, getLocalAddress(), type, nullptr, payloadSize + CryptoService::getOverhead(type));
+    if (cPacket == nullptr)
+        return nullptr;
+
+    if (lstConfig->source->read(offset, cPacket->payload, payloadSize) != payloadSize) {
+        ESP_LOGE(LM_TAG, "Source could not be read Seq_id: %d, Num: %d", config->seq_id, seq_num);
+        delete cPacket;
+        return nullptr;
     }
-    else
-        deletePacket(appPacket);
-}
 
-uint32_t LoraMesher::getPropagationTimeWithRandom(uint8_t multiplayer) {
-    // TODO: Use the RTT or other congestion metrics to calculate the time, timeouts...
-    uint32_t time = getMaxPropagationTime();
-    uint32_t randomTime = random(time, time * 3 + (multiplayer + routingTableSize()) * 100);
-    return randomTime;
-}
+    addParityPacket(lstConfig, seq_num, cPacket->payload, payloadSize);
 
-void LoraMesher::recalculateMaxTimeOnAir() {
-    maxTimeOnAir = radio->getTimeOnAir(PacketFactory::getMaxPacketSize()) / 1000;
-    ESP_LOGV(LM_TAG, "Max Time on Air changed %d ms", (int)maxTimeOnAir);
+    cPacket->number = seq_num;
+    cPacket->seq_id = config->seq_id;
+
+    if (!CryptoService::encryptPacket(reinterpret_cast<Packet<uint8_t>*>(cPacket))) {
+        ESP_LOGE(LM_TAG, "Source packet could not be encrypted Seq_id: %d, Num: %d", config->seq_id, seq_num);
+        delete cPacket;
+        return nullptr;
+    }
+
+    QueuePacket<ControlPacket>* pq = PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY + 1, seq_num);
+
+    //Keep it until it is acknowledged
+    PacketQueueService::addOrderedByNumber(lstConfig->list, pq);
+
+    return pq;
 }
 
-void LoraMesher::recordState(LM_StateType type, Packet<uint8_t>* packet) {
-    if (simulatorService == nullptr)
+void LoraMesher::deleteAcknowledgedPackets(listConfiguration* lstConfig) {
+    sequencePacketConfig* config = lstConfig->config;
+
+    //The SYNC packet is needed until the first ACK
+    if (config->firstAckReceived == 0)
         return;
 
-    simulatorService->addState(ReceivedPackets->getLength(), getSendQueueSize(),
-        getReceivedQueueSize(), routingTableSize(), q_WRP->getLength(), q_WSP->getLength(),
-        type, packet);
+    lstConfig->list->setInUse();
+    while (lstConfig->list->moveToStart() && lstConfig->list->getCurrent()->number <= config->lastAck)
+        PacketQueueService::deleteQueuePacketAndPacket(lstConfig->list->Pop());
+    lstConfig->list->releaseInUse();
 }
 
-#ifdef LM_TESTING
-bool LoraMesher::canReceivePacket(uint16_t source) {
-	return true;
-}
-#endif
+void LoraMesher::sendPacketSequenceWindow(listConfiguration* lstConfig) {
+    sequencePacketConfig* config = lstConfig->config;
 
-#ifdef LM_TESTING
-bool LoraMesher::isDataPacketAndLocal(DataPacket* packet, uint16_t localAddress) {
-    return PacketService::isDataPacket(packet->type) && packet->via == localAddress;
-}
+    CongestionWindow* congestion = updateCongestionWindow(lstConfig);
 
-bool LoraMesher::shouldProcessPacket(Packet<uint8_t>* packet) {
-    return isDataPacketAndLocal(reinterpret_cast<DataPacket*>(packet), getLocalAddress()) || canReceivePacket(packet->src);
+    uint32_t windowEnd = (uint32_t) config->lastAck + config->window;
+    if (windowEnd > config->number)
+        windowEnd = config->number;
+
+    while (config->lastSent < windowEnd) {
+        //Every sequence keeps one packet in flight, the others are sent while the window of the next hop has room
+        if (congestion != nullptr && config->lastSent > config->lastAck && congestion->inFlight >= congestion->size)
+            break;
+
+        config->lastSent++;
+        sendPacketSequence(lstConfig, config->lastSent);
+        sendParityPacket(lstConfig, config->lastSent);
+
+        if (congestion != nullptr) {
+            congestion->inFlight++;
+            lstConfig->inFlight++;
+        }
+    }
 }
-#endif
 
-/**
- *  End Region Packet Service
-**/
+CongestionWindow* LoraMesher::updateCongestionWindow(listConfiguration* lstConfig) {
+    if (!loraMesherConfig->congestionControl)
+        return nullptr;
 
+    sequencePacketConfig* config = lstConfig->config;
+    uint16_t via = RoutingTableService::getNextHop(config->source);
 
-/**
- *  Region Routing Table
-**/
+    //The route has changed, the packets in flight are moved to the window of the new next hop
+    if (via != lstConfig->congestionVia)
+        releaseCongestionWindow(lstConfig);
 
-size_t LoraMesher::routingTableSize() {
-    return RoutingTableService::routingTableSize();
-}
+    RouteNode* neighbour = via == 0 ? nullptr : RoutingTableService::findNode(via);
+    if (neighbour == nullptr)
+        return nullptr;
 
-/**
- *  End Region Routing Table
-**/
+    CongestionWindow* congestion = &neighbour->congestion;
+    if (congestion->size == 0) {
+        congestion->size = LM_CONGESTION_INITIAL_WINDOW;
+        congestion->threshold = LM_CONGESTION_MAX_WINDOW;
+    }
 
+    //The ACKs and the lost packets move the last packet acknowledged and the last packet sent
+    uint16_t inFlight = config->lastSent > config->lastAck ? config->lastSent - config->lastAck : 0;
+    uint32_t total = (uint32_t) congestion->inFlight + inFlight;
+    congestion->inFlight = total > lstConfig->inFlight ? total - lstConfig->inFlight : 0;
 
-/**
- *  Region PacketQueue
-**/
+    lstConfig->congestionVia = via;
+    lstConfig->inFlight = inFlight;
 
-size_t LoraMesher::getReceivedQueueSize() {
-    return ReceivedAppPackets->getLength();
+    return congestion;
 }
 
-size_t LoraMesher::getSendQueueSize() {
-    return ToSendPackets->getLength();
+void LoraMesher::releaseCongestionWindow(listConfiguration* lstConfig) {
+    if (lstConfig->congestionVia == 0)
+        return;
+
+    RouteNode* neighbour = RoutingTableService::findNode(lstConfig->congestionVia);
+    if (neighbour != nullptr) {
+        CongestionWindow& congestion = neighbour->congestion;
+        congestion.inFlight = congestion.inFlight > lstConfig->inFlight ? congestion.inFlight - lstConfig->inFlight : 0;
+    }
+
+    lstConfig->congestionVia = 0;
+    lstConfig->inFlight = 0;
 }
 
-void LoraMesher::addToSendOrderedAndNotify(QueuePacket<Packet<uint8_t>>* qp) {
-    PacketQueueService::addOrdered(ToSendPackets, qp);
-    ESP_LOGI(LM_TAG, "Added packet to Q_SP, notifying sender task");
+void LoraMesher::increaseCongestionWindow(listConfiguration* lstConfig, uint16_t acknowledged) {
+    CongestionWindow* congestion = updateCongestionWindow(lstConfig);
+
+    //The window is not full, it would grow without being used
+    if (congestion == nullptr || acknowledged == 0 || congestion->inFlight < congestion->size)
+        return;
+
+    if (congestion->size < congestion->threshold) {
+        congestion->size = std::min<uint16_t>(congestion->size + acknowledged, LM_CONGESTION_MAX_WINDOW);
+        return;
+    }
 
-    //Notify the sendData task handle
-    xTaskNotify(SendData_TaskHandle, 0, eSetValueWithOverwrite);
-}
+    uint16_t count = congestion->acknowledged + acknowledged;
+    while (count >= congestion->size && congestion->size < LM_CONGESTION_MAX_WINDOW) {
+        count -= congestion->size;
+        congestion->size++;
+    }
 
-void LoraMesher::notifyNewSequenceStarted() {
-    //Notify the sendData task handle
-    xTaskNotify(QueueManager_TaskHandle, 0, eSetValueWithOverwrite);
+    congestion->acknowledged = std::min<uint16_t>(count, UINT8_MAX);
 }
 
-/**
- *  End Region PacketQueue
-**/
+void LoraMesher::decreaseCongestionWindow(uint16_t via, unsigned long rtt, bool timeout) {
+    if (!loraMesherConfig->congestionControl || via == 0)
+        return;
 
+    RouteNode* neighbour = RoutingTableService::findNode(via);
+    if (neighbour == nullptr || neighbour->congestion.size == 0)
+        return;
 
-/**
- * Large and Reliable payloads
- */
+    CongestionWindow& congestion = neighbour->congestion;
+    uint32_t now = millis();
 
-QueuePacket<ControlPacket>* LoraMesher::getStartSequencePacketQueue(uint16_t destination, uint8_t seq_id, uint16_t num_packets) {
-    uint8_t type = SYNC_P | NEED_ACK_P | XL_DATA_P;
+    if (!timeout && congestion.lastDecrease != 0 && now - congestion.lastDecrease < rtt)
+        return;
 
-    //Create the packet
-    ControlPacket* cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, num_packets);
+    congestion.lastDecrease = now;
+    //Most of the losses of a radio link are not caused by the window, they only decrease it by a quarter
+    congestion.threshold = std::max<uint8_t>(timeout ? congestion.size / 2 : congestion.size * 3 / 4, LM_CONGESTION_MIN_WINDOW);
+    congestion.size = congestion.threshold;
+    congestion.acknowledged = 0;
 
-    //Create a packet queue
-    return PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY, 0);
-}
+    incCongestionDecreases();
 
-void LoraMesher::sendAckPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num) {
-    uint8_t type = ACK_P;
+    ESP_LOGV(LM_TAG, "Congestion window of the next hop %X decreased to %d packets", via, congestion.size);
+}
 
-    //Create the packet
-    ControlPacket* cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, seq_num);
+void LoraMesher::sendCongestedSequences(uint16_t via, listConfiguration* lstConfig) {
+    if (!loraMesherConfig->congestionControl || via == 0)
+        return;
 
-    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), DEFAULT_PRIORITY + 3);
-}
+    q_WSP->setInUse();
 
-void LoraMesher::sendLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num) {
-    uint8_t type = LOST_P;
+    if (q_WSP->moveToStart()) {
+        do {
+            listConfiguration* current = q_WSP->getCurrent();
+            sequencePacketConfig* config = current->config;
 
-    //Create the packet
-    ControlPacket* cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, seq_num);
+            //The sequences waiting for the ACK of their SYNC packet cannot send the packets yet
+            if (current != lstConfig && current->congestionVia == via && config->firstAckReceived != 0 && config->lastSent < config->number)
+                sendPacketSequenceWindow(current);
+        } while (q_WSP->next());
+    }
 
-    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), DEFAULT_PRIORITY + 2);
+    q_WSP->releaseInUse();
 }
 
-bool LoraMesher::sendPacketSequence(listConfiguration* lstConfig, uint16_t seq_num) {
-    // Check if the sequence number requested is valid
-    if (lstConfig->config->lastAck > seq_num) {
-        ESP_LOGE(LM_TAG, "Trying to send packet sequence previously acknowledged Seq_id: %d, Num: %d", lstConfig->config->seq_id, seq_num);
-        return false;
-    }
+void LoraMesher::addCongestionQueueDelay(QueuePacket<Packet<uint8_t>>* tx, uint16_t via) {
+    if (!loraMesherConfig->congestionControl)
+        return;
 
-    //Get the packet queue with the sequence number
-    QueuePacket<ControlPacket>* pq = PacketQueueService::findPacketQueue(lstConfig->list, seq_num);
+    RouteNode* neighbour = RoutingTableService::findNode(via);
+    if (neighbour == nullptr || neighbour->congestion.size == 0)
+        return;
 
-    if (pq == nullptr) {
-        ESP_LOGE(LM_TAG, "NOT FOUND the packet queue with Seq_id: %d, Num: %d", lstConfig->config->seq_id, seq_num);
-        return false;
-    }
+    CongestionWindow& congestion = neighbour->congestion;
+    uint32_t waited = (LatencyService::now() - tx->timestamp) / 1000;
 
-    //Create the packet
-    Packet<uint8_t>* p = PacketService::copyPacket(pq->packet, pq->packet->getPacketLength());
+    congestion.queueDelay = std::min<uint32_t>((congestion.queueDelay * 7UL + waited) / 8, UINT16_MAX);
 
-    //Add the packet to the send queue
-    setPackedForSend(p, DEFAULT_PRIORITY);
+    //The packets of the sequences wait for the other packets of the node, the windows send more than the link carries
+    if (waited > LM_CONGESTION_QUEUE_DELAY)
+        decreaseCongestionWindow(via, neighbour->SRTT, false);
+}
 
-    return true;
+void LoraMesher::processAckPacket(ControlPacket* cPacket) {
+    addAck(cPacket->src, cPacket->seq_id, cPacket->number);
+
+    //The ACKs of the other sequences to this node coalesced with it
+    size_t numRecords = std::min<size_t>(PacketService::getPacketPayloadLength(cPacket) / sizeof(AckRecord), LM_MAX_ACK_RECORDS);
+
+    for (size_t i = 0; i < numRecords; i++) {
+        AckRecord record;
+        memcpy(&record, cPacket->payload + i * sizeof(AckRecord), sizeof(AckRecord));
+        addAck(cPacket->src, record.seq_id, record.number);
+    }
 }
 
-void LoraMesher::addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num) {
+void LoraMesher::addAck(uint16_t source, LM_SeqId seq_id, uint16_t seq_num) {
     listConfiguration* config = findSequenceList(q_WSP, seq_id, source);
     if (config == nullptr) {
         ESP_LOGE(LM_TAG, "NOT FOUND the sequence packet config in add ack with Seq_id: %d, Source: %d", seq_id, source);
         return;
     }
 
+    uint16_t via = config->congestionVia;
+
+    if (!updateAck(config, seq_num)) {
+        //The end of the sequence leaves room inside the congestion window of its next hop
+        sendCongestedSequences(via, nullptr);
+        return;
+    }
+
+    ESP_LOGV(LM_TAG, "Sending next packets of the window after receiving an ACK");
+
+    //Send the next packets of the sequence that fit inside the window, and the other sequences through the same next hop
+    sendPacketSequenceWindow(config);
+    sendCongestedSequences(config->congestionVia, config);
+}
+
+bool LoraMesher::updateAck(listConfiguration* config, uint16_t seq_num) {
     //If all packets has been arrived to the destiny
     //Delete this sequence
     if (config->config->number == seq_num) {
-        ESP_LOGI(LM_TAG, "All the packets has been arrived to the seq_Id: %d", seq_id);
+        ESP_LOGI(LM_TAG, "All the packets has been arrived to the seq_Id: %d", config->config->seq_id);
+
+        updateLossRate(config);
+
+        if (config->config->lastAck < seq_num)
+            increaseCongestionWindow(config, seq_num - config->config->lastAck);
+
+        if (config->source != nullptr) {
+            SequenceSource* source = config->source;
+            config->source = nullptr;
+
+            source->onSequenceEnd(config->config->source, config->config->seq_id, true);
+        }
+
         findAndClearLinkedList(q_WSP, config);
-        return;
+        return false;
     }
 
     if (config->config->lastAck > seq_num) {
         ESP_LOGE(LM_TAG, "ACK received that has been yet acknowledged Seq_id: %d, Num: %d", config->config->seq_id, seq_num);
-        return;
+        return false;
     }
 
+    //The ACKs are cumulative, a repeated ACK does not acknowledge new packets
+    bool newAck = config->config->firstAckReceived == 0 || config->config->lastAck < seq_num;
+
+    if (newAck)
+        increaseCongestionWindow(config, seq_num - config->config->lastAck);
+
     //Set has been received some ACK
     config->config->firstAckReceived = 1;
 
-    // TODO: Check for repeated ACKs and packets.
-
     //Add the last ack to the config packet
     config->config->lastAck = seq_num;
 
-    // Recalculate the RTT
-    actualizeRTT(config->config);
+    if (config->config->lastSent < seq_num)
+        config->config->lastSent = seq_num;
+
+    if (newAck) {
+        // Recalculate the RTT
+        actualizeRTT(config->config);
+
+        //Reset the timeouts
+        resetTimeout(config->config);
+    }
+
+    if (config->source != nullptr)
+        deleteAcknowledgedPackets(config);
+
+    return true;
+}
+
+void LoraMesher::processSackPacket(ControlPacket* p) {
+    listConfiguration* listConfig = findSequenceList(q_WSP, p->seq_id, p->src);
+    if (listConfig == nullptr) {
+        ESP_LOGE(LM_TAG, "NOT FOUND the sequence packet config in selective ACK with Seq_id: %d, Source: %d", p->seq_id, p->src);
+        return;
+    }
+
+    uint16_t base = p->number;
+    uint16_t via = listConfig->congestionVia;
+
+    if (!updateAck(listConfig, base)) {
+        sendCongestedSequences(via, nullptr);
+        return;
+    }
+
+    sequencePacketConfig* config = listConfig->config;
+    size_t bitmapSize = PacketService::getPacketPayloadLength(p);
+    uint8_t* bitmap = p->payload;
+
+    //The packets after the highest received can still be in flight, only the gaps before it are missing
+    uint32_t highest = base + 1;
+    for (size_t i = 0; i < bitmapSize * 8; i++) {
+        if (bitmap[i / 8] & (1 << (i % 8)))
+            highest = base + 1 + i;
+    }
+
+    if (highest > config->number)
+        highest = config->number;
+
+    uint16_t resent = 0;
+
+    for (uint32_t number = base + 1; number <= highest; number++) {
+        size_t bit = number - base - 1;
+        bool received = bit < bitmapSize * 8 && (bitmap[bit / 8] & (1 << (bit % 8)));
+
+        if (received)
+            continue;
+
+        ESP_LOGV(LM_TAG, "Selective ACK, resending Seq_id: %d, Num: %d", config->seq_id, number);
+
+        if (config->lastSent < number)
+            config->lastSent = number;
+
+        if (sendPacketSequence(listConfig, number))
+            resent++;
+    }
+
+    if (resent > 0) {
+        RoutingTableService::incLinkCounter(p->src, &LinkCounters::lost, resent);
+        RoutingTableService::incLinkCounter(p->src, &LinkCounters::retries, resent);
 
-    //Reset the timeouts
-    resetTimeout(config->config);
+        decreaseCongestionWindow(listConfig->congestionVia, config->node != nullptr ? config->node->SRTT : 0, false);
 
-    ESP_LOGV(LM_TAG, "Sending next packet after receiving an ACK");
+        config->numberOfTimeouts++;
+        //Reset the timeout of this sequence packets inside the q_WSP
+        recalculateTimeoutAfterTimeout(config);
+    }
 
-    //Send the next packet sequence
-    sendPacketSequence(config, seq_num + 1);
+    //Fill the window again
+    sendPacketSequenceWindow(listConfig);
 }
 
 bool LoraMesher::processLargePayloadPacket(QueuePacket<ControlPacket>* pq) {
@@ -1185,109 +3286,219 @@ bool LoraMesher::processLargePayloadPacket(QueuePacket<ControlPacket>* pq) {
         return false;
     }
 
-    if (configList->config->lastAck + 1 != cPacket->number) {
-        ESP_LOGE(LM_TAG, "Sequence number received in bad order in seq_Id: %d, received: %d expected: %d", cPacket->seq_id, cPacket->number, configList->config->lastAck + 1);
-        sendLostPacket(cPacket->src, cPacket->seq_id, configList->config->lastAck + 1);
+    sequencePacketConfig* config = configList->config;
+
+    if (cPacket->number == 0 || cPacket->number > config->number) {
+        ESP_LOGE(LM_TAG, "Sequence number out of the sequence in seq_Id: %d, received: %d, number of packets: %d", cPacket->seq_id, cPacket->number, config->number);
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return false;
+    }
+
+    if (cPacket->number <= config->lastAck) {
+        ESP_LOGW(LM_TAG, "Sequence number already received in seq_Id: %d, received: %d, last ACK: %d", cPacket->seq_id, cPacket->number, config->lastAck);
+        //The ACK could have been lost, repeat the cumulative ACK
+        sendAckPacket(cPacket->src, cPacket->seq_id, config->lastAck);
+
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return false;
+    }
+
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+    size_t payloadSize = PacketService::getPacketPayloadLength(cPacket);
+
+    //Every packet but the last one is full, it is needed to know the position inside the payload
+    if (payloadSize > maxPayloadSize || (cPacket->number != config->number && payloadSize != maxPayloadSize)) {
+        ESP_LOGE(LM_TAG, "Wrong payload size in seq_Id: %d, received: %d, size: %d", cPacket->seq_id, cPacket->number, payloadSize);
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return false;
+    }
+
+    //Packets can arrive out of order, keep the list ordered by number to know which ones are missing
+    pq->number = cPacket->number;
 
+    if (!PacketQueueService::addOrderedByNumber(configList->list, pq)) {
+        ESP_LOGW(LM_TAG, "Repeated packet in seq_Id: %d, received: %d", cPacket->seq_id, cPacket->number);
         PacketQueueService::deleteQueuePacketAndPacket(pq);
         return false;
     }
 
-    configList->config->lastAck++;
+    uint16_t src = cPacket->src;
+
+    //Without a sink the payload can be copied into its position now, only the number is kept in the list.
+    //The sink needs the chunks in order, the packets after a gap are kept until the gap is filled
+    if (configList->sink == nullptr) {
+        deliverSequencePayload(configList, cPacket);
+        delete cPacket;
+        pq->packet = nullptr;
+    }
+
+    uint16_t previousAck = config->lastAck;
+    bool hasGap = false;
+
+    //Advance the last ACK through the consecutive packets received, they are not needed anymore
+    for (;;) {
+        QueuePacket<ControlPacket>* next = nullptr;
+
+        configList->list->setInUse();
+        if (configList->list->moveToStart() && configList->list->getCurrent()->number == config->lastAck + 1)
+            next = configList->list->Pop();
+
+        hasGap = configList->list->getLength() > 0;
+        configList->list->releaseInUse();
+
+        if (next == nullptr)
+            break;
+
+        config->lastAck++;
+
+        //The packets received in order of the block are kept in its parity, the rest of the block is in the list
+        if (configList->fecBlock > 0 && config->lastAck < config->number) {
+            if (configList->fecParity == nullptr)
+                configList->fecParity = new uint8_t[maxPayloadSize];
+
+            if ((config->lastAck - 1) % configList->fecBlock == 0)
+                memset(configList->fecParity, 0, maxPayloadSize);
+
+            const uint8_t* payload = next->packet != nullptr ? next->packet->payload :
+                configList->appPacket->payload + (config->lastAck - 1) * maxPayloadSize;
+            LM_Parity::add(configList->fecParity, payload, maxPayloadSize);
+        }
+
+        if (next->packet != nullptr)
+            deliverSequencePayload(configList, next->packet);
+
+        PacketQueueService::deleteQueuePacketAndPacket(next);
+    }
+
+    if (config->lastAck != previousAck) {
+        //Send the cumulative ACK, if there is a gap the selective ACK includes it
+        if (!hasGap)
+            sendAckPacket(src, config->seq_id, config->lastAck);
 
-    configList->list->setInUse();
-    configList->list->Append(pq);
-    configList->list->releaseInUse();
+        // Recalculate the RTT
+        actualizeRTT(config);
+    }
+
+    //The parity packet of the block is sent after its last packet, the missing packet is requested if it cannot rebuild it
+    bool waitingParity = false;
+    if (hasGap && configList->fecBlock > 0) {
+        uint16_t missing = config->lastAck + 1;
+        uint16_t blockStart = missing - (missing - 1) % configList->fecBlock;
+        uint32_t blockEnd = std::min<uint32_t>(blockStart + configList->fecBlock - 1, config->number);
 
-    //Send ACK
-    sendAckPacket(cPacket->src, cPacket->seq_id, cPacket->number);
+        configList->list->setInUse();
+        uint16_t lastReceived = configList->list->Last() != nullptr ? configList->list->Last()->number : 0;
+        configList->list->releaseInUse();
+
+        waitingParity = configList->lastParity != blockStart && lastReceived <= blockEnd;
+    }
 
-    // Recalculate the RTT
-    actualizeRTT(configList->config);
+    //Request the missing packets, only once for every gap
+    if (hasGap && !waitingParity && config->lastLostRequested != config->lastAck + 1) {
+        ESP_LOGW(LM_TAG, "Missing packet in seq_Id: %d, requesting from: %d", config->seq_id, config->lastAck + 1);
+        config->lastLostRequested = config->lastAck + 1;
+        sendSackPacket(configList);
+    }
 
     // Reset the timeouts
-    resetTimeout(configList->config);
+    resetTimeout(config);
 
     //All packets has been arrived, join them and send to the user
-    if (configList->config->lastAck == configList->config->number) {
+    if (config->lastAck == config->number) {
         joinPacketsAndNotifyUser(configList);
         return true;
     }
 
+    //The packet received could leave a single packet missing in the block of a parity packet kept
+    if (configList->parityList != nullptr)
+        recoverWithParity(configList);
+
     return true;
 }
 
 void LoraMesher::joinPacketsAndNotifyUser(listConfiguration* listConfig) {
     ESP_LOGV(LM_TAG, "Joining packets seq_Id: %d Src: %X", listConfig->config->seq_id, listConfig->config->source);
 
-    LM_LinkedList<QueuePacket<ControlPacket>>* list = listConfig->list;
+    if (listConfig->sink != nullptr) {
+        //The payload has been delivered to the sink while the packets were arriving
+        SequenceSink* sink = listConfig->sink;
+        listConfig->sink = nullptr;
 
-    list->setInUse();
-    if (!list->moveToStart()) {
-        list->releaseInUse();
+        sink->onSequenceEnd(listConfig->config->source, listConfig->config->seq_id, listConfig->sinkPayloadSize, true);
+
+        findAndClearLinkedList(q_WRP, listConfig);
         return;
     }
 
-    //TODO: getPacketPayloadLength could be done when adding the packets inside the list
-    size_t payloadSize = 0;
-    size_t number = 1;
-
-    do {
-        ControlPacket* currentP = reinterpret_cast<ControlPacket*>(list->getCurrent()->packet);
-
-        if (number != (currentP->number))
-            //TODO: ORDER THE PACKETS if they are not ordered?
-            ESP_LOGE(LM_TAG, "Wrong packet order");
-
-        number++;
-        payloadSize += PacketService::getPacketPayloadLength(currentP);
-    } while (list->next());
+    //The payload has been copied while the packets were arriving
+    AppPacket<uint8_t>* p = listConfig->appPacket;
+    listConfig->appPacket = nullptr;
 
-    //Move to start again
-    list->moveToStart();
+    ESP_LOGV(LM_TAG, "Large Packet Payload Size: %d", (int)p->payloadSize);
 
-    ControlPacket* currentP = list->getCurrent()->packet;
+    uint16_t source = listConfig->config->source;
+    LM_SeqId seq_id = listConfig->config->seq_id;
+    uint16_t number = listConfig->config->number;
+    bool compressed = listConfig->compressed;
 
-    uint32_t appPacketLength = sizeof(AppPacket<uint8_t>);
-
-    //Packet length = size of the packet + size of the payload
-    uint32_t packetLength = appPacketLength + payloadSize;
-
-    AppPacket<uint8_t>* p = static_cast<AppPacket<uint8_t>*>(pvPortMalloc(packetLength));
+    //TODO: When finished, clear everything? Or maintain the config until timeout?
+    findAndClearLinkedList(q_WRP, listConfig);
 
-    ESP_LOGV(LM_TAG, "Large Packet Packet length: %d Payload Size: %d", (int)packetLength, payloadSize);
+    if (compressed) {
+        AppPacket<uint8_t>* decompressed = PacketService::createDecompressedAppPacket(getLocalAddress(), source, p->payload, p->payloadSize);
+        PacketPoolService::releasePayload(p);
 
-    if (p) {
-        //Copy the payload into the packet
-        unsigned long actualPayloadSizeDst = appPacketLength;
+        if (decompressed == nullptr) {
+            ESP_LOGE(LM_TAG, "Failed to decompress the payload of seq_Id: %d Src: %X", seq_id, source);
+            return;
+        }
 
-        do {
-            currentP = list->getCurrent()->packet;
+        p = decompressed;
 
-            size_t actualPayloadSizeSrc = PacketService::getPacketPayloadLength(currentP);
+        ESP_LOGV(LM_TAG, "Large Packet Payload decompressed to %d bytes", (int)p->payloadSize);
 
-            memcpy(reinterpret_cast<void*>((unsigned long)p + (actualPayloadSizeDst)), currentP->payload, actualPayloadSizeSrc);
-            actualPayloadSizeDst += actualPayloadSizeSrc;
-        } while (list->next());
+        //The sink receives the whole payload in a single chunk
+        SequenceSink* sink = sequenceSink;
+        if (sink != nullptr && sink->onSequenceStart(source, seq_id, number, p->payloadSize)) {
+            sink->onChunk(source, seq_id, 0, p->payload, p->payloadSize);
+            sink->onSequenceEnd(source, seq_id, p->payloadSize, true);
+            PacketPoolService::releasePayload(p);
+            return;
+        }
     }
 
-    list->releaseInUse();
-
     //Set values to the AppPacket
-    p->payloadSize = payloadSize;
-    p->src = listConfig->config->source;
+    p->src = source;
     p->dst = getLocalAddress();
 
-    //TODO: When finished, clear everything? Or maintain the config until timeout?
-    findAndClearLinkedList(q_WRP, listConfig);
-
     notifyUserReceivedPacket(p);
 }
 
-void LoraMesher::processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq_num) {
+void LoraMesher::deliverSequencePayload(listConfiguration* listConfig, ControlPacket* cPacket) {
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+    size_t payloadSize = PacketService::getPacketPayloadLength(cPacket);
+    uint32_t offset = (cPacket->number - 1) * maxPayloadSize;
+
+    if (listConfig->sink != nullptr) {
+        listConfig->sink->onChunk(cPacket->src, cPacket->seq_id, offset, cPacket->payload, payloadSize);
+        listConfig->sinkPayloadSize += payloadSize;
+        return;
+    }
+
+    AppPacket<uint8_t>* appPacket = listConfig->appPacket;
+    memcpy(appPacket->payload + offset, cPacket->payload, payloadSize);
+    appPacket->payloadSize += payloadSize;
+}
+
+void LoraMesher::processSyncPacket(uint16_t source, LM_SeqId seq_id, uint16_t seq_num, bool compressed, uint8_t channel,
+    uint8_t fecBlock, uint8_t lastPacketSize) {
     //Check for repeated sequence lists
     listConfiguration* listConfig = findSequenceList(q_WRP, seq_id, source);
 
+    //The source has moved the sequence to the control channel after a timeout
+    if (listConfig != nullptr && channel == 0 && ChannelService::endSession(source, seq_id))
+        xTaskNotify(SendData_TaskHandle, 0, eSetValueWithOverwrite);
+
     if (listConfig == nullptr) {
         // Get the Routing Table node of the destination
         RouteNode* node = RoutingTableService::findNode(source);
@@ -1297,10 +3508,55 @@ void LoraMesher::processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq
             return;
         }
 
+        //The SYNC specifies the number of packets and all of them but the last one are full
+        size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+
+        //Without the ACK of the SYNC the source retries it later
+        uint16_t maxSequences = loraMesherConfig->maxReceiveSequences;
+        if (maxSequences > 0 && q_WRP->getLength() >= maxSequences) {
+            ESP_LOGW(LM_TAG, "Sequence from %X rejected, there are %d sequences", source, (int)q_WRP->getLength());
+            incSequencesRejected();
+            return;
+        }
+
+        //Check if the sink receives the sequence. A compressed payload is reassembled and decompressed before being delivered
+        SequenceSink* sink = compressed ? nullptr : sequenceSink;
+        if (sink != nullptr && !sink->onSequenceStart(source, seq_id, seq_num, seq_num * maxPayloadSize))
+            sink = nullptr;
+
+        //Otherwise reserve the whole payload
+        AppPacket<uint8_t>* appPacket = nullptr;
+        if (sink == nullptr) {
+            if (isOverHeapBudget(sizeof(AppPacket<uint8_t>) + seq_num * maxPayloadSize)) {
+                ESP_LOGW(LM_TAG, "Sequence from %X rejected, Seq_id: %d would be over the heap budget", source, seq_id);
+                incSequencesRejected();
+                return;
+            }
+
+            appPacket = static_cast<AppPacket<uint8_t>*>(PacketPoolService::allocatePayload(sizeof(AppPacket<uint8_t>) + seq_num * maxPayloadSize));
+
+            if (appPacket == nullptr) {
+                ESP_LOGE(LM_TAG, "Not enough memory to receive the sequence Seq_id: %d, Number of packets: %d", seq_id, seq_num);
+                return;
+            }
+
+            appPacket->payloadSize = 0;
+            appPacket->next = nullptr;
+        }
+
         //Create the pair of configuration
         listConfig = new listConfiguration();
         listConfig->config = new sequencePacketConfig(seq_id, source, seq_num, node);
         listConfig->list = new LM_LinkedList<QueuePacket<ControlPacket>>();
+        listConfig->appPacket = appPacket;
+        listConfig->sink = sink;
+        listConfig->compressed = compressed;
+
+        //The parity packets are ignored if the size of the last packet is not valid
+        if (lastPacketSize > 0 && lastPacketSize <= maxPayloadSize) {
+            listConfig->fecBlock = fecBlock;
+            listConfig->lastPacketSize = lastPacketSize;
+        }
 
         // Starting to calculate RTT
         actualizeRTT(listConfig->config);
@@ -1308,6 +3564,7 @@ void LoraMesher::processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq
         //Add list configuration to the waiting received packets queue
         q_WRP->setInUse();
         q_WRP->Append(listConfig);
+        indexSequence(listConfig);
         q_WRP->releaseInUse();
 
         // Reset the timeout
@@ -1316,13 +3573,18 @@ void LoraMesher::processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq
         // Notify the queueManager that a new sequence has been started
         notifyNewSequenceStarted();
 
+        //Listen to the data channel of the source, only neighbours can use it. If there is another session the ACKs are
+        //sent in the control channel and the source moves the sequence to it after the timeout
+        if (channel != 0 && RoutingTableService::getNextHop(source) == source)
+            ChannelService::startSession(source, seq_id, channel);
+
         //Change the number to send the ack to the correct one
         //cPacket->number in SYNC_P specify the number of packets and it needs to ACK the 0
         sendAckPacket(source, seq_id, 0);
     }
 }
 
-void LoraMesher::processLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num) {
+void LoraMesher::processLostPacket(uint16_t destination, LM_SeqId seq_id, uint16_t seq_num) {
     //Find the list config
     listConfiguration* listConfig = findSequenceList(q_WSP, seq_id, destination);
 
@@ -1342,15 +3604,35 @@ void LoraMesher::processLostPacket(uint16_t destination, uint8_t seq_id, uint16_
     // If the first sync is received but the first ack is not, then the receiver will send a first lost packet.
     listConfig->config->firstAckReceived = 1;
 
+    // The receiver requests the first packet it is missing, all the previous ones have been received
+    if (seq_num > 0 && listConfig->config->lastAck < seq_num - 1)
+        listConfig->config->lastAck = seq_num - 1;
+
+    if (listConfig->config->lastSent < seq_num)
+        listConfig->config->lastSent = seq_num;
+
+    if (listConfig->source != nullptr)
+        deleteAcknowledgedPackets(listConfig);
+
+    RoutingTableService::incLinkCounter(destination, &LinkCounters::lost);
+
     //Send the packet sequence that has been lost
     if (sendPacketSequence(listConfig, seq_num)) {
+        RoutingTableService::incLinkCounter(destination, &LinkCounters::retries);
+
+        RouteNode* node = listConfig->config->node;
+        decreaseCongestionWindow(listConfig->congestionVia, node != nullptr ? node->SRTT : 0, false);
+
         listConfig->config->numberOfTimeouts++;
         //Reset the timeout of this sequence packets inside the q_WSP
         recalculateTimeoutAfterTimeout(listConfig->config);
     }
+
+    //Fill the window again
+    sendPacketSequenceWindow(listConfig);
 }
 
-void LoraMesher::addTimeout(LM_LinkedList<listConfiguration>* queue, uint8_t seq_id, uint16_t source) {
+void LoraMesher::addTimeout(LM_LinkedList<listConfiguration>* queue, LM_SeqId seq_id, uint16_t source) {
     listConfiguration* config = findSequenceList(q_WSP, seq_id, source);
     if (config == nullptr) {
         ESP_LOGE(LM_TAG, "NOT FOUND the sequence packet config in add timeout with Seq_id: %d, Source: %d", seq_id, source);
@@ -1416,11 +3698,52 @@ void LoraMesher::clearLinkedList(listConfiguration* listConfig) {
         list->DeleteCurrent();
     }
 
+    //The sequence has not been completed
+    if (listConfig->sink != nullptr)
+        listConfig->sink->onSequenceEnd(listConfig->config->source, listConfig->config->seq_id, listConfig->sinkPayloadSize, false);
+
+    if (listConfig->source != nullptr)
+        listConfig->source->onSequenceEnd(listConfig->config->source, listConfig->config->seq_id, false);
+
+    sequenceTimeouts->remove(listConfig->config);
+    unindexSequence(listConfig);
+    releaseCongestionWindow(listConfig);
+
+    //The receiver keeps the data channel to send the last ACK
+    bool linger = listConfig->config->queueType == QueueType::WRP;
+    if (ChannelService::endSession(listConfig->config->source, listConfig->config->seq_id, linger) && !linger)
+        xTaskNotify(SendData_TaskHandle, 0, eSetValueWithOverwrite);
+
+    if (listConfig->parityList != nullptr) {
+        listConfig->parityList->setInUse();
+        while (listConfig->parityList->moveToStart())
+            PacketQueueService::deleteQueuePacketAndPacket(listConfig->parityList->Pop());
+        listConfig->parityList->releaseInUse();
+
+        delete listConfig->parityList;
+    }
+
     delete list;
+    delete listConfig->appPacket;
+    delete[] listConfig->fecParity;
     delete listConfig->config;
     delete listConfig;
 }
 
+void LoraMesher::setSequenceChannel(listConfiguration* listConfig, uint8_t channel) {
+    LM_LinkedList<QueuePacket<ControlPacket>>* list = listConfig->list;
+    list->setInUse();
+
+    //The SYNC packet is the first one until it is acknowledged
+    if (list->moveToStart()) {
+        ControlPacket* sync = list->getCurrent()->packet;
+        if (PacketService::isSyncPacket(sync->type) && PacketService::getPacketPayloadLength(sync) > 0)
+            sync->payload[0] = channel;
+    }
+
+    list->releaseInUse();
+}
+
 void LoraMesher::findAndClearLinkedList(LM_LinkedList<listConfiguration>* queue, listConfiguration* listConfig) {
     queue->setInUse();
 
@@ -1436,96 +3759,149 @@ void LoraMesher::findAndClearLinkedList(LM_LinkedList<listConfiguration>* queue,
     queue->releaseInUse();
 }
 
-LoraMesher::listConfiguration* LoraMesher::findSequenceList(LM_LinkedList<listConfiguration>* queue, uint8_t seq_id, uint16_t source) {
+LoraMesher::listConfiguration* LoraMesher::findSequenceList(LM_LinkedList<listConfiguration>* queue, LM_SeqId seq_id, uint16_t source) {
+    QueueType type = queue == q_WRP ? QueueType::WRP : queue == q_WSP ? QueueType::WSP : QueueType::WMP;
+
+    //The sequences of the address are linked inside the index, there is no need to scan the queue
+    portENTER_CRITICAL(&sequencesIndexMux);
+
+    listConfiguration* current = sequencesIndex->Find(source);
+    while (current != nullptr && (current->config->seq_id != seq_id || current->config->queueType != type))
+        current = current->nextOfAddress;
+
+    bool scan = current == nullptr && unindexedSequences > 0;
+
+    portEXIT_CRITICAL(&sequencesIndexMux);
+
+    if (!scan)
+        return current;
+
+    //The index was full when the sequence was added
     queue->setInUse();
 
     if (queue->moveToStart()) {
         do {
-            listConfiguration* current = queue->getCurrent();
-
-            if (current->config->seq_id == seq_id && current->config->source == source) {
-                queue->releaseInUse();
-                return current;
+            if (queue->getCurrent()->config->seq_id == seq_id && queue->getCurrent()->config->source == source) {
+                current = queue->getCurrent();
+                break;
             }
-
         } while (queue->next());
     }
 
     queue->releaseInUse();
 
-    return nullptr;
-
-}
-
-void LoraMesher::managerReceivedQueue() {
-    managerTimeouts(q_WRP, QueueType::WRP);
+    return current;
 }
 
-void LoraMesher::managerSendQueue() {
-    managerTimeouts(q_WSP, QueueType::WSP);
-}
+void LoraMesher::managerTimeouts() {
+    sequencePacketConfig* configPacket;
 
-void LoraMesher::managerTimeouts(LM_LinkedList<listConfiguration>* queue, QueueType type) {
-    String queueName;
-    if (type == QueueType::WRP) {
-        queueName = F("Waiting Received Queue");
-    }
-    else {
-        queueName = F("Waiting Send Queue");
-    }
+    while ((configPacket = sequenceTimeouts->popExpired(millis())) != nullptr) {
+        QueueType type = configPacket->queueType;
+        LM_LinkedList<listConfiguration>* queue = getSequenceQueue(type);
 
-    ESP_LOGV(LM_TAG, "Checking %s timeouts. Open connections %d", queueName.c_str(), queue->getLength());
+        String queueName;
+        if (type == QueueType::WRP) {
+            queueName = F("Waiting Received Queue");
+        }
+        else if (type == QueueType::WSP) {
+            queueName = F("Waiting Send Queue");
+        }
+        else {
+            queueName = F("Waiting Multicast Queue");
+        }
 
-    queue->setInUse();
+        queue->setInUse();
 
-    if (queue->moveToStart()) {
-        do {
-            listConfiguration* current = queue->getCurrent();
-
-            // Get Config packet
-            sequencePacketConfig* configPacket = current->config;
-
-            // If Config packet has reached timeout
-            if (configPacket->timeout < millis()) {
-                // Increment number of timeouts
-                configPacket->numberOfTimeouts++;
-
-                // Description of the timeout:
-                // The number of the packet would be the following: 
-                // If it is a sender it starts from 0 to n + 1 packets, that includes the sync packet: If num = 0, it is that the sync packet has been lost, if num > 0, it is that the packet num - 1 has been lost
-                // For the the receiver it starts from 0 to n packets
-                ESP_LOGW(LM_TAG, "%s timeout reached, Src: %X, Seq_Id: %d, Num: %d, N.TimeOuts %d",
-                    queueName.c_str(), configPacket->source, configPacket->seq_id, configPacket->lastAck + configPacket->firstAckReceived, configPacket->numberOfTimeouts);
-
-                // If number of timeouts is greater than Max timeouts, erase it
-                if (configPacket->numberOfTimeouts >= MAX_TIMEOUTS) {
-                    ESP_LOGE(LM_TAG, "%s, MAX TIMEOUTS reached, erasing Id: %d", queueName.c_str(), configPacket->seq_id);
-                    clearLinkedList(current);
-                    queue->DeleteCurrent();
-                    continue;
+        // Find the sequence of the timeout
+        listConfiguration* current = nullptr;
+        if (queue->moveToStart()) {
+            do {
+                if (queue->getCurrent()->config == configPacket) {
+                    current = queue->getCurrent();
+                    break;
                 }
+            } while (queue->next());
+        }
+
+        if (current == nullptr) {
+            ESP_LOGW(LM_TAG, "%s timeout of a sequence not found", queueName.c_str());
+            queue->releaseInUse();
+            continue;
+        }
+
+        // The multicast sequences have their own timeouts, without RTT nor data channels
+        if (type == QueueType::WMP) {
+            if (!manageMulticastTimeout(current)) {
+                clearLinkedList(current);
+                queue->DeleteCurrent();
+            }
+
+            queue->releaseInUse();
+            continue;
+        }
+
+        // The payload is not useful anymore, the destination discards the incomplete sequence by its timeouts
+        if (configPacket->deadline != 0 && (long) (millis() - configPacket->deadline) >= 0) {
+            ESP_LOGW(LM_TAG, "%s deadline reached, erasing Id: %d", queueName.c_str(), configPacket->seq_id);
+            incDeadlineDrops();
+
+            clearLinkedList(current);
+            queue->DeleteCurrent();
+            queue->releaseInUse();
+            continue;
+        }
+
+        // Increment number of timeouts
+        configPacket->numberOfTimeouts++;
+
+        // The data channel is not reliable, the rest of the sequence continues in the control channel
+        if (ChannelService::endSession(configPacket->source, configPacket->seq_id)) {
+            if (type == QueueType::WSP)
+                setSequenceChannel(current, 0);
+
+            xTaskNotify(SendData_TaskHandle, 0, eSetValueWithOverwrite);
+        }
+
+        // Description of the timeout:
+        // The number of the packet would be the following: 
+        // If it is a sender it starts from 0 to n + 1 packets, that includes the sync packet: If num = 0, it is that the sync packet has been lost, if num > 0, it is that the packet num - 1 has been lost
+        // For the the receiver it starts from 0 to n packets
+        ESP_LOGW(LM_TAG, "%s timeout reached, Src: %X, Seq_Id: %d, Num: %d, N.TimeOuts %d",
+            queueName.c_str(), configPacket->source, configPacket->seq_id, configPacket->lastAck + configPacket->firstAckReceived, configPacket->numberOfTimeouts);
+
+        // If number of timeouts is greater than Max timeouts, erase it
+        if (configPacket->numberOfTimeouts >= MAX_TIMEOUTS) {
+            ESP_LOGE(LM_TAG, "%s, MAX TIMEOUTS reached, erasing Id: %d", queueName.c_str(), configPacket->seq_id);
+            if (type == QueueType::WSP)
+                RoutingTableService::incLinkCounter(configPacket->source, &LinkCounters::lost);
+
+            clearLinkedList(current);
+            queue->DeleteCurrent();
+            queue->releaseInUse();
+            continue;
+        }
 
-                // Recalculate the timeout
-                recalculateTimeoutAfterTimeout(configPacket);
+        // Nothing has been acknowledged during a whole timeout, the window of the next hop starts again
+        if (type == QueueType::WSP)
+            decreaseCongestionWindow(current->congestionVia, 0, true);
 
-                if (type == QueueType::WRP) {
-                    // Send Last ACK + 1 (Request this packet)
-                    sendLostPacket(configPacket->source, configPacket->seq_id, configPacket->lastAck + 1);
-                }
-                else {
-                    // Repeat the configPacket ACK
-                    if (configPacket->firstAckReceived == 0)
-                        // Send the first packet of the sequence (SYNC packet)
-                        sendPacketSequence(current, 0);
-                }
-            }
+        // Recalculate the timeout
+        recalculateTimeoutAfterTimeout(configPacket);
 
-            vTaskDelay(1);
+        if (type == QueueType::WRP) {
+            // Request Last ACK + 1 and the other missing packets
+            sendSackPacket(current);
+        }
+        else {
+            // Repeat the configPacket ACK
+            if (configPacket->firstAckReceived == 0 && sendPacketSequence(current, 0))
+                // The first packet of the sequence (SYNC packet) has been sent again
+                RoutingTableService::incLinkCounter(configPacket->source, &LinkCounters::retries);
+        }
 
-        } while (queue->next());
+        queue->releaseInUse();
     }
-
-    queue->releaseInUse();
 }
 
 unsigned long LoraMesher::getMaximumTimeout(sequencePacketConfig* configPacket) {
@@ -1534,7 +3910,7 @@ unsigned long LoraMesher::getMaximumTimeout(sequencePacketConfig* configPacket)
         return 50000;
     }
 
-    uint8_t hops = configPacket->node->networkNode.metric;
+    uint8_t hops = RoutingTableService::getNumberOfHops(configPacket->node);
     if (hops == 0) {
         ESP_LOGE(LM_TAG, "Find next hop in add timeout");
         return 50000;
@@ -1560,7 +3936,7 @@ unsigned long LoraMesher::calculateTimeout(sequencePacketConfig* configPacket) {
         return MIN_TIMEOUT * 1000;
     }
 
-    uint8_t hops = configPacket->node->networkNode.metric;
+    uint8_t hops = RoutingTableService::getNumberOfHops(configPacket->node);
     if (hops == 0) {
         ESP_LOGE(LM_TAG, "Find next hop in add timeout");
         return MIN_TIMEOUT * 1000;
@@ -1605,6 +3981,18 @@ void LoraMesher::addTimeout(sequencePacketConfig* configPacket) {
     configPacket->previousTimeout = timeout;
 
     ESP_LOGV(LM_TAG, "Timeout set to %u s for addr %X", (unsigned int)(timeout / 1000), configPacket->source);
+
+    scheduleTimeout(configPacket);
+}
+
+void LoraMesher::scheduleTimeout(sequencePacketConfig* configPacket) {
+    // The sequence is cancelled at its deadline
+    if (configPacket->deadline != 0 && (long) (configPacket->timeout - configPacket->deadline) > 0)
+        configPacket->timeout = configPacket->deadline;
+
+    if (sequenceTimeouts->update(configPacket) && QueueManager_TaskHandle)
+        // The queue manager could be sleeping until a later timeout
+        xTaskNotifyGive(QueueManager_TaskHandle);
 }
 
 void LoraMesher::recalculateTimeoutAfterTimeout(sequencePacketConfig* configPacket) {
@@ -1623,8 +4011,14 @@ void LoraMesher::recalculateTimeoutAfterTimeout(sequencePacketConfig* configPack
             (unsigned int)configPacket->previousTimeout, (unsigned int)backoffTimeout, configPacket->source);
     }
 
-    // Add congestion factor based on queue length (2 seconds per queued packet)
+    // Add congestion factor based on queue length (2 seconds per queued packet), or twice the smoothed time that
+    // the packets wait inside the send queue when the window of the next hop measures it
     unsigned long congestionFactor = ToSendPackets->getLength() * 2000;
+    if (loraMesherConfig->congestionControl && configPacket->queueType == QueueType::WSP) {
+        RouteNode* neighbour = RoutingTableService::findNode(RoutingTableService::getNextHop(configPacket->source));
+        if (neighbour != nullptr && neighbour->congestion.size > 0)
+            congestionFactor = neighbour->congestion.queueDelay * 2UL;
+    }
     timeout += congestionFactor;
 
     unsigned long maxTimeout = getMaximumTimeout(configPacket);
@@ -1651,18 +4045,13 @@ void LoraMesher::recalculateTimeoutAfterTimeout(sequencePacketConfig* configPack
 
     ESP_LOGV(LM_TAG, "Timeout recalculated to %u s (after %d timeouts) for addr %X",
         (unsigned int)(timeout / 1000), configPacket->numberOfTimeouts, configPacket->source);
-}
 
-uint8_t LoraMesher::getSequenceId() {
-    if (sequence_id == 255) {
-        sequence_id = 0;
-        return 255;
-    }
-
-    uint8_t seqId = sequence_id;
-    sequence_id++;
+    scheduleTimeout(configPacket);
+}
 
-    return seqId;
+LM_SeqId LoraMesher::getSequenceId() {
+    //It wraps around after the last id
+    return sequence_id++;
 }
 
 /**
@@ -1670,54 +4059,545 @@ uint8_t LoraMesher::getSequenceId() {
  */
 
 
-bool LoraMesher::isDuplicatePacket(Packet<uint8_t>* p) {
-    ToSendPackets->setInUse();
+/**
+ * Multicast sequences
+ */
 
-    if (ToSendPackets->moveToStart()) {
+LM_SendStatus LoraMesher::sendMulticastSequence(uint16_t group, const uint8_t* payload, uint32_t payloadSize, bool compressed) {
+    ESP_LOGV(LM_TAG, "Sending multicast payload with %d bytes to group %X", (int)payloadSize, group);
+
+    //Max payload size per packet
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(MC_DATA_P);
+
+    //Number of packets
+    uint32_t numOfPackets = payloadSize / maxPayloadSize + (payloadSize % maxPayloadSize > 0);
+    if (numOfPackets > UINT16_MAX) {
+        ESP_LOGE(LM_TAG, "Payload too large to be sent multicast, %d bytes", (int)payloadSize);
+        return LM_SendStatus::INVALID;
+    }
+
+    //Generate a sequence Id for this list of packets
+    LM_SeqId seq_id = getSequenceId();
+    uint16_t localAddress = getLocalAddress();
+
+    //Create a new Linked list to store the QueuePackets, they are kept to repair the neighbours
+    LM_LinkedList<QueuePacket<ControlPacket>>* packetList = new LM_LinkedList<QueuePacket<ControlPacket>>();
+
+    //Add the SYNC packet with the number of packets
+    uint8_t syncType = compressed ? MC_SYNC_P | COMPRESSED_P : MC_SYNC_P;
+    ControlPacket* sync = PacketService::createEmptyControlPacket(group, localAddress, syncType, seq_id, numOfPackets);
+    if (sync == nullptr) {
+        ESP_LOGE(LM_TAG, "Multicast sequence not sent, the SYNC packet could not be created");
+        delete packetList;
+        return LM_SendStatus::NO_MEMORY;
+    }
+
+    packetList->Append(PacketQueueService::createQueuePacket(sync, DEFAULT_PRIORITY, 0));
+
+    //The counter is wider than the number of packets, it cannot wrap around at the last one
+    for (uint32_t i = 1; i <= numOfPackets; i++) {
+        //Get the position of the payload
+        const uint8_t* payloadToSend = payload + (i - 1) * maxPayloadSize;
+
+        //Get the payload Size in bytes
+        size_t payloadSizeToSend = maxPayloadSize;
+        if (i == numOfPackets)
+            payloadSizeToSend = payloadSize - (maxPayloadSize * (numOfPackets - 1));
+
+        //Create a new packet with the previous payload and the space to encrypt it
+        ControlPacket* cPacket = PacketService::createControlPacket(group, localAddress, MC_DATA_P, nullptr, payloadSizeToSend + CryptoService::getOverhead(MC_DATA_P));
+        if (cPacket != nullptr) {
+            memcpy(cPacket->payload, payloadToSend, payloadSizeToSend);
+            cPacket->number = i;
+            cPacket->seq_id = seq_id;
+        }
+
+        if (cPacket == nullptr || !CryptoService::encryptPacket(reinterpret_cast<Packet<uint8_t>*>(cPacket))) {
+            ESP_LOGE(LM_TAG, "Multicast sequence not sent, packet %d could not be created or encrypted", (int)i);
+            if (cPacket != nullptr)
+                deletePacket(reinterpret_cast<Packet<uint8_t>*>(cPacket));
+
+            packetList->setInUse();
+            while (packetList->moveToStart())
+                PacketQueueService::deleteQueuePacketAndPacket(packetList->Pop());
+            packetList->releaseInUse();
+
+            delete packetList;
+            return LM_SendStatus::NO_MEMORY;
+        }
+
+        packetList->Append(PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY, i));
+    }
+
+    //Create the pair of configuration, the sender has all the packets
+    listConfiguration* listConfig = new listConfiguration();
+    listConfig->config = new sequencePacketConfig(seq_id, localAddress, numOfPackets, nullptr);
+    listConfig->config->queueType = QueueType::WMP;
+    listConfig->list = packetList;
+    listConfig->compressed = compressed;
+    listConfig->group = group;
+    listConfig->complete = true;
+
+    q_WMP->setInUse();
+    q_WMP->Append(listConfig);
+    indexSequence(listConfig);
+    q_WMP->releaseInUse();
+
+    setMulticastTimeout(listConfig->config, LM_MULTICAST_LINGER);
+
+    //Every packet is sent once, the missing ones are requested by the neighbours
+    packetList->setInUse();
+    if (packetList->moveToStart()) {
         do {
-            Packet<uint8_t>* current = ToSendPackets->getCurrent()->packet;
+            transmitMulticastPacket(packetList->getCurrent());
+        } while (packetList->next());
+    }
+    packetList->releaseInUse();
 
-            if (current->src == p->src && current->dst == p->dst && current->type == p->type &&
-                memcmp(current->payload, p->payload, p->packetSize - sizeof(Packet<uint8_t>)) == 0) {
-                ToSendPackets->releaseInUse();
-                return true;
-            }
+    // Notify the queueManager that a new sequence has been started
+    notifyNewSequenceStarted();
 
-        } while (ToSendPackets->next());
+    return LM_SendStatus::OK;
+}
+
+void LoraMesher::transmitMulticastPacket(QueuePacket<ControlPacket>* pq) {
+    //The neighbours request the missing packets to the last node that has sent them
+    pq->packet->via = getLocalAddress();
+
+    //The SYNC goes before the packets of the sequence
+    uint8_t priority = PacketService::isSyncPacket(pq->packet->type) ? DEFAULT_PRIORITY + 1 : DEFAULT_PRIORITY;
+
+    //Share the packet with the send queue, the buffer is only copied if it is not inside the packet pool
+    setPackedForSend(PacketService::sharePacket(pq->packet, pq->packet->getPacketLength()), priority);
+}
+
+void LoraMesher::processMulticastPacket(QueuePacket<ControlPacket>* pq) {
+    ControlPacket* cPacket = pq->packet;
+    uint16_t source = cPacket->src;
+    bool isSync = PacketService::isSyncPacket(cPacket->type);
+
+    //The packets sent by this node come back from the relays
+    if (source == getLocalAddress()) {
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
     }
 
-    ToSendPackets->releaseInUse();
+    listConfiguration* listConfig = findSequenceList(q_WMP, cPacket->seq_id, source);
 
-    return false;
+    if (listConfig == nullptr) {
+        if (q_WMP->getLength() >= LM_MULTICAST_MAX_SEQUENCES) {
+            ESP_LOGW(LM_TAG, "Multicast packet from %X not stored, too many multicast sequences", source);
+            PacketQueueService::deleteQueuePacketAndPacket(pq);
+            return;
+        }
+
+        //The number of packets is known with the SYNC packet, it could arrive after the others
+        listConfig = new listConfiguration();
+        listConfig->config = new sequencePacketConfig(cPacket->seq_id, source, 0, nullptr);
+        listConfig->config->queueType = QueueType::WMP;
+        listConfig->list = new LM_LinkedList<QueuePacket<ControlPacket>>();
+        listConfig->group = cPacket->dst;
+
+        q_WMP->setInUse();
+        q_WMP->Append(listConfig);
+        indexSequence(listConfig);
+        q_WMP->releaseInUse();
+
+        // Notify the queueManager that a new sequence has been started
+        notifyNewSequenceStarted();
+    }
+
+    sequencePacketConfig* config = listConfig->config;
+
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(MC_DATA_P);
+    size_t payloadSize = PacketService::getPacketPayloadLength(cPacket);
+    size_t overhead = CryptoService::getOverhead(cPacket->type);
+
+    bool valid = isSync ? cPacket->number > 0 :
+        cPacket->number > 0 && (config->number == 0 || cPacket->number <= config->number) &&
+        payloadSize >= overhead && payloadSize - overhead <= maxPayloadSize;
+
+    if (!valid) {
+        ESP_LOGE(LM_TAG, "Wrong multicast packet in seq_Id: %d, Src: %X, received: %d", cPacket->seq_id, source, cPacket->number);
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
+
+    //The SYNC is the packet 0 of the list
+    pq->number = isSync ? 0 : cPacket->number;
+
+    if (!PacketQueueService::addOrderedByNumber(listConfig->list, pq)) {
+        ESP_LOGV(LM_TAG, "Repeated multicast packet in seq_Id: %d, Src: %X, received: %d", cPacket->seq_id, source, pq->number);
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
+
+    if (isSync) {
+        config->number = cPacket->number;
+        listConfig->compressed = PacketService::isCompressedPacket(cPacket->type);
+    }
+
+    //The missing packets are requested through the reverse path, the next hop is closer to the source
+    uint16_t nextHop = RoutingTableService::getNextHop(source);
+    listConfig->upstream = nextHop != 0 ? nextHop : cPacket->via;
+
+    //Forward it once. If all the routes are through the neighbour that has sent it, the other nodes have received it from it
+    if (RoutingTableService::hasRouteNotVia(cPacket->via))
+        transmitMulticastPacket(pq);
+
+    if (config->number > 0 && listConfig->list->getLength() == config->number + 1u) {
+        ESP_LOGV(LM_TAG, "Multicast sequence complete, seq_Id: %d, Src: %X", config->seq_id, source);
+        listConfig->complete = true;
+
+        if (isGroupMember(listConfig->group))
+            deliverMulticastPayload(listConfig);
+
+        setMulticastTimeout(config, LM_MULTICAST_LINGER);
+        return;
+    }
+
+    //Wait for the following packets before requesting the missing ones. The jitter avoids that all the neighbours send it at once
+    config->numberOfTimeouts = 0;
+    setMulticastTimeout(config, LM_MULTICAST_NACK_TIMEOUT + random(0, LM_MULTICAST_NACK_TIMEOUT / 4));
 }
 
-void LoraMesher::removeNodeFromQSPandQWP(uint16_t address) {
-    q_WRP->setInUse();
-    if (q_WRP->moveToStart()) {
+void LoraMesher::sendMulticastNack(listConfiguration* listConfig) {
+    sequencePacketConfig* config = listConfig->config;
+
+    if (listConfig->upstream == 0)
+        return;
+
+    //The payload is the source of the sequence and the bitmap of the missing packets after the first one
+    uint8_t payload[sizeof(uint16_t) + LM_SACK_BITMAP_SIZE] = { 0 };
+    memcpy(payload, &config->source, sizeof(uint16_t));
+
+    uint8_t* bitmap = payload + sizeof(uint16_t);
+    size_t bitmapSize = 0;
+    const size_t maxBits = LM_SACK_BITMAP_SIZE * 8;
+
+    bool missing = false;
+    uint16_t first = 0;
+    uint32_t expected = 0;
+
+    auto addMissing = [&](uint32_t number) {
+        if (!missing) {
+            missing = true;
+            first = number;
+            return true;
+        }
+
+        size_t bit = number - first - 1;
+        if (bit >= maxBits)
+            return false;
+
+        bitmap[bit / 8] |= 1 << (bit % 8);
+        bitmapSize = bit / 8 + 1;
+        return true;
+    };
+
+    //The list is ordered by number, the gaps are the missing packets. Without the SYNC the last ones are unknown
+    bool full = false;
+    listConfig->list->setInUse();
+    if (listConfig->list->moveToStart()) {
         do {
-            listConfiguration* current = q_WRP->getCurrent();
-            if (current != nullptr && current->config->source == address) {
-                ESP_LOGI(LM_TAG, "Clearing node info from address %X", address);
-                clearLinkedList(current);
-                q_WRP->DeleteCurrent();
+            uint16_t number = listConfig->list->getCurrent()->number;
+            while (!full && expected < number)
+                full = !addMissing(expected++);
+
+            expected = number + 1;
+        } while (!full && listConfig->list->next());
+    }
+    listConfig->list->releaseInUse();
+
+    while (!full && expected <= config->number)
+        full = !addMissing(expected++);
+
+    if (!missing)
+        return;
+
+    ESP_LOGW(LM_TAG, "Missing multicast packets in seq_Id: %d, Src: %X, requesting from: %d to %X", config->seq_id, config->source, first, listConfig->upstream);
+
+    ControlPacket* cPacket = PacketService::createControlPacket(listConfig->upstream, getLocalAddress(), MC_NACK_P, payload, sizeof(uint16_t) + bitmapSize);
+    cPacket->seq_id = config->seq_id;
+    cPacket->number = first;
+
+    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), DEFAULT_PRIORITY + 2);
+}
+
+void LoraMesher::processMulticastNack(ControlPacket* p) {
+    size_t payloadSize = PacketService::getPacketPayloadLength(p);
+    if (payloadSize < sizeof(uint16_t)) {
+        ESP_LOGW(LM_TAG, "Malformed multicast NACK from %X", p->src);
+        return;
+    }
+
+    uint16_t source;
+    memcpy(&source, p->payload, sizeof(uint16_t));
+
+    const uint8_t* bitmap = p->payload + sizeof(uint16_t);
+    size_t maxBits = std::min<size_t>(payloadSize - sizeof(uint16_t), LM_SACK_BITMAP_SIZE) * 8;
+
+    listConfiguration* listConfig = findSequenceList(q_WMP, p->seq_id, source);
+    if (listConfig == nullptr) {
+        ESP_LOGW(LM_TAG, "Multicast NACK of a sequence not found, seq_Id: %d, Src: %X", p->seq_id, source);
+        return;
+    }
+
+    size_t resent = 0;
+
+    //Send again the first packet and the ones of the bitmap that are stored
+    listConfig->list->setInUse();
+    if (listConfig->list->moveToStart()) {
+        do {
+            QueuePacket<ControlPacket>* current = listConfig->list->getCurrent();
+            if (current->number < p->number)
                 continue;
+
+            size_t bit = current->number - p->number - 1;
+            if (current->number != p->number && bit >= maxBits)
+                break;
+
+            if (current->number == p->number || (bitmap[bit / 8] & (1 << (bit % 8)))) {
+                transmitMulticastPacket(current);
+                resent++;
             }
-        } while (q_WRP->next());
+        } while (listConfig->list->next());
     }
+    listConfig->list->releaseInUse();
 
-    q_WRP->releaseInUse();
+    ESP_LOGV(LM_TAG, "Multicast NACK from %X, %d packets sent again", p->src, (int)resent);
 
-    q_WSP->setInUse();
-    if (q_WSP->moveToStart()) {
+    //Keep the packets while the neighbours are repairing the sequence
+    if (listConfig->complete)
+        setMulticastTimeout(listConfig->config, LM_MULTICAST_LINGER);
+
+    if (resent > 0)
+        RoutingTableService::incLinkCounter(p->src, &LinkCounters::retries);
+}
+
+void LoraMesher::deliverMulticastPayload(listConfiguration* listConfig) {
+    sequencePacketConfig* config = listConfig->config;
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(MC_DATA_P);
+
+    AppPacket<uint8_t>* appPacket = static_cast<AppPacket<uint8_t>*>(PacketPoolService::allocatePayload(sizeof(AppPacket<uint8_t>) + config->number * maxPayloadSize));
+    if (appPacket == nullptr) {
+        ESP_LOGE(LM_TAG, "Not enough memory to deliver the multicast sequence Seq_id: %d, Number of packets: %d", config->seq_id, config->number);
+        return;
+    }
+
+    appPacket->payloadSize = 0;
+    appPacket->next = nullptr;
+
+    bool delivered = true;
+
+    listConfig->list->setInUse();
+    if (listConfig->list->moveToStart()) {
         do {
-            listConfiguration* current = q_WSP->getCurrent();
-            if (current != nullptr && current->config->source == address) {
-                ESP_LOGI(LM_TAG, "Clearing node info from address %X", address);
-                clearLinkedList(current);
-                q_WSP->DeleteCurrent();
+            ControlPacket* cPacket = listConfig->list->getCurrent()->packet;
+            if (PacketService::isSyncPacket(cPacket->type))
                 continue;
+
+            //The stored packet is forwarded encrypted, a copy is decrypted
+            size_t packetLength = cPacket->getPacketLength();
+            uint8_t* buffer = static_cast<uint8_t*>(PacketPoolService::allocate(packetLength));
+            if (buffer == nullptr) {
+                delivered = false;
+                break;
             }
-        } while (q_WSP->next());
+
+            memcpy(buffer, reinterpret_cast<uint8_t*>(cPacket), packetLength);
+            Packet<uint8_t>* copy = reinterpret_cast<Packet<uint8_t>*>(buffer);
+
+            if (!CryptoService::decryptPacket(copy)) {
+                incDecryptionFailed();
+                PacketPoolService::release(copy);
+                delivered = false;
+                break;
+            }
+
+            ControlPacket* decrypted = reinterpret_cast<ControlPacket*>(copy);
+            size_t payloadSize = PacketService::getPacketPayloadLength(decrypted);
+            memcpy(appPacket->payload + appPacket->payloadSize, decrypted->payload, payloadSize);
+            appPacket->payloadSize += payloadSize;
+
+            PacketPoolService::release(copy);
+        } while (listConfig->list->next());
     }
-    q_WSP->releaseInUse();
+    listConfig->list->releaseInUse();
+
+    if (!delivered) {
+        ESP_LOGE(LM_TAG, "Multicast sequence not delivered, seq_Id: %d, Src: %X", config->seq_id, config->source);
+        PacketPoolService::releasePayload(appPacket);
+        return;
+    }
+
+    if (listConfig->compressed) {
+        AppPacket<uint8_t>* decompressed = PacketService::createDecompressedAppPacket(listConfig->group, config->source, appPacket->payload, appPacket->payloadSize);
+        PacketPoolService::releasePayload(appPacket);
+
+        if (decompressed == nullptr) {
+            ESP_LOGE(LM_TAG, "Failed to decompress the multicast payload of seq_Id: %d Src: %X", config->seq_id, config->source);
+            return;
+        }
+
+        appPacket = decompressed;
+    }
+
+    appPacket->src = config->source;
+    appPacket->dst = listConfig->group;
+
+    notifyUserReceivedPacket(appPacket);
+}
+
+bool LoraMesher::manageMulticastTimeout(listConfiguration* listConfig) {
+    sequencePacketConfig* config = listConfig->config;
+
+    //The neighbours have had time to request the missing packets
+    if (listConfig->complete)
+        return false;
+
+    config->numberOfTimeouts++;
+
+    ESP_LOGW(LM_TAG, "Waiting Multicast Queue timeout reached, Src: %X, Seq_Id: %d, N.TimeOuts %d",
+        config->source, config->seq_id, config->numberOfTimeouts);
+
+    if (config->numberOfTimeouts >= MAX_TIMEOUTS) {
+        ESP_LOGE(LM_TAG, "Waiting Multicast Queue, MAX TIMEOUTS reached, erasing Id: %d", config->seq_id);
+        return false;
+    }
+
+    sendMulticastNack(listConfig);
+
+    //The upstream neighbour could be missing the packets too, it needs time to repair itself. The NACKs are sent
+    //before the upstream neighbour stops lingering, every NACK keeps its packets for another LM_MULTICAST_LINGER
+    unsigned long backoff = (unsigned long)LM_MULTICAST_NACK_TIMEOUT << std::min<uint8_t>(config->numberOfTimeouts, 3);
+    setMulticastTimeout(config, std::min<unsigned long>(backoff, LM_MULTICAST_LINGER / 2));
+
+    return true;
+}
+
+void LoraMesher::setMulticastTimeout(sequencePacketConfig* configPacket, unsigned long timeout) {
+    configPacket->timeout = millis() + timeout;
+    configPacket->previousTimeout = timeout;
+
+    scheduleTimeout(configPacket);
+}
+
+bool LoraMesher::joinGroup(uint16_t group) {
+    if (!PacketService::isGroupAddress(group))
+        return false;
+
+    if (isGroupMember(group))
+        return true;
+
+    for (size_t i = 0; i < LM_MAX_GROUPS; i++) {
+        if (groups[i] == 0) {
+            groups[i] = group;
+            return true;
+        }
+    }
+
+    ESP_LOGW(LM_TAG, "Group %X not joined, maximum number of groups reached", group);
+    return false;
+}
+
+void LoraMesher::leaveGroup(uint16_t group) {
+    for (size_t i = 0; i < LM_MAX_GROUPS; i++) {
+        if (groups[i] == group)
+            groups[i] = 0;
+    }
+}
+
+bool LoraMesher::isGroupMember(uint16_t group) {
+    if (group == BROADCAST_ADDR)
+        return true;
+
+    for (size_t i = 0; i < LM_MAX_GROUPS; i++) {
+        if (groups[i] == group)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * End Multicast sequences
+ */
+
+
+bool LoraMesher::isDuplicatePacket(Packet<uint8_t>* p) {
+    //The key is removed when the packet leaves the send queue, it does not expire while the packet waits
+    return !sendDuplicateCache->add(PacketService::getPacketKey(p, false), 0);
+}
+
+void LoraMesher::removeNodeFromQSPandQWP(uint16_t address) {
+    for (;;) {
+        portENTER_CRITICAL(&sequencesIndexMux);
+        listConfiguration* current = sequencesIndex->Find(address);
+        portEXIT_CRITICAL(&sequencesIndexMux);
+
+        // No more sequences of this address
+        if (current == nullptr)
+            return;
+
+        LM_LinkedList<listConfiguration>* queue = getSequenceQueue(current->config->queueType);
+
+        queue->setInUse();
+
+        // It could have been cleared meanwhile, then it is not inside the index anymore
+        if (queue->Search(current) && current->config->source == address) {
+            ESP_LOGI(LM_TAG, "Clearing node info from address %X", address);
+            clearLinkedList(current);
+            queue->DeleteCurrent();
+        }
+
+        queue->releaseInUse();
+    }
+}
+
+void LoraMesher::indexSequence(listConfiguration* listConfig) {
+    portENTER_CRITICAL(&sequencesIndexMux);
+
+    listConfig->nextOfAddress = sequencesIndex->Find(listConfig->config->source);
+    listConfig->indexed = sequencesIndex->Add(listConfig->config->source, listConfig);
+    if (!listConfig->indexed) {
+        listConfig->nextOfAddress = nullptr;
+        unindexedSequences++;
+    }
+
+    portEXIT_CRITICAL(&sequencesIndexMux);
+}
+
+void LoraMesher::unindexSequence(listConfiguration* listConfig) {
+    uint16_t address = listConfig->config->source;
+
+    portENTER_CRITICAL(&sequencesIndexMux);
+
+    if (!listConfig->indexed) {
+        unindexedSequences--;
+        portEXIT_CRITICAL(&sequencesIndexMux);
+        return;
+    }
+
+    listConfig->indexed = false;
+
+    listConfiguration* current = sequencesIndex->Find(address);
+
+    if (current == listConfig) {
+        if (listConfig->nextOfAddress != nullptr)
+            sequencesIndex->Add(address, listConfig->nextOfAddress);
+        else
+            sequencesIndex->Remove(address);
+    }
+    else {
+        while (current != nullptr && current->nextOfAddress != listConfig)
+            current = current->nextOfAddress;
+
+        if (current != nullptr)
+            current->nextOfAddress = listConfig->nextOfAddress;
+    }
+
+    listConfig->nextOfAddress = nullptr;
+
+    portEXIT_CRITICAL(&sequencesIndexMux);
 }
\ No newline at end of file
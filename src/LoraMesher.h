@@ -7,22 +7,63 @@
 //Actual LoRaMesher Libraries
 #include "BuildOptions.h"
 
+#ifdef LM_HOST_BUILD
+#include "modules/LM_Module.h"
+#else
 #include "modules/LM_Modules.h"
+#endif
 
 #include "utilities/LinkedQueue.hpp"
 
+#include "utilities/IntrusiveList.hpp"
+
+#include "utilities/SPSCRing.hpp"
+
+#include "utilities/PriorityQueue.hpp"
+
+#include "utilities/DeadlineHeap.hpp"
+
+#include "utilities/AddressMap.hpp"
+
+#include "utilities/Parity.hpp"
+
 #include "services/PacketService.h"
 
 #include "services/RoutingTableService.h"
 
 #include "services/PacketQueueService.h"
 
+#include "services/PacketPoolService.h"
+
 #include "services/WiFiService.h"
 
 #include "services/RoleService.h"
 
 #include "services/SimulatorService.h"
 
+#include "services/AirtimeService.h"
+
+#include "services/CryptoService.h"
+
+#include "services/ChannelService.h"
+#include "services/SlotService.h"
+
+#include "services/LatencyService.h"
+
+#include "services/TraceService.h"
+
+#include "services/PersistenceService.h"
+
+#include "entities/stats/StatsSnapshot.h"
+
+#include "entities/stats/TaskStats.h"
+
+#include "entities/stream/SequenceSink.h"
+
+#include "entities/stream/SequenceSource.h"
+
+#include "entities/packets/QoS.h"
+
 /**
  * @brief LoRaMesher Library
  *
@@ -49,6 +90,19 @@ public:
         RFM95_MOD,
     };
 
+    /**
+     * @brief Configuration of a task of LoraMesher
+     *
+     */
+    struct TaskConfig {
+        uint32_t stackSize; // Stack in bytes
+        UBaseType_t priority; // FreeRTOS priority, the radio tasks are above the managers
+        BaseType_t core; // Core where it runs, tskNO_AFFINITY to let FreeRTOS choose it
+
+        TaskConfig(uint32_t stackSize_, UBaseType_t priority_, BaseType_t core_ = LM_TASK_CORE):
+            stackSize(stackSize_), priority(priority_), core(core_) {}
+    };
+
     /**
      * @brief LoRaMesher configuration
      *
@@ -74,9 +128,99 @@ public:
         // In bytes (226 bytes [UE max allowed with SF7 and 125khz])
         // MAX payload size for hello packets = LM_MAX_PACKET_SIZE - 7 bytes of header
         // MAX payload size for data packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via
-        // MAX payload size for reliable and large packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via - 3 of control packet.
+        // MAX payload size for reliable and large packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via - 3 of control packet (4 with LM_SEQUENCE_ID_16BIT).
         // Having different max_packet_size in the same network will cause problems.
         size_t max_packet_size = LM_MAX_PACKET_SIZE;
+        // Number of large payload packets that can be sent without waiting for their ACK. 1 is stop and wait.
+        // The receiver accepts the packets out of order and acknowledges the last consecutive packet received.
+        uint8_t reliableWindowSize = LM_RELIABLE_WINDOW_SIZE;
+        // Milliseconds that an ACK waits inside the send queue before being sent. The ACKs to the same node are coalesced
+        // while they wait, a single ACK packet acknowledges several packets and several sequences. 0 to send it as soon as possible.
+        uint16_t ackDelay = LM_ACK_DELAY;
+        // Send a parity packet after every block of packets of the reliable payloads, the destination rebuilds a lost packet
+        // of every block without waiting for its retransmission. The block is smaller for the destinations with more packets
+        // resent, from LM_FEC_MAX_BLOCK to LM_FEC_MIN_BLOCK packets. All the nodes must support it.
+        bool fec = false;
+        // Share an AIMD congestion window between all the reliable payloads sent through the same next hop. It grows with
+        // the acknowledged packets, the lost packets and the packets delayed inside the send queue decrease it by a quarter
+        // and the timeouts halve it.
+        bool congestionControl = false;
+        // Send the data packets to the neighbours with a compact header of 4 to 8 bytes instead of 9 to 12: short addresses, no size, given
+        // by the radio, no via when it is the destination and the number of the control packets in one byte. The short address is the low
+        // byte of the address, a node advertises in its HELLO packets that it receives them while the low bytes of all the nodes it knows
+        // are unique. All the nodes decode both headers, the nodes of previous versions discard the compact ones.
+        bool compactHeader = false;
+        // Send the HELLO packets with the compact format, more routes fit in every packet.
+        // All the nodes decode both formats, but the nodes of previous versions only the default one. Enable it when all the network is updated.
+        bool compactHello = false;
+        // Limit the airtime to the duty cycle of the EU868 sub-band of the frequency inside a sliding window of one hour.
+        // If false all the frequencies use LM_DUTY_CYCLE.
+        bool regulatoryDutyCycle = false;
+        // Scan the channel with CAD before sending and send as soon as it is free, with an exponential backoff when busy.
+        // If false it waits a random delay of some times the maximum time on air.
+        bool listenBeforeTalk = false;
+        // Send in the control channel only inside the slot of this node, instead of after a random delay or a channel scan. The gateway
+        // with the lowest address in range sends the time reference and the slots inside its HELLO packets, one for itself and one for
+        // each of its neighbours, plus a contention slot for the other nodes. The nodes without beacon keep the random access.
+        // All the nodes must support it.
+        bool slottedAccess = false;
+        // Send the data packets to the same next hop together inside a single aggregated packet.
+        // A data packet waits up to aggregationHoldTime ms for other packets. All the nodes must support it.
+        bool aggregation = false;
+        uint16_t aggregationHoldTime = LM_AGGREGATION_HOLD_TIME;
+        // Flood the data packets sent to a group address, including the broadcast address, to the whole network.
+        // A node forwards a packet once, after a random time of floodInterval ms, if it has not heard floodRedundancy copies
+        // of other nodes meanwhile. All the nodes must have the same configuration.
+        bool flooding = false;
+        uint16_t floodInterval = LM_FLOOD_INTERVAL;
+        uint8_t floodRedundancy = LM_FLOOD_REDUNDANCY;
+        // Compress the payload of the data packets and the reliable payloads when it becomes smaller.
+        // The reliable payload is compressed as a whole before being split. All the nodes must support it.
+        bool compression = false;
+        // AES-128 network key of 16 bytes, the payload of the data packets is encrypted by the source and decrypted by the destination.
+        // It adds LM_ENCRYPTION_COUNTER_SIZE + LM_ENCRYPTION_TAG_SIZE bytes to every packet. nullptr to not encrypt.
+        const uint8_t* networkKey = nullptr;
+        // Adapt the transmission power to every neighbour, keeping LM_ADR_SNR_MARGIN dB over the demodulation floor of the SF.
+        // The HELLO packets include the SNR of the neighbours and are sent at full power. All the nodes must support it.
+        bool adaptiveDataRate = false;
+        // Advertise the load of the gateways inside the HELLO packets, the nodes choose the least loaded of the nearest
+        // gateways with getClosestGateway. All the nodes must support it.
+        bool gatewayLoad = false;
+        // Number of data channels spaced channelSpacing MHz after freq, the control channel. The HELLO, SYNC and broadcast packets
+        // are sent in the control channel, a reliable sequence to a neighbour is moved to a data channel announced in its SYNC packet.
+        // 0 uses only one channel. All the nodes must support it.
+        uint8_t dataChannels = 0;
+        float channelSpacing = LM_CHANNEL_SPACING;
+        // Maximum packets inside the send queue, including the forwarded ones, and payloads waiting to be read by the user. 0 without limit
+        uint16_t sendQueueSize = LM_SEND_QUEUE_SIZE;
+        uint16_t appQueueSize = LM_APP_QUEUE_SIZE;
+        // Maximum reliable sequences being sent and being received at the same time, 0 without limit.
+        // The new sequences are rejected, the ones received are lost by the timeout of the source
+        uint8_t maxSendSequences = LM_MAX_SEND_SEQUENCES;
+        uint8_t maxReceiveSequences = LM_MAX_RECEIVE_SEQUENCES;
+        // Bytes of heap that the packets, outside the packet pools, and the payloads being received or waiting for the user can use.
+        // Over the budget the queues drop packets with the drop policy and the new sequences are rejected. 0 without limit
+        uint32_t heapBudget = LM_HEAP_BUDGET;
+        // Packet dropped when the send queue or the received queue is full or the heap budget has been reached
+        LM_DropPolicy dropPolicy = LM_DropPolicy::LOWEST_PRIORITY;
+        // Persist the routes and the RTT and SNR of the neighbours to NVS, they are restored by begin. They are written every
+        // persistInterval seconds if they have changed and by standby. Arduino initializes NVS, otherwise begin initializes it
+        bool persistRoutes = false;
+        uint32_t persistInterval = LM_PERSIST_INTERVAL;
+        // Tasks of LoraMesher, created by begin
+        TaskConfig receiveTask = TaskConfig(LM_TASK_STACK_SIZE, 6);
+        TaskConfig sendTask = TaskConfig(LM_TASK_STACK_SIZE, 5);
+        TaskConfig helloTask = TaskConfig(LM_TASK_STACK_SIZE, 4);
+        TaskConfig processTask = TaskConfig(LM_TASK_STACK_SIZE, 3);
+        TaskConfig routingTableManagerTask = TaskConfig(LM_TASK_STACK_SIZE, 2);
+        TaskConfig queueManagerTask = TaskConfig(LM_TASK_STACK_SIZE, 2);
+        TaskConfig traceTask = TaskConfig(LM_TRACE_TASK_STACK_SIZE, 1);
+        // Radio module created by the application, it replaces the module selected by module and LoraMesher deletes it.
+        // The host build has no hardware modules, it must be set, e.g. to the simulated module.
+        LM_Module* radioModule = nullptr;
+        // Second radio module created by the application, e.g. another SX1262 of a gateway, LoraMesher deletes it. It carries
+        // the sessions in the data channels while radioModule stays in the control channel, it requires dataChannels > 0.
+        LM_Module* dataRadioModule = nullptr;
 #ifdef ARDUINO
         // Custom SPI pins
         SPIClass* spi = nullptr;
@@ -196,28 +340,41 @@ public:
      *
      * @param freq Frequency to be set in MHz
      */
-    void setFrequency(float freq) { radio->setFrequency(freq); recalculateMaxTimeOnAir(); }
+    void setFrequency(float freq);
 
     /**
      * @brief Sets LoRa bandwidth. Allowed values are 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125, 250 and 500 kHz.
      *
      * @param bw LoRa bandwidth to be set in kHz.
      */
-    void setBandwidth(float bw) { radio->setBandwidth(bw); recalculateMaxTimeOnAir(); }
+    void setBandwidth(float bw) {
+        radio->setBandwidth(bw);
+        if (dataRadio != nullptr) dataRadio->setBandwidth(bw);
+        recalculateMaxTimeOnAir();
+    }
 
     /**
      * @brief Sets LoRa spreading factor. Allowed values range from 6 to 12.
      *
      * @param sf LoRa spreading factor to be set.
      */
-    void setSpreadingFactor(uint8_t sf) { radio->setSpreadingFactor(sf); recalculateMaxTimeOnAir(); }
+    void setSpreadingFactor(uint8_t sf) {
+        radio->setSpreadingFactor(sf);
+        if (dataRadio != nullptr) dataRadio->setSpreadingFactor(sf);
+        loraMesherConfig->sf = sf;
+        recalculateMaxTimeOnAir();
+    }
 
     /**
      * @brief Sets LoRa coding rate denominator. Allowed values range from 5 to 8.
      *
      * @param cr LoRa coding rate denominator to be set.
      */
-    void setCodingRate(uint8_t cr) { radio->setCodingRate(cr); recalculateMaxTimeOnAir(); }
+    void setCodingRate(uint8_t cr) {
+        radio->setCodingRate(cr);
+        if (dataRadio != nullptr) dataRadio->setCodingRate(cr);
+        recalculateMaxTimeOnAir();
+    }
 
     /**
      * @brief Sets transmission output power. Allowed values range from -3 to 15 dBm (RFO pin) or +2 to +17 dBm (PA_BOOST pin).
@@ -225,8 +382,9 @@ public:
      *
      * @param power Transmission output power in dBm.
      * @param useRfo Whether to use the RFO (true) or the PA_BOOST (false) pin for the RF output. Defaults to PA_BOOST.
+     * With the adaptive data rate it is the maximum power, used for the HELLO and broadcast packets.
      */
-    void setOutputPower(int8_t power, bool useRfo = false) { radio->setOutputPower(power, useRfo); }
+    void setOutputPower(int8_t power, bool useRfo = false);
 
     /**
      * @brief Set the Receive App Data Task Handle, every time a received packet for this node is detected, this task will be notified.
@@ -235,12 +393,84 @@ public:
      */
     void setReceiveAppDataTaskHandle(TaskHandle_t ReceiveAppDataTaskHandle) { ReceiveAppData_TaskHandle = ReceiveAppDataTaskHandle; }
 
+    /**
+     * @brief Handler of the payloads received for this node, called by the process task with the payload lent.
+     * The payload is only valid until it returns, it must copy the bytes it keeps.
+     *
+     */
+    typedef void (*AppPayloadHandler)(uint16_t src, uint16_t dst, const uint8_t* payload, uint32_t payloadSize);
+
+    /**
+     * @brief Set the handler of the payloads received for this node, instead of the received queue and the Receive App Data Task.
+     * The payloads of the data packets are read inside the received packet, without an AppPacket, the reliable payloads
+     * are read inside the AppPacket where they have been joined. The process task waits for the handler, it must be short.
+     *
+     * @param handler Handler, nullptr to queue the payloads again
+     */
+    void setAppPayloadHandler(AppPayloadHandler handler) { appPayloadHandler = handler; }
+
+    /**
+     * @brief Set the Sequence Sink. The large payloads accepted by the sink are delivered to it in chunks while they
+     * are received, instead of being joined into an AppPacket. The sink must be valid until it is replaced.
+     *
+     * @param sink Sequence sink, nullptr to receive all the large payloads as AppPackets
+     */
+    void setSequenceSink(SequenceSink* sink) { sequenceSink = sink; }
+
+    /**
+     * @brief Handler of a user packet type, called by the process task with the packet, its RSSI and its SNR.
+     * The packet is deleted after it returns.
+     *
+     */
+    typedef void (*PacketHandler)(Packet<uint8_t>* packet, int8_t rssi, int8_t snr);
+
+    /**
+     * @brief Set the handler of a user packet type, a type without the DATA_P and HELLO_P bits. The received packets
+     * of the type sent to this node or to the broadcast address are given to it. It must be set before start.
+     *
+     * @param type Packet type
+     * @param handler Handler, nullptr to remove it
+     * @return true If it has been set
+     * @return false If the type is used by LoraMesher or there are LM_MAX_PACKET_HANDLERS handlers
+     */
+    bool setPacketHandler(uint8_t type, PacketHandler handler);
+
+    /**
+     * @brief Set the Link Metric used to select the routes, the hop count by default. The LoRaMesher takes the ownership
+     * of the metric. All the nodes of the network must use the same link metric, e.g. new EtxLinkMetric(config.sf)
+     *
+     * @param metric Link metric, nullptr to use the hop count
+     */
+    void setLinkMetric(LinkMetric* metric) { RoutingTableService::setLinkMetric(metric); }
+
     /**
      * @brief A copy of the routing table list. Delete it after using the list.
+     * The list shares the nodes of the routing table, they are deleted when the routes expire.
+     * Use getRoutingTable or forEachRoute instead.
      *
      */
     LM_LinkedList<RouteNode>* routingTableListCopy() { return new LM_LinkedList<RouteNode>(*RoutingTableService::routingTableList); }
 
+    /**
+     * @brief Copy the routing table into the array, without allocating memory. The copies remain valid when the routes expire.
+     *
+     * @param nodes Array where the routes are written
+     * @param maxNodes Size of the array
+     * @param first Position of the first route copied, to copy the routing table in parts
+     * @return size_t Number of routes written
+     */
+    size_t getRoutingTable(RouteNode* nodes, size_t maxNodes, size_t first = 0) { return RoutingTableService::getRouteNodes(nodes, maxNodes, first); }
+
+    /**
+     * @brief Call the visitor with every route of the routing table. The routing table is locked during the whole iteration,
+     * the visitor must not call the functions of LoraMesher nor keep the pointers after returning.
+     *
+     * @tparam Visitor Callable with a const RouteNode*
+     * @param visitor Visitor
+     */
+    template <typename Visitor>
+    void forEachRoute(Visitor visitor) { RoutingTableService::forEachNode(visitor); }
+
     /**
      * @brief Send a Packet
      * This function will create a DataPacket with the payload and destination address, and set it to the send queue.
@@ -249,19 +479,21 @@ public:
      * @param dst Destination address
      * @param payload Payload to send
      * @param payloadSize Payload size to be send in Bytes
+     * @param qos Class and max age of the payload
+     * @return LM_SendStatus OK if it has been queued, QUEUE_FULL or NO_MEMORY if the producer has to wait
      */
-    void sendPacket(uint16_t dst, const uint8_t* payload, uint32_t payloadSize) {
+    LM_SendStatus sendPacket(uint16_t dst, const uint8_t* payload, uint32_t payloadSize, const LM_QoS& qos = LM_QoS()) {
         //Cannot send an empty packet
         if (payloadSize == 0)
-            return;
+            return LM_SendStatus::INVALID;
 
         ESP_LOGV(LM_TAG, "Creating a packet for send with %d bytes", payloadSize);
 
-        //Create a data packet with the payload
-        DataPacket* dPacket = PacketService::createDataPacket(dst, getLocalAddress(), DATA_P, payload, payloadSize);
+        //Create a data packet with the payload, compressed if enabled
+        DataPacket* dPacket = createSendDataPacket(dst, payload, payloadSize);
 
         //Create the packet and set it to the send queue
-        setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(dPacket), DEFAULT_PRIORITY);
+        return setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(dPacket), qos.getPriority(), qos.maxAge, qos.demote);
     }
 
     /**
@@ -271,34 +503,59 @@ public:
      * @param dst Destination
      * @param payload Payload of type T
      * @param payloadSize Length of the payload in T
+     * @param qos Class and max age of the payload
+     * @return LM_SendStatus OK if it has been queued, QUEUE_FULL or NO_MEMORY if the producer has to wait
      */
     template <typename T>
-    void createPacketAndSend(uint16_t dst, T* payload, uint8_t payloadSize) {
+    LM_SendStatus createPacketAndSend(uint16_t dst, T* payload, uint8_t payloadSize, const LM_QoS& qos = LM_QoS()) {
         //Cannot send an empty packet
         if (payloadSize == 0)
-            return;
+            return LM_SendStatus::INVALID;
 
         //Get the size of the payload in bytes
         size_t payloadSizeInBytes = payloadSize * sizeof(T);
 
         ESP_LOGV(LM_TAG, "Creating a packet for send with %d bytes", payloadSizeInBytes);
 
-        //Create a data packet with the payload
-        DataPacket* dPacket = PacketService::createDataPacket(dst, getLocalAddress(), DATA_P, reinterpret_cast<uint8_t*>(payload), payloadSizeInBytes);
+        //Create a data packet with the payload, compressed if enabled
+        DataPacket* dPacket = createSendDataPacket(dst, reinterpret_cast<uint8_t*>(payload), payloadSizeInBytes);
 
         //Create the packet and set it to the send queue
-        setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(dPacket), DEFAULT_PRIORITY);
+        return setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(dPacket), qos.getPriority(), qos.maxAge, qos.demote);
     }
 
     /**
      * @brief Send the payload reliable.
      * It will wait for an ACK back from the destination to send the next packet.
+     * If the destination is a group address, including the broadcast address, the payload is sent once as a multicast
+     * sequence. Every relay forwards it once and the members request the missing packets to the neighbour that forwarded them.
+     * The QoS sets the priority of the packets of a unicast sequence and the sequence is cancelled if it has not finished
+     * after the max age, the demote option is not used. It is not used by the multicast sequences.
      *
      * @param dst destination address
      * @param payload payload to send
      * @param payloadSize payload size to be send in Bytes
+     * @param qos Class and max age of the payload
+     * @return LM_SendStatus OK if the sequence has been started, QUEUE_FULL if there are maxSendSequences sequences
+     * or NO_MEMORY if the heap budget has been reached
+     */
+    LM_SendStatus sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize, const LM_QoS& qos = LM_QoS());
+
+    /**
+     * @brief Send the payload of a source reliable, without copying it in memory.
+     * The packets are read from the source when the window can send them and deleted when they are acknowledged.
+     * The source must be valid until its onSequenceEnd is called. It cannot be sent to a group address.
+     * The payload is never compressed, it is not available as a whole.
+     *
+     * @param dst destination address
+     * @param source source of the payload to send
+     * @param payloadSize payload size to be send in Bytes
+     * @param qos Class and max age of the payload, like the other reliable payloads
+     * @return LM_SendStatus OK if the sequence has been started, INVALID if the source is empty, the destination is a group
+     * address or the payload is too large, NO_ROUTE if the destination is not inside the routing table, QUEUE_FULL if there are
+     * maxSendSequences sequences or NO_MEMORY if the heap budget has been reached. If it is not OK the source is not used
      */
-    void sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize);
+    LM_SendStatus sendReliablePacket(uint16_t dst, SequenceSource* source, uint32_t payloadSize, const LM_QoS& qos = LM_QoS());
 
     /**
      * @brief Send the payload reliable. It will wait for an ack of the destination.
@@ -307,12 +564,52 @@ public:
      * @param dst Destination
      * @param payload Payload of type T
      * @param payloadSize Length of the payload in T
+     * @param qos Class and max age of the payload
      */
     template <typename T>
-    void sendReliable(uint16_t dst, T* payload, uint32_t payloadSize) {
-        sendReliablePacket(dst, reinterpret_cast<uint8_t*>(payload), sizeof(T) * payloadSize);
+    LM_SendStatus sendReliable(uint16_t dst, T* payload, uint32_t payloadSize, const LM_QoS& qos = LM_QoS()) {
+        return sendReliablePacket(dst, reinterpret_cast<uint8_t*>(payload), sizeof(T) * payloadSize, qos);
     }
 
+    /**
+     * @brief Send a packet of a user packet type to a neighbour or to the broadcast address. It is not routed,
+     * acknowledged nor encrypted, the neighbours receive it with the handler of the type.
+     *
+     * @param dst Neighbour or BROADCAST_ADDR
+     * @param type Packet type without the DATA_P and HELLO_P bits
+     * @param payload Payload
+     * @param payloadSize Payload size in bytes, it must fit inside a packet
+     * @param qos Class and max age of the packet
+     * @return LM_SendStatus OK if it has been queued, INVALID if the type is used by LoraMesher or the payload does not fit
+     */
+    LM_SendStatus sendCustomPacket(uint16_t dst, uint8_t type, const uint8_t* payload, uint8_t payloadSize, const LM_QoS& qos = LM_QoS());
+
+    /**
+     * @brief Join a group, the multicast payloads sent to the group address will be delivered to the user.
+     * All the nodes are members of the broadcast group
+     *
+     * @param group Group address, from LM_GROUP_ADDR_FIRST to BROADCAST_ADDR
+     * @return true If it is a member of the group
+     * @return false If it is not a group address or the node has already joined LM_MAX_GROUPS groups
+     */
+    bool joinGroup(uint16_t group);
+
+    /**
+     * @brief Leave a group, the payloads of the group are still forwarded to the other members
+     *
+     * @param group Group address
+     */
+    void leaveGroup(uint16_t group);
+
+    /**
+     * @brief Returns if the node is a member of the group
+     *
+     * @param group Group address
+     * @return true If it is a member of the group
+     * @return false If not
+     */
+    bool isGroupMember(uint16_t group);
+
     /**
      * @brief Returns the number of packets inside the received packets queue
      *
@@ -338,9 +635,51 @@ public:
         ReceivedAppPackets->setInUse();
         AppPacket<T>* appPacket = reinterpret_cast<AppPacket<T>*>(ReceivedAppPackets->Pop());
         ReceivedAppPackets->releaseInUse();
+
+        if (appPacket != nullptr)
+            LatencyService::record(LatencyStage::APP_QUEUE, appPacket->timestamp);
+
         return appPacket;
     }
 
+    /**
+     * @brief Get the next application packets, all of them are taken from the received queue under a single lock.
+     * They must be deleted with deletePackets or one by one with deletePacket.
+     *
+     * @tparam T Type to be converted
+     * @param packets Array where the packets are written
+     * @param maxPackets Size of the array
+     * @return size_t Number of packets written
+     */
+    template<typename T>
+    size_t getNextAppPackets(AppPacket<T>** packets, size_t maxPackets) {
+        size_t numPackets = 0;
+
+        ReceivedAppPackets->setInUse();
+        while (numPackets < maxPackets && ReceivedAppPackets->getLength() > 0)
+            packets[numPackets++] = reinterpret_cast<AppPacket<T>*>(ReceivedAppPackets->Pop());
+        ReceivedAppPackets->releaseInUse();
+
+        uint32_t now = LatencyService::now();
+        for (size_t i = 0; i < numPackets; i++)
+            LatencyService::record(LatencyStage::APP_QUEUE, packets[i]->timestamp, now);
+
+        return numPackets;
+    }
+
+    /**
+     * @brief Delete the packets returned by getNextAppPackets
+     *
+     * @tparam T Type of packet
+     * @param packets Packets to delete
+     * @param numPackets Number of packets
+     */
+    template <typename T>
+    static void deletePackets(AppPacket<T>** packets, size_t numPackets) {
+        for (size_t i = 0; i < numPackets; i++)
+            PacketPoolService::releasePayload(packets[i]);
+    }
+
     /**
      * @brief Delete the packet from memory
      *
@@ -349,7 +688,7 @@ public:
      */
     template <typename T>
     static void deletePacket(AppPacket<T>* p) {
-        vPortFree(p);
+        PacketPoolService::releasePayload(p);
     }
 
     /**
@@ -367,366 +706,947 @@ public:
      */
     uint16_t getLocalAddress();
 
+    /**
+     * @brief Get a consistent copy of all the counters of the node, with 64-bit values. The getters of every counter
+     * return the lower 32 bits of the same counters.
+     *
+     * @param reset If true the counters are reset to 0 in the same critical section, the next snapshot counts from now
+     * @return StatsSnapshot
+     */
+    StatsSnapshot getStatsSnapshot(bool reset = false);
+
+    /**
+     * @brief Get the minimum free stack of every task since it was created
+     *
+     * @return TaskStats
+     */
+    TaskStats getTaskStats();
+
+    /**
+     * @brief Get the link counters of the neighbours: packets sent, received, retries and losses
+     *
+     * @param neighbourStats Array where the counters are written
+     * @param maxNeighbours Size of the array
+     * @param reset If true the counters returned are reset to 0
+     * @return size_t Number of neighbours written
+     */
+    size_t getNeighbourStats(NeighbourStats* neighbourStats, size_t maxNeighbours, bool reset = false) {
+        return RoutingTableService::getNeighbourStats(neighbourStats, maxNeighbours, reset);
+    }
+
     /**
      * @brief Get the Received Data Packets Num
      *
      * @return uint32_t
      */
-    uint32_t getReceivedDataPacketsNum() { return receivedDataPacketsNum; }
+    uint32_t getReceivedDataPacketsNum() { return getStat(&StatsSnapshot::receivedDataPackets); }
 
     /**
      * @brief Get the Send Packets Num
      *
      * @return uint32_t
      */
-    uint32_t getSendPacketsNum() { return sendPacketsNum; }
+    uint32_t getSendPacketsNum() { return getStat(&StatsSnapshot::sentPackets); }
 
     /**
      * @brief Get the Received Hello Packets Num
      *
      * @return uint32_t
      */
-    uint32_t getReceivedHelloPacketsNum() { return receivedHelloPacketsNum; }
+    uint32_t getReceivedHelloPacketsNum() { return getStat(&StatsSnapshot::receivedHelloPackets); }
 
     /**
      * @brief Get the Sent Hello Packets Num
      *
      * @return uint32_t
      */
-    uint32_t getSentHelloPacketsNum() { return sentHelloPacketsNum; }
+    uint32_t getSentHelloPacketsNum() { return getStat(&StatsSnapshot::sentHelloPackets); }
 
     /**
      * @brief Get the Received Broadcast Packets Num
      *
      * @return uint32_t
      */
-    uint32_t getReceivedBroadcastPacketsNum() { return receivedBroadcastPacketsNum; }
+    uint32_t getReceivedBroadcastPacketsNum() { return getStat(&StatsSnapshot::receivedBroadcastPackets); }
 
     /**
      * @brief Get the Received Broadcast Packets Num
      *
      * @return uint32_t
      */
-    uint32_t getForwardedPacketsNum() { return forwardedPacketsNum; }
+    uint32_t getForwardedPacketsNum() { return getStat(&StatsSnapshot::forwardedPackets); }
 
     /**
      * @brief Get the Data Packets For Me Num
      *
      * @return uint32_t
      */
-    uint32_t getDataPacketsForMeNum() { return dataPacketForMeNum; }
+    uint32_t getDataPacketsForMeNum() { return getStat(&StatsSnapshot::dataPacketsForMe); }
 
     /**
      * @brief Get the Received I Am Via Num
      *
      * @return uint32_t
      */
-    uint32_t getReceivedIAmViaNum() { return receivedIAmViaNum; }
+    uint32_t getReceivedIAmViaNum() { return getStat(&StatsSnapshot::receivedIAmVia); }
 
     /**
      * @brief Get the Destiny Unreachable Num
      *
      * @return uint32_t
      */
-    uint32_t getDestinyUnreachableNum() { return sendPacketDestinyUnreachableNum; }
+    uint32_t getDestinyUnreachableNum() { return getStat(&StatsSnapshot::destinyUnreachable); }
 
     /**
      * @brief Get the Received Not For Me
      *
      * @return uint32_t
      */
-    uint32_t getReceivedNotForMe() { return receivedPacketNotForMeNum; }
+    uint32_t getReceivedNotForMe() { return getStat(&StatsSnapshot::receivedNotForMe); }
 
     /**
-     * @brief Get the payload received bytes
+     * @brief Get the number of data packets sent inside aggregated packets
      *
      * @return uint32_t
      */
-    uint32_t getReceivedPayloadBytes() { return receivedPayloadBytes; }
+    uint32_t getAggregatedPacketsNum() { return getStat(&StatsSnapshot::aggregatedPackets); }
 
     /**
-     * @brief Get the control received bytes
+     * @brief Get the number of ACKs not sent in their own packet, coalesced with another ACK or carried by a data packet
      *
      * @return uint32_t
      */
-    uint32_t getReceivedControlBytes() { return receivedControlBytes; }
+    uint32_t getCoalescedAcksNum() { return getStat(&StatsSnapshot::coalescedAcks); }
 
     /**
-     * @brief Get the payload sent bytes
+     * @brief Get the number of flooded packets not forwarded because the neighbours had forwarded them
      *
      * @return uint32_t
      */
-    uint32_t getSentPayloadBytes() { return sentPayloadBytes; }
+    uint32_t getSuppressedFloodsNum() { return getStat(&StatsSnapshot::suppressedFloods); }
 
     /**
-     * @brief Get the control sent bytes
+     * @brief Get the number of packets and reliable payloads dropped because they reached their max age
      *
      * @return uint32_t
      */
-    uint32_t getSentControlBytes() { return sentControlBytes; }
+    uint32_t getDeadlineDropsNum() { return getStat(&StatsSnapshot::deadlineDrops); }
 
     /**
-     * @brief Checks if the node is a gateway
+     * @brief Get the number of packets that reached their max age and were demoted to the lowest priority
      *
+     * @return uint32_t
      */
-    static bool isGatewayRole() { return RoleService::isGateway(); };
+    uint32_t getDeadlineDemotionsNum() { return getStat(&StatsSnapshot::deadlineDemotions); }
 
     /**
-     * @brief Defines that the node is a gateway
+     * @brief Get the number of packets dropped because the send queue was full or the heap budget was reached
      *
+     * @return uint32_t
      */
-    static void addGatewayRole() { RoleService::setRole(ROLE_GATEWAY); };
+    uint32_t getSendQueueDropsNum() { return getStat(&StatsSnapshot::sendQueueDrops); }
 
     /**
-     * @brief Defines that the node is not a gateway
+     * @brief Get the number of payloads for the user dropped because the received queue was full or the heap budget was reached
      *
+     * @return uint32_t
      */
-    static void removeGatewayRole() { RoleService::removeRole(ROLE_GATEWAY); };
+    uint32_t getAppQueueDropsNum() { return getStat(&StatsSnapshot::appQueueDrops); }
 
     /**
-     * @brief Defines any type of Role
+     * @brief Get the number of reliable sequences rejected because of the limits of sequences or the heap budget
      *
-     * @param role Role to be defined
+     * @return uint32_t
      */
-    static void addRole(uint8_t role) { RoleService::setRole(role); };
+    uint32_t getSequencesRejectedNum() { return getStat(&StatsSnapshot::sequencesRejected); }
 
     /**
-     * @brief Get the Nearest Gateway object
+     * @brief Get the number of parity packets sent by the reliable payloads
      *
-     * @return RouteNode*
+     * @return uint32_t
      */
-    static RouteNode* getClosestGateway() { return RoutingTableService::getBestNodeByRole(ROLE_GATEWAY); };
+    uint32_t getParityPacketsNum() { return getStat(&StatsSnapshot::parityPackets); }
 
     /**
-     * @brief Get the Best Node With Role
+     * @brief Get the number of packets of the reliable payloads rebuilt with a parity packet
      *
-     * @param role Role to be searched
-     * @return RouteNode* Route Node
+     * @return uint32_t
      */
-    static RouteNode* getBestNodeWithRole(uint8_t role) { return RoutingTableService::getBestNodeByRole(role); };
+    uint32_t getRecoveredPacketsNum() { return getStat(&StatsSnapshot::recoveredPackets); }
 
     /**
-     * @brief Set the Simulator Service object
+     * @brief Get the number of decreases of the congestion windows of the next hops of the reliable payloads
      *
-     * @param service Simulator Service
+     * @return uint32_t
      */
-    void setSimulatorService(SimulatorService* service) { simulatorService = service; }
+    uint32_t getCongestionDecreasesNum() { return getStat(&StatsSnapshot::congestionDecreases); }
 
     /**
-     * @brief Remove the Simulator Service object
+     * @brief Get the number of packets sent with a compact header
      *
+     * @return uint32_t
      */
-    void removeSimulatorService() { simulatorService = nullptr; }
-
-#ifndef LM_GOD_MODE
-private:
-#endif
+    uint32_t getCompactHeadersNum() { return getStat(&StatsSnapshot::compactHeaders); }
 
     /**
-     * @brief Construct a new LoraMesher object
+     * @brief Get the bytes of header saved by the packets sent with a compact header
      *
+     * @return uint32_t
      */
-    LoraMesher();
+    uint32_t getCompactHeaderSavedBytes() { return getStat(&StatsSnapshot::compactHeaderSavedBytes); }
 
     /**
-     * @brief Configuration of the LoRaMesher
+     * @brief Get the number of packets sent inside the slots of the slotted access
      *
+     * @return uint32_t
      */
-    LoraMesherConfig* loraMesherConfig = new LoraMesherConfig();
-
-    LM_LinkedList<AppPacket<uint8_t>>* ReceivedAppPackets = new LM_LinkedList<AppPacket<uint8_t>>();
-
-    LM_LinkedList<QueuePacket<Packet<uint8_t>>>* ReceivedPackets = new LM_LinkedList<QueuePacket<Packet<uint8_t>>>();
-
-    LM_LinkedList<QueuePacket<Packet<uint8_t>>>* ToSendPackets = new LM_LinkedList<QueuePacket<Packet<uint8_t>>>();
+    uint32_t getSlottedPacketsNum() { return getStat(&StatsSnapshot::slottedPackets); }
 
     /**
-     * @brief RadioLib module
+     * @brief Get the bytes of heap used by the packets and the payloads, they are limited by the heap budget
      *
+     * @return size_t
      */
-    LM_Module* radio = nullptr;
+    size_t getPacketHeapInUse() { return PacketPoolService::getHeapInUse(); }
 
     /**
-     * @brief Hello task handle. It will send a hello packet every HELLO_PACKETS_DELAY s
+     * @brief Get the payload bytes given to the compression
      *
+     * @return uint32_t
      */
-    TaskHandle_t Hello_TaskHandle = nullptr;
+    uint32_t getCompressionInputBytes() { return getStat(&StatsSnapshot::compressionInputBytes); }
 
     /**
-     * @brief Receive packets task handle. Every time a LoRa packet is detected it will create a packet,
-     *  store it into the received packets queue and notify the receive data task handle
+     * @brief Get the payload bytes sent after the compression, the payloads not compressed are included with their size
      *
+     * @return uint32_t
      */
-    TaskHandle_t ReceivePacket_TaskHandle = nullptr;
+    uint32_t getCompressionOutputBytes() { return getStat(&StatsSnapshot::compressionOutputBytes); }
 
     /**
-     * @brief Receive Data task handle. It will process all the packets inside the received packets queue.
-     * It will be notified by the ReceivePacket_TaskHandle
+     * @brief Get the compression ratio, the output bytes per hundred input bytes
      *
+     * @return uint32_t 100 if nothing has been compressed
      */
-    TaskHandle_t ReceiveData_TaskHandle = nullptr;
+    uint32_t getCompressionRatio() {
+        StatsSnapshot snapshot = getStatsSnapshot();
+        return snapshot.compressionInputBytes == 0 ? 100 : snapshot.compressionOutputBytes * 100 / snapshot.compressionInputBytes;
+    }
 
     /**
-     * @brief Send data task handle. Every SEND_PACKETS_DELAY s it will get the packet from send packets queue,
-     * add the via if it is necessary and send it.
+     * @brief Get the number of received packets discarded because they could not be authenticated with the network key
      *
+     * @return uint32_t
      */
-    TaskHandle_t SendData_TaskHandle = nullptr;
+    uint32_t getDecryptionFailedNum() { return getStat(&StatsSnapshot::decryptionFailed); }
 
     /**
-     * @brief Receive App data task handle. Every time that a packet is received and is for this node, this task will be notified.
-     * This task is implemented by the user.
+     * @brief Get the airtime statistics of the actual band: duty cycle, budget, used and remaining airtime inside the window
      *
+     * @return AirtimeStats
      */
-    TaskHandle_t ReceiveAppData_TaskHandle = nullptr;
+    AirtimeStats getAirtimeStats() { return AirtimeService::getStats(); }
 
     /**
-     * @brief Queue manager task handle. This task manages the queues inside LoRaMesher, checking for timeouts and resending messages.
+     * @brief Get the latency statistics of a stage of the receive or send pipeline in microseconds: min, average, p99 and max
      *
+     * @param stage Stage
+     * @return LatencyStats
      */
-    TaskHandle_t QueueManager_TaskHandle = nullptr;
+    LatencyStats getLatencyStats(LatencyStage stage) { return LatencyService::getStats(stage); }
 
     /**
-     * @brief Routing table manager task handle. This manages the routing table, checking for timeouts and removing nodes.
+     * @brief Get the latency statistics of the send queue for the class of a priority in microseconds
      *
+     * @param priority Priority, the classes are defined by LM_LATENCY_PRIORITY_CLASSES
+     * @return LatencyStats
      */
-    TaskHandle_t RoutingTableManager_TaskHandle = nullptr;
-
-    void initConfiguration();
-
-    static void onReceive(void);
-
-    void setDioActionsForScanChannel();
-
-    void setDioActionsForReceivePacket();
-
-    void clearDioActions();
-
-    int startReceiving();
+    LatencyStats getSendQueueLatencyStats(uint8_t priority) { return LatencyService::getQueueStats(priority); }
 
     /**
-     * @brief Scan activity channel
+     * @brief Reset the latency statistics
      *
      */
-    void channelScan();
-
-    int startChannelScan();
-
-    void receivingRoutine();
-
-    void initializeLoRa();
-
-    void initializeSchedulers();
-
-    void sendHelloPacket();
-
-    void routingTableManager();
-
-    void queueManager();
+    void resetLatencyStats() { LatencyService::reset(); }
 
     /**
-     * @brief Region Monitoring variables
+     * @brief Get the number of received packets dropped because the received packets queue was full
      *
+     * @return uint32_t
      */
+    uint32_t getReceivedQueueFullNum() { return getStat(&StatsSnapshot::receivedQueueFull); }
 
-    uint32_t receivedDataPacketsNum = 0;
-    void incReceivedDataPackets() { receivedDataPacketsNum++; }
-
-    uint32_t sendPacketsNum = 0;
-    void incSendPackets() { sendPacketsNum++; }
-
-    uint32_t receivedHelloPacketsNum = 0;
-    void incRecHelloPackets() { receivedHelloPacketsNum++; }
-
-    uint32_t sentHelloPacketsNum = 0;
-    void incSentHelloPackets() { sentHelloPacketsNum++; }
-
-    uint32_t receivedBroadcastPacketsNum = 0;
-    void incReceivedBroadcast() { receivedBroadcastPacketsNum++; }
-
-    uint32_t forwardedPacketsNum = 0;
-    void incForwardedPackets() { forwardedPacketsNum++; }
-
-    uint32_t dataPacketForMeNum = 0;
-    void incDataPacketForMe() { dataPacketForMeNum++; }
-
-    uint32_t receivedIAmViaNum = 0;
-    void incReceivedIAmVia() { receivedIAmViaNum++; }
-
-    uint32_t sendPacketDestinyUnreachableNum = 0;
-    void incDestinyUnreachable() { sendPacketDestinyUnreachableNum++; }
-
-    uint32_t receivedPacketNotForMeNum = 0;
-    void incReceivedNotForMe() { receivedPacketNotForMeNum++; }
-
-    uint32_t receivedPayloadBytes = 0;
-    void incReceivedPayloadBytes(uint32_t numBytes) { receivedPayloadBytes += numBytes; }
+    /**
+     * @brief Get the number of received packets dropped because they were duplicated
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedDuplicatesNum() { return getStat(&StatsSnapshot::receivedDuplicates); }
 
-    uint32_t receivedControlBytes = 0;
-    void incReceivedControlBytes(uint32_t numBytes) { receivedControlBytes += numBytes; }
+    /**
+     * @brief Get the payload received bytes
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedPayloadBytes() { return getStat(&StatsSnapshot::receivedPayloadBytes); }
 
-    uint32_t sentPayloadBytes = 0;
-    void incSentPayloadBytes(uint32_t numBytes) { sentPayloadBytes += numBytes; }
+    /**
+     * @brief Get the control received bytes
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedControlBytes() { return getStat(&StatsSnapshot::receivedControlBytes); }
 
-    uint32_t sentControlBytes = 0;
-    void incSentControlBytes(uint32_t numBytes) { sentControlBytes += numBytes; }
+    /**
+     * @brief Get the payload sent bytes
+     *
+     * @return uint32_t
+     */
+    uint32_t getSentPayloadBytes() { return getStat(&StatsSnapshot::sentPayloadBytes); }
 
     /**
-     * @brief Function that process the packets inside Received Packets
-     * Task executed every time that a packet arrive.
+     * @brief Get the control sent bytes
      *
+     * @return uint32_t
      */
-    void processPackets();
+    uint32_t getSentControlBytes() { return getStat(&StatsSnapshot::sentControlBytes); }
 
     /**
-     * @brief Delete the packet from memory
+     * @brief Get the packet pool statistics, number of blocks in use, high water mark and the heap fallbacks
      *
-     * @tparam T Type of packet
-     * @param p Packet to delete
+     * @return PacketPoolStats
      */
-    template <typename T>
-    static void deletePacket(Packet<T>* p) {
-        vPortFree(p);
-    }
+    PacketPoolStats getPacketPoolStats() { return PacketPoolService::getStats(); }
 
     /**
-     * @brief Sets the packet in a Fifo with priority and will send the packet when needed.
+     * @brief Get the queue packet pool statistics
      *
-     * @param p packet<uint8_t>*
-     * @param priority Priority set DEFAULT_PRIORITY by default. 0 most priority
+     * @return PacketPoolStats
      */
-    void setPackedForSend(Packet<uint8_t>* p, uint8_t priority) {
-        if (!p) {
-            ESP_LOGE(LM_TAG, "setPackedForSend: Packet is null, cannot be sent");
-            return;
-        }
+    PacketPoolStats getQueuePacketPoolStats() { return PacketPoolService::getQueuePacketStats(); }
 
-        // Check for duplicate packet before adding to send queue
-        if (isDuplicatePacket(p)) {
-            ESP_LOGW(LM_TAG, "setPackedForSend: Duplicate packet detected, not adding to send queue");
-            return;
+    /**
+     * @brief Checks if the node is a gateway
+     *
+     */
+    static bool isGatewayRole() { return RoleService::isGateway(); };
+
+    /**
+     * @brief Defines that the node is a gateway
+     *
+     */
+    static void addGatewayRole() { RoleService::setRole(ROLE_GATEWAY); };
+
+    /**
+     * @brief Defines that the node is not a gateway
+     *
+     */
+    static void removeGatewayRole() { RoleService::removeRole(ROLE_GATEWAY); };
+
+    /**
+     * @brief Defines any type of Role
+     *
+     * @param role Role to be defined
+     */
+    static void addRole(uint8_t role) { RoleService::setRole(role); };
+
+    /**
+     * @brief Get the Nearest Gateway object. Between the gateways with the same metric, the least loaded with gatewayLoad,
+     * and the nodes spread between the equal ones.
+     *
+     * @return RouteNode*
+     */
+    static RouteNode* getClosestGateway() { return RoutingTableService::getBestNodeByRole(ROLE_GATEWAY); };
+
+    /**
+     * @brief Get the load of this node advertised when it is a gateway, the highest of the send queue used
+     * and the airtime used of the budget
+     *
+     * @return uint8_t Load, from 0 to 255
+     */
+    uint8_t getLoad();
+
+    /**
+     * @brief Get the Best Node With Role
+     *
+     * @param role Role to be searched
+     * @return RouteNode* Route Node
+     */
+    static RouteNode* getBestNodeWithRole(uint8_t role) { return RoutingTableService::getBestNodeByRole(role); };
+
+    /**
+     * @brief Set the Simulator Service object
+     *
+     * @param service Simulator Service
+     */
+    void setSimulatorService(SimulatorService* service) { simulatorService = service; }
+
+    /**
+     * @brief Remove the Simulator Service object
+     *
+     */
+    void removeSimulatorService() { simulatorService = nullptr; }
+
+#ifndef LM_GOD_MODE
+private:
+#endif
+
+    /**
+     * @brief Construct a new LoraMesher object
+     *
+     */
+    LoraMesher();
+
+    /**
+     * @brief Configuration of the LoRaMesher
+     *
+     */
+    LoraMesherConfig* loraMesherConfig = new LoraMesherConfig();
+
+    LM_IntrusiveList<AppPacket<uint8_t>>* ReceivedAppPackets = new LM_IntrusiveList<AppPacket<uint8_t>>();
+
+    /**
+     * @brief Received packets waiting to be processed. The receiving task is the only producer
+     * and the process task the only consumer.
+     *
+     */
+    LM_SPSCRing<QueuePacket<Packet<uint8_t>>, LM_RECEIVED_QUEUE_SIZE>* ReceivedPackets = new LM_SPSCRing<QueuePacket<Packet<uint8_t>>, LM_RECEIVED_QUEUE_SIZE>();
+
+    LM_PriorityQueue<QueuePacket<Packet<uint8_t>>, MAX_PRIORITY>* ToSendPackets = new LM_PriorityQueue<QueuePacket<Packet<uint8_t>>, MAX_PRIORITY>();
+
+    /**
+     * @brief RadioLib module, in the control channel when there is a data radio
+     *
+     */
+    LM_Module* radio = nullptr;
+
+    /**
+     * @brief RadioLib module of the data channels, nullptr if there is only one radio
+     *
+     */
+    LM_Module* dataRadio = nullptr;
+
+    /**
+     * @brief State of a radio module, every radio has its receive task and its transmission in progress
+     *
+     */
+    struct RadioState {
+        LM_Module* module = nullptr;
+        // Receive task, every time a LoRa packet is detected it creates a packet, stores it into the received packets
+        // queue and notifies the process task
+        TaskHandle_t receiveTask = nullptr;
+        // Channel set in the module, 0 is the control channel
+        uint8_t channel = 0;
+        // Power set in the module in dBm
+        int8_t actualTxPower = LM_POWER;
+        // A packet has been received while waiting to send
+        volatile bool hasReceivedMessage = false;
+        // A packet is being transmitted
+        volatile bool transmitting = false;
+        // The transmit done interrupt has been received
+        volatile bool transmitDone = false;
+        // Time in ms when the transmission is considered finished even without the transmit done interrupt
+        unsigned long transmitDeadline = 0;
+        // Time in microseconds of the start of the transmission, of the transmit done interrupt and of the last receive interrupt
+        uint32_t transmitStartTime = 0;
+        volatile uint32_t transmitDoneTime = 0;
+        volatile uint32_t receiveInterruptTime = 0;
+    };
+
+    /**
+     * @brief Radios, the control radio and the data radio if numRadios is 2
+     *
+     */
+    static const uint8_t CONTROL_RADIO = 0;
+    static const uint8_t DATA_RADIO = 1;
+    RadioState radios[2];
+    uint8_t numRadios = 1;
+
+    /**
+     * @brief The receive tasks of both radios push into the ReceivedPackets ring, it has a single producer
+     *
+     */
+    portMUX_TYPE receivedMux = portMUX_INITIALIZER_UNLOCKED;
+
+    /**
+     * @brief Get the radio that sends in a channel, the data radio sends in the data channels
+     *
+     */
+    RadioState& getSendRadio(uint8_t channel) { return numRadios > 1 && channel != 0 ? radios[DATA_RADIO] : radios[CONTROL_RADIO]; }
+
+    /**
+     * @brief Get the channel where a radio listens. With a data radio the control radio always listens to the
+     * control channel and the data radio to the channel of the session, or to its last data channel without session.
+     *
+     */
+    uint8_t getListenChannel(const RadioState& radioState);
+
+    /**
+     * @brief Hello task handle. It will send a hello packet every HELLO_PACKETS_DELAY s
+     *
+     */
+    TaskHandle_t Hello_TaskHandle = nullptr;
+
+    /**
+     * @brief Notification bits of the Hello task: the routing table has changed, a neighbour has solicited the
+     * routing table and LoraMesher has started
+     *
+     */
+    static const uint32_t HELLO_NOTIFY_CHANGED = 1;
+    static const uint32_t HELLO_NOTIFY_SOLICITED = 2;
+    static const uint32_t HELLO_NOTIFY_STARTED = 4;
+
+    /**
+     * @brief Receive Data task handle. It will process all the packets inside the received packets queue.
+     * It will be notified by the receive task of the radios
+     *
+     */
+    TaskHandle_t ReceiveData_TaskHandle = nullptr;
+
+    /**
+     * @brief Send data task handle. Every SEND_PACKETS_DELAY s it will get the packet from send packets queue,
+     * add the via if it is necessary and send it.
+     *
+     */
+    TaskHandle_t SendData_TaskHandle = nullptr;
+
+    /**
+     * @brief Receive App data task handle. Every time that a packet is received and is for this node, this task will be notified.
+     * This task is implemented by the user.
+     *
+     */
+    TaskHandle_t ReceiveAppData_TaskHandle = nullptr;
+
+    /**
+     * @brief Handler of the payloads for this node, if nullptr they are queued for the Receive App Data Task
+     *
+     */
+    AppPayloadHandler appPayloadHandler = nullptr;
+
+    /**
+     * @brief Sink of the large payloads, if nullptr they are delivered as AppPackets
+     *
+     */
+    SequenceSink* sequenceSink = nullptr;
+
+    /**
+     * @brief Handlers of the user packet types
+     *
+     */
+    struct PacketHandlerEntry {
+        uint8_t type;
+        PacketHandler handler;
+    };
+
+    PacketHandlerEntry packetHandlers[LM_MAX_PACKET_HANDLERS] = {};
+    uint8_t numPacketHandlers = 0;
+
+    /**
+     * @brief Give a packet of a user packet type to its handler
+     *
+     * @param rx Packet received, it is deleted
+     */
+    void processCustomPacket(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Queue manager task handle. This task manages the queues inside LoRaMesher, checking for timeouts and resending messages.
+     *
+     */
+    TaskHandle_t QueueManager_TaskHandle = nullptr;
+
+    /**
+     * @brief Routing table manager task handle. This manages the routing table, checking for timeouts and removing nodes.
+     *
+     */
+    TaskHandle_t RoutingTableManager_TaskHandle = nullptr;
+
+    /**
+     * @brief Trace task handle. This low priority task prints the deferred trace every LM_TRACE_DRAIN_PERIOD ms.
+     *
+     */
+    TaskHandle_t Trace_TaskHandle = nullptr;
+
+    void initConfiguration();
+
+    /**
+     * @brief Receive interrupts of the control and the data radio, they notify the receive task of the radio
+     *
+     */
+    static void onReceive(void);
+    static void onDataReceive(void);
+    static void receiveInterrupt(RadioState& radioState);
+
+    /**
+     * @brief Transmit done interrupts of the control and the data radio, they notify the send task
+     *
+     */
+    static void onTransmitDone(void);
+    static void onDataTransmitDone(void);
+    static void transmitDoneInterrupt(RadioState& radioState);
+
+    /**
+     * @brief Finish the transmission in progress of a radio and start receiving again. Called from the send task.
+     *
+     * @param radioState Radio
+     * @param wait If true it waits until the transmission is done, otherwise it only finishes a transmission already done
+     */
+    void finishTransmit(RadioState& radioState, bool wait);
+
+    /**
+     * @brief Finish the transmissions in progress of all the radios
+     *
+     * @param wait If true it waits until the transmissions are done
+     */
+    void finishTransmit(bool wait);
+
+    /**
+     * @brief Aggregate the data packet with the data packets of the send queue to the same next hop, waiting up to the
+     * aggregation hold time for new ones while the frame is not full and there are no packets with higher priority.
+     * An ACK is carried by the data packets already queued to its next hop, it does not wait for new ones.
+     *
+     * @param tx Data packet or ACK popped from the send queue
+     * @param nextHop Next hop of the packet
+     * @param sendId Id of the next packet sent by this node, used for the records of this node
+     * @return QueuePacket<Packet<uint8_t>>* The aggregated packet, or tx if there was nothing to aggregate.
+     * The queue packets aggregated are deleted
+     */
+    QueuePacket<Packet<uint8_t>>* aggregatePackets(QueuePacket<Packet<uint8_t>>* tx, uint16_t nextHop, uint8_t& sendId);
+
+    /**
+     * @brief Process every record of an aggregated packet as a data packet received
+     *
+     * @param pq Aggregated packet
+     */
+    void processAggregatedPacket(QueuePacket<DataPacket>* pq);
+
+    void setDioActionsForScanChannel(RadioState& radioState);
+
+    void setDioActionsForReceivePacket(RadioState& radioState);
+
+    /**
+     * @brief Clear the DIO actions of all the radios
+     *
+     */
+    void clearDioActions();
+
+    /**
+     * @brief Start receiving in the listen channel of a radio
+     *
+     */
+    int startReceiving(RadioState& radioState);
+
+    /**
+     * @brief Scan activity channel
+     *
+     */
+    void channelScan();
+
+    int startChannelScan();
+
+    /**
+     * @brief Receive task of a radio
+     *
+     */
+    void receivingRoutine(RadioState& radioState);
+
+    void initializeLoRa();
+
+    void initializeSchedulers();
+
+    /**
+     * @brief Create the receive task of the data radio, if there is a data radio and it has not been created
+     *
+     */
+    void initializeDataReceiveTask();
+
+    /**
+     * @brief Create a task with its configuration
+     *
+     * @param function Function of the task, it receives this LoraMesher
+     * @param name Name of the task
+     * @param config Stack, priority and core
+     * @param handle Handle of the task created
+     */
+    void createTask(TaskFunction_t function, const char* name, const TaskConfig& config, TaskHandle_t* handle);
+
+    /**
+     * @brief Wait until the task has suspended itself, waiting for start
+     *
+     * @param task Task handle
+     */
+    void waitTaskSuspended(TaskHandle_t task);
+
+    void sendHelloPacket();
+
+    /**
+     * @brief Create the HELLO packets with the routing table and add them to the send queue
+     *
+     * @param onlyChanged If true only the routes changed since the last HELLO packet are sent, in a delta HELLO packet
+     * @param sendEmpty If true a HELLO packet is sent even if there are no routes to be sent
+     * @param solicit If true the neighbours are asked to send their whole routing table
+     */
+    void sendRoutingPackets(bool onlyChanged, bool sendEmpty, bool solicit = false);
+
+    /**
+     * @brief Network nodes of the HELLO packets being created, only used by the hello task
+     *
+     */
+    NetworkNode advertisedNodes[RTMAXSIZE];
+
+    void routingTableManager();
+
+    void queueManager();
+
+    void traceRoutine();
+
+    /**
+     * @brief Region Monitoring variables
+     *
+     */
+
+    /**
+     * @brief Counters of the node, protected by statsMux. The ESP32 has no 64-bit atomic instructions, all the counters
+     * are updated in the same critical section and a snapshot copies them at once.
+     *
+     */
+    StatsSnapshot stats = {};
+    portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    void incStat(uint64_t StatsSnapshot::* counter, uint32_t count = 1) {
+        portENTER_CRITICAL(&statsMux);
+        stats.*counter += count;
+        portEXIT_CRITICAL(&statsMux);
+    }
+
+    uint32_t getStat(uint64_t StatsSnapshot::* counter) {
+        portENTER_CRITICAL(&statsMux);
+        uint64_t value = stats.*counter;
+        portEXIT_CRITICAL(&statsMux);
+        return value;
+    }
+
+    void incReceivedDataPackets() { incStat(&StatsSnapshot::receivedDataPackets); }
+    void incSendPackets() { incStat(&StatsSnapshot::sentPackets); }
+    void incRecHelloPackets() { incStat(&StatsSnapshot::receivedHelloPackets); }
+    void incSentHelloPackets() { incStat(&StatsSnapshot::sentHelloPackets); }
+    void incReceivedBroadcast() { incStat(&StatsSnapshot::receivedBroadcastPackets); }
+    void incForwardedPackets() { incStat(&StatsSnapshot::forwardedPackets); }
+    void incDataPacketForMe() { incStat(&StatsSnapshot::dataPacketsForMe); }
+    void incReceivedIAmVia() { incStat(&StatsSnapshot::receivedIAmVia); }
+    void incDestinyUnreachable() { incStat(&StatsSnapshot::destinyUnreachable); }
+    void incReceivedNotForMe() { incStat(&StatsSnapshot::receivedNotForMe); }
+    void incReceivedQueueFull() { incStat(&StatsSnapshot::receivedQueueFull); }
+    void incReceivedDuplicates() { incStat(&StatsSnapshot::receivedDuplicates); }
+    void incReceivedPayloadBytes(uint32_t numBytes) { incStat(&StatsSnapshot::receivedPayloadBytes, numBytes); }
+    void incReceivedControlBytes(uint32_t numBytes) { incStat(&StatsSnapshot::receivedControlBytes, numBytes); }
+    void incSentPayloadBytes(uint32_t numBytes) { incStat(&StatsSnapshot::sentPayloadBytes, numBytes); }
+    void incSentControlBytes(uint32_t numBytes) { incStat(&StatsSnapshot::sentControlBytes, numBytes); }
+    void incAggregatedPackets(uint32_t numPackets) { incStat(&StatsSnapshot::aggregatedPackets, numPackets); }
+    void incCoalescedAcks() { incStat(&StatsSnapshot::coalescedAcks); }
+    void incDecryptionFailed() { incStat(&StatsSnapshot::decryptionFailed); }
+    void incSuppressedFloods() { incStat(&StatsSnapshot::suppressedFloods); }
+    void incDeadlineDrops() { incStat(&StatsSnapshot::deadlineDrops); }
+    void incDeadlineDemotions() { incStat(&StatsSnapshot::deadlineDemotions); }
+    void incSendQueueDrops() { incStat(&StatsSnapshot::sendQueueDrops); }
+    void incAppQueueDrops() { incStat(&StatsSnapshot::appQueueDrops); }
+    void incSequencesRejected() { incStat(&StatsSnapshot::sequencesRejected); }
+    void incParityPackets() { incStat(&StatsSnapshot::parityPackets); }
+    void incRecoveredPackets() { incStat(&StatsSnapshot::recoveredPackets); }
+    void incCongestionDecreases() { incStat(&StatsSnapshot::congestionDecreases); }
+    void incCompactHeaders(uint32_t savedBytes) {
+        incStat(&StatsSnapshot::compactHeaders);
+        incStat(&StatsSnapshot::compactHeaderSavedBytes, savedBytes);
+    }
+    void incSlottedPackets() { incStat(&StatsSnapshot::slottedPackets); }
+
+    void incCompressionBytes(uint32_t inputBytes, uint32_t outputBytes) {
+        portENTER_CRITICAL(&statsMux);
+        stats.compressionInputBytes += inputBytes;
+        stats.compressionOutputBytes += outputBytes;
+        portEXIT_CRITICAL(&statsMux);
+    }
+
+    /**
+     * @brief Create a data packet to be sent, the payload is compressed if the compression is enabled and it becomes smaller
+     *
+     * @param dst Destination address
+     * @param payload Payload to send
+     * @param payloadSize Payload size in bytes
+     * @return DataPacket*
+     */
+    DataPacket* createSendDataPacket(uint16_t dst, const uint8_t* payload, uint32_t payloadSize);
+
+    /**
+     * @brief Compress a payload if the compression is enabled, counting it in the compression statistics
+     *
+     * @param payload Payload to compress
+     * @param payloadSize Payload size in bytes
+     * @param compressedSize Size of the compressed payload
+     * @return uint8_t* Compressed payload to be freed with vPortFree, nullptr if it is not compressed
+     */
+    uint8_t* compressSendPayload(const uint8_t* payload, uint32_t payloadSize, uint32_t& compressedSize);
+
+    /**
+     * @brief Function that process the packets inside Received Packets
+     * Task executed every time that a packet arrive.
+     *
+     */
+    void processPackets();
+
+    /**
+     * @brief Set a routing packet for send, adding the link reports of the neighbours to the last one with the adaptive data rate
+     *
+     * @param tx Routing packet
+     * @param last If it is the last routing packet of the HELLO
+     * @param overflowType Type of the HELLO without routes created when the reports do not fit, with the compact header
+     * and the solicit bits of the HELLO
+     */
+    void setRoutingPacketForSend(RoutePacket* tx, bool last, uint8_t overflowType);
+
+    /**
+     * @brief Delete the packet from memory
+     *
+     * @tparam T Type of packet
+     * @param p Packet to delete
+     */
+    template <typename T>
+    static void deletePacket(Packet<T>* p) {
+        PacketPoolService::release(p);
+    }
+
+    /**
+     * @brief Sets the packet in a Fifo with priority and will send the packet when needed.
+     *
+     * @param p packet<uint8_t>*
+     * @param priority Priority set DEFAULT_PRIORITY by default. 0 most priority
+     * @param maxAge Milliseconds that it can wait in the send queue, 0 without limit
+     * @param demote After the max age it is sent with the lowest priority instead of being dropped
+     * @return LM_SendStatus OK if it is inside the send queue, the same packet was already inside it or
+     * the packet is deleted otherwise
+     */
+    LM_SendStatus setPackedForSend(Packet<uint8_t>* p, uint8_t priority, uint32_t maxAge = 0, bool demote = false) {
+        if (!p) {
+            ESP_LOGE(LM_TAG, "setPackedForSend: Packet is null, cannot be sent");
+            return LM_SendStatus::NO_MEMORY;
+        }
+
+        // Check for duplicate packet before adding to send queue
+        if (isDuplicatePacket(p)) {
+            ESP_LOGW(LM_TAG, "setPackedForSend: Duplicate packet detected, not adding to send queue");
+            deletePacket(p);
+            return LM_SendStatus::OK;
         }
 
-        ESP_LOGI(LM_TAG, "Adding packet to Q_SP");
-        QueuePacket<Packet<uint8_t>>* send = PacketQueueService::createQueuePacket(p, priority);
-        ESP_LOGI(LM_TAG, "Created packet to Q_SP");
-        addToSendOrderedAndNotify(send);
-    }
+        ESP_LOGI(LM_TAG, "Adding packet to Q_SP");
+        QueuePacket<Packet<uint8_t>>* send = PacketQueueService::createQueuePacket(p, priority);
+        PacketQueueService::setDeadline(send, maxAge, demote);
+        ESP_LOGI(LM_TAG, "Created packet to Q_SP");
+        return addToSendOrderedAndNotify(send);
+    }
+
+    /**
+     * @brief Check if the packet is a duplicate of a packet waiting in the send queue.
+     * If it is not, the packet is added to the send duplicate cache until it leaves the send queue.
+     * @param p Packet to check
+     * @return true if the packet is a duplicate
+     * @return false if the packet is not a duplicate
+     */
+    bool isDuplicatePacket(Packet<uint8_t>* p);
+
+    /**
+     * @brief Packets waiting inside the send queue
+     *
+     */
+    LM_DuplicateCache<LM_DUPLICATE_CACHE_SIZE>* sendDuplicateCache = new LM_DuplicateCache<LM_DUPLICATE_CACHE_SIZE>();
+
+    /**
+     * @brief Packets received recently
+     *
+     */
+    LM_DuplicateCache<LM_DUPLICATE_CACHE_SIZE>* receivedDuplicateCache = new LM_DuplicateCache<LM_DUPLICATE_CACHE_SIZE>();
+
+    /**
+     * @brief Flooded packets received recently, by their flood key. The copies forwarded by the neighbours are duplicates
+     *
+     */
+    LM_DuplicateCache<LM_FLOOD_CACHE_SIZE>* floodDuplicateCache = new LM_DuplicateCache<LM_FLOOD_CACHE_SIZE>();
+
+    /**
+     * @brief Flooded packet waiting to be forwarded. It waits for its deadline and then in the send queue, the copies
+     * are counted until it is transmitted
+     *
+     */
+    struct floodPacket {
+        bool used{ false }; //The entry has a flooded packet
+        Packet<uint8_t>* packet{ nullptr }; //Copy of the packet to forward, still encrypted. nullptr once in the send queue
+        uint32_t key{ 0 }; //Flood key of the packet
+        unsigned long deadline{ 0 }; //millis() when it is forwarded, or when the entry expires once in the send queue
+        uint8_t copies{ 0 }; //Copies heard from other nodes since it was received
+    };
+
+    /**
+     * @brief Flooded packets waiting to be forwarded, protected by the floodsMux
+     *
+     */
+    floodPacket pendingFloods[LM_FLOOD_PENDING];
+
+    portMUX_TYPE floodsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    //Flooded packets waiting for their deadline
+    size_t numPendingFloods = 0;
+
+    /**
+     * @brief Process a data packet to a group when flooding is enabled. A new packet is copied to be forwarded later,
+     * a copy forwarded by another node is counted and deleted
+     *
+     * @param pq Queue packet
+     * @return true If it is a new packet, it continues to be processed
+     * @return false If it has been deleted, it was a duplicate or sent by this node
+     */
+    bool processFloodPacket(QueuePacket<DataPacket>* pq);
+
+    /**
+     * @brief Forward the flooded packets whose time has come, if they have not been heard enough times
+     *
+     */
+    void manageFloods();
 
     /**
-     * @brief Check if the packet is a duplicate
-     * @param p Packet to check
-     * @return true if the packet is a duplicate
-     * @return false if the packet is not a duplicate
+     * @brief Get the milliseconds until the next flooded packet has to be forwarded
+     *
+     * @param maxWait Maximum milliseconds returned, if there are no packets waiting
+     * @return unsigned long
      */
-    bool isDuplicatePacket(Packet<uint8_t>* p);
+    unsigned long getTimeUntilNextFlood(unsigned long maxWait);
+
+    /**
+     * @brief A flooded packet about to be transmitted has been heard enough times while it was in the send queue.
+     * It frees the entry of the packet
+     *
+     * @param p Packet to send
+     * @return true If it must not be transmitted
+     * @return false If it is not a flooded packet or it has not been heard enough times
+     */
+    bool isFloodSuppressed(Packet<uint8_t>* p);
 
     /**
-     * @brief Add the Queue packet into the ToSendPackets and notify the SendData Task Handle
+     * @brief Add the Queue packet into the ToSendPackets and notify the SendData Task Handle.
+     * If the queue is full or the heap budget has been reached a packet is dropped with the drop policy,
+     * the new one is deleted if it is the dropped one
      *
      * @param qp
+     * @return LM_SendStatus OK if it has been added
+     */
+    LM_SendStatus addToSendOrderedAndNotify(QueuePacket<Packet<uint8_t>>* qp);
+
+    /**
+     * @brief The heap used by the packets and the payloads would be over the heap budget
+     *
+     * @param size Bytes to be allocated
+     * @return true If it is over the budget
+     * @return false If not or the budget is disabled
      */
-    void addToSendOrderedAndNotify(QueuePacket<Packet<uint8_t>>* qp);
+    bool isOverHeapBudget(size_t size = 0);
 
     /**
      * @brief Notify the QueueManager_TaskHandle that a new sequence has been started
@@ -749,20 +1669,56 @@ private:
     void processDataPacketForMe(QueuePacket<DataPacket>* pq);
 
     /**
-     * @brief Notifies the ReceivedUserData_TaskHandle that a packet has been arrived
+     * @brief Notifies the ReceivedUserData_TaskHandle that a packet has been arrived, or gives it to the payload handler and deletes it
      *
      * @param appPq App packet
      */
     void notifyUserReceivedPacket(AppPacket<uint8_t>* appPq);
 
     /**
-     * @brief Send a packet through Lora
+     * @brief Wait until the packet can be sent by its radio, with the listen before talk or the random delay.
+     * The transmission of the other radio continues meanwhile.
+     *
+     * @param p Packet to send
+     */
+    void waitBeforeSendPacket(Packet<uint8_t>* p);
+
+    /**
+     * @brief Send a packet through Lora with the radio of its channel, waitBeforeSendPacket has been called before
      *
      * @param p Packet to send
+     * @param view Parsed view of the packet
      * @return true has been send correctly
      * @return false has not been send
      */
-    bool sendPacket(Packet<uint8_t>* p);
+    bool sendPacket(Packet<uint8_t>* p, const PacketView& view);
+
+    /**
+     * @brief Size of the packet with a compact header if it is sent with it: a data packet to a single node, whose next hop
+     * receives the compact headers and whose short addresses are unique
+     *
+     * @param p Packet to be sent, with its final via
+     * @return size_t Size of the frame, 0 if it is sent with the default header
+     */
+    size_t getCompactFrameLength(Packet<uint8_t>* p);
+
+    /**
+     * @brief Size of the packet on the air, with the compact header or the default one
+     *
+     * @param p Packet to be sent
+     * @return size_t Size in bytes
+     */
+    size_t getFrameLength(Packet<uint8_t>* p);
+
+    /**
+     * @brief Expand a frame received with a compact header into a packet with the default header
+     *
+     * @param frame Frame received, it is deleted and replaced by the packet
+     * @param frameLength Size of the frame given by the radio
+     * @return true If it has been expanded
+     * @return false If the header is not valid or its short addresses are not known, the frame is kept
+     */
+    bool readCompactFrame(Packet<uint8_t>*& frame, size_t frameLength);
 
     /**
      * @brief Proccess that sends the data inside the FIFO
@@ -777,7 +1733,7 @@ private:
      * @param seq_id Sequence Id
      * @param num_packets Number of packets of the sequence
      */
-    void sendStartSequencePackets(uint16_t destination, uint8_t seq_id, uint16_t num_packets);
+    void sendStartSequencePackets(uint16_t destination, LM_SeqId seq_id, uint16_t num_packets);
 
 
     /**
@@ -786,9 +1742,14 @@ private:
      * @param destination destination address
      * @param seq_id Sequence Id
      * @param num_packets Number of packets of the sequence
-     * @return QueuePacket<ControlPacket>*
+     * @param compressed If the payload of the sequence is compressed
+     * @param fecBlock Packets of every parity block, 0 without parity packets
+     * @param lastPacketSize Payload bytes of the last packet, only sent with the parity packets
+     * @return QueuePacket<ControlPacket>* In multi-channel mode the SYNC packet has a payload of one byte with the data channel.
+     * With parity packets it is followed by the parity block and the size of the last packet
      */
-    QueuePacket<ControlPacket>* getStartSequencePacketQueue(uint16_t destination, uint8_t seq_id, uint16_t num_packets);
+    QueuePacket<ControlPacket>* getStartSequencePacketQueue(uint16_t destination, LM_SeqId seq_id, uint16_t num_packets, bool compressed = false,
+        uint8_t fecBlock = 0, uint8_t lastPacketSize = 0);
 
     /**
      * @brief Sends an ACK packet to the destination
@@ -797,7 +1758,26 @@ private:
      * @param seq_id Id of the sequence
      * @param seq_num Number of the ack
      */
-    void sendAckPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num);
+    void sendAckPacket(uint16_t destination, LM_SeqId seq_id, uint16_t seq_num);
+
+    /**
+     * @brief Coalesce the ACK with the ACK to the same destination waiting inside the send queue. The ACK of the
+     * same sequence is cumulative, its number is raised, the ACK of another sequence is added as an ACK record
+     *
+     * @param destination destination address
+     * @param seq_id Id of the sequence
+     * @param seq_num Number of the ack
+     * @return true If it has been coalesced, it is not sent
+     * @return false If there is no ACK to the destination or it is full
+     */
+    bool coalesceAck(uint16_t destination, LM_SeqId seq_id, uint16_t seq_num);
+
+    /**
+     * @brief Process an ACK packet, the ACK of its sequence and the ACK records of the other sequences
+     *
+     * @param cPacket ACK packet
+     */
+    void processAckPacket(ControlPacket* cPacket);
 
     /**
      * @brief Send a lost packet
@@ -806,15 +1786,16 @@ private:
      * @param seq_id Id of the sequence
      * @param seq_num Number of the lost packet
      */
-    void sendLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num);
+    void sendLostPacket(uint16_t destination, LM_SeqId seq_id, uint16_t seq_num);
 
     /**
-     * @brief Prints the header of the packet without the payload
+     * @brief Records the header of the packet without the payload in the trace
      *
-     * @param p packet to be printed
-     * @param title Title to print the header
+     * @param p packet to be traced
+     * @param view Parsed view of the packet
+     * @param event TraceEvent::PACKET_RECEIVED or TraceEvent::PACKET_SENT
      */
-    void printHeaderPacket(Packet<uint8_t>* p, String title);
+    void traceHeaderPacket(Packet<uint8_t>* p, const PacketView& view, TraceEvent event);
 
     /**
      * @brief Process a large payload packet
@@ -831,8 +1812,11 @@ private:
      * @param source Source Id
      * @param seq_id Sequence Id
      * @param seq_num Sequence number
+     * @param compressed If the payload of the sequence is compressed
+     * @param channel Data channel announced by the source, 0 to receive it in the control channel
      */
-    void processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq_num);
+    void processSyncPacket(uint16_t source, LM_SeqId seq_id, uint16_t seq_num, bool compressed, uint8_t channel,
+        uint8_t fecBlock = 0, uint8_t lastPacketSize = 0);
 
     /**
      * @brief Add the ack number to the respectively sequence and reset the timeout numbers
@@ -841,32 +1825,33 @@ private:
      * @param seq_id Sequence id of the packet
      * @param seq_num Sequence number that has been Acknowledged
      */
-    void addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num);
+    void addAck(uint16_t source, LM_SeqId seq_id, uint16_t seq_num);
 
     /**
-     * @brief Sequence Id, used to get the id of the packet sequence
+     * @brief Process a selective ACK, acknowledge the packets and resend only the packets that are missing
      *
+     * @param p Selective ACK packet
      */
-    uint8_t sequence_id = 0;
+    void processSackPacket(ControlPacket* p);
 
     /**
-     * @brief Get the Sequence Id for the packet sequence
+     * @brief Sequence Id, used to get the id of the packet sequence
      *
-     * @return uint8_t
      */
-    uint8_t getSequenceId();
+    LM_SeqId sequence_id = 0;
 
     /**
-     * @brief Manage all the packets inside the Q_WSP, checking for timeouts and erasing them if lost connection
+     * @brief Get the Sequence Id for the packet sequence
      *
+     * @return LM_SeqId
      */
-    void managerSendQueue();
+    LM_SeqId getSequenceId();
 
-    /**
-     * @brief Manage all the packets inside the Q_WRP, checking for timeouts and erasing them if lost connection
-     *
-     */
-    void managerReceivedQueue();
+    enum QueueType {
+        WRP,
+        WSP,
+        WMP
+    };
 
     /**
      * @brief Used to set the configuration of the sequence of packets of the lists of packets
@@ -874,7 +1859,7 @@ private:
      */
     struct sequencePacketConfig {
         //Identification is Sequence Id and Source address
-        uint8_t seq_id; //Sequence Id
+        LM_SeqId seq_id; //Sequence Id
         uint16_t source; //Source Address
 
         uint16_t number{ 0 }; //Number of packets of the sequence
@@ -884,9 +1869,15 @@ private:
         unsigned long previousTimeout{ 0 }; //Previous timeout of the sequence
         uint8_t numberOfTimeouts{ 0 }; //Number of timeouts that has been occurred
         unsigned long calculatingRTT{ 0 }; // Calculating RTT
+        uint16_t window{ 1 }; //Number of packets that can be sent without being acknowledged
+        uint16_t lastSent{ 0 }; //Highest packet number sent. Only used by the sender
+        uint16_t lastLostRequested{ 0 }; //Last packet number requested with a lost packet. Only used by the receiver
+        QueueType queueType{ WRP }; //Queue of the sequence, Q_WRP, Q_WSP or Q_WMP
+        int16_t timerIndex{ -1 }; //Position inside the sequence timeouts heap
+        unsigned long deadline{ 0 }; //millis() when the sequence is cancelled if it has not finished, 0 never. Only used by the sender
         RouteNode* node; //Node of the routing table sequence
 
-        sequencePacketConfig(uint8_t seq_id, uint16_t source, uint16_t number, RouteNode* node) : seq_id(seq_id), source(source), number(number), node(node) {};
+        sequencePacketConfig(LM_SeqId seq_id, uint16_t source, uint16_t number, RouteNode* node) : seq_id(seq_id), source(source), number(number), node(node) {};
     };
 
     /**
@@ -896,14 +1887,42 @@ private:
     struct listConfiguration {
         sequencePacketConfig* config;
         LM_LinkedList<QueuePacket<ControlPacket>>* list;
+        AppPacket<uint8_t>* appPacket{ nullptr }; //Payload being reassembled. Only used by the receiver
+        SequenceSink* sink{ nullptr }; //Sink receiving the payload instead of the appPacket. Only used by the receiver
+        SequenceSource* source{ nullptr }; //Source of the payload, the packets are created when sent. Only used by the sender
+        uint32_t sourcePayloadSize{ 0 }; //Bytes of the source payload
+        uint32_t sinkPayloadSize{ 0 }; //Bytes delivered to the sink
+        bool compressed{ false }; //The payload is compressed, it is reassembled before being delivered. Only used by the receiver
+        listConfiguration* nextOfAddress{ nullptr }; //Next sequence of the same address inside the sequences index
+        bool indexed{ false }; //It is inside the sequences index, it is not when the index is full
+        uint16_t group{ 0 }; //Group address of a multicast sequence
+        uint16_t upstream{ 0 }; //Neighbour that the missing packets of a multicast sequence are requested to, the next hop to the source
+        bool complete{ false }; //All the packets of the multicast sequence are stored, they are kept to repair the neighbours
+        uint8_t priority{ DEFAULT_PRIORITY }; //Priority of the packets of the sequence in the send queue. Only used by the sender
+        uint8_t fecBlock{ 0 }; //Packets covered by every parity packet, 0 without parity packets
+        uint8_t lastPacketSize{ 0 }; //Payload bytes of the last packet, known with the SYNC packet when there are parity packets
+        uint8_t* fecParity{ nullptr }; //Parity of the packets of the block: the sender builds the parity packet with it, the receiver the packets received in order
+        uint16_t fecNext{ 1 }; //Next packet added to the parity. Only used by the sender
+        LM_LinkedList<QueuePacket<ControlPacket>>* parityList{ nullptr }; //Parity packets not sent yet by the sender, or of the blocks not completed yet by the receiver
+        uint16_t lastParity{ 0 }; //First packet of the block of the last parity packet received. Only used by the receiver
+        uint32_t sentPackets{ 0 }; //Packets sent including the resent ones, to estimate the loss to the destination. Only used by the sender
+        uint16_t congestionVia{ 0 }; //Next hop whose congestion window has the packets in flight of the sequence. Only used by the sender
+        uint16_t inFlight{ 0 }; //Packets in flight of the sequence added to the congestion window of congestionVia. Only used by the sender
     };
 
-    enum QueueType {
-        WRP,
-        WSP
-    };
+    /**
+     * @brief Manage the sequences of the Q_WSP and Q_WRP whose timeout has been reached, resending the packets
+     * and erasing them if lost connection
+     *
+     */
+    void managerTimeouts();
 
-    void managerTimeouts(LM_LinkedList<listConfiguration>* queue, QueueType type);
+    /**
+     * @brief Add the sequence timeout to the timeouts heap and wake the queue manager if it is the earliest one
+     *
+     * @param configPacket configuration packet with the timeout set
+     */
+    void scheduleTimeout(sequencePacketConfig* configPacket);
 
     /**
      * @brief Actualize the RTT field
@@ -921,7 +1940,7 @@ private:
      * @return true If has been send
      * @return false If not
      */
-    void processLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num);
+    void processLostPacket(uint16_t destination, LM_SeqId seq_id, uint16_t seq_num);
 
     /**
      * @brief Send a packet of the sequence of the specific list configuration and sequence_num
@@ -934,12 +1953,197 @@ private:
     bool sendPacketSequence(listConfiguration* lstConfig, uint16_t seq_num);
 
     /**
-     * @brief Join all the packets inside the list configuration and notify the user
+     * @brief Send the packets of the sequence that fit inside the window, from the last packet sent
+     * up to the last ACK received plus the window size, and inside the congestion window of the next hop
+     *
+     * @param lstConfig List configuration
+     */
+    void sendPacketSequenceWindow(listConfiguration* lstConfig);
+
+    /**
+     * @brief Get the congestion window of the actual next hop of a sent sequence and move the packets in flight of the
+     * sequence to it, the route can have changed since the last packets. It is initialized for the first sequence.
+     *
+     * @param lstConfig List configuration of the sent sequence
+     * @return CongestionWindow* Congestion window, nullptr if it is disabled or the next hop is not inside the routing table
+     */
+    CongestionWindow* updateCongestionWindow(listConfiguration* lstConfig);
+
+    /**
+     * @brief Remove the packets in flight of a sent sequence from the congestion window of its next hop
+     *
+     * @param lstConfig List configuration of the sent sequence
+     */
+    void releaseCongestionWindow(listConfiguration* lstConfig);
+
+    /**
+     * @brief Grow the congestion window of the next hop with the packets acknowledged. It only grows while it limits the packets in flight.
+     *
+     * @param lstConfig List configuration of the sent sequence
+     * @param acknowledged Packets acknowledged
+     */
+    void increaseCongestionWindow(listConfiguration* lstConfig, uint16_t acknowledged);
+
+    /**
+     * @brief Decrease the congestion window of a next hop, at most once every round trip. The losses of the
+     * packets sent in the same round trip, by this or other sequences, are a single congestion event.
+     *
+     * @param via Next hop
+     * @param rtt Smoothed round trip through the next hop, 0 if unknown
+     * @param timeout If true the window is halved, otherwise it is decreased by a quarter
+     */
+    void decreaseCongestionWindow(uint16_t via, unsigned long rtt, bool timeout);
+
+    /**
+     * @brief Send the packets allowed by the congestion window of a next hop of the other sequences through it,
+     * after an ACK or the end of a sequence left room inside it
+     *
+     * @param via Next hop
+     * @param lstConfig List configuration of the sequence that has already filled its window, nullptr if none
+     */
+    void sendCongestedSequences(uint16_t via, listConfiguration* lstConfig);
+
+    /**
+     * @brief Add the time that a packet of a reliable payload has waited inside the send queue to the congestion
+     * window of its next hop, a long wait decreases it
+     *
+     * @param tx Packet of a reliable payload sent by this node
+     * @param via Next hop
+     */
+    void addCongestionQueueDelay(QueuePacket<Packet<uint8_t>>* tx, uint16_t via);
+
+    /**
+     * @brief Split the payload in a sequence of packets and start sending it
+     *
+     * @param dst destination address, it cannot be the broadcast address
+     * @param payload payload to send
+     * @param payloadSize payload size to be send in Bytes
+     * @param compressed If the payload is compressed
+     * @param qos Class and max age of the payload
+     * @return LM_SendStatus OK if it has been started
+     */
+    LM_SendStatus sendReliableSequence(uint16_t dst, const uint8_t* payload, uint32_t payloadSize, bool compressed, const LM_QoS& qos);
+
+    /**
+     * @brief Check if a new sequence can be started, the rejected sequences are counted
+     *
+     * @param queue Queue of the sequences
+     * @param maxSequences Maximum number of sequences inside the queue, 0 to not limit them
+     * @param payloadSize Bytes of the payload that will be allocated
+     * @return LM_SendStatus OK, QUEUE_FULL or NO_MEMORY
+     */
+    LM_SendStatus checkSendSequenceLimits(LM_LinkedList<listConfiguration>* queue, uint16_t maxSequences, uint32_t payloadSize);
+
+    /**
+     * @brief Start a send sequence, add it to the q_WSP and send the SYNC packet
+     *
+     * @param lstConfig List configuration with the SYNC packet inside the list
+     * @param qos Class and max age of the payload
+     */
+    void startSendSequence(listConfiguration* lstConfig, const LM_QoS& qos);
+
+    /**
+     * @brief Create the packet of the sequence reading its payload from the source and add it to the list
+     *
+     * @param lstConfig List configuration with a source
+     * @param seq_num number of the packet inside the sequence id
+     * @return QueuePacket<ControlPacket>* Queue packet added or nullptr if the source could not be read
+     */
+    QueuePacket<ControlPacket>* createSourcePacket(listConfiguration* lstConfig, uint16_t seq_num);
+
+    /**
+     * @brief Delete the packets of a sequence with a source that have been acknowledged
+     *
+     * @param lstConfig List configuration with a source
+     */
+    void deleteAcknowledgedPackets(listConfiguration* lstConfig);
+
+    /**
+     * @brief Send a selective ACK packet of a received sequence. It contains the last consecutive packet received
+     * and a bitmap of the packets received after it, the bit i is the packet lastAck + 1 + i.
+     *
+     * @param listConfig List configuration of the received sequence
+     */
+    void sendSackPacket(listConfiguration* listConfig);
+
+    /**
+     * @brief Get the packets of every parity block of a sequence to the node, from the packets resent to it
+     *
+     * @param node Node of the routing table of the destination
+     * @return uint8_t Packets of every block, 0 without parity packets
+     */
+    uint8_t getFecBlock(RouteNode* node);
+
+    /**
+     * @brief Update the loss rate of the destination of a sent sequence that has been acknowledged
+     *
+     * @param lstConfig List configuration of the sent sequence
+     */
+    void updateLossRate(listConfiguration* lstConfig);
+
+    /**
+     * @brief Add the payload of a packet to the parity of its block. After the last packet of the block the parity
+     * packet is created and stored until it is sent. The packets are added once, in order
+     *
+     * @param lstConfig List configuration of the sent sequence
+     * @param seq_num Number of the packet
+     * @param payload Payload of the packet, not encrypted
+     * @param payloadSize Size of the payload
+     */
+    void addParityPacket(listConfiguration* lstConfig, uint16_t seq_num, const uint8_t* payload, size_t payloadSize);
+
+    /**
+     * @brief Send the parity packet of the block if the packet is the last one of it. It is only sent once,
+     * the packets resent alone do not repeat it
+     *
+     * @param lstConfig List configuration of the sent sequence
+     * @param seq_num Number of the packet sent
+     */
+    void sendParityPacket(listConfiguration* lstConfig, uint16_t seq_num);
+
+    /**
+     * @brief Process a parity packet. If it is the only packet of the block missing it is rebuilt and processed as
+     * received, otherwise the parity packet is kept until its block can be rebuilt or it is completed by the packets resent
+     *
+     * @param pq Parity packet
+     */
+    void processParityPacket(QueuePacket<ControlPacket>* pq);
+
+    /**
+     * @brief Rebuild the first packet missing of a received sequence with the parity packet of its block.
+     * The parity packets of the blocks completed are deleted
+     *
+     * @param listConfig List configuration of the received sequence
+     * @return true If the packet has been rebuilt and processed, the sequence could have been completed and deleted
+     * @return false If it cannot be rebuilt yet
+     */
+    bool recoverWithParity(listConfiguration* listConfig);
+
+    /**
+     * @brief Update the sequence with a cumulative ACK. If all the packets are acknowledged the sequence is deleted.
+     *
+     * @param listConfig List configuration of the sent sequence
+     * @param seq_num Sequence number that has been Acknowledged
+     * @return true If the sequence continues and the ACK is valid
+     * @return false If the sequence has been finished or the ACK is old
+     */
+    bool updateAck(listConfiguration* listConfig, uint16_t seq_num);
+
+    /**
+     * @brief Notify the user with the payload reassembled inside the list configuration, or finish the sink, and clear the sequence
      *
      * @param listConfig list configuration to join
      */
     void joinPacketsAndNotifyUser(listConfiguration* listConfig);
 
+    /**
+     * @brief Deliver the payload of a packet of the sequence to the sink or copy it to its position inside the appPacket
+     *
+     * @param listConfig list configuration of the received sequence
+     * @param cPacket packet of the sequence
+     */
+    void deliverSequencePayload(listConfiguration* listConfig, ControlPacket* cPacket);
+
     /**
      * @brief If executed it will reset the number of timeouts to 0 and reset the timeout
      *
@@ -947,7 +2151,7 @@ private:
      * @param seq_id sequence id
      * @param source source address
      */
-    void addTimeout(LM_LinkedList<listConfiguration>* queue, uint8_t seq_id, uint16_t source);
+    void addTimeout(LM_LinkedList<listConfiguration>* queue, LM_SeqId seq_id, uint16_t source);
 
     /**
      * @brief If executed it will reset the number of timeouts to 0 and reset the timeout
@@ -1002,14 +2206,25 @@ private:
     void findAndClearLinkedList(LM_LinkedList<listConfiguration>* queue, listConfiguration* listConfig);
 
     /**
-     * @brief With a sequence id and a linkedList, it will find the first sequence inside a queue that have the sequence id
+     * @brief With a sequence id and a linkedList, it will find the first sequence inside a queue that have the sequence id.
+     * It is found through the sequences index by address
      *
      * @param queue Queue to find the sequence id
      * @param seq_id Sequence id to find
      * @param source Source of the list
      * @return listConfiguration*
      */
-    listConfiguration* findSequenceList(LM_LinkedList<listConfiguration>* queue, uint8_t seq_id, uint16_t source);
+    listConfiguration* findSequenceList(LM_LinkedList<listConfiguration>* queue, LM_SeqId seq_id, uint16_t source);
+
+    /**
+     * @brief Get the queue of a queue type
+     *
+     * @param type Queue type
+     * @return LM_LinkedList<listConfiguration>* Q_WRP, Q_WSP or Q_WMP
+     */
+    LM_LinkedList<listConfiguration>* getSequenceQueue(QueueType type) {
+        return type == QueueType::WRP ? q_WRP : type == QueueType::WSP ? q_WSP : q_WMP;
+    }
 
     /**
      * @brief Queue Waiting Sending Packets (Q_WSP)
@@ -1025,18 +2240,191 @@ private:
      */
     LM_LinkedList<listConfiguration>* q_WRP = new LM_LinkedList<listConfiguration>();
 
+    /**
+     * @brief Queue Waiting Multicast Packets (Q_WMP)
+     * Multicast sequences sent, received or forwarded by this node, with the packets in order by number and encrypted
+     *
+     */
+    LM_LinkedList<listConfiguration>* q_WMP = new LM_LinkedList<listConfiguration>();
+
+    /**
+     * @brief Groups joined by the node, 0 is a free position
+     *
+     */
+    uint16_t groups[LM_MAX_GROUPS] = { 0 };
+
+    /**
+     * @brief Send the payload as a multicast sequence to a group. The packets are kept to repair the neighbours
+     * during LM_MULTICAST_LINGER
+     *
+     * @param group Group address
+     * @param payload Payload, already compressed
+     * @param payloadSize Payload size in bytes
+     * @param compressed The payload is compressed
+     * @return LM_SendStatus OK if it has been started
+     */
+    LM_SendStatus sendMulticastSequence(uint16_t group, const uint8_t* payload, uint32_t payloadSize, bool compressed);
+
+    /**
+     * @brief Process a packet of a multicast sequence. It is stored, forwarded once if there are nodes that could
+     * need it and the payload is delivered to the user when all the packets are received and the node is a member
+     *
+     * @param pq Queue packet, it is stored or deleted
+     */
+    void processMulticastPacket(QueuePacket<ControlPacket>* pq);
+
+    /**
+     * @brief Process a multicast NACK, the packets requested that are stored are sent again
+     *
+     * @param p Multicast NACK
+     */
+    void processMulticastNack(ControlPacket* p);
+
+    /**
+     * @brief Send a multicast NACK to the upstream neighbour. The number is the first packet missing and the bitmap
+     * the missing packets after it, the bit i is the packet number + 1 + i
+     *
+     * @param listConfig List configuration of the multicast sequence
+     */
+    void sendMulticastNack(listConfiguration* listConfig);
+
+    /**
+     * @brief Send a stored packet of a multicast sequence with this node as via
+     *
+     * @param pq Queue packet of the sequence
+     */
+    void transmitMulticastPacket(QueuePacket<ControlPacket>* pq);
+
+    /**
+     * @brief Decrypt and join the payload of a complete multicast sequence and notify the user
+     *
+     * @param listConfig List configuration of the multicast sequence
+     */
+    void deliverMulticastPayload(listConfiguration* listConfig);
+
+    /**
+     * @brief Manage the timeout of a multicast sequence, requesting the missing packets with a backoff
+     *
+     * @param listConfig List configuration of the multicast sequence
+     * @return true If the sequence continues
+     * @return false If the sequence has to be cleared, it was complete or the maximum timeouts has been reached
+     */
+    bool manageMulticastTimeout(listConfiguration* listConfig);
+
+    /**
+     * @brief Set the timeout of a multicast sequence
+     *
+     * @param configPacket Configuration of the sequence
+     * @param timeout Milliseconds from now
+     */
+    void setMulticastTimeout(sequencePacketConfig* configPacket, unsigned long timeout);
+
+    /**
+     * @brief Timeouts of the sequences of the Q_WSP and Q_WRP ordered by deadline, the queue manager sleeps until the first one
+     *
+     */
+    LM_DeadlineHeap<sequencePacketConfig>* sequenceTimeouts = new LM_DeadlineHeap<sequencePacketConfig>();
+
+    /**
+     * @brief Index of the sequences of the Q_WSP and Q_WRP by address. Every entry is the first sequence of the address,
+     * the others are linked with nextOfAddress. It is protected by the sequencesIndexMux.
+     *
+     */
+    LM_AddressMap<listConfiguration, RTMAXSIZE>* sequencesIndex = new LM_AddressMap<listConfiguration, RTMAXSIZE>();
+
+    portMUX_TYPE sequencesIndexMux = portMUX_INITIALIZER_UNLOCKED;
+
+    /**
+     * @brief Number of sequences that did not fit inside the sequences index, they are found scanning the queues
+     *
+     */
+    size_t unindexedSequences = 0;
+
+    /**
+     * @brief Add the sequence to the sequences index
+     *
+     * @param listConfig List configuration
+     */
+    void indexSequence(listConfiguration* listConfig);
+
+    /**
+     * @brief Remove the sequence from the sequences index
+     *
+     * @param listConfig List configuration
+     */
+    void unindexSequence(listConfiguration* listConfig);
+
     /**
      * @brief Max time on air for a given configuration in ms
      *
      */
     uint32_t maxTimeOnAir = 0;
 
+    /**
+     * @brief Configured transmission power in dBm, the actual power set in the radio and the output pin
+     *
+     */
+    int8_t txPower = LM_POWER;
+    bool txUseRfo = false;
+
+    /**
+     * @brief Get the transmission power of a packet, reduced with the SNR at which its next hop receives this node
+     *
+     * @param p Packet to be sent
+     * @return int8_t Power in dBm
+     */
+    int8_t getLinkTransmitPower(Packet<uint8_t>* p);
+
+    /**
+     * @brief Set the transmission power in a radio if it is not the actual one
+     *
+     * @param radioState Radio
+     * @param power Power in dBm
+     */
+    void setTransmitPower(RadioState& radioState, int8_t power);
+
+    /**
+     * @brief Get the channel of a packet. The SYNC, broadcast and routing packets are sent in the control channel,
+     * the others in the data channel of the session with their next hop
+     *
+     * @param p Packet to be sent
+     * @return uint8_t Channel
+     */
+    uint8_t getPacketChannel(Packet<uint8_t>* p);
+
+    /**
+     * @brief Set the channel in a radio if it is not the actual one
+     *
+     * @param radioState Radio
+     * @param channel Channel
+     */
+    void setRadioChannel(RadioState& radioState, uint8_t channel);
+
+    /**
+     * @brief Announce the data channel of a sequence inside its SYNC packet, 0 to continue it in the control channel
+     *
+     * @param listConfig Sequence
+     * @param channel Channel
+     */
+    void setSequenceChannel(listConfiguration* listConfig, uint8_t channel);
+
     /**
      * @brief Wait before sending function
      *
+     * @param radioState Radio that sends
      * @param repeatedDetectPreambles Number of repeated detected preambles
      */
-    void waitBeforeSend(uint8_t repeatedDetectPreambles);
+    void waitBeforeSend(RadioState& radioState, uint8_t repeatedDetectPreambles);
+
+    /**
+     * @brief Listen before talk, scan the channel with CAD until it is free. When it is busy it receives the packet
+     * and waits a random backoff of up to 2^attempt slots, the exponent is capped at LM_LBT_MAX_BACKOFF_EXP.
+     *
+     * @param radioState Radio that sends
+     * @return true If the channel is free
+     * @return false If it was still busy after LM_LBT_MAX_ATTEMPTS scans
+     */
+    bool waitChannelFree(RadioState& radioState);
 
     /**
      * @brief Max propagation time for a given configuration in ms
@@ -1058,12 +2446,6 @@ private:
      */
     void recalculateMaxTimeOnAir();
 
-    /**
-     * @brief Has received a Message when scanning channels
-     *
-     */
-    bool hasReceivedMessage = false;
-
     /** @brief Get the Simulator Service object
      *
      * @return SimulatorService*
@@ -1074,9 +2456,9 @@ private:
      * @brief Record the state of the LoRaMesher
      *
      * @param type Type of the state
-     * @param packet Packet to be recorded
+     * @param pq Packet to be recorded with its parsed view
      */
-    void recordState(LM_StateType type, Packet<uint8_t>* packet = nullptr);
+    void recordState(LM_StateType type, QueuePacket<Packet<uint8_t>>* pq = nullptr);
 
     /**
      * @brief Remove the node from Q_WSP and Q_WRP
@@ -3,6 +3,8 @@
 
 #include "BuildOptions.h"
 
+#include "services/PacketPoolService.h"
+
 /**
  * @brief Application packet, it is used to send the packet to the application layer
  *
@@ -29,6 +31,18 @@ public:
      */
     uint32_t payloadSize = 0;
 
+    /**
+     * @brief Time in microseconds when it was added to the received application packets queue
+     *
+     */
+    uint32_t timestamp = 0;
+
+    /**
+     * @brief Link used by the received application packets queue
+     *
+     */
+    AppPacket<T>* next = nullptr;
+
     /**
      * @brief Payload Array
      *
@@ -51,7 +65,7 @@ public:
      */
     void operator delete(void* p) {
         ESP_LOGV(LM_TAG, "Deleting app packet");
-        vPortFree(p);
+        PacketPoolService::releasePayload(p);
     }
 };
 
@@ -5,10 +5,12 @@
 
 #include "BuildOptions.h"
 
+#include "services/PacketPoolService.h"
+
 #pragma pack(1)
 class ControlPacket final: public RouteDataPacket {
 public:
-    uint8_t seq_id = 0;
+    LM_SeqId seq_id = 0;
     uint16_t number = 0;
     uint8_t payload[];
 
@@ -28,9 +30,18 @@ public:
      */
     void operator delete(void* p) {
         ESP_LOGV(LM_TAG, "Deleting Control packet");
-        vPortFree(p);
+        PacketPoolService::release(p);
     }
 };
+
+/**
+ * @brief ACK of another sequence to the same node, inside the payload of an ACK packet
+ *
+ */
+struct AckRecord {
+    LM_SeqId seq_id;
+    uint16_t number;
+};
 #pragma pack()
 
 #endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define _LORAMESHER_PACKET_H
 
 #include "BuildOptions.h"
+
+#include "services/PacketPoolService.h"
 #include "PacketHeader.h"
 
 #pragma pack(1)
@@ -18,7 +20,7 @@ public:
      */
     void operator delete(void* p) {
         ESP_LOGV(LM_TAG, "Deleting  packet");
-        vPortFree(p);
+        PacketPoolService::release(p);
     }
 
 };
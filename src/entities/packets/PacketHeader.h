@@ -3,6 +3,8 @@
 
 #include "BuildOptions.h"
 
+#include "services/PacketPoolService.h"
+
 #pragma pack(1)
 class PacketHeader {
 public:
@@ -13,6 +15,12 @@ public:
     uint8_t id;
     uint8_t packetSize = 0;
 
+    /**
+     * @brief The destination is a group address, the packet is for all the members of the group
+     *
+     */
+    bool isGroupDestination() const { return dst >= LM_GROUP_ADDR_FIRST; }
+
     /**
      * @brief Delete function for Packets
      *
@@ -20,7 +28,7 @@ public:
      */
     void operator delete(void* p) {
         ESP_LOGV(LM_TAG, "Deleting Header packet");
-        vPortFree(p);
+        PacketPoolService::release(p);
     }
 
 };
@@ -0,0 +1,86 @@
+#ifndef _LORAMESHER_PACKET_VIEW_H
+#define _LORAMESHER_PACKET_VIEW_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Class of a packet given by its type
+ *
+ */
+enum class PacketClass : uint8_t {
+    UNKNOWN = 0,
+    ROUTE,
+    DATA,
+    CONTROL
+};
+
+/**
+ * @brief Parsed view of a packet, filled once by PacketService::parsePacket when the packet is received or sent.
+ * It is stored in the QueuePacket next to the packet buffer, the header fields are read from the buffer with it
+ * without checking the type again. It must be parsed again if the type or the size of the packet change.
+ *
+ */
+class PacketView {
+public:
+    /**
+     * @brief Class of the packet
+     *
+     */
+    PacketClass packetClass = PacketClass::UNKNOWN;
+
+    /**
+     * @brief Header length in bytes, the payload starts after it
+     *
+     */
+    uint8_t headerLength = 0;
+
+    /**
+     * @brief Payload length in bytes
+     *
+     */
+    uint8_t payloadLength = 0;
+
+    /**
+     * @brief The whole packet is control data, routing packets, ACKs and lost packets
+     *
+     */
+    bool controlOnly = false;
+
+    bool isRoute() const { return packetClass == PacketClass::ROUTE; }
+
+    /**
+     * @brief Data and control packets have the via
+     *
+     */
+    bool isData() const { return packetClass == PacketClass::DATA || packetClass == PacketClass::CONTROL; }
+
+    /**
+     * @brief Control packets have the sequence id and number
+     *
+     */
+    bool isControl() const { return packetClass == PacketClass::CONTROL; }
+
+    /**
+     * @brief Get the payload of the packet
+     *
+     * @param p Packet of the view
+     * @return uint8_t* First byte of the payload
+     */
+    uint8_t* getPayload(void* p) const { return static_cast<uint8_t*>(p) + headerLength; }
+
+    /**
+     * @brief Get the bytes of user payload, 0 for the control only packets
+     *
+     */
+    size_t getUserPayloadLength() const { return controlOnly ? 0 : payloadLength; }
+
+    /**
+     * @brief Get the bytes of control, the header or the whole packet for the control only packets
+     *
+     */
+    size_t getControlLength() const { return controlOnly ? headerLength + payloadLength : headerLength; }
+};
+
+static_assert(sizeof(PacketView) == 4, "The packet view is stored inside every queue packet");
+
+#endif
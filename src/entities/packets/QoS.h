@@ -0,0 +1,75 @@
+#ifndef _LORAMESHER_QOS_H
+#define _LORAMESHER_QOS_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Class of service of a payload, it sets the priority of its packets inside the send queue
+ *
+ */
+enum class LM_QoSClass : uint8_t {
+    BACKGROUND, // Sent when there are no other payloads waiting
+    NORMAL,     // Default class of the payloads
+    URGENT      // Sent before the other payloads, after the packets of the protocol
+};
+
+/**
+ * @brief Packet dropped when a queue is full or the heap budget has been reached
+ *
+ */
+enum class LM_DropPolicy : uint8_t {
+    TAIL_DROP,      // The new packet
+    OLDEST,         // The packet that has been waiting the longest
+    LOWEST_PRIORITY // The oldest packet of the lowest priority, the new one if it has the lowest priority
+};
+
+/**
+ * @brief Result of giving a payload to LoraMesher to be sent
+ *
+ */
+enum class LM_SendStatus : uint8_t {
+    OK,             // It has been queued to be sent
+    INVALID,        // Empty payload or it cannot be sent to the destination
+    NO_ROUTE,       // The destination is not inside the routing table
+    QUEUE_FULL,     // The send queue or the reliable sequences are full, try again later
+    NO_MEMORY       // The heap budget has been reached or the memory could not be allocated, try again later
+};
+
+/**
+ * @brief Quality of service of a payload. The deadline is only known by the node that sends the payload,
+ * the relays forward its packets with the default priority.
+ *
+ */
+struct LM_QoS {
+    LM_QoSClass qosClass = LM_QoSClass::NORMAL;
+
+    // Maximum time in ms that the packets can wait in the send queue, 0 without limit. A reliable payload is
+    // cancelled if it has not been acknowledged after this time. It is limited to LM_QOS_MAX_AGE
+    uint32_t maxAge = 0;
+
+    // When the max age is reached the packets are sent with the lowest priority instead of being dropped
+    bool demote = false;
+
+    LM_QoS() = default;
+
+    LM_QoS(LM_QoSClass qosClass, uint32_t maxAge = 0, bool demote = false):
+        qosClass(qosClass), maxAge(maxAge), demote(demote) {};
+
+    /**
+     * @brief Priority of the packets inside the send queue
+     *
+     * @return uint8_t
+     */
+    uint8_t getPriority() const {
+        switch (qosClass) {
+            case LM_QoSClass::BACKGROUND:
+                return LM_QOS_BACKGROUND_PRIORITY;
+            case LM_QoSClass::URGENT:
+                return LM_QOS_URGENT_PRIORITY;
+            default:
+                return DEFAULT_PRIORITY;
+        }
+    }
+};
+
+#endif
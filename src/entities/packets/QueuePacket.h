@@ -3,14 +3,70 @@
 
 #include "BuildOptions.h"
 
+#include "services/PacketPoolService.h"
+
+#include "PacketView.h"
+
 template <typename T>
 class QueuePacket {
 public:
     uint16_t number = 0;
     uint8_t priority = 0;
-    float rssi = 0;
-    float snr = 0;
+    int8_t rssi = 0;
+
+    /**
+     * @brief Time in microseconds when the packet entered the actual queue, used by the latency statistics
+     *
+     */
+    uint32_t timestamp = 0;
+
+    int8_t snr = 0;
+
+    /**
+     * @brief View of the packet parsed when it is received or sent. The fields are ordered to keep the queue packet inside its pool block
+     *
+     */
+    PacketView view;
+
+    /**
+     * @brief When the deadline is reached the packet is sent with the lowest priority instead of being dropped
+     *
+     */
+    bool demote = false;
+
+    /**
+     * @brief Deadline to be sent, in LM_QOS_DEADLINE_TICK of millis(). 0 without deadline
+     *
+     */
+    uint16_t deadline = 0;
+
     T* packet;
+
+    /**
+     * @brief Link used by the LM_IntrusiveList queues
+     *
+     */
+    QueuePacket<T>* next = nullptr;
+
+    /**
+     * @brief New function for Queue Packets, they are taken from the queue packets pool
+     *
+     * @param size Size of the queue packet
+     */
+    void* operator new(size_t size) {
+        return PacketPoolService::allocateQueuePacket(size);
+    }
+
+    /**
+     * @brief Delete function for Queue Packets
+     *
+     * @param p Queue packet to be deleted
+     */
+    void operator delete(void* p) {
+        PacketPoolService::releaseQueuePacket(p);
+    }
 };
 
+static_assert(sizeof(QueuePacket<uint8_t>) <= PacketPoolService::QUEUE_PACKET_BLOCK_SIZE, "Queue packet does not fit inside the pool blocks");
+
 #endif
@@ -0,0 +1,117 @@
+#ifndef _LORAMESHER_LINK_METRIC_H
+#define _LORAMESHER_LINK_METRIC_H
+
+#include "BuildOptions.h"
+
+#include "RouteNode.h"
+
+/**
+ * @brief Cost of the links used to select the routes. The metric of a route is the sum of the cost of its links
+ * and it is carried inside the HELLO packets, the route with the lowest metric is selected.
+ * All the nodes of the network must use the same link metric.
+ *
+ */
+class LinkMetric {
+public:
+    virtual ~LinkMetric() {}
+
+    /**
+     * @brief Cost of the link with a neighbour
+     *
+     * @param receivedSNR SNR of the packet just received from the neighbour
+     * @param neighbour Route node of the neighbour, nullptr if it is not inside the routing table yet
+     * @return uint8_t Cost between getMinimumLinkCost and getMaximumLinkCost
+     */
+    virtual uint8_t getLinkCost(int8_t receivedSNR, const RouteNode* neighbour) = 0;
+
+    /**
+     * @brief Cost of a perfect link, used to estimate the number of hops of a route
+     *
+     * @return uint8_t Minimum cost, at least 1
+     */
+    virtual uint8_t getMinimumLinkCost() = 0;
+
+    /**
+     * @brief Cost of the worst link
+     *
+     * @return uint8_t Maximum cost
+     */
+    virtual uint8_t getMaximumLinkCost() = 0;
+};
+
+/**
+ * @brief Every link costs 1, the metric is the number of hops
+ *
+ */
+class HopCountLinkMetric : public LinkMetric {
+public:
+    uint8_t getLinkCost(int8_t /*receivedSNR*/, const RouteNode* /*neighbour*/) override { return 1; }
+
+    uint8_t getMinimumLinkCost() override { return 1; }
+
+    uint8_t getMaximumLinkCost() override { return 1; }
+};
+
+/**
+ * @brief ETX like cost, the expected number of transmissions of the link in units of LM_ETX_COST_UNIT.
+ * The delivery ratio of every direction is estimated from the SNR margin over the demodulation floor of the
+ * spreading factor, the sent SNR is used when known, otherwise the link is assumed symmetric.
+ * When the RTT of the neighbour is known, the cost is increased with the RTT variation relative to the SRTT.
+ *
+ */
+class EtxLinkMetric : public LinkMetric {
+public:
+    /**
+     * @brief Construct a new Etx Link Metric object
+     *
+     * @param sf_ Spreading factor of the radio
+     */
+    EtxLinkMetric(uint8_t sf_ = 7): snrFloor(100 - 25 * (int16_t) sf_) {};
+
+    uint8_t getLinkCost(int8_t receivedSNR, const RouteNode* neighbour) override {
+        int8_t sentSNR = receivedSNR;
+        if (neighbour != nullptr && neighbour->sentSNR != 0)
+            sentSNR = neighbour->sentSNR;
+
+        // ETX = 1 / (df * dr), with the delivery ratios in percent
+        uint32_t cost = LM_ETX_COST_UNIT * 10000 / (deliveryRatio(receivedSNR) * deliveryRatio(sentSNR));
+
+        // Unstable links, up to 50% more when RTTVAR reaches SRTT
+        if (neighbour != nullptr && neighbour->SRTT > 0) {
+            unsigned long variation = neighbour->RTTVAR < neighbour->SRTT ? neighbour->RTTVAR : neighbour->SRTT;
+            cost += cost * variation / (2 * neighbour->SRTT);
+        }
+
+        if (cost < LM_ETX_COST_UNIT)
+            return LM_ETX_COST_UNIT;
+
+        return cost > LM_ETX_MAX_LINK_COST ? LM_ETX_MAX_LINK_COST : cost;
+    }
+
+    uint8_t getMinimumLinkCost() override { return LM_ETX_COST_UNIT; }
+
+    uint8_t getMaximumLinkCost() override { return LM_ETX_MAX_LINK_COST; }
+
+private:
+    /**
+     * @brief Demodulation floor of the spreading factor in tenths of dB, from -7.5 dB at SF7 to -20 dB at SF12
+     *
+     */
+    int16_t snrFloor;
+
+    /**
+     * @brief Estimated delivery ratio in percent, 100% with a margin of 5 dB over the floor and 10% at 5 dB under it
+     *
+     */
+    uint32_t deliveryRatio(int8_t snr) {
+        int16_t margin = snr * 10 - snrFloor;
+        if (margin >= 50)
+            return 100;
+        if (margin <= -50)
+            return 10;
+
+        return 55 + margin * 9 / 10;
+    }
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _LORAMESHER_LINK_REPORT_H
+#define _LORAMESHER_LINK_REPORT_H
+
+#include "BuildOptions.h"
+
+#pragma pack(1)
+
+/**
+ * @brief SNR at which a node receives a neighbour, reported back to the neighbour inside the HELLO packets
+ *
+ */
+class LinkReport {
+public:
+    /**
+     * @brief Address of the neighbour
+     *
+     */
+    uint16_t address = 0;
+
+    /**
+     * @brief SNR of the packets received from the neighbour
+     *
+     */
+    int8_t snr = 0;
+
+    LinkReport() {};
+    LinkReport(uint16_t address_, int8_t snr_): address(address_), snr(snr_) {};
+};
+
+#pragma pack()
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _LORAMESHER_LOAD_REPORT_H
+#define _LORAMESHER_LOAD_REPORT_H
+
+#include "BuildOptions.h"
+
+#pragma pack(1)
+
+/**
+ * @brief Load of a gateway, advertised inside the HELLO packets of the gateway and of the nodes with a route to it
+ *
+ */
+class LoadReport {
+public:
+    /**
+     * @brief Address of the gateway
+     *
+     */
+    uint16_t address = 0;
+
+    /**
+     * @brief Load of the gateway, from 0 to 255, the highest of the send queue and the airtime used
+     *
+     */
+    uint8_t load = 0;
+
+    LoadReport() {};
+    LoadReport(uint16_t address_, uint8_t load_): address(address_), load(load_) {};
+};
+
+#pragma pack()
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _LORAMESHER_NEIGHBOUR_STATS_H
+#define _LORAMESHER_NEIGHBOUR_STATS_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Counters of the link with a neighbour
+ *
+ */
+struct LinkCounters {
+    uint32_t txPackets;     // Unicast packets sent with the neighbour as next hop
+    uint32_t rxPackets;     // Packets received with the neighbour as source, HELLO packets included
+    uint32_t retries;       // Retransmissions through the neighbour, failed transmissions and resent sequence packets
+    uint32_t lost;          // Packets lost through the neighbour, reported missing by the receiver or dropped after the retries
+};
+
+/**
+ * @brief Link counters of a neighbour returned by RoutingTableService::getNeighbourStats
+ *
+ */
+struct NeighbourStats {
+    uint16_t address;
+    LinkCounters counters;
+};
+
+#endif
@@ -16,7 +16,7 @@ public:
     uint16_t address = 0;
 
     /**
-     * @brief Metric, how many hops to reach the previous address
+     * @brief Metric, cost to reach the previous address. With the default link metric it is the number of hops
      *
      */
     uint8_t metric = 0;
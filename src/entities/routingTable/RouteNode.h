@@ -1,8 +1,80 @@
 #ifndef _LORAMESHER_ROUTE_NODE_H
 #define _LORAMESHER_ROUTE_NODE_H
 
+#include "BuildOptions.h"
+
 #include "NetworkNode.h"
 
+#include "NeighbourStats.h"
+
+/**
+ * @brief Alternate next hop of a route, learned from the HELLO packets of the other neighbours
+ *
+ */
+class AlternateRoute {
+public:
+    /**
+     * @brief Next hop, 0 if the entry is empty
+     *
+     */
+    uint16_t via = 0;
+
+    /**
+     * @brief Metric of the route through this next hop
+     *
+     */
+    uint8_t metric = 0;
+
+    /**
+     * @brief Timeout of the alternate route
+     *
+     */
+    uint32_t timeout = 0;
+};
+
+/**
+ * @brief AIMD congestion window of the reliable payloads sent through a next hop, shared by all their sequences
+ *
+ */
+class CongestionWindow {
+public:
+    /**
+     * @brief Packets that the sequences through the next hop can have not acknowledged, 0 until the first sequence
+     *
+     */
+    uint8_t size = 0;
+
+    /**
+     * @brief Slow start threshold, the window grows by one packet every acknowledged packet below it and by one packet every window above it
+     *
+     */
+    uint8_t threshold = 0;
+
+    /**
+     * @brief Packets acknowledged since the last increase of the window above the threshold
+     *
+     */
+    uint8_t acknowledged = 0;
+
+    /**
+     * @brief Packets sent through the next hop and not acknowledged
+     *
+     */
+    uint16_t inFlight = 0;
+
+    /**
+     * @brief Smoothed milliseconds that the packets of the sequences wait inside the send queue
+     *
+     */
+    uint16_t queueDelay = 0;
+
+    /**
+     * @brief millis() of the last decrease, the window is decreased at most once every round trip
+     *
+     */
+    uint32_t lastDecrease = 0;
+};
+
 /**
  * @brief Route Node
  *
@@ -21,6 +93,25 @@ public:
      */
     uint32_t timeout = 0;
 
+    /**
+     * @brief Position inside the routes timeouts heap
+     *
+     */
+    int16_t timerIndex = -1;
+
+    /**
+     * @brief The metric, role or via has changed since the last HELLO packet
+     *
+     */
+    bool changed = true;
+
+    /**
+     * @brief The route has been restored from the flash and its next hop has not advertised it yet.
+     * It is used but not advertised in the HELLO packets.
+     *
+     */
+    bool restored = false;
+
     /**
      * @brief Next hop to send the message
      *
@@ -51,6 +142,54 @@ public:
      */
     unsigned long RTTVAR = 0;
 
+    /**
+     * @brief Smoothed percentage of the packets of the reliable payloads resent to the node
+     *
+     */
+    uint8_t lossRate = 0;
+
+    /**
+     * @brief Load advertised by the node if it is a gateway, from 0 to 255
+     *
+     */
+    uint8_t load = 0;
+
+    /**
+     * @brief The node has advertised in its last HELLO packet that it receives the compact headers, only used by the neighbours
+     *
+     */
+    bool compactHeader = false;
+
+    /**
+     * @brief Congestion window of the reliable payloads through this node as next hop, only used by the neighbours
+     *
+     */
+    CongestionWindow congestion;
+
+    /**
+     * @brief Alternate next hops, used when the route through via expires
+     *
+     */
+    AlternateRoute alternates[LM_ROUTE_ALTERNATES];
+
+    /**
+     * @brief Next path used when the load is spread across the equal cost paths
+     *
+     */
+    uint8_t nextPath = 0;
+
+    /**
+     * @brief Counters of the link, only used by the neighbours. Protected by the routing table semaphore.
+     *
+     */
+    LinkCounters counters = {};
+
+    /**
+     * @brief Construct an empty Route Node, used by the arrays of the routing table snapshots
+     *
+     */
+    RouteNode() {};
+
     /**
      * @brief Construct a new Route Node object
      *
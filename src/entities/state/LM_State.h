@@ -2,28 +2,50 @@
 
 #include "entities/packets/ControlPacket.h"
 
+// "LMST" in the exported bytes
+#define LM_STATE_EXPORT_MAGIC 0x54534D4C
+#define LM_STATE_RECORD_VERSION 1
+
 #pragma pack(1)
-enum LM_StateType {
+enum LM_StateType : uint8_t {
     STATE_TYPE_RECEIVED,
     STATE_TYPE_SENT,
     STATE_TYPE_MANAGER
 };
 
+/**
+ * @brief State record of the simulator, stored in the ring of the SimulatorService and exported as it is in memory
+ * (little endian, packed). LM_STATE_RECORD_VERSION must be incremented when the layout changes.
+ *
+ */
 class LM_State {
 public:
-    size_t id = 0;
+    uint32_t id = 0;                        // Number of the record, the gaps are overwritten records
+    uint32_t timestamp = 0;                 // millis() when the state was recorded
     LM_StateType type = STATE_TYPE_RECEIVED;
 
-    size_t receivedQueueSize = 0;
-    size_t sentQueueSize = 0;
-    size_t receivedUserQueueSize = 0;
-    size_t q_WRPSize = 0;
-    size_t q_WSPSize = 0;
-    size_t routingTableSize = 0;
-    size_t secondsSinceStart = 0;
-    size_t freeMemoryAllocation = 0;
-    // TODO: Clone all the routing table?
+    uint16_t receivedQueueSize = 0;
+    uint16_t sentQueueSize = 0;
+    uint16_t receivedUserQueueSize = 0;
+    uint16_t q_WRPSize = 0;
+    uint16_t q_WSPSize = 0;
+    uint16_t routingTableSize = 0;
+    uint32_t freeMemoryAllocation = 0;
+
+    ControlPacket packetHeader;             // Header of the packet, the fields that the packet type has not are 0
+};
 
-    ControlPacket packetHeader;
+/**
+ * @brief Header written at the start of every export of the SimulatorService, followed by numberOfStates records
+ *
+ */
+class LM_StateExportHeader {
+public:
+    uint32_t magic = LM_STATE_EXPORT_MAGIC;
+    uint8_t version = LM_STATE_RECORD_VERSION;
+    uint8_t recordSize = sizeof(LM_State);
+    uint16_t address = 0;                   // Address of the node
+    uint32_t overwrittenStates = 0;         // Records overwritten before being exported since the start
+    uint16_t numberOfStates = 0;            // Records after this header
 };
-#pragma pack()
\ No newline at end of file
+#pragma pack()
@@ -0,0 +1,50 @@
+#ifndef _LORAMESHER_STATS_SNAPSHOT_H
+#define _LORAMESHER_STATS_SNAPSHOT_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Counters of the node returned by LoraMesher::getStatsSnapshot. All of them are copied at the same time,
+ * the relations between them hold inside a snapshot (e.g. the sent control bytes of the sent packets).
+ *
+ */
+struct StatsSnapshot {
+    uint32_t startTime;                 // millis() when the counters started, at the start or at the last reset
+    uint32_t snapshotTime;              // millis() when the snapshot was taken
+
+    uint64_t receivedDataPackets;       // Data packets received
+    uint64_t sentPackets;               // Packets sent, all the types
+    uint64_t receivedHelloPackets;      // HELLO packets received
+    uint64_t sentHelloPackets;          // HELLO packets sent
+    uint64_t receivedBroadcastPackets;  // Broadcast packets received
+    uint64_t forwardedPackets;          // Packets sent with another source
+    uint64_t dataPacketsForMe;          // Data packets received with this node as destination
+    uint64_t receivedIAmVia;            // Data packets received with this node as next hop
+    uint64_t destinyUnreachable;        // Packets dropped because there was no route to the destination
+    uint64_t receivedNotForMe;          // Data packets received with another next hop
+    uint64_t receivedQueueFull;         // Packets dropped because the received packets queue was full
+    uint64_t receivedDuplicates;        // Duplicated packets dropped
+    uint64_t receivedPayloadBytes;      // Payload bytes received
+    uint64_t receivedControlBytes;      // Control bytes received
+    uint64_t sentPayloadBytes;          // Payload bytes sent
+    uint64_t sentControlBytes;          // Control bytes sent
+    uint64_t aggregatedPackets;         // Data packets sent inside aggregated packets
+    uint64_t coalescedAcks;             // ACKs coalesced with another ACK or carried by an aggregated packet
+    uint64_t decryptionFailed;          // Packets dropped because they could not be authenticated
+    uint64_t compressionInputBytes;     // Payload bytes given to the compression
+    uint64_t compressionOutputBytes;    // Payload bytes sent after the compression
+    uint64_t suppressedFloods;          // Flooded packets not forwarded, enough neighbours had forwarded them
+    uint64_t deadlineDrops;             // Packets and reliable payloads dropped because they reached their max age
+    uint64_t deadlineDemotions;         // Packets that reached their max age and were sent with the lowest priority
+    uint64_t sendQueueDrops;            // Packets dropped because the send queue was full or the heap budget was reached
+    uint64_t appQueueDrops;             // Payloads for the user dropped because the received queue was full or the heap budget was reached
+    uint64_t sequencesRejected;         // Reliable sequences not sent or not received because of the limits or the heap budget
+    uint64_t parityPackets;             // Parity packets sent by the reliable sequences
+    uint64_t recoveredPackets;          // Packets of the reliable sequences rebuilt with a parity packet
+    uint64_t congestionDecreases;       // Decreases of the congestion windows of the next hops of the reliable sequences
+    uint64_t compactHeaders;            // Packets sent with a compact header
+    uint64_t compactHeaderSavedBytes;   // Bytes of header not sent by the packets with a compact header
+    uint64_t slottedPackets;            // Packets sent inside the slots of the slotted access
+};
+
+#endif
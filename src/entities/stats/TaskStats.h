@@ -0,0 +1,22 @@
+#ifndef _LORAMESHER_TASK_STATS_H
+#define _LORAMESHER_TASK_STATS_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Minimum free stack in bytes of every task of LoraMesher since it was created, returned by LoraMesher::getTaskStats.
+ * A task near 0 is about to overflow its stack, its stack size in the LoraMesherConfig should be increased.
+ *
+ */
+struct TaskStats {
+    uint32_t receiveStackFree;              // Receiving routine
+    uint32_t dataReceiveStackFree;          // Data receiving routine, 0 if there is no data radio
+    uint32_t sendStackFree;                 // Sending routine
+    uint32_t helloStackFree;                // Hello routine
+    uint32_t processStackFree;              // Process routine
+    uint32_t routingTableManagerStackFree;  // Routing Table Manager routine
+    uint32_t queueManagerStackFree;         // Queue Manager routine
+    uint32_t traceStackFree;                // Trace routine, 0 if it has not been created
+};
+
+#endif
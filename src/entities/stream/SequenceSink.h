@@ -0,0 +1,50 @@
+#ifndef _LORAMESHER_SEQUENCE_SINK_H
+#define _LORAMESHER_SEQUENCE_SINK_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Receiver of the large payloads, it gets the payload in chunks while the sequence arrives instead of
+ * a single AppPacket when it finishes, the payload is never fully buffered.
+ * The functions are called from the LoRaMesher tasks, they should return fast and not wait for the LoRaMesher.
+ *
+ */
+class SequenceSink {
+public:
+    virtual ~SequenceSink() {}
+
+    /**
+     * @brief A new large payload sequence has been started
+     *
+     * @param src Source address
+     * @param seq_id Sequence id
+     * @param numberOfPackets Number of packets of the sequence
+     * @param maxPayloadSize Maximum size in bytes of the payload, the actual size is known at the end
+     * @return true Receive the sequence through this sink
+     * @return false Receive the sequence as an AppPacket
+     */
+    virtual bool onSequenceStart(uint16_t src, LM_SeqId seq_id, uint16_t numberOfPackets, uint32_t maxPayloadSize) = 0;
+
+    /**
+     * @brief A chunk of the payload has been received. The chunks are delivered in order.
+     *
+     * @param src Source address
+     * @param seq_id Sequence id
+     * @param offset Offset in bytes of the chunk inside the payload
+     * @param data Chunk, it is only valid during the call
+     * @param len Size of the chunk in bytes
+     */
+    virtual void onChunk(uint16_t src, LM_SeqId seq_id, uint32_t offset, const uint8_t* data, size_t len) = 0;
+
+    /**
+     * @brief The sequence has finished
+     *
+     * @param src Source address
+     * @param seq_id Sequence id
+     * @param payloadSize Number of bytes delivered
+     * @param completed True if all the payload has been received, false if the sequence has been aborted
+     */
+    virtual void onSequenceEnd(uint16_t src, LM_SeqId seq_id, uint32_t payloadSize, bool completed) = 0;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _LORAMESHER_SEQUENCE_SOURCE_H
+#define _LORAMESHER_SEQUENCE_SOURCE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Provider of a large payload to be sent. The packets of the sequence are read from the source when
+ * the window can send them, only the packets not acknowledged are kept in memory.
+ * The functions are called from the LoRaMesher tasks, they should return fast and not wait for the LoRaMesher.
+ *
+ */
+class SequenceSource {
+public:
+    virtual ~SequenceSource() {}
+
+    /**
+     * @brief Read a chunk of the payload. The same chunk can be read again if its packet needs to be created again.
+     *
+     * @param offset Offset in bytes of the chunk inside the payload
+     * @param buffer Buffer where to copy the chunk
+     * @param len Size of the chunk in bytes
+     * @return size_t Number of bytes copied, if it is lower than len the sequence cannot continue
+     */
+    virtual size_t read(uint32_t offset, uint8_t* buffer, size_t len) = 0;
+
+    /**
+     * @brief The sequence has finished, the source is not used anymore and it can be deleted
+     *
+     * @param dst Destination address
+     * @param seq_id Sequence id
+     * @param completed True if all the payload has been acknowledged, false if the sequence has been aborted
+     */
+    virtual void onSequenceEnd(uint16_t dst, LM_SeqId seq_id, bool completed) = 0;
+};
+
+#endif
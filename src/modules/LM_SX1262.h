@@ -31,9 +31,12 @@ public:
     float getSNR() override;
     int16_t readData(uint8_t* buffer, size_t numBytes) override;
     int16_t transmit(uint8_t* buffer, size_t length) override;
+    int16_t startTransmit(uint8_t* buffer, size_t length) override;
+    int16_t finishTransmit() override;
     uint32_t getTimeOnAir(size_t length) override;
 
     void setDioActionForReceiving(void (*action)()) override;
+    void setDioActionForTransmitting(void (*action)()) override;
     void setDioActionForReceivingTimeout(void (*action)()) override;
     void setDioActionForScanning(void (*action)()) override;
     void setDioActionForScanningTimeout(void (*action)()) override;
@@ -62,6 +62,14 @@ int16_t LM_SX1280::transmit(uint8_t* buffer, size_t length) {
     return module->transmit(buffer, length);
 }
 
+int16_t LM_SX1280::startTransmit(uint8_t* buffer, size_t length) {
+    return module->startTransmit(buffer, length);
+}
+
+int16_t LM_SX1280::finishTransmit() {
+    return module->finishTransmit();
+}
+
 uint32_t LM_SX1280::getTimeOnAir(size_t length) {
     return module->getTimeOnAir(length);
 }
@@ -70,6 +78,10 @@ void LM_SX1280::setDioActionForReceiving(void (*action)()) {
     module->setPacketReceivedAction(action);
 }
 
+void LM_SX1280::setDioActionForTransmitting(void (*action)()) {
+    module->setPacketSentAction(action);
+}
+
 void LM_SX1280::setDioActionForReceivingTimeout(void(*action)()) {
     module->setDio1Action(action);
 }
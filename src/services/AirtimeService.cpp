@@ -0,0 +1,147 @@
+#include "AirtimeService.h"
+
+static const uint32_t AIRTIME_WINDOW_MS = LM_AIRTIME_WINDOW * 1000UL;
+static const uint32_t AIRTIME_BUCKET_MS = AIRTIME_WINDOW_MS / LM_AIRTIME_BUCKETS;
+
+void AirtimeService::setFrequency(float freq) {
+    uint8_t band = numBands - 1;
+
+    for (uint8_t i = 0; i < numBands - 1; i++) {
+        if (freq >= bands[i].minFreq && freq <= bands[i].maxFreq) {
+            band = i;
+            break;
+        }
+    }
+
+    portENTER_CRITICAL(&airtimeMux);
+    bool changed = currentBand != band;
+    currentBand = band;
+    portEXIT_CRITICAL(&airtimeMux);
+
+    //In multi-channel mode it is called before every transmission
+    if (changed)
+        ESP_LOGI(LM_TAG, "Airtime band %d, duty cycle %d permille", band, getDutyCycle());
+}
+
+void AirtimeService::setRegulatoryDutyCycle(bool enabled) {
+    regulatory = enabled;
+}
+
+uint16_t AirtimeService::getDutyCycle() {
+    if (!regulatory || currentBand == numBands - 1)
+        return LM_DUTY_CYCLE * 10;
+
+    return bands[currentBand].dutyCycle;
+}
+
+uint32_t AirtimeService::getBudget() {
+    return AIRTIME_WINDOW_MS / 1000 * getDutyCycle();
+}
+
+void AirtimeService::advance(BandAirtime& band, uint32_t bucket) {
+    if (bucket - band.lastBucket >= LM_AIRTIME_BUCKETS) {
+        memset(band.buckets, 0, sizeof(band.buckets));
+        band.used = 0;
+    }
+    else {
+        while (band.lastBucket != bucket) {
+            band.lastBucket++;
+            uint32_t& expired = band.buckets[band.lastBucket % LM_AIRTIME_BUCKETS];
+            band.used -= expired;
+            expired = 0;
+        }
+    }
+
+    band.lastBucket = bucket;
+}
+
+uint32_t AirtimeService::getTimeUntilAvailable(uint32_t timeOnAir, uint8_t priority) {
+    if (getDutyCycle() >= 1000)
+        return 0;
+
+    uint32_t budget = getBudget();
+    uint32_t limit = priority >= LM_AIRTIME_HIGH_PRIORITY ? budget : budget / 100 * (100 - LM_AIRTIME_RESERVE);
+
+    uint32_t now = millis();
+    uint32_t bucket = now / AIRTIME_BUCKET_MS;
+    uint32_t wait = 0;
+
+    portENTER_CRITICAL(&airtimeMux);
+
+    BandAirtime& band = airtime[currentBand];
+    advance(band, bucket);
+
+    // A packet longer than the limit is sent when the window is empty
+    if (band.used > 0 && band.used + timeOnAir > limit) {
+        uint32_t freed = 0;
+
+        // The oldest bucket leaves the window at the end of the actual bucket
+        for (uint32_t i = 1; i < LM_AIRTIME_BUCKETS; i++) {
+            freed += band.buckets[(bucket + i) % LM_AIRTIME_BUCKETS];
+            wait = (bucket + i) * AIRTIME_BUCKET_MS - now;
+
+            if (band.used - freed + timeOnAir <= limit)
+                break;
+        }
+    }
+
+    portEXIT_CRITICAL(&airtimeMux);
+
+    return wait;
+}
+
+void AirtimeService::addAirtime(uint32_t timeOnAir) {
+    uint32_t bucket = millis() / AIRTIME_BUCKET_MS;
+
+    portENTER_CRITICAL(&airtimeMux);
+
+    BandAirtime& band = airtime[currentBand];
+    advance(band, bucket);
+
+    band.buckets[bucket % LM_AIRTIME_BUCKETS] += timeOnAir;
+    band.used += timeOnAir;
+
+    portEXIT_CRITICAL(&airtimeMux);
+}
+
+AirtimeStats AirtimeService::getStats() {
+    AirtimeStats stats;
+    stats.dutyCycle = getDutyCycle();
+    stats.budget = getBudget();
+    stats.delayedNum = delayedNum;
+
+    portENTER_CRITICAL(&airtimeMux);
+
+    BandAirtime& band = airtime[currentBand];
+    advance(band, millis() / AIRTIME_BUCKET_MS);
+    stats.used = band.used;
+
+    portEXIT_CRITICAL(&airtimeMux);
+
+    stats.remaining = stats.used < stats.budget ? stats.budget - stats.used : 0;
+
+    return stats;
+}
+
+// ETSI EN 300 220 sub-bands, the duty cycle in permille
+const AirtimeService::Band AirtimeService::bands[] = {
+    {863.0F, 865.0F, 1},
+    {865.0F, 868.0F, 10},
+    {868.0F, 868.6F, 10},
+    {868.7F, 869.2F, 1},
+    {869.4F, 869.65F, 100},
+    {869.7F, 870.0F, 10},
+    {0, 0, 0},
+};
+
+const uint8_t AirtimeService::numBands = sizeof(AirtimeService::bands) / sizeof(AirtimeService::Band);
+
+AirtimeService::BandAirtime* AirtimeService::airtime = new AirtimeService::BandAirtime[AirtimeService::numBands]();
+
+uint8_t AirtimeService::currentBand = AirtimeService::numBands - 1;
+
+bool AirtimeService::regulatory = false;
+
+uint32_t AirtimeService::delayedNum = 0;
+
+portMUX_TYPE AirtimeService::airtimeMux = portMUX_INITIALIZER_UNLOCKED;
@@ -0,0 +1,122 @@
+#ifndef _LORAMESHER_AIRTIME_SERVICE_H
+#define _LORAMESHER_AIRTIME_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Airtime statistics of the actual band
+ *
+ */
+struct AirtimeStats {
+    uint16_t dutyCycle;     // Duty cycle of the band in permille
+    uint32_t budget;        // Airtime allowed inside the window in ms
+    uint32_t used;          // Airtime used inside the window in ms
+    uint32_t remaining;     // Airtime remaining inside the window in ms
+    uint32_t delayedNum;    // Number of times that a packet has waited for airtime
+};
+
+/**
+ * @brief Airtime accounting of the transmissions. Every band has a sliding window of LM_AIRTIME_WINDOW seconds
+ * divided in LM_AIRTIME_BUCKETS buckets, a packet can be sent while the airtime used inside the window does not exceed
+ * the duty cycle of the band. The packets with lower priority than LM_AIRTIME_HIGH_PRIORITY leave a reserve of
+ * LM_AIRTIME_RESERVE percent of the budget to the high priority ones.
+ * With the regulatory duty cycle the bands are the EU868 sub-bands, otherwise all the frequencies use LM_DUTY_CYCLE.
+ *
+ */
+class AirtimeService {
+public:
+    /**
+     * @brief Set the frequency used to send, it selects the band
+     *
+     * @param freq Frequency in MHz
+     */
+    static void setFrequency(float freq);
+
+    /**
+     * @brief Use the duty cycle of the EU868 sub-bands instead of LM_DUTY_CYCLE
+     *
+     * @param enabled If true the regulatory duty cycle is used
+     */
+    static void setRegulatoryDutyCycle(bool enabled);
+
+    /**
+     * @brief Get the milliseconds to wait until a packet can be sent in the actual band
+     *
+     * @param timeOnAir Time on air of the packet in ms
+     * @param priority Priority of the packet
+     * @return uint32_t Milliseconds, 0 if it can be sent now
+     */
+    static uint32_t getTimeUntilAvailable(uint32_t timeOnAir, uint8_t priority);
+
+    /**
+     * @brief Add a transmission to the airtime of the actual band
+     *
+     * @param timeOnAir Time on air of the packet in ms
+     */
+    static void addAirtime(uint32_t timeOnAir);
+
+    /**
+     * @brief Count a packet that has waited for airtime
+     *
+     */
+    static void incDelayed() { delayedNum++; }
+
+    /**
+     * @brief Get the airtime statistics of the actual band
+     *
+     * @return AirtimeStats
+     */
+    static AirtimeStats getStats();
+
+private:
+    /**
+     * @brief Sliding window of a band
+     *
+     */
+    struct BandAirtime {
+        uint32_t buckets[LM_AIRTIME_BUCKETS];
+        uint32_t used;
+        uint32_t lastBucket;
+    };
+
+    /**
+     * @brief EU868 sub-band, the last one includes all the other frequencies
+     *
+     */
+    struct Band {
+        float minFreq;
+        float maxFreq;
+        uint16_t dutyCycle;
+    };
+
+    static const Band bands[];
+    static const uint8_t numBands;
+
+    static BandAirtime* airtime;
+    static uint8_t currentBand;
+    static bool regulatory;
+    static uint32_t delayedNum;
+    static portMUX_TYPE airtimeMux;
+
+    /**
+     * @brief Duty cycle of the actual band in permille
+     *
+     */
+    static uint16_t getDutyCycle();
+
+    /**
+     * @brief Airtime allowed inside the window of the actual band in ms
+     *
+     */
+    static uint32_t getBudget();
+
+    /**
+     * @brief Remove the buckets that are outside the window. It must be called inside the critical section.
+     *
+     * @param band Band airtime
+     * @param bucket Actual bucket
+     */
+    static void advance(BandAirtime& band, uint32_t bucket);
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "ChannelService.h"
+
+#include "WiFiService.h"
+
+void ChannelService::configure(float controlFreq, float spacing, uint8_t numDataChannels) {
+    portENTER_CRITICAL(&channelMux);
+
+    controlFrequency = controlFreq;
+    channelSpacing = spacing;
+    dataChannels = numDataChannels;
+    sessionChannel = 0;
+
+    portEXIT_CRITICAL(&channelMux);
+
+    if (numDataChannels > 0)
+        ESP_LOGI(LM_TAG, "Multi-channel mode, control channel %.3f MHz and %d data channels", controlFreq, numDataChannels);
+}
+
+float ChannelService::getFrequency(uint8_t channel) {
+    return controlFrequency + channel * channelSpacing;
+}
+
+uint8_t ChannelService::startSession(uint16_t peer, LM_SeqId seq_id, uint8_t channel) {
+    if (dataChannels == 0)
+        return 0;
+
+    // Spread the sequences of the different pairs of nodes between the data channels
+    if (channel == 0)
+        channel = 1 + (peer ^ WiFiService::getLocalAddress() ^ seq_id) % dataChannels;
+
+    if (channel > dataChannels)
+        return 0;
+
+    portENTER_CRITICAL(&channelMux);
+
+    expireLingering();
+
+    bool started = sessionChannel == 0;
+    if (started) {
+        sessionPeer = peer;
+        sessionSeqId = seq_id;
+        sessionChannel = channel;
+        sessionLingering = false;
+    }
+
+    portEXIT_CRITICAL(&channelMux);
+
+    if (!started) {
+        ESP_LOGV(LM_TAG, "Channel session with %X not started, there is another session", peer);
+        return 0;
+    }
+
+    ESP_LOGI(LM_TAG, "Channel session with %X Seq_Id: %d started in channel %d", peer, seq_id, channel);
+
+    return channel;
+}
+
+bool ChannelService::endSession(uint16_t peer, LM_SeqId seq_id, bool linger) {
+    portENTER_CRITICAL(&channelMux);
+
+    bool ended = sessionChannel != 0 && sessionPeer == peer && sessionSeqId == seq_id && !sessionLingering;
+    if (ended) {
+        if (linger) {
+            sessionLingering = true;
+            sessionLingerUntil = millis() + LM_CHANNEL_LINGER_TIME;
+        }
+        else
+            sessionChannel = 0;
+    }
+
+    portEXIT_CRITICAL(&channelMux);
+
+    if (ended)
+        ESP_LOGI(LM_TAG, "Channel session with %X Seq_Id: %d ended", peer, seq_id);
+
+    return ended;
+}
+
+uint8_t ChannelService::getSendChannel(uint16_t via) {
+    portENTER_CRITICAL(&channelMux);
+
+    expireLingering();
+    uint8_t channel = sessionChannel != 0 && sessionPeer == via ? sessionChannel : 0;
+
+    portEXIT_CRITICAL(&channelMux);
+
+    return channel;
+}
+
+void ChannelService::packetSent(uint16_t via) {
+    portENTER_CRITICAL(&channelMux);
+
+    if (sessionLingering && sessionPeer == via)
+        sessionChannel = 0;
+
+    portEXIT_CRITICAL(&channelMux);
+}
+
+uint8_t ChannelService::getListenChannel() {
+    portENTER_CRITICAL(&channelMux);
+
+    expireLingering();
+    uint8_t channel = sessionChannel;
+
+    portEXIT_CRITICAL(&channelMux);
+
+    return channel;
+}
+
+void ChannelService::expireLingering() {
+    if (sessionLingering && (long) (millis() - sessionLingerUntil) >= 0)
+        sessionChannel = 0;
+}
+
+float ChannelService::controlFrequency = LM_BAND;
+
+float ChannelService::channelSpacing = LM_CHANNEL_SPACING;
+
+uint8_t ChannelService::dataChannels = 0;
+
+uint16_t ChannelService::sessionPeer = 0;
+
+LM_SeqId ChannelService::sessionSeqId = 0;
+
+uint8_t ChannelService::sessionChannel = 0;
+
+bool ChannelService::sessionLingering = false;
+
+unsigned long ChannelService::sessionLingerUntil = 0;
+
+portMUX_TYPE ChannelService::channelMux = portMUX_INITIALIZER_UNLOCKED;
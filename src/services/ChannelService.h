@@ -0,0 +1,102 @@
+#ifndef _LORAMESHER_CHANNEL_SERVICE_H
+#define _LORAMESHER_CHANNEL_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Channels of the multi-channel mode. The channel 0 is the control channel, at the configured frequency,
+ * where all the nodes listen and the HELLO, SYNC and broadcast packets are sent. The data channels are spaced
+ * after it. A reliable sequence to a neighbour can be moved to a data channel announced inside its SYNC packet,
+ * both nodes send and listen to it while the session lasts. A node has at most one session at the same time.
+ * Any timeout of the sequence ends the session, the rest of the sequence continues in the control channel.
+ *
+ */
+class ChannelService {
+public:
+    /**
+     * @brief Configure the channels
+     *
+     * @param controlFreq Frequency of the control channel in MHz
+     * @param spacing Spacing between the channels in MHz
+     * @param numDataChannels Number of data channels, 0 disables the multi-channel mode
+     */
+    static void configure(float controlFreq, float spacing, uint8_t numDataChannels);
+
+    /**
+     * @brief Get if the multi-channel mode is enabled
+     *
+     */
+    static bool isEnabled() { return dataChannels > 0; }
+
+    /**
+     * @brief Get the frequency of a channel
+     *
+     * @param channel Channel, 0 is the control channel
+     * @return float Frequency in MHz
+     */
+    static float getFrequency(uint8_t channel);
+
+    /**
+     * @brief Start a session with a neighbour in a data channel, if there is no other session
+     *
+     * @param peer Address of the neighbour
+     * @param seq_id Sequence id
+     * @param channel Data channel, 0 to select it from the addresses and the sequence id
+     * @return uint8_t Channel of the session, 0 if it could not be started
+     */
+    static uint8_t startSession(uint16_t peer, LM_SeqId seq_id, uint8_t channel = 0);
+
+    /**
+     * @brief End the session of a sequence
+     *
+     * @param peer Address of the neighbour
+     * @param seq_id Sequence id
+     * @param linger If true the session lasts until the next packet to the neighbour is sent, or LM_CHANNEL_LINGER_TIME ms,
+     * used to send the last ACK of the sequence
+     * @return true If the session of the sequence has ended
+     */
+    static bool endSession(uint16_t peer, LM_SeqId seq_id, bool linger = false);
+
+    /**
+     * @brief Channel used to send a packet to a next hop
+     *
+     * @param via Next hop
+     * @return uint8_t Channel of the session with the next hop, 0 if none
+     */
+    static uint8_t getSendChannel(uint16_t via);
+
+    /**
+     * @brief A packet to a next hop has been sent, a lingering session with it ends
+     *
+     * @param via Next hop
+     */
+    static void packetSent(uint16_t via);
+
+    /**
+     * @brief Channel where the node listens
+     *
+     * @return uint8_t Channel of the session, 0 if none
+     */
+    static uint8_t getListenChannel();
+
+private:
+    static float controlFrequency;
+    static float channelSpacing;
+    static uint8_t dataChannels;
+
+    static uint16_t sessionPeer;
+    static LM_SeqId sessionSeqId;
+    static uint8_t sessionChannel;
+    static bool sessionLingering;
+    static unsigned long sessionLingerUntil;
+
+    static portMUX_TYPE channelMux;
+
+    /**
+     * @brief End the lingering session if its time has passed. It must be called inside the critical section.
+     *
+     */
+    static void expireLingering();
+};
+
+#endif
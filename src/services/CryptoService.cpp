@@ -0,0 +1,162 @@
+#include "CryptoService.h"
+
+#include "PacketService.h"
+
+#include "esp_random.h"
+
+static const size_t NONCE_SIZE = 13;
+static const size_t MAX_AAD_SIZE = 7 + sizeof(LM_SeqId);
+
+static_assert(LM_ENCRYPTION_TAG_SIZE >= 4 && LM_ENCRYPTION_TAG_SIZE <= 16 && LM_ENCRYPTION_TAG_SIZE % 2 == 0, "Invalid CCM tag size");
+static_assert(LM_ENCRYPTION_COUNTER_SIZE > 0 && LM_ENCRYPTION_COUNTER_SIZE <= 4, "Invalid frame counter size");
+
+bool CryptoService::setNetworkKey(const uint8_t* key) {
+    if (ccmMutex == nullptr)
+        ccmMutex = xSemaphoreCreateMutex();
+
+    xSemaphoreTake(ccmMutex, portMAX_DELAY);
+
+    enabled = false;
+    mbedtls_ccm_free(&ccm);
+    mbedtls_ccm_init(&ccm);
+
+    if (key != nullptr) {
+        int ret = mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, key, 128);
+        if (ret != 0)
+            ESP_LOGE(LM_TAG, "Network key could not be set, error %d", ret);
+        else
+            enabled = true;
+
+        //Random start, the nonces of a node must not be repeated after a reboot
+        frameCounter = esp_random();
+    }
+
+    xSemaphoreGive(ccmMutex);
+
+    ESP_LOGI(LM_TAG, "Payload encryption %s", enabled ? "enabled" : "disabled");
+
+    return key == nullptr || enabled;
+}
+
+bool CryptoService::isEncryptedType(uint8_t type) {
+    if (!enabled)
+        return false;
+
+    //The SYNC and the aggregated packets have the XL bit, they have no payload of the user
+    return PacketService::isOnlyDataPacket(type) ||
+        (PacketService::isXLPacket(type) && !PacketService::isSyncPacket(type) && !PacketService::isAggregatedPacket(type));
+}
+
+uint8_t CryptoService::getOverhead(uint8_t type) {
+    return isEncryptedType(type) ? LM_ENCRYPTION_COUNTER_SIZE + LM_ENCRYPTION_TAG_SIZE : 0;
+}
+
+void CryptoService::getNonce(uint16_t src, const uint8_t* counter, uint8_t* nonce) {
+    memset(nonce, 0, NONCE_SIZE);
+    memcpy(nonce, &src, sizeof(src));
+    memcpy(nonce + sizeof(src), counter, LM_ENCRYPTION_COUNTER_SIZE);
+}
+
+size_t CryptoService::getAdditionalData(Packet<uint8_t>* p, uint8_t* aad) {
+    memcpy(aad, &p->src, sizeof(p->src));
+    memcpy(aad + 2, &p->dst, sizeof(p->dst));
+    aad[4] = p->type;
+
+    if (!PacketService::isControlPacket(p->type))
+        return 5;
+
+    ControlPacket* cPacket = reinterpret_cast<ControlPacket*>(p);
+    memcpy(aad + 5, &cPacket->seq_id, sizeof(cPacket->seq_id));
+    memcpy(aad + 5 + sizeof(cPacket->seq_id), &cPacket->number, sizeof(cPacket->number));
+
+    return MAX_AAD_SIZE;
+}
+
+bool CryptoService::encryptPacket(Packet<uint8_t>* p) {
+    if (!isEncryptedType(p->type))
+        return true;
+
+    size_t headerSize = PacketService::getHeaderLength(p);
+    uint8_t overhead = getOverhead(p->type);
+
+    if (p->packetSize < headerSize + overhead) {
+        ESP_LOGE(LM_TAG, "Packet without space for the encryption");
+        return false;
+    }
+
+    uint8_t* payload = reinterpret_cast<uint8_t*>(p) + headerSize;
+    size_t payloadSize = p->packetSize - headerSize - overhead;
+    uint8_t* counter = payload + payloadSize;
+    uint8_t* tag = counter + LM_ENCRYPTION_COUNTER_SIZE;
+
+    uint8_t aad[MAX_AAD_SIZE];
+    size_t aadSize = getAdditionalData(p, aad);
+
+    uint8_t nonce[NONCE_SIZE];
+
+    xSemaphoreTake(ccmMutex, portMAX_DELAY);
+
+    uint32_t actualCounter = frameCounter++;
+    memcpy(counter, &actualCounter, LM_ENCRYPTION_COUNTER_SIZE);
+    getNonce(p->src, counter, nonce);
+
+    int ret = mbedtls_ccm_encrypt_and_tag(&ccm, payloadSize, nonce, NONCE_SIZE, aad, aadSize,
+        payload, payload, tag, LM_ENCRYPTION_TAG_SIZE);
+
+    xSemaphoreGive(ccmMutex);
+
+    if (ret != 0) {
+        ESP_LOGE(LM_TAG, "Payload could not be encrypted, error %d", ret);
+        return false;
+    }
+
+    return true;
+}
+
+bool CryptoService::decryptPacket(Packet<uint8_t>* p) {
+    if (!isEncryptedType(p->type))
+        return true;
+
+    size_t headerSize = PacketService::getHeaderLength(p);
+    uint8_t overhead = getOverhead(p->type);
+
+    if (p->packetSize < headerSize + overhead) {
+        ESP_LOGW(LM_TAG, "Encrypted packet too small, %d bytes", p->packetSize);
+        return false;
+    }
+
+    uint8_t* payload = reinterpret_cast<uint8_t*>(p) + headerSize;
+    size_t payloadSize = p->packetSize - headerSize - overhead;
+    const uint8_t* counter = payload + payloadSize;
+    const uint8_t* tag = counter + LM_ENCRYPTION_COUNTER_SIZE;
+
+    uint8_t aad[MAX_AAD_SIZE];
+    size_t aadSize = getAdditionalData(p, aad);
+
+    uint8_t nonce[NONCE_SIZE];
+    getNonce(p->src, counter, nonce);
+
+    xSemaphoreTake(ccmMutex, portMAX_DELAY);
+
+    int ret = mbedtls_ccm_auth_decrypt(&ccm, payloadSize, nonce, NONCE_SIZE, aad, aadSize,
+        payload, payload, tag, LM_ENCRYPTION_TAG_SIZE);
+
+    xSemaphoreGive(ccmMutex);
+
+    if (ret != 0) {
+        ESP_LOGW(LM_TAG, "Packet from %X not authentic, error %d", p->src, ret);
+        return false;
+    }
+
+    p->packetSize -= overhead;
+
+    return true;
+}
+
+mbedtls_ccm_context CryptoService::ccm;
+
+SemaphoreHandle_t CryptoService::ccmMutex = nullptr;
+
+bool CryptoService::enabled = false;
+
+uint32_t CryptoService::frameCounter = 0;
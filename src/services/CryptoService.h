@@ -0,0 +1,93 @@
+#ifndef _LORAMESHER_CRYPTO_SERVICE_H
+#define _LORAMESHER_CRYPTO_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/Packet.h"
+
+#include "mbedtls/ccm.h"
+
+/**
+ * @brief AES-CCM encryption of the data payloads with a network key, using the AES engine of the ESP32 through mbedTLS.
+ * The payload of the data packets and the large payload packets is encrypted in place by the source node and decrypted
+ * by the destination, the nodes in the middle forward it without decrypting it.
+ * The payload is followed by a frame counter of LM_ENCRYPTION_COUNTER_SIZE bytes, that makes the nonce unique with
+ * the source, and the tag truncated to LM_ENCRYPTION_TAG_SIZE bytes. The source, destination, type and, for the
+ * control packets, the sequence id and number are authenticated. The via and the id change on every hop and are not.
+ *
+ */
+class CryptoService {
+public:
+    /**
+     * @brief Set the AES-128 network key, all the nodes of the network must use the same key
+     *
+     * @param key Key of 16 bytes, nullptr disables the encryption
+     * @return true If the key has been set
+     * @return false If the key could not be set, the encryption is disabled
+     */
+    static bool setNetworkKey(const uint8_t* key);
+
+    /**
+     * @brief Get if the encryption is enabled
+     *
+     * @return true If a network key has been set
+     */
+    static bool isEnabled() { return enabled; }
+
+    /**
+     * @brief Get if the payload of a type of packet is encrypted
+     *
+     * @param type Type of the packet
+     * @return true If the encryption is enabled and it is a data packet or a large payload packet
+     * @return false If not
+     */
+    static bool isEncryptedType(uint8_t type);
+
+    /**
+     * @brief Bytes added to the payload of a type of packet
+     *
+     * @param type Type of the packet
+     * @return uint8_t Size of the frame counter and the tag, 0 if the payload is not encrypted
+     */
+    static uint8_t getOverhead(uint8_t type);
+
+    /**
+     * @brief Encrypt the payload in place. The packet must be created with getOverhead bytes more than the payload
+     * and all the header fields authenticated set.
+     *
+     * @param p Packet to be encrypted
+     * @return true If it has been encrypted, or if its type is not encrypted
+     * @return false If it could not be encrypted, it must not be sent
+     */
+    static bool encryptPacket(Packet<uint8_t>* p);
+
+    /**
+     * @brief Authenticate and decrypt the payload in place, the packet size is reduced by getOverhead bytes
+     *
+     * @param p Packet to be decrypted
+     * @return true If it has been decrypted, or if its type is not encrypted
+     * @return false If the packet is not authentic, it must be discarded
+     */
+    static bool decryptPacket(Packet<uint8_t>* p);
+
+private:
+    static mbedtls_ccm_context ccm;
+    static SemaphoreHandle_t ccmMutex;
+    static bool enabled;
+    static uint32_t frameCounter;
+
+    /**
+     * @brief Build the nonce with the source and the frame counter
+     *
+     */
+    static void getNonce(uint16_t src, const uint8_t* counter, uint8_t* nonce);
+
+    /**
+     * @brief Build the additional authenticated data of the packet
+     *
+     * @return size_t Size of the additional data
+     */
+    static size_t getAdditionalData(Packet<uint8_t>* p, uint8_t* aad);
+};
+
+#endif
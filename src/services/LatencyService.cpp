@@ -0,0 +1,96 @@
+#include "LatencyService.h"
+
+static_assert(LM_LATENCY_PRIORITY_CLASSES >= 3, "The priority classes include below and above the default priority");
+
+void LatencyService::record(LatencyStage stage, uint32_t start, uint32_t end) {
+    uint32_t latency = end - start;
+
+    portENTER_CRITICAL(&latencyMux);
+    add(stages[(uint8_t) stage], latency);
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+void LatencyService::recordQueue(uint8_t priority, uint32_t start) {
+    uint32_t latency = now() - start;
+
+    portENTER_CRITICAL(&latencyMux);
+    add(stages[(uint8_t) LatencyStage::TX_QUEUE], latency);
+    add(priorities[getPriorityClass(priority)], latency);
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+LatencyStats LatencyService::getStats(LatencyStage stage) {
+    portENTER_CRITICAL(&latencyMux);
+    LatencyStats stats = getStats(stages[(uint8_t) stage]);
+    portEXIT_CRITICAL(&latencyMux);
+
+    return stats;
+}
+
+LatencyStats LatencyService::getQueueStats(uint8_t priority) {
+    portENTER_CRITICAL(&latencyMux);
+    LatencyStats stats = getStats(priorities[getPriorityClass(priority)]);
+    portEXIT_CRITICAL(&latencyMux);
+
+    return stats;
+}
+
+void LatencyService::reset() {
+    portENTER_CRITICAL(&latencyMux);
+    memset(stages, 0, sizeof(stages));
+    memset(priorities, 0, sizeof(priorities));
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+void LatencyService::add(Histogram& histogram, uint32_t latency) {
+    uint8_t bucket = 0;
+    while (bucket < NUM_BUCKETS - 1 && (latency >> (bucket + 1)) != 0)
+        bucket++;
+
+    histogram.buckets[bucket]++;
+
+    if (histogram.count == 0 || latency < histogram.min)
+        histogram.min = latency;
+    if (latency > histogram.max)
+        histogram.max = latency;
+
+    histogram.count++;
+    histogram.sum += latency;
+}
+
+LatencyStats LatencyService::getStats(const Histogram& histogram) {
+    LatencyStats stats = {histogram.count, histogram.min, 0, 0, histogram.max};
+    if (histogram.count == 0)
+        return stats;
+
+    stats.avg = histogram.sum / histogram.count;
+
+    // First bucket that reaches the 99% of the samples
+    uint32_t target = histogram.count - histogram.count / 100;
+    uint32_t accumulated = 0;
+
+    for (uint8_t i = 0; i < NUM_BUCKETS; i++) {
+        accumulated += histogram.buckets[i];
+        if (accumulated >= target) {
+            uint32_t upper = i == NUM_BUCKETS - 1 ? histogram.max : (2UL << i) - 1;
+            stats.p99 = upper < histogram.max ? upper : histogram.max;
+            break;
+        }
+    }
+
+    return stats;
+}
+
+uint8_t LatencyService::getPriorityClass(uint8_t priority) {
+    if (priority < DEFAULT_PRIORITY)
+        return 0;
+
+    uint8_t priorityClass = priority - DEFAULT_PRIORITY + 1;
+    return priorityClass < LM_LATENCY_PRIORITY_CLASSES ? priorityClass : LM_LATENCY_PRIORITY_CLASSES - 1;
+}
+
+LatencyService::Histogram LatencyService::stages[(uint8_t) LatencyStage::NUM_STAGES] = {};
+
+LatencyService::Histogram LatencyService::priorities[LM_LATENCY_PRIORITY_CLASSES] = {};
+
+portMUX_TYPE LatencyService::latencyMux = portMUX_INITIALIZER_UNLOCKED;
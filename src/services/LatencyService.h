@@ -0,0 +1,127 @@
+#ifndef _LORAMESHER_LATENCY_SERVICE_H
+#define _LORAMESHER_LATENCY_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "esp_timer.h"
+
+/**
+ * @brief Stages of the receive and send pipelines
+ *
+ */
+enum class LatencyStage : uint8_t {
+    RX_READ = 0,    // From the receive interrupt until the packet is read and added to the received packets ring
+    RX_QUEUE,       // Time inside the received packets ring until the process task takes it
+    RX_PROCESS,     // Time processing a received packet
+    APP_QUEUE,      // Time inside the received application packets queue until the application takes it
+    TX_QUEUE,       // Time inside the send queue, all the priorities
+    TX_BACKOFF,     // Time waiting before sending, the random delay or the listen before talk backoff
+    TX_AIR,         // From the start of the transmission until the transmit done interrupt
+    NUM_STAGES
+};
+
+/**
+ * @brief Latency statistics of a stage in microseconds
+ *
+ */
+struct LatencyStats {
+    uint32_t count;     // Number of samples
+    uint32_t min;       // Minimum latency
+    uint32_t avg;       // Average latency
+    uint32_t p99;       // 99th percentile, upper bound of its histogram bucket
+    uint32_t max;       // Maximum latency
+};
+
+/**
+ * @brief Latency of every stage of the packets. Every stage has a histogram with power of two buckets of microseconds,
+ * the percentiles have the precision of the bucket. The send queue time is also recorded by priority classes:
+ * below DEFAULT_PRIORITY, DEFAULT_PRIORITY, the LM_LATENCY_PRIORITY_CLASSES - 3 following priorities and the others above.
+ *
+ */
+class LatencyService {
+public:
+    /**
+     * @brief Actual time in microseconds, it can be called from an interrupt
+     *
+     */
+    static uint32_t now() { return (uint32_t) esp_timer_get_time(); }
+
+    /**
+     * @brief Record the latency of a stage
+     *
+     * @param stage Stage
+     * @param start Time in microseconds when the stage started
+     * @param end Time in microseconds when the stage ended, by default now
+     */
+    static void record(LatencyStage stage, uint32_t start, uint32_t end = now());
+
+    /**
+     * @brief Record the time of a packet inside the send queue
+     *
+     * @param priority Priority of the packet
+     * @param start Time in microseconds when it was added to the queue
+     */
+    static void recordQueue(uint8_t priority, uint32_t start);
+
+    /**
+     * @brief Get the latency statistics of a stage
+     *
+     * @param stage Stage
+     * @return LatencyStats
+     */
+    static LatencyStats getStats(LatencyStage stage);
+
+    /**
+     * @brief Get the send queue latency statistics of the class of a priority
+     *
+     * @param priority Priority
+     * @return LatencyStats
+     */
+    static LatencyStats getQueueStats(uint8_t priority);
+
+    /**
+     * @brief Reset all the statistics
+     *
+     */
+    static void reset();
+
+private:
+    static constexpr uint8_t NUM_BUCKETS = 24;
+
+    /**
+     * @brief Histogram of a stage, the bucket i counts the latencies from 2^i to 2^(i+1) - 1 microseconds.
+     * The last bucket counts all the greater latencies.
+     *
+     */
+    struct Histogram {
+        uint32_t buckets[NUM_BUCKETS];
+        uint32_t count;
+        uint32_t min;
+        uint32_t max;
+        uint64_t sum;
+    };
+
+    static Histogram stages[(uint8_t) LatencyStage::NUM_STAGES];
+    static Histogram priorities[LM_LATENCY_PRIORITY_CLASSES];
+    static portMUX_TYPE latencyMux;
+
+    /**
+     * @brief Add a latency to a histogram
+     *
+     */
+    static void add(Histogram& histogram, uint32_t latency);
+
+    /**
+     * @brief Get the statistics of a histogram
+     *
+     */
+    static LatencyStats getStats(const Histogram& histogram);
+
+    /**
+     * @brief Class of a priority
+     *
+     */
+    static uint8_t getPriorityClass(uint8_t priority);
+};
+
+#endif
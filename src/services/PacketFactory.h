@@ -3,6 +3,10 @@
 
 #include "entities/packets/Packet.h"
 
+#include "services/PacketPoolService.h"
+
+#include "services/TraceService.h"
+
 class PacketFactory {
 public:
 
@@ -45,7 +49,7 @@ public:
         ESP_LOGV(LM_TAG, "Creating packet with %u bytes", actualPacketSize);
 
         // Allocate memory for the packet
-        T* packet = static_cast<T*>(pvPortMalloc(actualPacketSize));
+        T* packet = static_cast<T*>(PacketPoolService::allocate(actualPacketSize));
         if (packet == nullptr) {
             ESP_LOGE(LM_TAG, "Failed to allocate packet memory");
             return nullptr;
@@ -71,7 +75,7 @@ public:
             memcpy(payloadDest, payload, copySize);
         }
 
-        ESP_LOGI(LM_TAG, "Packet created with %u bytes", actualPacketSize);
+        LM_TRACE_I(TraceEvent::PACKET_CREATED, actualPacketSize);
         return packet;
     };
 
@@ -0,0 +1,15 @@
+#include "PacketPoolService.h"
+
+PacketPoolStats PacketPoolService::getStats() {
+    return getPoolStats(pool);
+}
+
+PacketPoolStats PacketPoolService::getQueuePacketStats() {
+    return getPoolStats(queuePacketPool);
+}
+
+LM_BlockPool<LM_PACKET_POOL_BLOCK_SIZE, LM_PACKET_POOL_BLOCKS> PacketPoolService::pool;
+
+LM_BlockPool<PacketPoolService::QUEUE_PACKET_BLOCK_SIZE, LM_QUEUE_PACKET_POOL_BLOCKS> PacketPoolService::queuePacketPool;
+
+LM_CountedHeap PacketPoolService::payloadHeap;
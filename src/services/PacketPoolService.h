@@ -0,0 +1,149 @@
+#ifndef _LORAMESHER_PACKET_POOL_SERVICE_H
+#define _LORAMESHER_PACKET_POOL_SERVICE_H
+
+#include "utilities/BlockPool.hpp"
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Packet pool statistics
+ *
+ */
+struct PacketPoolStats {
+    size_t blockSize;
+    size_t numBlocks;
+    size_t inUse;
+    size_t highWaterMark;
+    uint32_t heapFallbacks;
+    size_t heapInUse;           // Bytes of the heap fallbacks in use
+};
+
+/**
+ * @brief Pool of fixed size blocks used for the packet buffers (Packet, DataPacket, ControlPacket, RoutePacket).
+ * The radio packets are created and deleted continuously, taking them from a preallocated pool prevents the heap
+ * fragmentation. If there are no free blocks or the packet does not fit inside a block it uses the heap.
+ *
+ */
+class PacketPoolService {
+public:
+
+    /**
+     * @brief Size of the blocks of the queue packets pool, a QueuePacket has 12 bytes of fields and two pointers
+     *
+     */
+    static constexpr size_t QUEUE_PACKET_BLOCK_SIZE = 16 + 2 * sizeof(void*);
+
+    /**
+     * @brief Allocate memory for a packet
+     *
+     * @param size Size of the packet in bytes
+     * @return void* Pointer to the packet memory or nullptr if it could not be allocated
+     */
+    static void* allocate(size_t size) {
+        return pool.allocate(size);
+    }
+
+    /**
+     * @brief Release a packet allocated with allocate, the memory is freed when nobody else retains it
+     *
+     * @param p Pointer to the packet
+     */
+    static void release(void* p) {
+        pool.release(p);
+    }
+
+    /**
+     * @brief Add a reference to a packet, it will need an additional release. Used to share the same buffer
+     * between the send queue and the packets waiting for an ACK, instead of copying it.
+     *
+     * @param p Pointer to the packet
+     * @return true If the packet can be shared
+     * @return false If the packet is not inside the pool and it needs to be copied
+     */
+    static bool retain(void* p) {
+        return pool.retain(p);
+    }
+
+    /**
+     * @brief Allocate memory for a queue packet
+     *
+     * @param size Size of the queue packet in bytes
+     * @return void* Pointer to the queue packet memory or nullptr if it could not be allocated
+     */
+    static void* allocateQueuePacket(size_t size) {
+        return queuePacketPool.allocate(size);
+    }
+
+    /**
+     * @brief Free the memory of a queue packet allocated with allocateQueuePacket
+     *
+     * @param p Pointer to the queue packet
+     */
+    static void releaseQueuePacket(void* p) {
+        queuePacketPool.release(p);
+    }
+
+    /**
+     * @brief Allocate memory for a payload delivered to the user (AppPacket) or being reassembled. It is taken from
+     * the heap and counted inside the heap in use
+     *
+     * @param size Size in bytes
+     * @return void* Pointer to the memory or nullptr if it could not be allocated
+     */
+    static void* allocatePayload(size_t size) {
+        return payloadHeap.allocate(size);
+    }
+
+    /**
+     * @brief Free the memory allocated with allocatePayload
+     *
+     * @param p Pointer to the memory, it can be nullptr
+     */
+    static void releasePayload(void* p) {
+        payloadHeap.release(p);
+    }
+
+    /**
+     * @brief Bytes of the heap used by the packets outside the pools, the queue packets outside their pool and the payloads
+     *
+     * @return size_t
+     */
+    static size_t getHeapInUse() {
+        return pool.getHeapInUse() + queuePacketPool.getHeapInUse() + payloadHeap.getInUse();
+    }
+
+    /**
+     * @brief Get the pool statistics
+     *
+     * @return PacketPoolStats
+     */
+    static PacketPoolStats getStats();
+
+    /**
+     * @brief Get the queue packets pool statistics
+     *
+     * @return PacketPoolStats
+     */
+    static PacketPoolStats getQueuePacketStats();
+
+private:
+    static LM_BlockPool<LM_PACKET_POOL_BLOCK_SIZE, LM_PACKET_POOL_BLOCKS> pool;
+
+    static LM_BlockPool<QUEUE_PACKET_BLOCK_SIZE, LM_QUEUE_PACKET_POOL_BLOCKS> queuePacketPool;
+
+    static LM_CountedHeap payloadHeap;
+
+    template <size_t BlockSize, size_t NumBlocks>
+    static PacketPoolStats getPoolStats(const LM_BlockPool<BlockSize, NumBlocks>& blockPool) {
+        PacketPoolStats stats;
+        stats.blockSize = blockPool.getBlockSize();
+        stats.numBlocks = blockPool.getNumBlocks();
+        stats.inUse = blockPool.getInUse();
+        stats.highWaterMark = blockPool.getHighWaterMark();
+        stats.heapFallbacks = blockPool.getHeapFallbacks();
+        stats.heapInUse = blockPool.getHeapInUse();
+        return stats;
+    }
+};
+
+#endif // _LORAMESHER_PACKET_POOL_SERVICE_H
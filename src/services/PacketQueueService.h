@@ -7,6 +7,10 @@
 
 #include "utilities/LinkedQueue.hpp"
 
+#include "utilities/IntrusiveList.hpp"
+
+#include "utilities/PriorityQueue.hpp"
+
 #include "BuildOptions.h"
 
 class PacketQueueService {
@@ -43,7 +47,7 @@ public:
      * @return QueuePacket<T>* QueueElement inside the list
      */
     template<class T>
-    static QueuePacket<T>* findPacketQueue(LM_LinkedList<QueuePacket<T>>* queue, uint8_t num) {
+    static QueuePacket<T>* findPacketQueue(LM_LinkedList<QueuePacket<T>>* queue, uint16_t num) {
         queue->setInUse();
 
         if (queue->moveToStart()) {
@@ -64,12 +68,90 @@ public:
     }
 
     /**
-     * @brief Add the Queue packet into the list ordered
+     * @brief Add the Queue packet into the list ordered by number, from the lowest to the highest
+     *
+     * @tparam T Type of the queue
+     * @param queue Queue where to add the QueuePacket
+     * @param qp Queue packet to be added
+     * @return true If it has been added
+     * @return false If there is already a Queue packet with the same number, it is not added
+     */
+    template<class T>
+    static bool addOrderedByNumber(LM_LinkedList<QueuePacket<T>>* queue, QueuePacket<T>* qp) {
+        queue->setInUse();
+
+        if (queue->moveToStart()) {
+            do {
+                QueuePacket<T>* current = queue->getCurrent();
+
+                if (current->number == qp->number) {
+                    queue->releaseInUse();
+                    return false;
+                }
+
+                if (current->number > qp->number) {
+                    queue->addCurrent(qp);
+                    queue->releaseInUse();
+                    return true;
+                }
+
+            } while (queue->next());
+        }
+
+        queue->Append(qp);
+
+        queue->releaseInUse();
+
+        return true;
+    }
+
+    /**
+     * @brief Set the deadline of a queue packet
+     *
+     * @tparam T Type of packet
+     * @param qp Queue packet
+     * @param maxAge Milliseconds from now until the deadline, 0 without deadline. It is limited to LM_QOS_MAX_AGE
+     * @param demote The packet is sent with the lowest priority after the deadline instead of being dropped
+     */
+    template<class T>
+    static void setDeadline(QueuePacket<T>* qp, uint32_t maxAge, bool demote) {
+        qp->demote = demote;
+
+        if (maxAge == 0) {
+            qp->deadline = 0;
+            return;
+        }
+
+        uint16_t deadline = (millis() + (maxAge < LM_QOS_MAX_AGE ? maxAge : LM_QOS_MAX_AGE)) / LM_QOS_DEADLINE_TICK;
+
+        //0 is reserved to the packets without deadline
+        qp->deadline = deadline == 0 ? 1 : deadline;
+    }
+
+    /**
+     * @brief The queue packet has a deadline and it has been reached
+     *
+     * @tparam T Type of packet
+     * @param qp Queue packet
+     * @return true If it has expired
+     * @return false If not or it has no deadline
+     */
+    template<class T>
+    static bool isExpired(QueuePacket<T>* qp) {
+        if (qp->deadline == 0)
+            return false;
+
+        uint16_t now = millis() / LM_QOS_DEADLINE_TICK;
+        return (int16_t) (uint16_t) (now - qp->deadline) >= 0;
+    }
+
+    /**
+     * @brief Add the Queue packet into the list ordered by priority, after the packets with the same priority
      *
-     * @param list Linked list to add the QueuePacket
+     * @param list Priority queue to add the QueuePacket
      * @param qp Queue packet to be added
      */
-    static void addOrdered(LM_LinkedList<QueuePacket<Packet<uint8_t>>>* list, QueuePacket<Packet<uint8_t>>* qp);
+    static void addOrdered(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>, MAX_PRIORITY>* list, QueuePacket<Packet<uint8_t>>* qp);
 
     /**
      * @brief It will delete the packet queue and the packet inside it
@@ -78,7 +160,7 @@ public:
      */
     static void deleteQueuePacketAndPacket(QueuePacket<Packet<uint8_t>>* pq) {
         ESP_LOGI(LM_TAG, "Deleting packet");
-        vPortFree(pq->packet);
+        PacketPoolService::release(pq->packet);
 
         ESP_LOGI(LM_TAG, "Deleting packet queue");
         delete pq;
@@ -1,5 +1,9 @@
 #include "PacketService.h"
 
+#include "CryptoService.h"
+
+#include <algorithm>
+
 Packet<uint8_t>* PacketService::createEmptyPacket(size_t packetSize) {
     size_t maxPacketSize = PacketFactory::getMaxPacketSize();
     if (packetSize > maxPacketSize) {
@@ -7,7 +11,7 @@ Packet<uint8_t>* PacketService::createEmptyPacket(size_t packetSize) {
         packetSize = maxPacketSize;
     }
 
-    Packet<uint8_t>* p = static_cast<Packet<uint8_t>*>(pvPortMalloc(packetSize));
+    Packet<uint8_t>* p = static_cast<Packet<uint8_t>*>(PacketPoolService::allocate(packetSize));
 
     ESP_LOGI(LM_TAG, "Packet created with %d bytes", packetSize);
 
@@ -25,14 +29,59 @@ AppPacket<uint8_t>* PacketService::convertPacket(DataPacket* p) {
 
     uint32_t payloadSize = p->packetSize - sizeof(DataPacket);
 
+    if (isCompressedPacket(p->type))
+        return createDecompressedAppPacket(p->dst, p->src, p->payload, payloadSize);
+
     AppPacket<uint8_t>* uPacket = createAppPacket(p->dst, p->src, p->payload, payloadSize);
     return uPacket;
 }
 
+AppPacket<uint8_t>* PacketService::createDecompressedAppPacket(uint16_t dst, uint16_t src, const uint8_t* payload, uint32_t payloadSize) {
+    uint32_t size;
+    if (!LM_Lzss::getDecompressedSize(payload, payloadSize, size)) {
+        ESP_LOGE(LM_TAG, "Invalid compressed payload of %d bytes", payloadSize);
+        return nullptr;
+    }
+
+    AppPacket<uint8_t>* p = static_cast<AppPacket<uint8_t>*>(PacketPoolService::allocatePayload(sizeof(AppPacket<uint8_t>) + size));
+
+    if (p == nullptr) {
+        ESP_LOGW(LM_TAG, "User Packet not allocated");
+        return nullptr;
+    }
+
+    if (LM_Lzss::decompress(payload, payloadSize, p->payload, size) != size) {
+        ESP_LOGE(LM_TAG, "Compressed payload of %d bytes corrupted", payloadSize);
+        PacketPoolService::releasePayload(p);
+        return nullptr;
+    }
+
+    p->dst = dst;
+    p->src = src;
+    p->payloadSize = size;
+
+    return p;
+}
+
+uint8_t* PacketService::compressPayload(const uint8_t* payload, uint32_t payloadSize, uint32_t& compressedSize) {
+    uint8_t* compressed = static_cast<uint8_t*>(pvPortMalloc(payloadSize));
+    if (compressed == nullptr)
+        return nullptr;
+
+    //Only if it saves at least one byte
+    compressedSize = LM_Lzss::compress(payload, payloadSize, compressed, payloadSize - 1);
+    if (compressedSize == 0) {
+        vPortFree(compressed);
+        return nullptr;
+    }
+
+    return compressed;
+}
+
 AppPacket<uint8_t>* PacketService::createAppPacket(uint16_t dst, uint16_t src, uint8_t* payload, uint32_t payloadSize) {
     int packetLength = sizeof(AppPacket<uint8_t>) + payloadSize;
 
-    AppPacket<uint8_t>* p = static_cast<AppPacket<uint8_t>*>(pvPortMalloc(packetLength));
+    AppPacket<uint8_t>* p = static_cast<AppPacket<uint8_t>*>(PacketPoolService::allocatePayload(packetLength));
 
     if (p) {
         //Copy the payload into the packet
@@ -51,68 +100,559 @@ AppPacket<uint8_t>* PacketService::createAppPacket(uint16_t dst, uint16_t src, u
 }
 
 bool PacketService::isDataPacket(uint8_t type) {
-    return (type & DATA_P) == DATA_P;
+    return (type & DATA_P) == DATA_P && !isHelloPacket(type);
 }
 
 bool PacketService::isOnlyDataPacket(uint8_t type) {
-    return type == DATA_P;
+    return (type & ~COMPRESSED_P) == DATA_P;
+}
+
+bool PacketService::isCompressedPacket(uint8_t type) {
+    return (type & COMPRESSED_P) == COMPRESSED_P;
 }
 
 bool PacketService::isControlPacket(uint8_t type) {
-    return !(isHelloPacket(type) || isOnlyDataPacket(type));
+    return !(isHelloPacket(type) || isOnlyDataPacket(type) || isAggregatedPacket(type));
 }
 
 bool PacketService::isHelloPacket(uint8_t type) {
     return (type & HELLO_P) == HELLO_P;
 }
 
+bool PacketService::isHelloDeltaPacket(uint8_t type) {
+    return (type & HELLO_DELTA_P) == HELLO_DELTA_P;
+}
+
+bool PacketService::isHelloCompactPacket(uint8_t type) {
+    return (type & HELLO_COMPACT_P) == HELLO_COMPACT_P;
+}
+
+bool PacketService::isHelloLinkReportPacket(uint8_t type) {
+    return (type & HELLO_LINK_REPORT_P) == HELLO_LINK_REPORT_P;
+}
+
+bool PacketService::isHelloLoadPacket(uint8_t type) {
+    return (type & HELLO_LOAD_P) == HELLO_LOAD_P;
+}
+
+bool PacketService::isHelloCompactHeaderPacket(uint8_t type) {
+    return (type & HELLO_COMPACT_HEADER_P) == HELLO_COMPACT_HEADER_P;
+}
+
+bool PacketService::isHelloBeaconPacket(uint8_t type) {
+    return (type & HELLO_BEACON_P) == HELLO_BEACON_P;
+}
+
+bool PacketService::isHelloSolicitPacket(uint8_t type) {
+    return (type & HELLO_SOLICIT_P) == HELLO_SOLICIT_P;
+}
+
+bool PacketService::isAggregatedPacket(uint8_t type) {
+    return (type & AGGREGATED_P) == AGGREGATED_P && !isHelloPacket(type);
+}
+
 bool PacketService::isNeedAckPacket(uint8_t type) {
-    return (type & NEED_ACK_P) == NEED_ACK_P;
+    return (type & NEED_ACK_P) == NEED_ACK_P && !isHelloPacket(type);
 }
 
 bool PacketService::isAckPacket(uint8_t type) {
-    return (type & ACK_P) == ACK_P;
+    return (type & ACK_P) == ACK_P && !isHelloPacket(type);
 }
 
 bool PacketService::isLostPacket(uint8_t type) {
-    return (type & LOST_P) == LOST_P;
+    return (type & LOST_P) == LOST_P && !isHelloPacket(type);
+}
+
+bool PacketService::isSackPacket(uint8_t type) {
+    return (type & SACK_P) == SACK_P && !isHelloPacket(type);
 }
 
 bool PacketService::isSyncPacket(uint8_t type) {
-    return (type & SYNC_P) == SYNC_P;
+    return (type & SYNC_P) == SYNC_P && !isHelloPacket(type);
 }
 
 bool PacketService::isXLPacket(uint8_t type) {
-    return (type & XL_DATA_P) == XL_DATA_P;
+    return (type & XL_DATA_P) == XL_DATA_P && !isHelloPacket(type);
+}
+
+bool PacketService::isMulticastPacket(uint8_t type) {
+    uint8_t multicastType = type & ~COMPRESSED_P;
+    return multicastType == MC_DATA_P || multicastType == MC_SYNC_P;
+}
+
+bool PacketService::isMulticastNackPacket(uint8_t type) {
+    return type == MC_NACK_P;
 }
 
 bool PacketService::isDataControlPacket(uint8_t type) {
-    return (isHelloPacket(type) || isAckPacket(type) || isLostPacket(type) || isLostPacket(type));
+    return PacketTypeTable::get(type).controlOnly;
 }
 
 uint8_t PacketService::getHeaderLength(uint8_t type) {
-    if (isControlPacket(type))
-        return sizeof(ControlPacket);
+    return PacketTypeTable::get(type).typeHeaderLength;
+}
+
+RoutePacket* PacketService::addLinkReports(RoutePacket* p, const LinkReport* reports, size_t numOfReports) {
+    size_t reportsSize = numOfReports * sizeof(LinkReport);
+
+    RoutePacket* reportPacket = static_cast<RoutePacket*>(PacketPoolService::allocate(p->packetSize + getLinkReportsSize(numOfReports)));
+    if (reportPacket == nullptr) {
+        ESP_LOGE(LM_TAG, "Routing packet with link reports not allocated");
+        return p;
+    }
+
+    memcpy(reportPacket, p, p->packetSize);
 
-    if (isDataPacket(type))
-        return sizeof(DataPacket);
+    uint8_t* trailer = reinterpret_cast<uint8_t*>(reportPacket) + p->packetSize;
+    memcpy(trailer, reports, reportsSize);
+    trailer[reportsSize] = numOfReports;
 
-    return 0;
+    reportPacket->type |= HELLO_LINK_REPORT_P;
+    reportPacket->packetSize = p->packetSize + getLinkReportsSize(numOfReports);
+
+    PacketPoolService::release(p);
+
+    return reportPacket;
+}
+
+bool PacketService::removeLinkReports(RoutePacket* p, uint16_t address, int8_t& snr, bool& found) {
+    found = false;
+
+    if (p->packetSize < sizeof(RoutePacket) + 1)
+        return false;
+
+    uint8_t* packetBytes = reinterpret_cast<uint8_t*>(p);
+    size_t numOfReports = packetBytes[p->packetSize - 1];
+    size_t trailerSize = getLinkReportsSize(numOfReports);
+
+    if (p->packetSize < sizeof(RoutePacket) + trailerSize)
+        return false;
+
+    LinkReport* reports = reinterpret_cast<LinkReport*>(packetBytes + p->packetSize - trailerSize);
+
+    for (size_t i = 0; i < numOfReports; i++) {
+        if (reports[i].address == address) {
+            snr = reports[i].snr;
+            found = true;
+            break;
+        }
+    }
+
+    p->packetSize -= trailerSize;
+
+    return true;
+}
+
+RoutePacket* PacketService::addLoadReports(RoutePacket* p, const LoadReport* reports, size_t numOfReports) {
+    size_t reportsSize = numOfReports * sizeof(LoadReport);
+
+    RoutePacket* reportPacket = static_cast<RoutePacket*>(PacketPoolService::allocate(p->packetSize + getLoadReportsSize(numOfReports)));
+    if (reportPacket == nullptr) {
+        ESP_LOGE(LM_TAG, "Routing packet with load reports not allocated");
+        return p;
+    }
+
+    memcpy(reportPacket, p, p->packetSize);
+
+    uint8_t* trailer = reinterpret_cast<uint8_t*>(reportPacket) + p->packetSize;
+    memcpy(trailer, reports, reportsSize);
+    trailer[reportsSize] = numOfReports;
+
+    reportPacket->type |= HELLO_LOAD_P;
+    reportPacket->packetSize = p->packetSize + getLoadReportsSize(numOfReports);
+
+    PacketPoolService::release(p);
+
+    return reportPacket;
+}
+
+bool PacketService::removeLoadReports(RoutePacket* p, LoadReport* reports, size_t maxReports, size_t& numOfReports) {
+    numOfReports = 0;
+
+    if (p->packetSize < sizeof(RoutePacket) + 1)
+        return false;
+
+    uint8_t* packetBytes = reinterpret_cast<uint8_t*>(p);
+    size_t numInPacket = packetBytes[p->packetSize - 1];
+    size_t trailerSize = getLoadReportsSize(numInPacket);
+
+    if (p->packetSize < sizeof(RoutePacket) + trailerSize)
+        return false;
+
+    numOfReports = numInPacket < maxReports ? numInPacket : maxReports;
+    memcpy(reports, packetBytes + p->packetSize - trailerSize, numOfReports * sizeof(LoadReport));
+
+    p->packetSize -= trailerSize;
+
+    return true;
+}
+
+RoutePacket* PacketService::addSlotBeacon(RoutePacket* p, uint16_t slotLength, const uint16_t* owners, size_t numOfSlots) {
+    size_t beaconSize = getSlotBeaconSize(numOfSlots);
+
+    RoutePacket* beaconPacket = static_cast<RoutePacket*>(PacketPoolService::allocate(p->packetSize + beaconSize));
+    if (beaconPacket == nullptr) {
+        ESP_LOGE(LM_TAG, "Routing packet with slot beacon not allocated");
+        return p;
+    }
+
+    memcpy(beaconPacket, p, p->packetSize);
+
+    //The offset is written when the packet is sent
+    uint8_t* trailer = reinterpret_cast<uint8_t*>(beaconPacket) + p->packetSize;
+    memset(trailer, 0, sizeof(uint16_t));
+    memcpy(trailer + sizeof(uint16_t), &slotLength, sizeof(uint16_t));
+    memcpy(trailer + 2 * sizeof(uint16_t), owners, numOfSlots * sizeof(uint16_t));
+    trailer[beaconSize - 1] = numOfSlots;
+
+    beaconPacket->type |= HELLO_BEACON_P;
+    beaconPacket->packetSize = p->packetSize + beaconSize;
+
+    PacketPoolService::release(p);
+
+    return beaconPacket;
+}
+
+void PacketService::setSlotBeaconOffset(RoutePacket* p, uint16_t offset) {
+    uint8_t* packetBytes = reinterpret_cast<uint8_t*>(p);
+    size_t beaconSize = getSlotBeaconSize(packetBytes[p->packetSize - 1]);
+
+    memcpy(packetBytes + p->packetSize - beaconSize, &offset, sizeof(uint16_t));
+}
+
+bool PacketService::removeSlotBeacon(RoutePacket* p, uint16_t& offset, uint16_t& slotLength, uint16_t* owners, size_t maxSlots, size_t& numOfSlots) {
+    numOfSlots = 0;
+
+    if (p->packetSize < sizeof(RoutePacket) + 1)
+        return false;
+
+    uint8_t* packetBytes = reinterpret_cast<uint8_t*>(p);
+    size_t numInPacket = packetBytes[p->packetSize - 1];
+    size_t beaconSize = getSlotBeaconSize(numInPacket);
+
+    if (p->packetSize < sizeof(RoutePacket) + beaconSize)
+        return false;
+
+    uint8_t* trailer = packetBytes + p->packetSize - beaconSize;
+    memcpy(&offset, trailer, sizeof(uint16_t));
+    memcpy(&slotLength, trailer + sizeof(uint16_t), sizeof(uint16_t));
+
+    numOfSlots = numInPacket < maxSlots ? numInPacket : maxSlots;
+    memcpy(owners, trailer + 2 * sizeof(uint16_t), numOfSlots * sizeof(uint16_t));
+
+    p->packetSize -= beaconSize;
+
+    return true;
 }
 
-RoutePacket* PacketService::createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole) {
+RoutePacket* PacketService::createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole, uint8_t type) {
     size_t routingSizeInBytes = numOfNodes * sizeof(NetworkNode);
 
     RoutePacket* routePacket = PacketFactory::createPacket<RoutePacket>(reinterpret_cast<uint8_t*>(nodes), routingSizeInBytes);
     routePacket->dst = BROADCAST_ADDR;
     routePacket->src = localAddress;
-    routePacket->type = HELLO_P;
+    routePacket->type = type;
     routePacket->packetSize = routingSizeInBytes + sizeof(RoutePacket);
     routePacket->nodeRole = nodeRole;
 
     return routePacket;
 }
 
+/**
+ * @brief Size in bytes of the varint of a value, 7 bits per byte
+ *
+ */
+static size_t varintSize(uint16_t value) {
+    return value < 0x80 ? 1 : (value < 0x4000 ? 2 : 3);
+}
+
+RoutePacket* PacketService::createCompactRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole, uint8_t type, size_t& encodedNodes) {
+    // Group the nodes by role and order the addresses to have small differences
+    std::sort(nodes, nodes + numOfNodes, [](const NetworkNode& a, const NetworkNode& b) {
+        return a.role != b.role ? a.role < b.role : a.address < b.address;
+    });
+
+    const size_t maxPayloadSize = PacketFactory::getMaxPacketSize() - sizeof(RoutePacket);
+
+    // Count the nodes that fit inside the packet
+    size_t payloadSize = 0;
+    size_t runLength = 0;
+    encodedNodes = 0;
+
+    for (size_t i = 0; i < numOfNodes; i++) {
+        bool newRun = i == 0 || nodes[i].role != nodes[i - 1].role || runLength == UINT8_MAX;
+        uint16_t delta = newRun ? nodes[i].address : nodes[i].address - nodes[i - 1].address;
+
+        size_t entrySize = (newRun ? 2 : 0) + varintSize(delta) + 1;
+        if (payloadSize + entrySize > maxPayloadSize)
+            break;
+
+        payloadSize += entrySize;
+        runLength = newRun ? 1 : runLength + 1;
+        encodedNodes++;
+    }
+
+    RoutePacket* routePacket = PacketFactory::createPacket<RoutePacket>(nullptr, payloadSize);
+    routePacket->dst = BROADCAST_ADDR;
+    routePacket->src = localAddress;
+    routePacket->type = type;
+    routePacket->packetSize = payloadSize + sizeof(RoutePacket);
+    routePacket->nodeRole = nodeRole;
+
+    uint8_t* payload = reinterpret_cast<uint8_t*>(routePacket->networkNodes);
+    uint8_t* runCount = nullptr;
+
+    for (size_t i = 0; i < encodedNodes; i++) {
+        bool newRun = runCount == nullptr || nodes[i].role != nodes[i - 1].role || *runCount == UINT8_MAX;
+        uint16_t delta = newRun ? nodes[i].address : nodes[i].address - nodes[i - 1].address;
+
+        if (newRun) {
+            *payload++ = nodes[i].role;
+            runCount = payload++;
+            *runCount = 0;
+        }
+
+        while (delta >= 0x80) {
+            *payload++ = (delta & 0x7F) | 0x80;
+            delta >>= 7;
+        }
+        *payload++ = delta;
+
+        *payload++ = nodes[i].metric;
+        (*runCount)++;
+    }
+
+    return routePacket;
+}
+
+bool PacketService::decodeCompactNetworkNodes(RoutePacket* p, NetworkNode* nodes, size_t maxNodes, size_t& numOfNodes) {
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(p->networkNodes);
+    const uint8_t* end = payload + (p->packetSize - sizeof(RoutePacket));
+
+    numOfNodes = 0;
+
+    while (payload < end) {
+        if (end - payload < 2)
+            return false;
+
+        uint8_t role = *payload++;
+        uint8_t count = *payload++;
+        uint16_t address = 0;
+
+        for (uint8_t i = 0; i < count; i++) {
+            uint32_t delta = 0;
+            uint8_t shift = 0;
+
+            do {
+                if (payload >= end || shift > 14)
+                    return false;
+
+                delta |= (uint32_t) (*payload & 0x7F) << shift;
+                shift += 7;
+            } while (*payload++ & 0x80);
+
+            if (payload >= end || numOfNodes >= maxNodes)
+                return false;
+
+            address += delta;
+            nodes[numOfNodes++] = NetworkNode(address, *payload++, role);
+        }
+    }
+
+    return true;
+}
+
+DataPacket* PacketService::createAggregatedPacket(uint16_t via, uint16_t src, DataPacket** packets, size_t numOfPackets) {
+    size_t payloadSize = 0;
+    for (size_t i = 0; i < numOfPackets; i++)
+        payloadSize += getAggregatedRecordSize(packets[i]);
+
+    uint8_t type = numOfPackets > 0 && packets[0]->type == ACK_P ? AGGREGATED_ACK_P : AGGREGATED_P;
+    DataPacket* frame = createDataPacket(via, src, type, nullptr, payloadSize);
+    frame->via = via;
+
+    uint8_t* payload = frame->payload;
+
+    for (size_t i = 0; i < numOfPackets; i++) {
+        DataPacket* p = packets[i];
+        uint8_t len = getPacketPayloadLength(p);
+
+        memcpy(payload, &p->src, sizeof(p->src));
+        memcpy(payload + 2, &p->dst, sizeof(p->dst));
+        payload[4] = p->id;
+        payload[5] = len;
+        memcpy(payload + AGGREGATED_RECORD_HEADER_SIZE, p->payload, len);
+
+        payload += AGGREGATED_RECORD_HEADER_SIZE + len;
+    }
+
+    return frame;
+}
+
+DataPacket* PacketService::getAggregatedRecord(DataPacket* frame, size_t& offset) {
+    size_t payloadSize = getPacketPayloadLength(frame);
+    if (offset + AGGREGATED_RECORD_HEADER_SIZE > payloadSize)
+        return nullptr;
+
+    const uint8_t* record = frame->payload + offset;
+    uint8_t len = record[5];
+
+    if (offset + AGGREGATED_RECORD_HEADER_SIZE + len > payloadSize)
+        return nullptr;
+
+    //The ACK is a control packet, its sequence id and number are at the start of the record payload
+    bool isAck = offset == 0 && frame->type == AGGREGATED_ACK_P;
+    if (isAck && len < sizeof(ControlPacket) - sizeof(DataPacket))
+        return nullptr;
+
+    uint16_t src, dst;
+    memcpy(&src, record, sizeof(src));
+    memcpy(&dst, record + 2, sizeof(dst));
+
+    DataPacket* p = createDataPacket(dst, src, isAck ? ACK_P : DATA_P, record + AGGREGATED_RECORD_HEADER_SIZE, len);
+    p->id = record[4];
+    p->via = frame->via;
+
+    offset += AGGREGATED_RECORD_HEADER_SIZE + len;
+
+    return p;
+}
+
+size_t PacketService::getCompactFrameLength(Packet<uint8_t>* p) {
+    const PacketTypeInfo& info = PacketTypeTable::get(p->type);
+    if ((info.packetClass != PacketClass::DATA && info.packetClass != PacketClass::CONTROL) || p->isGroupDestination() ||
+        p->packetSize < info.headerLength)
+        return 0;
+
+    DataPacket* data = reinterpret_cast<DataPacket*>(p);
+
+    //Type, id and the short destination and source
+    size_t length = 4;
+    if (data->via != p->dst)
+        length++;
+
+    if (info.packetClass == PacketClass::CONTROL)
+        length += sizeof(LM_SeqId) + (reinterpret_cast<ControlPacket*>(p)->number < 256 ? 1 : 2);
+
+    return length + p->packetSize - info.headerLength;
+}
+
+size_t PacketService::writeCompactFrame(Packet<uint8_t>* p, uint8_t* frame) {
+    const PacketTypeInfo& info = PacketTypeTable::get(p->type);
+    DataPacket* data = reinterpret_cast<DataPacket*>(p);
+
+    uint8_t type = p->type & ~(COMPACT_VIA_DST_F | COMPACT_SHORT_NUMBER_F);
+    size_t length = 4;
+
+    frame[1] = p->id;
+    frame[2] = getShortAddress(p->dst);
+    frame[3] = getShortAddress(p->src);
+
+    if (data->via == p->dst)
+        type |= COMPACT_VIA_DST_F;
+    else
+        frame[length++] = getShortAddress(data->via);
+
+    if (info.packetClass == PacketClass::CONTROL) {
+        ControlPacket* control = reinterpret_cast<ControlPacket*>(p);
+        memcpy(frame + length, &control->seq_id, sizeof(LM_SeqId));
+        length += sizeof(LM_SeqId);
+
+        if (control->number < 256) {
+            type |= COMPACT_SHORT_NUMBER_F;
+            frame[length++] = control->number;
+        }
+        else {
+            memcpy(frame + length, &control->number, sizeof(control->number));
+            length += sizeof(control->number);
+        }
+    }
+
+    frame[0] = type;
+
+    size_t payloadSize = p->packetSize - info.headerLength;
+    memcpy(frame + length, reinterpret_cast<uint8_t*>(p) + info.headerLength, payloadSize);
+    length += payloadSize;
+
+    //The byte of the size of the default header cannot be the size of the frame
+    if (!isCompactFrame(frame, length))
+        return 0;
+
+    return length;
+}
+
+bool PacketService::isCompactFrame(const uint8_t* frame, size_t frameLength) {
+    return frameLength < sizeof(PacketHeader) || reinterpret_cast<const PacketHeader*>(frame)->packetSize != frameLength;
+}
+
+bool PacketService::readCompactHeader(const uint8_t* frame, size_t frameLength, CompactHeader& header) {
+    if (frameLength < 4)
+        return false;
+
+    header.type = (frame[0] & ~(COMPACT_VIA_DST_F | COMPACT_SHORT_NUMBER_F)) | DATA_P;
+    header.viaIsDst = (frame[0] & COMPACT_VIA_DST_F) == COMPACT_VIA_DST_F;
+    header.shortNumber = (frame[0] & COMPACT_SHORT_NUMBER_F) == COMPACT_SHORT_NUMBER_F;
+
+    const PacketTypeInfo& info = PacketTypeTable::get(header.type);
+    if (info.packetClass != PacketClass::DATA && info.packetClass != PacketClass::CONTROL)
+        return false;
+
+    header.id = frame[1];
+    header.dst = frame[2];
+    header.src = frame[3];
+
+    size_t length = 4;
+    header.via = header.viaIsDst ? header.dst : frame[length++];
+
+    if (info.packetClass == PacketClass::CONTROL)
+        length += sizeof(LM_SeqId) + (header.shortNumber ? 1 : 2);
+
+    if (frameLength < length)
+        return false;
+
+    size_t packetSize = info.headerLength + frameLength - length;
+    if (packetSize > PacketFactory::getMaxPacketSize())
+        return false;
+
+    header.length = length;
+    header.packetSize = packetSize;
+
+    return true;
+}
+
+Packet<uint8_t>* PacketService::expandCompactFrame(const uint8_t* frame, const CompactHeader& header, uint16_t dst, uint16_t src, uint16_t via) {
+    const PacketTypeInfo& info = PacketTypeTable::get(header.type);
+
+    Packet<uint8_t>* p = static_cast<Packet<uint8_t>*>(PacketPoolService::allocate(header.packetSize));
+    if (p == nullptr)
+        return nullptr;
+
+    DataPacket* data = reinterpret_cast<DataPacket*>(p);
+    data->dst = dst;
+    data->src = src;
+    data->type = header.type;
+    data->id = header.id;
+    data->packetSize = header.packetSize;
+    data->via = via;
+
+    if (info.packetClass == PacketClass::CONTROL) {
+        ControlPacket* control = reinterpret_cast<ControlPacket*>(p);
+        const uint8_t* fields = frame + header.length - sizeof(LM_SeqId) - (header.shortNumber ? 1 : 2);
+
+        memcpy(&control->seq_id, fields, sizeof(LM_SeqId));
+        fields += sizeof(LM_SeqId);
+
+        if (header.shortNumber)
+            control->number = *fields;
+        else
+            memcpy(&control->number, fields, sizeof(control->number));
+    }
+
+    memcpy(reinterpret_cast<uint8_t*>(p) + info.headerLength, frame + header.length, header.packetSize - info.headerLength);
+
+    return p;
+}
+
 DataPacket* PacketService::dataPacket(Packet<uint8_t>* p) {
     return reinterpret_cast<DataPacket*>(p);
 }
@@ -121,8 +661,11 @@ ControlPacket* PacketService::controlPacket(Packet<uint8_t>* p) {
     return reinterpret_cast<ControlPacket*>(p);
 }
 
-ControlPacket* PacketService::createControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t* payload, uint8_t payloadSize) {
+ControlPacket* PacketService::createControlPacket(uint16_t dst, uint16_t src, uint8_t type, const uint8_t* payload, uint8_t payloadSize) {
     ControlPacket* packet = PacketFactory::createPacket<ControlPacket>(payload, payloadSize);
+    if (packet == nullptr)
+        return nullptr;
+
     packet->dst = dst;
     packet->src = src;
     packet->type = type;
@@ -131,8 +674,11 @@ ControlPacket* PacketService::createControlPacket(uint16_t dst, uint16_t src, ui
     return packet;
 }
 
-ControlPacket* PacketService::createEmptyControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t seq_id, uint16_t num_packets) {
+ControlPacket* PacketService::createEmptyControlPacket(uint16_t dst, uint16_t src, uint8_t type, LM_SeqId seq_id, uint16_t num_packets) {
     ControlPacket* packet = PacketFactory::createPacket<ControlPacket>(nullptr, 0);
+    if (packet == nullptr)
+        return nullptr;
+
     packet->dst = dst;
     packet->src = src;
     packet->type = type;
@@ -145,6 +691,9 @@ ControlPacket* PacketService::createEmptyControlPacket(uint16_t dst, uint16_t sr
 
 DataPacket* PacketService::createDataPacket(uint16_t dst, uint16_t src, uint8_t type, const uint8_t* payload, uint8_t payloadSize) {
     DataPacket* packet = PacketFactory::createPacket<DataPacket>(payload, payloadSize);
+    if (packet == nullptr)
+        return nullptr;
+
     packet->dst = dst;
     packet->src = src;
     packet->type = type;
@@ -162,14 +711,35 @@ size_t PacketService::getHeaderLength(Packet<uint8_t>* p) {
 }
 
 size_t PacketService::getControlLength(Packet<uint8_t>* p) {
-    if (isDataControlPacket(p->type))
-        return p->packetSize;
-
-    return getHeaderLength(p);
+    const PacketTypeInfo& info = PacketTypeTable::get(p->type);
+    return info.controlOnly ? p->packetSize : info.typeHeaderLength;
 }
 
 uint8_t PacketService::getMaximumPayloadLength(uint8_t type) {
-    return PacketFactory::getMaxPacketSize() - getHeaderLength(type);
+    return PacketFactory::getMaxPacketSize() - getHeaderLength(type) - CryptoService::getOverhead(type);
+}
+
+uint32_t PacketService::getPacketKey(Packet<uint8_t>* p, bool includeId) {
+    uint32_t key = LM_Hash::fnv1a(&p->src, sizeof(p->src));
+    key = LM_Hash::fnv1a(&p->dst, sizeof(p->dst), key);
+    key = LM_Hash::fnv1a(&p->type, sizeof(p->type), key);
+
+    if (includeId)
+        key = LM_Hash::fnv1a(&p->id, sizeof(p->id), key);
+
+    if (p->packetSize > sizeof(Packet<uint8_t>))
+        key = LM_Hash::fnv1a(p->payload, p->packetSize - sizeof(Packet<uint8_t>), key);
+
+    return key;
+}
+
+uint32_t PacketService::getFloodKey(DataPacket* p) {
+    uint32_t key = LM_Hash::fnv1a(&p->src, sizeof(p->src));
+    key = LM_Hash::fnv1a(&p->dst, sizeof(p->dst), key);
+    key = LM_Hash::fnv1a(&p->type, sizeof(p->type), key);
+    key = LM_Hash::fnv1a(&p->id, sizeof(p->id), key);
+
+    return LM_Hash::fnv1a(p->payload, getPacketPayloadLength(p), key);
 }
 
 size_t PacketService::getPacketPayloadLengthWithoutControl(Packet<uint8_t>* p) {
@@ -195,3 +765,25 @@ ControlPacket* PacketService::getPacketHeader(Packet<uint8_t>* p) {
     memcpy(reinterpret_cast<void*>(ctrlPacket), reinterpret_cast<void*>(p), sizeof(PacketHeader));
     return ctrlPacket;
 }
+
+bool PacketService::parsePacket(Packet<uint8_t>* p, PacketView& view) {
+    const PacketTypeInfo& info = PacketTypeTable::get(p->type);
+
+    if (p->packetSize < info.headerLength)
+        return false;
+
+    view.packetClass = info.packetClass;
+    view.headerLength = info.headerLength;
+    view.payloadLength = p->packetSize - info.headerLength;
+    view.controlOnly = info.controlOnly;
+
+    return true;
+}
+
+void PacketService::copyPacketHeader(Packet<uint8_t>* p, const PacketView& view, ControlPacket& header) {
+    //The routing packets only have the common header
+    size_t size = view.isData() ? view.headerLength : sizeof(PacketHeader);
+
+    memset(reinterpret_cast<void*>(&header), 0, sizeof(ControlPacket));
+    memcpy(reinterpret_cast<void*>(&header), reinterpret_cast<void*>(p), size);
+}
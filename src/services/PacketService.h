@@ -6,9 +6,16 @@
 #include "entities/packets/DataPacket.h"
 #include "entities/packets/AppPacket.h"
 #include "entities/packets/RoutePacket.h"
+#include "entities/packets/PacketView.h"
+#include "entities/routingTable/LinkReport.h"
+#include "entities/routingTable/LoadReport.h"
 #include "services/RoleService.h"
+#include "services/PacketTypeTable.h"
 #include "BuildOptions.h"
 #include "PacketFactory.h"
+#include "PacketPoolService.h"
+#include "utilities/DuplicateCache.hpp"
+#include "utilities/Lzss.hpp"
 
 class PacketService {
 public:
@@ -39,7 +46,7 @@ public:
      * @param payloadSize Payload size
      * @return ControlPacket*
      */
-    static ControlPacket* createControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t* payload, uint8_t payloadSize);
+    static ControlPacket* createControlPacket(uint16_t dst, uint16_t src, uint8_t type, const uint8_t* payload, uint8_t payloadSize);
 
     /**
      * @brief Create a Empty Control Packet
@@ -51,7 +58,7 @@ public:
      * @param num_packets Number of the packet
      * @return ControlPacket*
      */
-    static ControlPacket* createEmptyControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t seq_id, uint16_t num_packets);
+    static ControlPacket* createEmptyControlPacket(uint16_t dst, uint16_t src, uint8_t type, LM_SeqId seq_id, uint16_t num_packets);
 
     /**
      * @brief Create a Data Packet
@@ -83,7 +90,7 @@ public:
      */
     template<class T>
     static Packet<uint8_t>* copyPacket(T* p, size_t packetLength) {
-        Packet<uint8_t>* cpPacket = static_cast<Packet<uint8_t>*>(pvPortMalloc(packetLength));
+        Packet<uint8_t>* cpPacket = static_cast<Packet<uint8_t>*>(PacketPoolService::allocate(packetLength));
 
         if (cpPacket) {
             memcpy(reinterpret_cast<void*>(cpPacket), reinterpret_cast<void*>(p), packetLength);
@@ -96,6 +103,24 @@ public:
         return cpPacket;
     }
 
+    /**
+     * @brief Share a packet. If the packet is inside the packet pool it returns the same buffer with an additional reference,
+     * otherwise it returns a copy. In both cases the result must be deleted as any other packet.
+     * The shared buffer is the same, modifications are seen by all the owners.
+     *
+     * @tparam T type of packet
+     * @param p packet
+     * @param packetLength all packet length
+     * @return Packet<uint8_t>*
+     */
+    template<class T>
+    static Packet<uint8_t>* sharePacket(T* p, size_t packetLength) {
+        if (PacketPoolService::retain(p))
+            return reinterpret_cast<Packet<uint8_t>*>(p);
+
+        return copyPacket(p, packetLength);
+    }
+
     /**
      * @brief Create a Routing Packet object
      *
@@ -103,9 +128,281 @@ public:
      * @param nodes list of NetworkNodes
      * @param numOfNodes Number of nodes
      * @param nodeRole Role of the node
+     * @param type Type of the packet, HELLO_P or HELLO_DELTA_P
+     * @return RoutePacket*
+     */
+    static RoutePacket* createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole, uint8_t type = HELLO_P);
+
+    /**
+     * @brief Create a Routing Packet with the compact format. The nodes are sorted by role and address, then every run
+     * of nodes with the same role is encoded as the role and the number of nodes followed by, for every node,
+     * the address as a varint of the difference with the previous one and the metric.
+     * It encodes as many nodes as fit inside the packet.
+     *
+     * @param localAddress localAddress of the node
+     * @param nodes list of NetworkNodes, they are sorted by this function
+     * @param numOfNodes Number of nodes
+     * @param nodeRole Role of the node
+     * @param type Type of the packet, it must include HELLO_COMPACT_P
+     * @param encodedNodes Number of nodes encoded inside the packet
      * @return RoutePacket*
      */
-    static RoutePacket* createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole);
+    static RoutePacket* createCompactRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole, uint8_t type, size_t& encodedNodes);
+
+    /**
+     * @brief Decode the network nodes of a Routing Packet with the compact format
+     *
+     * @param p Routing packet
+     * @param nodes Array where the nodes are decoded
+     * @param maxNodes Size of the array, getMaximumCompactNetworkNodes is enough for any packet
+     * @param numOfNodes Number of nodes decoded
+     * @return true If the packet is valid
+     * @return false If the packet is malformed
+     */
+    static bool decodeCompactNetworkNodes(RoutePacket* p, NetworkNode* nodes, size_t maxNodes, size_t& numOfNodes);
+
+    /**
+     * @brief Size in bytes of the link reports added at the end of a Routing Packet
+     *
+     * @param numOfReports Number of link reports
+     * @return size_t Size of the reports and their number
+     */
+    static size_t getLinkReportsSize(size_t numOfReports) { return numOfReports * sizeof(LinkReport) + 1; }
+
+    /**
+     * @brief Create a copy of the Routing Packet with the link reports at the end and the HELLO_LINK_REPORT_P type.
+     * The original packet is deleted.
+     *
+     * @param p Routing packet
+     * @param reports Link reports
+     * @param numOfReports Number of link reports, up to 255
+     * @return RoutePacket* Routing packet with the reports
+     */
+    static RoutePacket* addLinkReports(RoutePacket* p, const LinkReport* reports, size_t numOfReports);
+
+    /**
+     * @brief Remove the link reports from the end of a Routing Packet, getting the one of an address
+     *
+     * @param p Routing packet with the HELLO_LINK_REPORT_P type, its size is reduced to the routes only
+     * @param address Address of the link report to find
+     * @param snr SNR of the link report of the address
+     * @param found If the address has a link report
+     * @return true If the reports are valid
+     * @return false If the packet is malformed
+     */
+    static bool removeLinkReports(RoutePacket* p, uint16_t address, int8_t& snr, bool& found);
+
+    /**
+     * @brief Size in bytes of the load reports added at the end of a Routing Packet
+     *
+     * @param numOfReports Number of load reports
+     * @return size_t Size of the reports and their number
+     */
+    static size_t getLoadReportsSize(size_t numOfReports) { return numOfReports * sizeof(LoadReport) + 1; }
+
+    /**
+     * @brief Create a copy of the Routing Packet with the load reports at the end and the HELLO_LOAD_P type.
+     * The original packet is deleted.
+     *
+     * @param p Routing packet, with the link reports already added
+     * @param reports Load reports
+     * @param numOfReports Number of load reports, up to 255
+     * @return RoutePacket* Routing packet with the reports
+     */
+    static RoutePacket* addLoadReports(RoutePacket* p, const LoadReport* reports, size_t numOfReports);
+
+    /**
+     * @brief Remove the load reports from the end of a Routing Packet. They must be removed before the link reports.
+     *
+     * @param p Routing packet with the HELLO_LOAD_P type, its size is reduced to the routes and the link reports
+     * @param reports Array where the reports are written
+     * @param maxReports Size of the array, the other reports are discarded
+     * @param numOfReports Number of reports written
+     * @return true If the reports are valid
+     * @return false If the packet is malformed
+     */
+    static bool removeLoadReports(RoutePacket* p, LoadReport* reports, size_t maxReports, size_t& numOfReports);
+
+    /**
+     * @brief Size in bytes of the slot beacon added at the end of a Routing Packet
+     *
+     * @param numOfSlots Number of slots with an owner
+     * @return size_t Size of the offset, the slot length, the owners and their number
+     */
+    static size_t getSlotBeaconSize(size_t numOfSlots) { return 2 * sizeof(uint16_t) + numOfSlots * sizeof(uint16_t) + 1; }
+
+    /**
+     * @brief Create a copy of the Routing Packet with the slot beacon at the end and the HELLO_BEACON_P type.
+     * The original packet is deleted. The offset inside the frame is written with setSlotBeaconOffset before sending it.
+     *
+     * @param p Routing packet, with the link and the load reports already added
+     * @param slotLength Length of a slot in ms
+     * @param owners Address of the owner of each slot
+     * @param numOfSlots Number of slots with an owner, up to 255
+     * @return RoutePacket* Routing packet with the beacon
+     */
+    static RoutePacket* addSlotBeacon(RoutePacket* p, uint16_t slotLength, const uint16_t* owners, size_t numOfSlots);
+
+    /**
+     * @brief Write the ms since the start of the frame at which the Routing Packet is sent
+     *
+     * @param p Routing packet with the HELLO_BEACON_P type
+     * @param offset Offset inside the frame in ms
+     */
+    static void setSlotBeaconOffset(RoutePacket* p, uint16_t offset);
+
+    /**
+     * @brief Remove the slot beacon from the end of a Routing Packet. It must be removed before the load reports.
+     *
+     * @param p Routing packet with the HELLO_BEACON_P type, its size is reduced to the routes and the reports
+     * @param offset Offset inside the frame at which it was sent in ms
+     * @param slotLength Length of a slot in ms
+     * @param owners Array where the owners of the slots are written
+     * @param maxSlots Size of the array, the other slots are discarded
+     * @param numOfSlots Number of owners written
+     * @return true If the beacon is valid
+     * @return false If the packet is malformed
+     */
+    static bool removeSlotBeacon(RoutePacket* p, uint16_t& offset, uint16_t& slotLength, uint16_t* owners, size_t maxSlots, size_t& numOfSlots);
+
+    /**
+     * @brief Get the maximum number of network nodes that a Routing Packet with the compact format can contain
+     *
+     * @param p Routing packet
+     * @return size_t Maximum number of nodes
+     */
+    static size_t getMaximumCompactNetworkNodes(RoutePacket* p) { return (p->packetSize - sizeof(RoutePacket)) / 2; }
+
+    /**
+     * @brief Compact header read from a frame, the addresses are the short addresses of the nodes
+     *
+     */
+    struct CompactHeader {
+        uint8_t type;
+        uint8_t id;
+        uint8_t dst;
+        uint8_t src;
+        uint8_t via;
+        // The via is not inside the frame, it is the destination
+        bool viaIsDst;
+        // The number of the control packet is inside one byte
+        bool shortNumber;
+        // Size of the compact header inside the frame
+        uint8_t length;
+        // Size of the packet once expanded
+        uint8_t packetSize;
+    };
+
+    /**
+     * @brief The flags of the compact header take the DATA_P and HELLO_P bits of the type, all the types with a compact
+     * header have the first and not the second
+     *
+     */
+    static constexpr uint8_t COMPACT_VIA_DST_F = DATA_P;
+    static constexpr uint8_t COMPACT_SHORT_NUMBER_F = HELLO_P;
+
+    /**
+     * @brief Short address of a node inside the compact headers, its low byte
+     *
+     */
+    static uint8_t getShortAddress(uint16_t address) { return address & 0xFF; }
+
+    /**
+     * @brief Size in bytes of the packet sent with a compact header. Only the data and control packets to a single node
+     * have it: a packed type and flags byte, the id, the short addresses, the via only if it is not the destination,
+     * the number of the control packets in one byte when it is lower than 256 and no size, given by the radio.
+     *
+     * @param p Packet with its final via
+     * @return size_t Size of the frame, 0 if the packet has not a compact header
+     */
+    static size_t getCompactFrameLength(Packet<uint8_t>* p);
+
+    /**
+     * @brief Write the packet with a compact header
+     *
+     * @param p Packet with a compact header
+     * @param frame Buffer of getCompactFrameLength bytes
+     * @return size_t Size of the frame, 0 if the frame would be read as a packet with the default header,
+     * it must be sent with the default header
+     */
+    static size_t writeCompactFrame(Packet<uint8_t>* p, uint8_t* frame);
+
+    /**
+     * @brief The frame received has a compact header. The size of the default header is the size of the frame,
+     * it is not inside the compact headers
+     *
+     * @param frame Frame received
+     * @param frameLength Size given by the radio
+     * @return true If the frame has a compact header
+     * @return false If it has the default header
+     */
+    static bool isCompactFrame(const uint8_t* frame, size_t frameLength);
+
+    /**
+     * @brief Read the compact header of a frame
+     *
+     * @param frame Frame received
+     * @param frameLength Size given by the radio
+     * @param header Compact header
+     * @return true If the header is valid
+     * @return false If the frame is malformed or its type has not a compact header
+     */
+    static bool readCompactHeader(const uint8_t* frame, size_t frameLength, CompactHeader& header);
+
+    /**
+     * @brief Create the packet with the default header of a frame with a compact header
+     *
+     * @param frame Frame received
+     * @param header Compact header of the frame
+     * @param dst Destination of the short address
+     * @param src Source of the short address
+     * @param via Via of the short address, or the destination
+     * @return Packet<uint8_t>* Packet of header.packetSize bytes, nullptr if there is no memory
+     */
+    static Packet<uint8_t>* expandCompactFrame(const uint8_t* frame, const CompactHeader& header, uint16_t dst, uint16_t src, uint16_t via);
+
+    /**
+     * @brief Size in bytes of the header of every record inside an aggregated packet: source, destination, id and payload size
+     *
+     */
+    static constexpr size_t AGGREGATED_RECORD_HEADER_SIZE = 6;
+
+    /**
+     * @brief Maximum number of records inside an aggregated packet, the packet size is one byte
+     *
+     */
+    static constexpr size_t MAX_AGGREGATED_RECORDS = UINT8_MAX / AGGREGATED_RECORD_HEADER_SIZE;
+
+    /**
+     * @brief Size in bytes of the data packet as a record inside an aggregated packet
+     *
+     * @param p Data packet
+     * @return size_t Record size
+     */
+    static size_t getAggregatedRecordSize(DataPacket* p) { return AGGREGATED_RECORD_HEADER_SIZE + getPacketPayloadLength(p); }
+
+    /**
+     * @brief Create an Aggregated Packet, a single frame with all the data packets to the same next hop.
+     * Every record contains the source, destination, id, payload size and payload of a data packet.
+     * If the first packet is an ACK the frame is an AGGREGATED_ACK_P, its record payload is the sequence id, number and ACK records.
+     *
+     * @param via Next hop, it is the destination and via of the packet
+     * @param src Source address
+     * @param packets Data packets, they are not deleted
+     * @param numOfPackets Number of packets
+     * @return DataPacket*
+     */
+    static DataPacket* createAggregatedPacket(uint16_t via, uint16_t src, DataPacket** packets, size_t numOfPackets);
+
+    /**
+     * @brief Get a copy of the record of an Aggregated Packet at the offset as a DataPacket with the via of the packet.
+     * The first record of an AGGREGATED_ACK_P is returned as an ACK control packet
+     *
+     * @param frame Aggregated packet
+     * @param offset Offset of the record inside the payload, it is moved to the next record
+     * @return DataPacket* Data packet or nullptr if there are no more records or the record is malformed
+     */
+    static DataPacket* getAggregatedRecord(DataPacket* frame, size_t& offset);
 
     /**
      * @brief Create a Application Packet
@@ -119,7 +416,28 @@ public:
     static AppPacket<uint8_t>* createAppPacket(uint16_t dst, uint16_t src, uint8_t* payload, uint32_t payloadSize);
 
     /**
-     * @brief given a DataPacket it will be converted to a AppPacket
+     * @brief Create a Application Packet with the decompressed payload
+     *
+     * @param dst destination address
+     * @param src source address
+     * @param payload compressed payload array
+     * @param payloadSize compressed payload size in bytes
+     * @return AppPacket<uint8_t>* nullptr if the payload is malformed or there is no memory
+     */
+    static AppPacket<uint8_t>* createDecompressedAppPacket(uint16_t dst, uint16_t src, const uint8_t* payload, uint32_t payloadSize);
+
+    /**
+     * @brief Compress a payload, it is only compressed if the result is smaller
+     *
+     * @param payload payload array
+     * @param payloadSize payload size in bytes
+     * @param compressedSize size in bytes of the compressed payload
+     * @return uint8_t* Compressed payload, it must be freed with vPortFree. nullptr if it is not smaller or there is no memory
+     */
+    static uint8_t* compressPayload(const uint8_t* payload, uint32_t payloadSize, uint32_t& compressedSize);
+
+    /**
+     * @brief given a DataPacket it will be converted to a AppPacket, decompressing the payload if needed
      *
      * @param p packet of type DataPacket
      * @return AppPacket<uint8_t>*
@@ -184,7 +502,7 @@ public:
     static size_t getControlLength(Packet<uint8_t>* p);
 
     /**
-     * @brief Get the Maximum Payload Length with a MAXPACKETSIZE
+     * @brief Get the Maximum Payload Length with a MAXPACKETSIZE, without the bytes added by the encryption
      *
      * @param type
      * @return uint8_t
@@ -192,7 +510,26 @@ public:
     static uint8_t getMaximumPayloadLength(uint8_t type);
 
     /**
-     * @brief Given a type returns if is a data packet
+     * @brief Get the key that identifies the packet in the duplicate caches. It is a hash of the source,
+     * destination, type, optionally the id, and all the bytes after the header.
+     *
+     * @param p Packet
+     * @param includeId If true the id of the packet is included in the key
+     * @return uint32_t Key of the packet
+     */
+    static uint32_t getPacketKey(Packet<uint8_t>* p, bool includeId);
+
+    /**
+     * @brief Get the key that identifies a flooded data packet. It is the key with the id without the via,
+     * all the copies forwarded by the neighbours have the same key.
+     *
+     * @param p Data packet
+     * @return uint32_t Key of the packet
+     */
+    static uint32_t getFloodKey(DataPacket* p);
+
+    /**
+     * @brief Given a type returns if is a data packet. The HELLO types are not, HELLO_BEACON_P has the DATA_P bit
      *
      * @param type type of the packet
      * @return true True if needed
@@ -209,6 +546,15 @@ public:
      */
     static bool isOnlyDataPacket(uint8_t type);
 
+    /**
+     * @brief Given a type returns if the payload is compressed
+     *
+     * @param type type of the packet
+     * @return true True if compressed
+     * @return false If not
+     */
+    static bool isCompressedPacket(uint8_t type);
+
     /**
      * @brief Given a type returns if is a control packet
      *
@@ -227,6 +573,78 @@ public:
      */
     static bool isHelloPacket(uint8_t type);
 
+    /**
+     * @brief Given a type returns if is a delta hello packet
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isHelloDeltaPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a compact hello packet
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isHelloCompactPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a hello packet with link reports
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isHelloLinkReportPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a hello packet with load reports
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isHelloLoadPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a hello packet of a node that receives the compact headers
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isHelloCompactHeaderPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a hello packet with the slots of the slotted access
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isHelloBeaconPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a hello packet that solicits the routing table of the neighbours
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isHelloSolicitPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is an aggregated packet. It needs to be checked before isAckPacket and isXLPacket
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isAggregatedPacket(uint8_t type);
+
     /**
      * @brief Given a type returns if is a NeedAck packet
      *
@@ -254,6 +672,15 @@ public:
      */
     static bool isLostPacket(uint8_t type);
 
+    /**
+     * @brief Given a type returns if is a Selective ACK packet. It needs to be checked before isAckPacket and isLostPacket
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isSackPacket(uint8_t type);
+
     /**
      * @brief Given a type returns if is a Sync packet
      *
@@ -272,6 +699,33 @@ public:
      */
     static bool isXLPacket(uint8_t type);
 
+    /**
+     * @brief Given a type returns if is a packet of a multicast sequence, MC_DATA_P or MC_SYNC_P
+     *
+     * @param type type of the packet
+     * @return true If it is a multicast packet
+     * @return false If not
+     */
+    static bool isMulticastPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a multicast NACK packet
+     *
+     * @param type type of the packet
+     * @return true If it is a multicast NACK
+     * @return false If not
+     */
+    static bool isMulticastNackPacket(uint8_t type);
+
+    /**
+     * @brief Returns if the address is a group address, including the broadcast address
+     *
+     * @param address Address
+     * @return true If it is a group address
+     * @return false If it is the address of a node
+     */
+    static bool isGroupAddress(uint16_t address) { return address >= LM_GROUP_ADDR_FIRST; }
+
     /**
      * @brief Given a type returns if is a Data Control Packet, It will include HELLO_P, ACKs, LOST_P and SYN_P
      *
@@ -288,6 +742,25 @@ public:
      * @return ControlPacket*
      */
     static ControlPacket* getPacketHeader(Packet<uint8_t>* p);
+
+    /**
+     * @brief Parse the type and the lengths of a packet into a view
+     *
+     * @param p Packet to be parsed
+     * @param view View of the packet
+     * @return true If the packet is valid
+     * @return false If the packet is smaller than its header or the size does not match, the packet must be discarded
+     */
+    static bool parsePacket(Packet<uint8_t>* p, PacketView& view);
+
+    /**
+     * @brief Copy the header of the packet without the payload
+     *
+     * @param p Packet
+     * @param view View of the packet
+     * @param header Header copied, the fields that the packet does not have are set to 0
+     */
+    static void copyPacketHeader(Packet<uint8_t>* p, const PacketView& view, ControlPacket& header);
 };
 
 #endif
@@ -0,0 +1,19 @@
+#include "PacketTypeTable.h"
+
+// The table is built by the compiler, it is constant data
+constexpr PacketTypeTable::Table PacketTypeTable::table;
+
+static_assert(PacketTypeTable::classify(DATA_P | COMPRESSED_P).kind == PacketKind::DATA, "Compressed data packet");
+static_assert(PacketTypeTable::classify(AGGREGATED_P).kind == PacketKind::AGGREGATED, "Aggregated packet before ACK and XL");
+static_assert(PacketTypeTable::classify(AGGREGATED_ACK_P).kind == PacketKind::AGGREGATED, "Aggregated packet with an ACK before SACK");
+static_assert(PacketTypeTable::classify(MC_NACK_P).kind == PacketKind::MULTICAST_NACK, "Multicast NACK before SYNC and LOST");
+static_assert(PacketTypeTable::classify(XL_PARITY_P).kind == PacketKind::XL_PARITY, "Parity packet before LOST");
+static_assert(PacketTypeTable::classify(SACK_P).kind == PacketKind::SACK, "Selective ACK before ACK and LOST");
+static_assert(PacketTypeTable::classify(MC_SYNC_P).kind == PacketKind::SYNC, "Multicast SYNC before XL");
+static_assert(PacketTypeTable::classify(HELLO_SOLICIT_P).packetClass == PacketClass::ROUTE, "Routing packet");
+static_assert(PacketTypeTable::classify(HELLO_LOAD_P).packetClass == PacketClass::ROUTE, "Routing packet with the load of the gateways");
+static_assert(PacketTypeTable::classify(HELLO_BEACON_P | HELLO_COMPACT_P).packetClass == PacketClass::ROUTE, "Routing packet with the slots, before DATA");
+static_assert(PacketTypeTable::classify(NEED_ACK_P).needAck, "Packet that needs an ACK");
+static_assert(!PacketTypeTable::classify(HELLO_BEACON_P | HELLO_COMPACT_HEADER_P).needAck, "Routing packet with the NEED_ACK_P bits");
+static_assert(PacketTypeTable::classify(HELLO_BEACON_P | HELLO_DELTA_P | HELLO_COMPACT_P).controlOnly, "Routing packet with the AGGREGATED_P bits");
+static_assert(PacketTypeTable::classify(HELLO_BEACON_P).typeHeaderLength == 0, "Routing packet with the DATA_P bit");
@@ -0,0 +1,141 @@
+#ifndef _LORAMESHER_PACKET_TYPE_TABLE_H
+#define _LORAMESHER_PACKET_TYPE_TABLE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/PacketHeader.h"
+#include "entities/packets/ControlPacket.h"
+#include "entities/packets/DataPacket.h"
+#include "entities/packets/RoutePacket.h"
+#include "entities/packets/PacketView.h"
+
+/**
+ * @brief Handler of a packet received by this node, selected by the type table
+ *
+ */
+enum class PacketKind : uint8_t {
+    // No handler, the types without the DATA_P nor the HELLO_P bits can have a user handler
+    NONE = 0,
+    ROUTE,
+    DATA,
+    AGGREGATED,
+    MULTICAST_NACK,
+    SACK,
+    ACK,
+    LOST,
+    SYNC,
+    XL_DATA,
+    XL_PARITY
+};
+
+/**
+ * @brief Classification of a packet type
+ *
+ */
+struct PacketTypeInfo {
+    PacketClass packetClass;
+    PacketKind kind;
+    // Header of the parsed view, the payload starts after it
+    uint8_t headerLength;
+    // Header of PacketService::getHeaderLength, 0 for the routing packets and PacketHeader for the user types
+    uint8_t typeHeaderLength;
+    // The whole packet is control data, routing packets, ACKs and lost packets
+    bool controlOnly : 1;
+    // The destination answers it with an ACK
+    bool needAck : 1;
+};
+
+/**
+ * @brief Table of the 256 packet types, built at compile time. The bits of the types overlap, e.g. ACK_P and
+ * SYNC_P contain DATA_P, the order of the checks is only written in classify. Receiving a packet is then
+ * one lookup and one switch over its kind, instead of a chain of bit tests.
+ *
+ */
+class PacketTypeTable {
+public:
+    /**
+     * @brief Get the classification of a type
+     *
+     */
+    static const PacketTypeInfo& get(uint8_t type) { return table.entries[type]; }
+
+    /**
+     * @brief Classify a type, the same bit tests of the PacketService::is functions in the order they must be checked
+     *
+     */
+    static constexpr PacketTypeInfo classify(uint8_t type) {
+        PacketTypeInfo info = {PacketClass::UNKNOWN, PacketKind::NONE, sizeof(PacketHeader), 0, false, false};
+
+        // The HELLO types can have the DATA_P bit, HELLO_BEACON_P, the data bits are not checked on them
+        bool isHello = has(type, HELLO_P);
+        bool isData = !isHello && has(type, DATA_P);
+        bool isAggregated = !isHello && has(type, AGGREGATED_P);
+        bool isOnlyData = (type & ~COMPRESSED_P) == DATA_P;
+
+        info.controlOnly = !isAggregated && (isHello || has(type, ACK_P) || has(type, LOST_P));
+        info.needAck = !isHello && has(type, NEED_ACK_P);
+
+        bool isControl = !(isHello || isOnlyData || isAggregated);
+        if (isControl)
+            info.typeHeaderLength = isData ? sizeof(ControlPacket) : sizeof(PacketHeader);
+        else
+            info.typeHeaderLength = isData ? sizeof(DataPacket) : 0;
+
+        if (isHello) {
+            info.packetClass = PacketClass::ROUTE;
+            info.kind = PacketKind::ROUTE;
+            info.headerLength = sizeof(RoutePacket);
+            return info;
+        }
+
+        if (isControl && isData) {
+            info.packetClass = PacketClass::CONTROL;
+            info.headerLength = sizeof(ControlPacket);
+        }
+        else if (isData) {
+            info.packetClass = PacketClass::DATA;
+            info.headerLength = sizeof(DataPacket);
+        }
+        else
+            return info;
+
+        // MC_NACK_P has the SYNC and LOST bits, SACK_P the ACK and LOST bits and XL_PARITY_P the XL and LOST bits,
+        // they are checked before them
+        if (isAggregated)
+            info.kind = PacketKind::AGGREGATED;
+        else if (isOnlyData)
+            info.kind = PacketKind::DATA;
+        else if (type == MC_NACK_P)
+            info.kind = PacketKind::MULTICAST_NACK;
+        else if (has(type, SACK_P))
+            info.kind = PacketKind::SACK;
+        else if (has(type, ACK_P))
+            info.kind = PacketKind::ACK;
+        else if (has(type, XL_PARITY_P))
+            info.kind = PacketKind::XL_PARITY;
+        else if (has(type, LOST_P))
+            info.kind = PacketKind::LOST;
+        else if (has(type, SYNC_P))
+            info.kind = PacketKind::SYNC;
+        else if (has(type, XL_DATA_P))
+            info.kind = PacketKind::XL_DATA;
+
+        return info;
+    }
+
+private:
+    static constexpr bool has(uint8_t type, uint8_t mask) { return (type & mask) == mask; }
+
+    struct Table {
+        PacketTypeInfo entries[256];
+
+        constexpr Table(): entries() {
+            for (uint16_t type = 0; type < 256; type++)
+                entries[type] = classify(type);
+        }
+    };
+
+    static const Table table;
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include "PersistenceService.h"
+
+#include "utilities/DuplicateCache.hpp"
+
+#include "nvs.h"
+#include "nvs_flash.h"
+
+static const char* PERSIST_ROUTES_KEY = "routes";
+
+void PersistenceService::configure(bool enabled_, uint32_t interval_) {
+    enabled = enabled_;
+    interval = interval_;
+    lastWrite = millis();
+
+    if (!enabled)
+        return;
+
+    //Arduino initializes it before the setup, it is only done once
+    esp_err_t err = nvs_flash_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(LM_TAG, "NVS could not be initialized (%d), the routing table is not persisted", err);
+        enabled = false;
+    }
+}
+
+size_t PersistenceService::restoreRoutingTable() {
+    if (!enabled)
+        return 0;
+
+    nvs_handle_t handle;
+    if (nvs_open(LM_PERSIST_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return 0;
+
+    size_t size = 0;
+    if (nvs_get_blob(handle, PERSIST_ROUTES_KEY, nullptr, &size) != ESP_OK || size < sizeof(PersistedHeader)) {
+        nvs_close(handle);
+        return 0;
+    }
+
+    uint8_t* buffer = new uint8_t[size];
+    esp_err_t err = nvs_get_blob(handle, PERSIST_ROUTES_KEY, buffer, &size);
+    nvs_close(handle);
+
+    PersistedHeader* header = reinterpret_cast<PersistedHeader*>(buffer);
+    PersistedRoute* routes = reinterpret_cast<PersistedRoute*>(buffer + sizeof(PersistedHeader));
+    size_t routesSize = size - sizeof(PersistedHeader);
+
+    //The flash could have been written by another version or copied from another node
+    if (err != ESP_OK || header->version != VERSION || header->localAddress != WiFiService::getLocalAddress() ||
+        routesSize != header->numRoutes * sizeof(PersistedRoute) || LM_Hash::fnv1a(routes, routesSize) != header->checksum) {
+        ESP_LOGW(LM_TAG, "Persisted routing table not valid, it is not restored");
+        delete[] buffer;
+        return 0;
+    }
+
+    uint32_t timeout = millis() + LM_PERSIST_ROUTE_TIMEOUT * 1000;
+    size_t restored = 0;
+
+    for (uint16_t i = 0; i < header->numRoutes; i++) {
+        PersistedRoute& route = routes[i];
+
+        RouteNode node(route.address, route.metric, route.role, route.via);
+        node.receivedSNR = route.receivedSNR;
+        node.sentSNR = route.sentSNR;
+        node.SRTT = route.SRTT;
+        node.RTTVAR = std::min(route.RTTVAR * 2UL, 60000UL);
+
+        if (RoutingTableService::restoreRoute(node, timeout))
+            restored++;
+    }
+
+    lastChecksum = header->checksum;
+
+    delete[] buffer;
+
+    ESP_LOGI(LM_TAG, "Restored %d routes of %d", restored, header->numRoutes);
+
+    return restored;
+}
+
+bool PersistenceService::saveRoutingTable(bool force) {
+    if (!enabled)
+        return false;
+
+    unsigned long now = millis();
+    if (!force && now - lastWrite < interval * 1000UL)
+        return false;
+
+    //The routing table can grow while it is copied, the routes that do not fit are written the next time
+    size_t maxRoutes = RoutingTableService::routingTableSize();
+    size_t size = sizeof(PersistedHeader) + maxRoutes * sizeof(PersistedRoute);
+    uint8_t* buffer = new uint8_t[size];
+
+    PersistedRoute* routes = reinterpret_cast<PersistedRoute*>(buffer + sizeof(PersistedHeader));
+    uint16_t numRoutes = 0;
+
+    RoutingTableService::forEachNode([&](const RouteNode* node) {
+        //The restored routes not validated yet are kept, the node could restart again before validating them
+        if (numRoutes >= maxRoutes)
+            return;
+
+        PersistedRoute& route = routes[numRoutes++];
+        route.address = node->networkNode.address;
+        route.metric = node->networkNode.metric;
+        route.role = node->networkNode.role;
+        route.via = node->via;
+        route.receivedSNR = node->receivedSNR;
+        route.sentSNR = node->sentSNR;
+        route.SRTT = std::min(node->SRTT, 60000UL);
+        route.RTTVAR = std::min(node->RTTVAR, 60000UL);
+    });
+
+    size_t routesSize = numRoutes * sizeof(PersistedRoute);
+
+    PersistedHeader* header = reinterpret_cast<PersistedHeader*>(buffer);
+    header->version = VERSION;
+    header->localAddress = WiFiService::getLocalAddress();
+    header->numRoutes = numRoutes;
+    header->checksum = LM_Hash::fnv1a(routes, routesSize);
+    uint32_t checksum = header->checksum;
+
+    //Every write wears the flash, the same routes are not written again
+    if (checksum == lastChecksum) {
+        delete[] buffer;
+        lastWrite = now;
+        return false;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(LM_PERSIST_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, PERSIST_ROUTES_KEY, buffer, sizeof(PersistedHeader) + routesSize);
+        if (err == ESP_OK)
+            err = nvs_commit(handle);
+
+        nvs_close(handle);
+    }
+
+    delete[] buffer;
+
+    if (err != ESP_OK) {
+        ESP_LOGE(LM_TAG, "Routing table could not be persisted (%d)", err);
+        return false;
+    }
+
+    lastWrite = now;
+    lastChecksum = checksum;
+
+    ESP_LOGI(LM_TAG, "Persisted %d routes", numRoutes);
+
+    return true;
+}
+
+bool PersistenceService::enabled = false;
+
+uint32_t PersistenceService::interval = LM_PERSIST_INTERVAL;
+
+unsigned long PersistenceService::lastWrite = 0;
+
+uint32_t PersistenceService::lastChecksum = 0;
@@ -0,0 +1,95 @@
+#ifndef _LORAMESHER_PERSISTENCE_SERVICE_H
+#define _LORAMESHER_PERSISTENCE_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "services/RoutingTableService.h"
+
+/**
+ * @brief Persistence of the routing table in NVS. The routes, the RTT and the SNR of the neighbours are
+ * restored after a reboot, the nodes do not wait several HELLO packets to rebuild the routes nor use the
+ * default timeouts of the reliable payloads. The restored routes are validated by the HELLO packets of their next hop.
+ *
+ */
+class PersistenceService {
+public:
+    /**
+     * @brief Configure the persistence, NVS is initialized if it is enabled
+     *
+     * @param enabled If false the routing table is not written nor restored
+     * @param interval Minimum seconds between two writes
+     */
+    static void configure(bool enabled, uint32_t interval);
+
+    /**
+     * @brief Restore the routing table written by this node. The routes are restored with
+     * LM_PERSIST_ROUTE_TIMEOUT and the RTT variation is doubled, the link may have changed while the node was off.
+     *
+     * @return size_t Number of routes restored
+     */
+    static size_t restoreRoutingTable();
+
+    /**
+     * @brief Write the routing table if it has changed since the last write, at most once every interval
+     *
+     * @param force If true it is written without waiting for the interval, used when the node stops
+     * @return true If it has been written
+     * @return false If not, because it is disabled, it has not changed, the interval has not passed or on error
+     */
+    static bool saveRoutingTable(bool force = false);
+
+private:
+#pragma pack(1)
+    /**
+     * @brief Route written in NVS
+     *
+     */
+    struct PersistedRoute {
+        uint16_t address;
+        uint8_t metric;
+        uint8_t role;
+        uint16_t via;
+        int8_t receivedSNR;
+        int8_t sentSNR;
+        // RTT in ms, SRTT and RTTVAR are capped at 60 seconds
+        uint16_t SRTT;
+        uint16_t RTTVAR;
+    };
+
+    /**
+     * @brief Header of the routes written in NVS
+     *
+     */
+    struct PersistedHeader {
+        uint8_t version;
+        uint16_t localAddress;
+        uint16_t numRoutes;
+        // FNV-1a of the routes
+        uint32_t checksum;
+    };
+#pragma pack()
+
+    /**
+     * @brief Version of the format, the routes of other versions are not restored
+     *
+     */
+    static const uint8_t VERSION = 1;
+
+    static bool enabled;
+
+    static uint32_t interval;
+
+    /**
+     * @brief Time of the last write, or of the configuration
+     *
+     */
+    static unsigned long lastWrite;
+
+    /**
+     * @brief Checksum of the routes inside NVS
+     *
+     */
+    static uint32_t lastChecksum;
+};
+
+#endif
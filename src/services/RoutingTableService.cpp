@@ -1,5 +1,9 @@
 #include "RoutingTableService.h"
 
+#include "services/PacketService.h"
+
+#include "utilities/DuplicateCache.hpp"
+
 size_t RoutingTableService::routingTableSize() {
     return routingTableList->getLength();
 }
@@ -7,39 +11,54 @@ size_t RoutingTableService::routingTableSize() {
 RouteNode* RoutingTableService::findNode(uint16_t address) {
     routingTableList->setInUse();
 
-    if (routingTableList->moveToStart()) {
-        do {
-            RouteNode* node = routingTableList->getCurrent();
-
-            if (node->networkNode.address == address) {
-                routingTableList->releaseInUse();
-                return node;
-            }
-
-        } while (routingTableList->next());
-    }
+    RouteNode* node = routingTableIndex->Find(address);
 
     routingTableList->releaseInUse();
-    return nullptr;
+    return node;
 }
 
 RouteNode* RoutingTableService::getBestNodeByRole(uint8_t role) {
-    RouteNode* bestNode = nullptr;
-
     routingTableList->setInUse();
 
-    if (routingTableList->moveToStart()) {
-        do {
-            RouteNode* node = routingTableList->getCurrent();
+    RouteNode* nearest = nullptr;
+    forEachNodeWithRole(role, [&](RouteNode* node) {
+        if (nearest == nullptr || node->networkNode.metric < nearest->networkNode.metric)
+            nearest = node;
+    });
 
-            if ((node->networkNode.role & role) == role &&
-                (bestNode == nullptr || node->networkNode.metric < bestNode->networkNode.metric)) {
-                bestNode = node;
-            }
-
-        } while (routingTableList->next());
+    if (nearest == nullptr) {
+        routingTableList->releaseInUse();
+        return nullptr;
     }
 
+    uint8_t maxMetric = addMetric(nearest->networkNode.metric, LM_GATEWAY_METRIC_MARGIN);
+
+    uint8_t minLoad = UINT8_MAX;
+    forEachNodeWithRole(role, [&](RouteNode* node) {
+        if (node->networkNode.metric <= maxMetric && node->load < minLoad)
+            minLoad = node->load;
+    });
+
+    uint16_t maxLoad = minLoad + LM_GATEWAY_LOAD_MARGIN;
+
+    //The nodes that see the same nodes choose different ones, the choice of every node does not change while they are equal
+    uint16_t localAddress = WiFiService::getLocalAddress();
+    RouteNode* bestNode = nullptr;
+    uint32_t bestHash = 0;
+
+    forEachNodeWithRole(role, [&](RouteNode* node) {
+        if (node->networkNode.metric > maxMetric || node->load > maxLoad)
+            return;
+
+        uint16_t addresses[2] = {localAddress, node->networkNode.address};
+        uint32_t hash = LM_Hash::fnv1a(addresses, sizeof(addresses));
+
+        if (bestNode == nullptr || hash < bestHash) {
+            bestNode = node;
+            bestHash = hash;
+        }
+    });
+
     routingTableList->releaseInUse();
     return bestNode;
 }
@@ -50,12 +69,47 @@ bool RoutingTableService::hasAddressRoutingTable(uint16_t address) {
 }
 
 uint16_t RoutingTableService::getNextHop(uint16_t dst) {
+    routingTableList->setInUse();
+
+    RouteNode* node = routingTableIndex->Find(dst);
+    uint16_t via = 0;
+
+    if (node != nullptr) {
+        via = node->via;
+
+#if LM_ROUTE_LOAD_BALANCE
+        // Rotate between the primary and the alternates with the same metric
+        uint16_t paths[LM_ROUTE_ALTERNATES + 1] = {node->via};
+        uint8_t numPaths = 1;
+
+        for (AlternateRoute& alternate : node->alternates) {
+            if (isAlternateValid(alternate) && alternate.metric == node->networkNode.metric)
+                paths[numPaths++] = alternate.via;
+        }
+
+        via = paths[node->nextPath++ % numPaths];
+#endif
+    }
+
+    routingTableList->releaseInUse();
+
+    return via;
+}
+
+bool RoutingTableService::isNextHop(uint16_t dst, uint16_t via) {
     RouteNode* node = findNode(dst);
+    return node != nullptr && node->via == via;
+}
 
-    if (node == nullptr)
-        return 0;
+bool RoutingTableService::hasRouteNotVia(uint16_t via) {
+    bool found = false;
+
+    forEachNode([&](const RouteNode* node) {
+        if (node->via != via)
+            found = true;
+    });
 
-    return node->via;
+    return found;
 }
 
 uint8_t RoutingTableService::getNumberOfHops(uint16_t address) {
@@ -64,31 +118,96 @@ uint8_t RoutingTableService::getNumberOfHops(uint16_t address) {
     if (node == nullptr)
         return 0;
 
-    return node->networkNode.metric;
+    return getNumberOfHops(node);
 }
 
-void RoutingTableService::processRoute(RoutePacket* p, int8_t receivedSNR) {
-    if ((p->packetSize - sizeof(RoutePacket)) % sizeof(NetworkNode) != 0) {
-        ESP_LOGE(LM_TAG, "Invalid route packet size");
-        return;
+uint8_t RoutingTableService::getNumberOfHops(RouteNode* node) {
+    uint8_t metric = node->networkNode.metric;
+    if (metric == 0)
+        return 0;
+
+    // Every link costs at least the minimum, the route cannot have more hops
+    uint8_t hops = metric / linkMetric->getMinimumLinkCost();
+    return hops == 0 ? 1 : hops;
+}
+
+void RoutingTableService::setLinkMetric(LinkMetric* metric) {
+    routingTableList->setInUse();
+
+    if (linkMetric != metric)
+        delete linkMetric;
+
+    linkMetric = metric != nullptr ? metric : new HopCountLinkMetric();
+
+    routingTableList->releaseInUse();
+}
+
+uint8_t RoutingTableService::addMetric(uint8_t metric, uint8_t cost) {
+    return metric > UINT8_MAX - cost ? UINT8_MAX : metric + cost;
+}
+
+bool RoutingTableService::processRoute(RoutePacket* p, int8_t receivedSNR) {
+    NetworkNode* nodes = p->networkNodes;
+    size_t numNodes;
+
+    if (PacketService::isHelloCompactPacket(p->type)) {
+        nodes = decodedNodes;
+
+        if (!PacketService::decodeCompactNetworkNodes(p, nodes, RTMAXSIZE, numNodes)) {
+            ESP_LOGE(LM_TAG, "Invalid compact route packet");
+            return false;
+        }
     }
+    else {
+        if ((p->packetSize - sizeof(RoutePacket)) % sizeof(NetworkNode) != 0) {
+            ESP_LOGE(LM_TAG, "Invalid route packet size");
+            return false;
+        }
 
-    size_t numNodes = p->getNetworkNodesSize();
+        numNodes = p->getNetworkNodesSize();
+    }
     ESP_LOGI(LM_TAG, "Route packet from %X with size %d", p->src, numNodes);
 
-    NetworkNode* receivedNode = new NetworkNode(p->src, 1, p->nodeRole);
-    processRoute(p->src, receivedNode);
-    delete receivedNode;
+    routingTableList->setInUse();
+
+    RouteNode* sender = routingTableIndex->Find(p->src);
+    if (sender != nullptr) {
+        ESP_LOGI(LM_TAG, "Reset Receive SNR from %X: %d", p->src, receivedSNR);
+        sender->receivedSNR = receivedSNR;
+    }
+
+    uint8_t linkCost = linkMetric->getLinkCost(receivedSNR, sender);
+
+    NetworkNode receivedNode = NetworkNode(p->src, linkCost, p->nodeRole);
 
-    resetReceiveSNRRoutePacket(p->src, receivedSNR);
+    // Computed once for the whole packet and updated with every new route added
+    uint8_t maximumMetric = calculateMaximumMetricOfRoutingTable();
+
+    bool changed = processRoute(p->src, &receivedNode, 0, maximumMetric);
+
+    if (sender == nullptr) {
+        sender = routingTableIndex->Find(p->src);
+        if (sender != nullptr)
+            sender->receivedSNR = receivedSNR;
+    }
 
     for (size_t i = 0; i < numNodes; i++) {
-        NetworkNode* node = &p->networkNodes[i];
-        node->metric++;
-        processRoute(p->src, node);
+        NetworkNode* node = &nodes[i];
+        uint8_t advertisedMetric = node->metric;
+        node->metric = addMetric(node->metric, linkCost);
+        changed |= processRoute(p->src, node, advertisedMetric, maximumMetric);
     }
 
-    printRoutingTable();
+    // The routes not included in a delta HELLO are still valid
+    if (PacketService::isHelloDeltaPacket(p->type))
+        resetTimeoutRoutesVia(p->src);
+
+    routingTableList->releaseInUse();
+
+    if (changed)
+        LM_TRACE_I(TraceEvent::ROUTING_TABLE_CHANGED, routingTableSize());
+
+    return changed;
 }
 
 void RoutingTableService::resetReceiveSNRRoutePacket(uint16_t src, int8_t receivedSNR) {
@@ -101,45 +220,265 @@ void RoutingTableService::resetReceiveSNRRoutePacket(uint16_t src, int8_t receiv
     rNode->receivedSNR = receivedSNR;
 }
 
-void RoutingTableService::processRoute(uint16_t via, NetworkNode* node) {
-    if (node->address != WiFiService::getLocalAddress()) {
+void RoutingTableService::resetSentSNRRoutePacket(uint16_t src, int8_t sentSNR) {
+    RouteNode* rNode = findNode(src);
+    if (rNode == nullptr)
+        return;
 
-        RouteNode* rNode = findNode(node->address);
-        //If nullptr the node is not inside the routing table, then add it
-        if (rNode == nullptr) {
-            addNodeToRoutingTable(node, via);
-            return;
-        }
+    ESP_LOGI(LM_TAG, "Reset Sent SNR from %X: %d", src, sentSNR);
 
-        //Update the metric and restart timeout if needed
-        if (node->metric < rNode->networkNode.metric) {
-            rNode->networkNode.metric = node->metric;
-            rNode->via = via;
-            resetTimeoutRoutingNode(rNode);
-            ESP_LOGI(LM_TAG, "Found better route for %X via %X metric %d", node->address, via, node->metric);
-        }
-        else if (node->metric == rNode->networkNode.metric) {
-            //Reset the timeout, only when the metric is the same as the actual route.
-            resetTimeoutRoutingNode(rNode);
-        }
+    rNode->sentSNR = sentSNR;
+}
+
+size_t RoutingTableService::getLinkReports(LinkReport* reports, size_t maxReports) {
+    routingTableList->setInUse();
+
+    size_t numOfNeighbours = 0;
+    size_t numOfReports = 0;
+
+    if (routingTableList->moveToStart()) {
+        do {
+            RouteNode* node = routingTableList->getCurrent();
+            if (node->via != node->networkNode.address)
+                continue;
+
+            //Skip the neighbours reported in the previous call
+            if (numOfNeighbours++ >= linkReportsStart && numOfReports < maxReports)
+                reports[numOfReports++] = LinkReport(node->networkNode.address, node->receivedSNR);
+        } while (routingTableList->next());
+    }
+
+    //Start again from the first neighbours when all of them have been reported
+    if (numOfReports < maxReports && routingTableList->moveToStart()) {
+        size_t i = 0;
+        do {
+            RouteNode* node = routingTableList->getCurrent();
+            if (node->via != node->networkNode.address)
+                continue;
+
+            if (i++ >= linkReportsStart || numOfReports >= maxReports)
+                break;
+
+            reports[numOfReports++] = LinkReport(node->networkNode.address, node->receivedSNR);
+        } while (routingTableList->next());
+    }
+
+    routingTableList->releaseInUse();
+
+    linkReportsStart = numOfNeighbours == 0 ? 0 : (linkReportsStart + numOfReports) % numOfNeighbours;
+
+    return numOfReports;
+}
+
+size_t RoutingTableService::getLoadReports(LoadReport* reports, size_t maxReports, uint8_t localLoad) {
+    size_t numOfReports = 0;
+
+    if (maxReports > 0 && RoleService::isGateway())
+        reports[numOfReports++] = LoadReport(WiFiService::getLocalAddress(), localLoad);
+
+    routingTableList->setInUse();
+
+    forEachNodeWithRole(ROLE_GATEWAY, [&](RouteNode* node) {
+        //The restored routes have not been advertised by their next hop yet, neither their load
+        if (numOfReports < maxReports && !node->restored)
+            reports[numOfReports++] = LoadReport(node->networkNode.address, node->load);
+    });
+
+    routingTableList->releaseInUse();
+
+    return numOfReports;
+}
+
+void RoutingTableService::updateLoads(uint16_t via, const LoadReport* reports, size_t numOfReports) {
+    routingTableList->setInUse();
+
+    for (size_t i = 0; i < numOfReports; i++) {
+        RouteNode* node = routingTableIndex->Find(reports[i].address);
+
+        //The load of the gateway is the one known by the next hop of the route
+        if (node != nullptr && node->via == via)
+            node->load = reports[i].load;
+    }
+
+    routingTableList->releaseInUse();
+}
+
+void RoutingTableService::setCompactHeader(uint16_t address, bool compactHeader) {
+    routingTableList->setInUse();
+
+    RouteNode* node = routingTableIndex->Find(address);
+    if (node != nullptr)
+        node->compactHeader = compactHeader;
+
+    routingTableList->releaseInUse();
+}
+
+bool RoutingTableService::hasCompactHeader(uint16_t address) {
+    routingTableList->setInUse();
+
+    RouteNode* node = routingTableIndex->Find(address);
+    bool compactHeader = node != nullptr && node->compactHeader;
+
+    routingTableList->releaseInUse();
+
+    return compactHeader;
+}
+
+bool RoutingTableService::hasUniqueShortAddresses() {
+    routingTableList->setInUse();
+
+    bool unique = sharedShortAddresses == 0 && shortAddressCount[PacketService::getShortAddress(WiFiService::getLocalAddress())] == 0;
+
+    routingTableList->releaseInUse();
+
+    return unique;
+}
+
+bool RoutingTableService::hasShortAddress(uint16_t address) {
+    uint16_t resolved;
+    return resolveShortAddress(PacketService::getShortAddress(address), resolved) && resolved == address;
+}
+
+bool RoutingTableService::resolveShortAddress(uint8_t shortAddress, uint16_t& address) {
+    uint16_t localAddress = WiFiService::getLocalAddress();
+
+    routingTableList->setInUse();
+
+    uint16_t count = shortAddressCount[shortAddress];
+    uint16_t owner = shortAddressOwner[shortAddress];
+
+    routingTableList->releaseInUse();
+
+    if (PacketService::getShortAddress(localAddress) == shortAddress) {
+        address = localAddress;
+        return count == 0;
+    }
+
+    address = owner;
+    return count == 1;
+}
+
+void RoutingTableService::incLinkCounter(uint16_t address, uint32_t LinkCounters::* counter, uint32_t count) {
+    routingTableList->setInUse();
+
+    RouteNode* node = routingTableIndex->Find(address);
+    if (node != nullptr && node->via != address)
+        node = routingTableIndex->Find(node->via);
+
+    if (node != nullptr)
+        node->counters.*counter += count;
+
+    routingTableList->releaseInUse();
+}
+
+void RoutingTableService::countReceivedPacket(uint16_t src) {
+    routingTableList->setInUse();
+
+    RouteNode* node = routingTableIndex->Find(src);
+    if (node != nullptr && node->via == src)
+        node->counters.rxPackets++;
+
+    routingTableList->releaseInUse();
+}
+
+size_t RoutingTableService::getNeighbourStats(NeighbourStats* stats, size_t maxNeighbours, bool reset) {
+    routingTableList->setInUse();
+
+    size_t numOfNeighbours = 0;
+
+    if (routingTableList->moveToStart()) {
+        do {
+            RouteNode* node = routingTableList->getCurrent();
+            if (node->via != node->networkNode.address)
+                continue;
+
+            if (numOfNeighbours >= maxNeighbours)
+                break;
+
+            stats[numOfNeighbours++] = {node->networkNode.address, node->counters};
+
+            if (reset)
+                node->counters = {};
+        } while (routingTableList->next());
+    }
+
+    routingTableList->releaseInUse();
+
+    return numOfNeighbours;
+}
+
+bool RoutingTableService::processRoute(uint16_t via, NetworkNode* node, uint8_t advertisedMetric, uint8_t& maximumMetric) {
+    if (node->address == WiFiService::getLocalAddress())
+        return false;
+
+    RouteNode* rNode = routingTableIndex->Find(node->address);
+    //If nullptr the node is not inside the routing table, then add it
+    if (rNode == nullptr)
+        return addNodeToRoutingTable(node, via, maximumMetric);
 
-        // Update the Role only if the node that sent the packet is the next hop
-        if (getNextHop(node->address) == via && node->role != rNode->networkNode.role) {
-            ESP_LOGI(LM_TAG, "Updating role of %X to %d", node->address, node->role);
-            rNode->networkNode.role = node->role;
+    bool changed = false;
+
+    //Update the metric and restart timeout if needed
+    if (node->metric < rNode->networkNode.metric) {
+        if (rNode->via != via) {
+            removeAlternate(rNode, via);
+            addAlternate(rNode, rNode->via, rNode->networkNode.metric, rNode->timeout);
         }
+
+        rNode->networkNode.metric = node->metric;
+        rNode->via = via;
+        resetTimeoutRoutingNode(rNode);
+        rNode->changed = true;
+        changed = true;
+        ESP_LOGI(LM_TAG, "Found better route for %X via %X metric %d", node->address, via, node->metric);
+    }
+    else if (node->metric == rNode->networkNode.metric) {
+        //Reset the timeout, only when the metric is the same as the actual route.
+        resetTimeoutRoutingNode(rNode);
+
+        if (rNode->via != via && advertisedMetric < rNode->networkNode.metric)
+            addAlternate(rNode, via, node->metric, rNode->timeout);
+    }
+    else if (rNode->via == via) {
+        //The cost of the actual route has increased, the next hop is the one that knows it
+        rNode->networkNode.metric = node->metric;
+        resetTimeoutRoutingNode(rNode);
+        rNode->changed = true;
+        changed = true;
+        ESP_LOGI(LM_TAG, "Route for %X via %X updated to metric %d", node->address, via, node->metric);
+
+        //An alternate could be better now
+        AlternateRoute* best = getBestAlternate(rNode);
+        if (best != nullptr && best->metric < rNode->networkNode.metric)
+            failover(rNode);
+    }
+    else if (advertisedMetric < rNode->networkNode.metric) {
+        //Only the next hops nearer to the destination than this node, they cannot route through this node
+        addAlternate(rNode, via, node->metric, millis() + DEFAULT_TIMEOUT * 1000);
     }
+
+    // Update the Role only if the node that sent the packet is the next hop
+    if (rNode->via == via && node->role != rNode->networkNode.role) {
+        ESP_LOGI(LM_TAG, "Updating role of %X to %d", node->address, node->role);
+        unindexRole(rNode);
+        rNode->networkNode.role = node->role;
+        indexRole(rNode);
+        rNode->changed = true;
+        changed = true;
+    }
+
+    return changed;
 }
 
-void RoutingTableService::addNodeToRoutingTable(NetworkNode* node, uint16_t via) {
+bool RoutingTableService::addNodeToRoutingTable(NetworkNode* node, uint16_t via, uint8_t& maximumMetric) {
     if (routingTableList->getLength() >= RTMAXSIZE) {
         ESP_LOGW(LM_TAG, "Routing table max size reached, not adding route and deleting it");
-        return;
+        return false;
     }
 
-    if (calculateMaximumMetricOfRoutingTable() < node->metric) {
+    if (maximumMetric < node->metric) {
         ESP_LOGW(LM_TAG, "Trying to add a route with a metric higher than the maximum of the routing table, not adding route and deleting it");
-        return;
+        return false;
     }
 
     RouteNode* rNode = new RouteNode(node->address, node->metric, node->role, via);
@@ -147,45 +486,170 @@ void RoutingTableService::addNodeToRoutingTable(NetworkNode* node, uint16_t via)
     //Reset the timeout of the node
     resetTimeoutRoutingNode(rNode);
 
-    routingTableList->setInUse();
-
     routingTableList->Append(rNode);
+    routingTableIndex->Add(rNode->networkNode.address, rNode);
+    indexRole(rNode);
+    indexShortAddress(rNode);
 
-    routingTableList->releaseInUse();
+    if (node->metric >= maximumMetric)
+        maximumMetric = addMetric(node->metric, linkMetric->getMaximumLinkCost());
 
     ESP_LOGI(LM_TAG, "New route added: %X via %X metric %d, role %d", node->address, via, node->metric, node->role);
+
+    return true;
 }
 
-NetworkNode* RoutingTableService::getAllNetworkNodes() {
+size_t RoutingTableService::getNetworkNodesToAdvertise(bool onlyChanged, NetworkNode* nodes, size_t maxNodes) {
     routingTableList->setInUse();
 
-    int routingSize = routingTableSize();
+    size_t numOfNodes = 0;
 
-    // If the routing table is empty return nullptr
-    if (routingSize == 0) {
-        routingTableList->releaseInUse();
-        return nullptr;
+    if (maxNodes > 0 && routingTableList->moveToStart()) {
+        do {
+            RouteNode* currentNode = routingTableList->getCurrent();
+            if ((onlyChanged && !currentNode->changed) || currentNode->restored)
+                continue;
+
+            nodes[numOfNodes++] = currentNode->networkNode;
+            currentNode->changed = false;
+        } while (numOfNodes < maxNodes && routingTableList->next());
     }
 
-    NetworkNode* payload = new NetworkNode[routingSize];
+    routingTableList->releaseInUse();
+
+    return numOfNodes;
+}
 
-    if (routingTableList->moveToStart()) {
-        for (int i = 0; i < routingSize; i++) {
-            RouteNode* currentNode = routingTableList->getCurrent();
-            payload[i] = currentNode->networkNode;
+size_t RoutingTableService::getNetworkNodes(NetworkNode* nodes, size_t maxNodes, size_t first) {
+    size_t position = 0;
+    size_t numOfNodes = 0;
 
-            if (!routingTableList->next())
-                break;
+    forEachNode([&](const RouteNode* node) {
+        if (position++ >= first && numOfNodes < maxNodes)
+            nodes[numOfNodes++] = node->networkNode;
+    });
+
+    return numOfNodes;
+}
+
+size_t RoutingTableService::getRouteNodes(RouteNode* nodes, size_t maxNodes, size_t first) {
+    size_t position = 0;
+    size_t numOfNodes = 0;
+
+    forEachNode([&](const RouteNode* node) {
+        if (position++ >= first && numOfNodes < maxNodes)
+            nodes[numOfNodes++] = *node;
+    });
+
+    return numOfNodes;
+}
+
+bool RoutingTableService::isAlternateValid(AlternateRoute& alternate) {
+    return alternate.via != 0 && (long) (alternate.timeout - millis()) > 0;
+}
+
+void RoutingTableService::addAlternate(RouteNode* node, uint16_t via, uint8_t metric, uint32_t timeout) {
+    if (via == node->via)
+        return;
+
+    AlternateRoute* slot = nullptr;
+
+    for (AlternateRoute& alternate : node->alternates) {
+        // The same next hop, update it
+        if (alternate.via == via) {
+            slot = &alternate;
+            break;
         }
+
+        // Prefer an invalid entry, then the worst one
+        if (slot == nullptr || (isAlternateValid(*slot) && (!isAlternateValid(alternate) || alternate.metric > slot->metric)))
+            slot = &alternate;
     }
 
-    routingTableList->releaseInUse();
+    if (slot == nullptr || (slot->via != via && isAlternateValid(*slot) && slot->metric <= metric))
+        return;
+
+    slot->via = via;
+    slot->metric = metric;
+    slot->timeout = timeout;
+}
+
+void RoutingTableService::removeAlternate(RouteNode* node, uint16_t via) {
+    for (AlternateRoute& alternate : node->alternates) {
+        if (alternate.via == via)
+            alternate.via = 0;
+    }
+}
+
+AlternateRoute* RoutingTableService::getBestAlternate(RouteNode* node) {
+    AlternateRoute* best = nullptr;
+
+    for (AlternateRoute& alternate : node->alternates) {
+        // The next hop must still be a neighbour
+        if (!isAlternateValid(alternate) || routingTableIndex->Find(alternate.via) == nullptr)
+            continue;
+
+        if (best == nullptr || alternate.metric < best->metric)
+            best = &alternate;
+    }
+
+    return best;
+}
+
+bool RoutingTableService::failover(RouteNode* node) {
+    AlternateRoute* best = getBestAlternate(node);
+    if (best == nullptr)
+        return false;
+
+    AlternateRoute previous = *best;
+
+    // The actual route is kept as an alternate while it is still valid
+    best->via = node->via;
+    best->metric = node->networkNode.metric;
+    best->timeout = node->timeout;
+
+    node->via = previous.via;
+    node->networkNode.metric = previous.metric;
+    node->timeout = previous.timeout;
+    node->changed = true;
+    routeTimeouts->update(node);
+
+    ESP_LOGI(LM_TAG, "Route for %X failed over to %X metric %d", node->networkNode.address, node->via, node->networkNode.metric);
+
+    return true;
+}
+
+void RoutingTableService::failoverRoutesVia(uint16_t via) {
+    if (routingTableList->moveToStart()) {
+        do {
+            RouteNode* node = routingTableList->getCurrent();
+            removeAlternate(node, via);
 
-    return payload;
+            if (node->via == via)
+                failover(node);
+        } while (routingTableList->next());
+    }
+}
+
+void RoutingTableService::resetTimeoutRoutesVia(uint16_t via) {
+    if (routingTableList->moveToStart()) {
+        do {
+            RouteNode* node = routingTableList->getCurrent();
+            if (node->via == via && !node->restored)
+                resetTimeoutRoutingNode(node);
+        } while (routingTableList->next());
+    }
 }
 
 void RoutingTableService::resetTimeoutRoutingNode(RouteNode* node) {
     node->timeout = millis() + DEFAULT_TIMEOUT * 1000;
+    routeTimeouts->update(node);
+
+    //A restored route is valid again, it is advertised with the next HELLO packet
+    if (node->restored) {
+        node->restored = false;
+        node->changed = true;
+    }
 }
 
 void RoutingTableService::aMessageHasBeenReceivedBy(uint16_t address) {
@@ -223,30 +687,148 @@ void RoutingTableService::printRoutingTable() {
 void RoutingTableService::manageTimeoutRoutingTable() {
     ESP_LOGI(LM_TAG, "Checking routes timeout");
 
+    uint16_t address;
+    bool removed = false;
+
+    while (popExpiredNode(address)) {
+        removeNodeIfExpired(address);
+        removed = true;
+    }
+
+    if (removed)
+        LM_TRACE_I(TraceEvent::ROUTING_TABLE_CHANGED, routingTableSize());
+}
+
+bool RoutingTableService::popExpiredNode(uint16_t& address) {
     routingTableList->setInUse();
 
-    if (routingTableList->moveToStart()) {
-        do {
-            RouteNode* node = routingTableList->getCurrent();
+    RouteNode* node;
 
-            if (node->timeout < millis()) {
-                ESP_LOGW(LM_TAG, "Route timeout %X via %X", node->networkNode.address, node->via);
+    // The routes with a valid alternate fail over instead of expiring
+    while ((node = routeTimeouts->popExpired(millis())) != nullptr && failover(node));
 
-                delete node;
-                routingTableList->DeleteCurrent();
-            }
+    if (node != nullptr) {
+        ESP_LOGW(LM_TAG, "Route timeout %X via %X", node->networkNode.address, node->via);
+        address = node->networkNode.address;
+    }
 
-        } while (routingTableList->next());
+    routingTableList->releaseInUse();
+
+    return node != nullptr;
+}
+
+void RoutingTableService::removeNodeIfExpired(uint16_t address) {
+    routingTableList->setInUse();
+
+    RouteNode* node = routingTableIndex->Find(address);
+
+    // The route could have been refreshed after expiring
+    if (node != nullptr && (long) (node->timeout - millis()) <= 0 && routingTableList->Search(node)) {
+        deleteCurrentNode();
+
+        // The routes through the removed neighbour fail over now, without waiting for their timeout
+        failoverRoutesVia(address);
     }
 
     routingTableList->releaseInUse();
+}
 
-    printRoutingTable();
+unsigned long RoutingTableService::getTimeUntilNextTimeout(unsigned long maxWait) {
+    return routeTimeouts->getTimeUntilFirst(millis(), maxWait);
 }
 
-uint8_t RoutingTableService::calculateMaximumMetricOfRoutingTable() {
+bool RoutingTableService::restoreRoute(const RouteNode& node, uint32_t timeout) {
+    uint16_t address = node.networkNode.address;
+    if (address == WiFiService::getLocalAddress())
+        return false;
+
     routingTableList->setInUse();
 
+    if (routingTableList->getLength() >= RTMAXSIZE || routingTableIndex->Find(address) != nullptr) {
+        routingTableList->releaseInUse();
+        return false;
+    }
+
+    RouteNode* rNode = new RouteNode(address, node.networkNode.metric, node.networkNode.role, node.via);
+    rNode->receivedSNR = node.receivedSNR;
+    rNode->sentSNR = node.sentSNR;
+    rNode->SRTT = node.SRTT;
+    rNode->RTTVAR = node.RTTVAR;
+    rNode->restored = true;
+    rNode->changed = false;
+    rNode->timeout = timeout;
+
+    routingTableList->Append(rNode);
+    routingTableIndex->Add(address, rNode);
+    indexRole(rNode);
+    indexShortAddress(rNode);
+    routeTimeouts->update(rNode);
+
+    routingTableList->releaseInUse();
+
+    ESP_LOGI(LM_TAG, "Route restored: %X via %X metric %d, role %d", address, node.via, node.networkNode.metric, node.networkNode.role);
+
+    return true;
+}
+
+void RoutingTableService::deleteCurrentNode() {
+    RouteNode* node = routingTableList->getCurrent();
+    if (node == nullptr)
+        return;
+
+    routingTableIndex->Remove(node->networkNode.address);
+    routeTimeouts->remove(node);
+    unindexRole(node);
+    unindexShortAddress(node);
+    routingTableList->DeleteCurrent();
+
+    delete node;
+}
+
+void RoutingTableService::indexRole(RouteNode* node) {
+    if (node->networkNode.role == ROLE_DEFAULT)
+        return;
+
+    if (roleIndexSize < LM_ROLE_INDEX_SIZE)
+        roleIndex[roleIndexSize++] = node;
+    else
+        unindexedRoles++;
+}
+
+void RoutingTableService::unindexRole(RouteNode* node) {
+    if (node->networkNode.role == ROLE_DEFAULT)
+        return;
+
+    for (size_t i = 0; i < roleIndexSize; i++) {
+        if (roleIndex[i] == node) {
+            roleIndex[i] = roleIndex[--roleIndexSize];
+            return;
+        }
+    }
+
+    if (unindexedRoles > 0)
+        unindexedRoles--;
+}
+
+void RoutingTableService::indexShortAddress(RouteNode* node) {
+    uint8_t shortAddress = PacketService::getShortAddress(node->networkNode.address);
+
+    if (shortAddressCount[shortAddress]++ == 1)
+        sharedShortAddresses++;
+
+    shortAddressOwner[shortAddress] ^= node->networkNode.address;
+}
+
+void RoutingTableService::unindexShortAddress(RouteNode* node) {
+    uint8_t shortAddress = PacketService::getShortAddress(node->networkNode.address);
+
+    if (--shortAddressCount[shortAddress] == 1)
+        sharedShortAddresses--;
+
+    shortAddressOwner[shortAddress] ^= node->networkNode.address;
+}
+
+uint8_t RoutingTableService::calculateMaximumMetricOfRoutingTable() {
     uint8_t maximumMetricOfRoutingTable = 0;
 
     if (routingTableList->moveToStart()) {
@@ -259,9 +841,29 @@ uint8_t RoutingTableService::calculateMaximumMetricOfRoutingTable() {
         } while (routingTableList->next());
     }
 
-    routingTableList->releaseInUse();
-
-    return maximumMetricOfRoutingTable + 1;
+    return addMetric(maximumMetricOfRoutingTable, linkMetric->getMaximumLinkCost());
 }
 
-LM_LinkedList<RouteNode>* RoutingTableService::routingTableList = new LM_LinkedList<RouteNode>();
\ No newline at end of file
+LM_LinkedList<RouteNode>* RoutingTableService::routingTableList = new LM_LinkedList<RouteNode>();
+
+LM_AddressMap<RouteNode, RTMAXSIZE>* RoutingTableService::routingTableIndex = new LM_AddressMap<RouteNode, RTMAXSIZE>();
+
+LM_DeadlineHeap<RouteNode>* RoutingTableService::routeTimeouts = new LM_DeadlineHeap<RouteNode>();
+
+LinkMetric* RoutingTableService::linkMetric = new HopCountLinkMetric();
+
+size_t RoutingTableService::linkReportsStart = 0;
+
+RouteNode* RoutingTableService::roleIndex[LM_ROLE_INDEX_SIZE] = {};
+
+size_t RoutingTableService::roleIndexSize = 0;
+
+size_t RoutingTableService::unindexedRoles = 0;
+
+uint16_t RoutingTableService::shortAddressCount[256] = {};
+
+uint16_t RoutingTableService::shortAddressOwner[256] = {};
+
+size_t RoutingTableService::sharedShortAddresses = 0;
+
+NetworkNode RoutingTableService::decodedNodes[RTMAXSIZE];
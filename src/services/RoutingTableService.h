@@ -3,10 +3,20 @@
 
 #include "utilities/LinkedQueue.hpp"
 
+#include "utilities/AddressMap.hpp"
+
+#include "utilities/DeadlineHeap.hpp"
+
 #include "entities/routingTable/RouteNode.h"
 
 #include "entities/routingTable/NetworkNode.h"
 
+#include "entities/routingTable/LinkMetric.h"
+
+#include "entities/routingTable/LinkReport.h"
+
+#include "entities/routingTable/LoadReport.h"
+
 #include "entities/packets/RoutePacket.h"
 
 #include "BuildOptions.h"
@@ -15,6 +25,8 @@
 
 #include "services/RoleService.h"
 
+#include "services/TraceService.h"
+
 /**
  * @brief Routing Table Service
  *
@@ -28,6 +40,33 @@ public:
 	 */
 	static LM_LinkedList<RouteNode>* routingTableList;
 
+	/**
+	 * @brief Index of the routing table by address. It contains the same nodes as the routingTableList
+	 * and it is protected by the routingTableList semaphore.
+	 *
+	 */
+	static LM_AddressMap<RouteNode, RTMAXSIZE>* routingTableIndex;
+
+	/**
+	 * @brief Timeouts of the routing table nodes ordered by deadline
+	 *
+	 */
+	static LM_DeadlineHeap<RouteNode>* routeTimeouts;
+
+	/**
+	 * @brief Link metric used to calculate the metric of the routes, hop count by default
+	 *
+	 */
+	static LinkMetric* linkMetric;
+
+	/**
+	 * @brief Set the Link Metric. The previous one is deleted. The metrics of the routes already inside the routing table
+	 * are updated with the next HELLO packets.
+	 *
+	 * @param metric Link metric, nullptr to use the hop count
+	 */
+	static void setLinkMetric(LinkMetric* metric);
+
 	/**
 	 * @brief Prints the actual routing table in the log
 	 *
@@ -35,11 +74,56 @@ public:
 	static void printRoutingTable();
 
 	/**
-	 * @brief Get the All Network Nodes that are inside the routing table
+	 * @brief Copy the network nodes to be sent in a HELLO packet into the array and mark them as not changed.
+	 * The nodes that do not fit keep their changed mark.
 	 *
-	 * @return NetworkNode* All the nodes in a list.
+	 * @param onlyChanged If true only the nodes changed since the last call are included
+	 * @param nodes Array where the nodes are written
+	 * @param maxNodes Size of the array
+	 * @return size_t Number of nodes written
 	 */
-	static NetworkNode* getAllNetworkNodes();
+	static size_t getNetworkNodesToAdvertise(bool onlyChanged, NetworkNode* nodes, size_t maxNodes);
+
+	/**
+	 * @brief Copy the network nodes of the routing table into the array, without allocating memory
+	 *
+	 * @param nodes Array where the nodes are written
+	 * @param maxNodes Size of the array
+	 * @param first Position of the first node copied, to copy the routing table in parts
+	 * @return size_t Number of nodes written
+	 */
+	static size_t getNetworkNodes(NetworkNode* nodes, size_t maxNodes, size_t first = 0);
+
+	/**
+	 * @brief Copy the route nodes of the routing table into the array, without allocating memory.
+	 * The copies remain valid when the routes are removed.
+	 *
+	 * @param nodes Array where the nodes are written
+	 * @param maxNodes Size of the array
+	 * @param first Position of the first node copied, to copy the routing table in parts
+	 * @return size_t Number of nodes written
+	 */
+	static size_t getRouteNodes(RouteNode* nodes, size_t maxNodes, size_t first = 0);
+
+	/**
+	 * @brief Call the visitor with every node of the routing table. The routing table is locked during the whole
+	 * iteration, the visitor must not call the functions of the routing table nor keep the pointers after returning.
+	 *
+	 * @tparam Visitor Callable with a const RouteNode*
+	 * @param visitor Visitor
+	 */
+	template <typename Visitor>
+	static void forEachNode(Visitor visitor) {
+		routingTableList->setInUse();
+
+		if (routingTableList->moveToStart()) {
+			do {
+				visitor(static_cast<const RouteNode*>(routingTableList->getCurrent()));
+			} while (routingTableList->next());
+		}
+
+		routingTableList->releaseInUse();
+	}
 
 	/**
 	 * @brief Find the node that contains the address
@@ -50,7 +134,10 @@ public:
 	static RouteNode* findNode(uint16_t address);
 
 	/**
-	 * @brief Get the best node that contains a role, the nearest
+	 * @brief Get the best node that contains a role. The nodes up to LM_GATEWAY_METRIC_MARGIN above the nearest are
+	 * equally reachable, the least loaded of them is chosen and the loads up to LM_GATEWAY_LOAD_MARGIN above it are equal.
+	 * Every node chooses a different one between the equal nodes, by the hash of both addresses, to spread the traffic.
+	 * Only the nodes of the role index are compared.
 	 *
 	 * @param role role to be found
 	 * @return RouteNode* pointer to the RouteNode or nullptr
@@ -67,13 +154,33 @@ public:
 	static bool hasAddressRoutingTable(uint16_t address);
 
 	/**
-	 * @brief Get the Next Hop address
+	 * @brief Get the Next Hop address. With LM_ROUTE_LOAD_BALANCE it rotates between the next hops with the same metric
 	 *
 	 * @param dst address of the next hop
 	 * @return uint16_t address of the next hop
 	 */
 	static uint16_t getNextHop(uint16_t dst);
 
+	/**
+	 * @brief Returns if via is the next hop of the route to dst
+	 *
+	 * @param dst Destination address
+	 * @param via Next hop
+	 * @return true If the route to dst goes through via
+	 * @return false If not or if there is no route
+	 */
+	static bool isNextHop(uint16_t dst, uint16_t via);
+
+	/**
+	 * @brief Returns if there is a route whose next hop is not via. A node that reaches all the others through via
+	 * does not need to forward the multicast packets received from it.
+	 *
+	 * @param via Next hop
+	 * @return true If any route has another next hop
+	 * @return false If all the routes go through via or the routing table is empty
+	 */
+	static bool hasRouteNotVia(uint16_t via);
+
 	/**
 	 * @brief Get the Number Of Hops of the address inside the routing table
 	 *
@@ -82,6 +189,15 @@ public:
 	 */
 	static uint8_t getNumberOfHops(uint16_t address);
 
+	/**
+	 * @brief Get the Number Of Hops of the route node. With a link metric other than the hop count it is the
+	 * maximum number of hops that the metric of the route allows.
+	 *
+	 * @param node Route node
+	 * @return uint8_t Number of Hops, 0 if the node has no metric
+	 */
+	static uint8_t getNumberOfHops(RouteNode* node);
+
 	/**
 	 * @brief Returns the routing table size
 	 *
@@ -90,18 +206,15 @@ public:
 	static size_t routingTableSize();
 
 	/**
-	 * @brief Process the network packet
+	 * @brief Process the network packet. The routing table is locked once and all the network nodes
+	 * of the packet are merged in a single pass.
 	 *
 	 * @param p Route Packet
+	 * @param receivedSNR Received SNR
+	 * @return true If the routing table has changed (new route, better route or role updated)
+	 * @return false If the routing table is the same
 	 */
-
-	 /**
-	  * @brief Process the network packet
-	  *
-	  * @param p Route Packet
-	  * @param receivedSNR Received SNR
-	  */
-	static void processRoute(RoutePacket* p, int8_t receivedSNR);
+	static bool processRoute(RoutePacket* p, int8_t receivedSNR);
 
 	/**
 	 * @brief Reset the SNR from the Route Node received
@@ -120,35 +233,280 @@ public:
 	static void resetSentSNRRoutePacket(uint16_t src, int8_t sentSNR);
 
 	/**
-	 * @brief Checks all the routing entries for a route timeout and remove the entry.
+	 * @brief Get the link reports of the neighbours, the SNR at which they are received. If there are more neighbours
+	 * than maxReports, every call starts with the ones that did not fit in the previous one.
+	 *
+	 * @param reports Array where the reports are written
+	 * @param maxReports Size of the array
+	 * @return size_t Number of reports
+	 */
+	static size_t getLinkReports(LinkReport* reports, size_t maxReports);
+
+	/**
+	 * @brief Get the load reports of the gateways of the routing table, with this node first if it is a gateway.
+	 * The neighbours learn the load of the gateways through the nodes that are their next hop.
+	 *
+	 * @param reports Array where the reports are written
+	 * @param maxReports Size of the array
+	 * @param localLoad Load of this node
+	 * @return size_t Number of reports
+	 */
+	static size_t getLoadReports(LoadReport* reports, size_t maxReports, uint8_t localLoad);
+
+	/**
+	 * @brief Update the load of the gateways reported by a neighbour, only the routes whose next hop is the neighbour
+	 *
+	 * @param via Address of the neighbour
+	 * @param reports Load reports
+	 * @param numOfReports Number of reports
+	 */
+	static void updateLoads(uint16_t via, const LoadReport* reports, size_t numOfReports);
+
+	/**
+	 * @brief Set if a neighbour receives the compact headers, given by its HELLO packets
+	 *
+	 * @param address Address of the neighbour
+	 * @param compactHeader If the neighbour receives them
+	 */
+	static void setCompactHeader(uint16_t address, bool compactHeader);
+
+	/**
+	 * @brief The neighbour receives the compact headers
+	 *
+	 * @param address Address of the neighbour
+	 * @return true If its last HELLO packet advertised it
+	 * @return false If not or it is not inside the routing table
+	 */
+	static bool hasCompactHeader(uint16_t address);
+
+	/**
+	 * @brief The short addresses of the routing table and this node are unique, the compact headers can be received and sent
+	 *
+	 */
+	static bool hasUniqueShortAddresses();
+
+	/**
+	 * @brief The short address of a node identifies it inside the routing table
+	 *
+	 * @param address Address of this node or of a node of the routing table
+	 * @return true If no other node has its short address
+	 * @return false If it is shared or the node is not inside the routing table
+	 */
+	static bool hasShortAddress(uint16_t address);
+
+	/**
+	 * @brief Get the address of a short address of a compact header
+	 *
+	 * @param shortAddress Short address
+	 * @param address Address of this node or of the only node of the routing table with the short address
+	 * @return true If a single node has the short address
+	 * @return false If none or several
+	 */
+	static bool resolveShortAddress(uint8_t shortAddress, uint16_t& address);
+
+	/**
+	 * @brief Increment a link counter of the neighbour that is the next hop to an address
+	 *
+	 * @param address Address of the neighbour or of a destination reached through it
+	 * @param counter Counter to increment
+	 * @param count Value added to the counter
+	 */
+	static void incLinkCounter(uint16_t address, uint32_t LinkCounters::* counter, uint32_t count = 1);
+
+	/**
+	 * @brief Count a received packet in the link counters if its source is a neighbour
+	 *
+	 * @param src Source of the packet
+	 */
+	static void countReceivedPacket(uint16_t src);
+
+	/**
+	 * @brief Get the link counters of the neighbours
+	 *
+	 * @param stats Array where the counters are written
+	 * @param maxNeighbours Size of the array
+	 * @param reset If true the counters returned are reset to 0
+	 * @return size_t Number of neighbours written
+	 */
+	static size_t getNeighbourStats(NeighbourStats* stats, size_t maxNeighbours, bool reset = false);
+
+	/**
+	 * @brief Remove all the routing entries whose timeout has been reached.
 	 *
 	 */
 	static void manageTimeoutRoutingTable();
 
+	/**
+	 * @brief Get the routing entry with the earliest timeout if it has been reached. It is removed from the timeouts,
+	 * the node must be removed afterwards with removeNodeIfExpired. The expired routes with a valid alternate
+	 * next hop fail over to it and are not returned.
+	 *
+	 * @param address Address of the expired node
+	 * @return true If a node has expired
+	 * @return false If there are no routes expired
+	 */
+	static bool popExpiredNode(uint16_t& address);
+
+	/**
+	 * @brief Remove the routing entry if its timeout has been reached. The routes through it fail over to their alternates.
+	 *
+	 * @param address Address of the node
+	 */
+	static void removeNodeIfExpired(uint16_t address);
+
+	/**
+	 * @brief Get the milliseconds until the next route timeout
+	 *
+	 * @param maxWait Value returned if there are no routes or the timeout is after it
+	 * @return unsigned long Milliseconds
+	 */
+	static unsigned long getTimeUntilNextTimeout(unsigned long maxWait);
+
 	/**
 	 * @brief Notify that a message has been received by the address
 	 * @param address Address that has received a message
 	 */
 	static void aMessageHasBeenReceivedBy(uint16_t address);
 
+	/**
+	 * @brief Add a route restored from the flash. It is used until its timeout but it is not advertised nor refreshed
+	 * by the delta HELLO packets until its next hop advertises it.
+	 *
+	 * @param node Route node with the address, metric, role, via, SNR and RTT
+	 * @param timeout Timeout of the route
+	 * @return true If it has been added
+	 * @return false If it is the local address, it is already inside the routing table or the routing table is full
+	 */
+	static bool restoreRoute(const RouteNode& node, uint32_t timeout);
+
+	/**
+	 * @brief Delete the current node of the routingTableList, removing it from the index and freeing it.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 */
+	static void deleteCurrentNode();
+
 private:
+	/**
+	 * @brief Neighbour where the next link reports start
+	 *
+	 */
+	static size_t linkReportsStart;
 
 	/**
-	 * @brief process the network node, adds the node in the routing table if can
+	 * @brief Index of the nodes of the routing table with a role. It is protected by the routingTableList semaphore.
 	 *
-	 * @param via via address
-	 * @param node NetworkNode
 	 */
-	static void processRoute(uint16_t via, NetworkNode* node);
+	static RouteNode* roleIndex[LM_ROLE_INDEX_SIZE];
+
+	/**
+	 * @brief Number of nodes inside the role index
+	 *
+	 */
+	static size_t roleIndexSize;
+
+	/**
+	 * @brief Nodes with a role that did not fit inside the role index, the routing table is scanned while there are any
+	 *
+	 */
+	static size_t unindexedRoles;
+
+	/**
+	 * @brief Add the node to the role index if it has a role.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @param node Route node
+	 */
+	static void indexRole(RouteNode* node);
+
+	/**
+	 * @brief Remove the node from the role index if it has a role.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @param node Route node
+	 */
+	static void unindexRole(RouteNode* node);
+
+	/**
+	 * @brief Number of nodes of the routing table with every short address. It is protected by the routingTableList semaphore.
+	 *
+	 */
+	static uint16_t shortAddressCount[256];
+
+	/**
+	 * @brief XOR of the addresses of the nodes with every short address, the address of the only one if its count is 1
+	 *
+	 */
+	static uint16_t shortAddressOwner[256];
+
+	/**
+	 * @brief Number of short addresses shared by several nodes of the routing table
+	 *
+	 */
+	static size_t sharedShortAddresses;
+
+	/**
+	 * @brief Routes decoded from the compact HELLO packets. Only the process task receives the routes
+	 *
+	 */
+	static NetworkNode decodedNodes[RTMAXSIZE];
+
+	/**
+	 * @brief Add the node to the count of its short address.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @param node Route node
+	 */
+	static void indexShortAddress(RouteNode* node);
 
 	/**
-	 * @brief process the network node, adds the node in the routing table if can
+	 * @brief Remove the node from the count of its short address
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @param node Route node
+	 */
+	static void unindexShortAddress(RouteNode* node);
+
+	/**
+	 * @brief Call the visitor with every node that contains a role, from the role index. The routing table is scanned
+	 * if some nodes did not fit inside the index or for ROLE_DEFAULT, that all the nodes contain.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @tparam Visitor Callable with a RouteNode*
+	 * @param role Role
+	 * @param visitor Visitor
+	 */
+	template <typename Visitor>
+	static void forEachNodeWithRole(uint8_t role, Visitor visitor) {
+		if (role != ROLE_DEFAULT && unindexedRoles == 0) {
+			for (size_t i = 0; i < roleIndexSize; i++) {
+				if ((roleIndex[i]->networkNode.role & role) == role)
+					visitor(roleIndex[i]);
+			}
+			return;
+		}
+
+		if (routingTableList->moveToStart()) {
+			do {
+				RouteNode* node = routingTableList->getCurrent();
+				if ((node->networkNode.role & role) == role)
+					visitor(node);
+			} while (routingTableList->next());
+		}
+	}
+
+	/**
+	 * @brief process the network node, adds the node in the routing table if can.
+	 * The routingTableList must be in use before calling this function.
 	 *
-	 * @param rNode route node
 	 * @param via via address
-	 * @param node NetworkNode
+	 * @param node NetworkNode, with the metric through via
+	 * @param advertisedMetric Metric advertised by via, used to accept it as an alternate next hop
+	 * @param maximumMetric Maximum metric accepted for new routes, updated when a route is added
+	 * @return true If the routing table has changed
+	 * @return false If the routing table is the same
 	 */
-	static void processRoute(RouteNode* rNode, uint16_t via, NetworkNode* node);
+	static bool processRoute(uint16_t via, NetworkNode* node, uint8_t advertisedMetric, uint8_t& maximumMetric);
 
 	/**
 	 * @brief Reset the timeout of the given node
@@ -158,26 +516,98 @@ private:
 	static void resetTimeoutRoutingNode(RouteNode* node);
 
 	/**
-	 * @brief Add node to the routing table
+	 * @brief Reset the timeout of the routes whose next hop is via.
+	 * A delta HELLO packet does not include them, they have not changed.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @param via Address of the next hop
+	 */
+	static void resetTimeoutRoutesVia(uint16_t via);
+
+	/**
+	 * @brief Returns if the alternate route is not empty and has not expired
+	 *
+	 * @param alternate Alternate route
+	 * @return true If it is valid
+	 * @return false If not
+	 */
+	static bool isAlternateValid(AlternateRoute& alternate);
+
+	/**
+	 * @brief Add or update the alternate next hop of the route. If all the entries are valid it replaces the one with the
+	 * highest metric, only when it is higher than the new one.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @param node Route node
+	 * @param via Alternate next hop
+	 * @param metric Metric through the next hop
+	 * @param timeout Timeout of the alternate route
+	 */
+	static void addAlternate(RouteNode* node, uint16_t via, uint8_t metric, uint32_t timeout);
+
+	/**
+	 * @brief Remove the alternate next hop of the route
+	 *
+	 * @param node Route node
+	 * @param via Alternate next hop
+	 */
+	static void removeAlternate(RouteNode* node, uint16_t via);
+
+	/**
+	 * @brief Get the valid alternate with the lowest metric whose next hop is still inside the routing table.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @param node Route node
+	 * @return AlternateRoute* Best alternate or nullptr
+	 */
+	static AlternateRoute* getBestAlternate(RouteNode* node);
+
+	/**
+	 * @brief Swap the route with its best alternate, the actual next hop is kept as an alternate.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @param node Route node
+	 * @return true If the route has failed over
+	 * @return false If there are no valid alternates
+	 */
+	static bool failover(RouteNode* node);
+
+	/**
+	 * @brief Fail over the routes whose next hop is via, and remove via from the alternates.
+	 * The routingTableList must be in use before calling this function.
+	 *
+	 * @param via Address of the next hop removed
+	 */
+	static void failoverRoutesVia(uint16_t via);
+
+	/**
+	 * @brief Add node to the routing table.
+	 * The routingTableList must be in use before calling this function.
 	 *
 	 * @param node Network node that includes the address and the metric
 	 * @param via Address to next hop to reach the network node address
+	 * @param maximumMetric Maximum metric accepted for new routes, updated when the route is added
+	 * @return true If the node has been added
+	 * @return false If the node has not been added
 	 */
-
-	 /**
-	  * @brief Add node to the routing table
-	  *
-	  * @param node Network node that includes the address and the metric
-	  * @param via Address to next hop to reach the network node address
-	  */
-	static void addNodeToRoutingTable(NetworkNode* node, uint16_t via);
+	static bool addNodeToRoutingTable(NetworkNode* node, uint16_t via, uint8_t& maximumMetric);
 
 	/**
-	 * @brief Get the Maximum Metric Of Routing Table. To prevent that some new entries are not added to the routing table.
+	 * @brief Get the Maximum Metric Of Routing Table plus the maximum link cost. To prevent that some new entries are not added to the routing table.
+	 * The routingTableList must be in use before calling this function.
 	 *
 	 * @return uint8_t Returns the maximum metric of the routing table
 	 */
 	static uint8_t calculateMaximumMetricOfRoutingTable();
+
+	/**
+	 * @brief Add the cost to the metric, saturating at UINT8_MAX
+	 *
+	 * @param metric Metric
+	 * @param cost Cost to be added
+	 * @return uint8_t Metric with the cost
+	 */
+	static uint8_t addMetric(uint8_t metric, uint8_t cost);
 };
 
 #endif
\ No newline at end of file
@@ -1,48 +1,52 @@
 #include "SimulatorService.h"
 
-SimulatorService::SimulatorService() {
+SimulatorService::SimulatorService(size_t capacity_) {
+    states = new LM_State[capacity_];
+    capacity = states == nullptr ? 0 : capacity_;
 
+    if (capacity == 0)
+        ESP_LOGE(LM_TAG, "Not enough memory to allocate the simulator states");
 }
 
 SimulatorService::~SimulatorService() {
-    clearStates();
-    delete statesList;
+    delete[] states;
 }
 
-void SimulatorService::addState(size_t receivedQueueSize, size_t sentQueueSize, size_t receivedUserQueueSize, size_t routingTableSize, size_t q_WRPSize, size_t q_WSPSize, LM_StateType type, Packet<uint8_t>* packet) {
-    if (!isSimulating) {
-        return;
-    }
-    uint32_t freeHeap = getFreeHeap();
+static uint16_t clampSize(size_t size) {
+    return size > UINT16_MAX ? UINT16_MAX : size;
+}
 
-    if (freeHeap < 10000) {
-        ESP_LOGW(LM_TAG, "Not enough memory to simulate. Free heap: %d", (int)freeHeap);
+void SimulatorService::addState(size_t receivedQueueSize, size_t sentQueueSize, size_t receivedUserQueueSize, size_t routingTableSize, size_t q_WRPSize, size_t q_WSPSize, LM_StateType type, Packet<uint8_t>* packet, const PacketView* view) {
+    if (!isSimulating || capacity == 0) {
         return;
     }
 
-    LM_State* state = new LM_State();
-    state->id = numberStates++;
-    state->receivedQueueSize = receivedQueueSize;
-    state->sentQueueSize = sentQueueSize;
-    state->receivedUserQueueSize = receivedUserQueueSize;
-    state->routingTableSize = routingTableSize;
-    state->q_WRPSize = q_WRPSize;
-    state->q_WSPSize = q_WSPSize;
-    state->type = type;
-    state->secondsSinceStart = millis() / 1000;
-    state->freeMemoryAllocation = freeHeap;
-
-    if (packet == nullptr) {
-        state->packetHeader = ControlPacket();
-        statesList->Append(state);
-        return;
+    LM_State state;
+    state.timestamp = millis();
+    state.type = type;
+    state.receivedQueueSize = clampSize(receivedQueueSize);
+    state.sentQueueSize = clampSize(sentQueueSize);
+    state.receivedUserQueueSize = clampSize(receivedUserQueueSize);
+    state.routingTableSize = clampSize(routingTableSize);
+    state.q_WRPSize = clampSize(q_WRPSize);
+    state.q_WSPSize = clampSize(q_WSPSize);
+    state.freeMemoryAllocation = getFreeHeap();
+
+    //The header is copied with the view of the packet, without allocating a copy
+    if (packet != nullptr && view != nullptr)
+        PacketService::copyPacketHeader(packet, *view, state.packetHeader);
+
+    portENTER_CRITICAL(&statesMux);
+
+    if (head - tail == capacity) {
+        tail++;
+        overwrittenStates++;
     }
 
-    ControlPacket* ctrlPacket = PacketService::getPacketHeader(packet);
-    memcpy(&state->packetHeader, ctrlPacket, sizeof(ControlPacket));
-    delete ctrlPacket;
+    state.id = head;
+    states[head++ % capacity] = state;
 
-    statesList->Append(state);
+    portEXIT_CRITICAL(&statesMux);
 }
 
 void SimulatorService::startSimulation() {
@@ -54,5 +58,84 @@ void SimulatorService::stopSimulation() {
 }
 
 void SimulatorService::clearStates() {
-    statesList->Clear();
+    portENTER_CRITICAL(&statesMux);
+    tail = head;
+    portEXIT_CRITICAL(&statesMux);
+}
+
+size_t SimulatorService::getNumberOfStates() {
+    portENTER_CRITICAL(&statesMux);
+    size_t numberOfStates = head - tail;
+    portEXIT_CRITICAL(&statesMux);
+
+    return numberOfStates;
+}
+
+bool SimulatorService::popState(LM_State& state) {
+    uint32_t id;
+    if (!peekState(state, id))
+        return false;
+
+    removeState(id);
+    return true;
+}
+
+size_t SimulatorService::exportStates(LM_StateWriter writer, void* context, size_t maxStates) {
+    LM_StateExportHeader header;
+    header.address = WiFiService::getLocalAddress();
+
+    size_t numberOfStates = getNumberOfStates();
+    if (numberOfStates > maxStates)
+        numberOfStates = maxStates;
+    if (numberOfStates > UINT16_MAX)
+        numberOfStates = UINT16_MAX;
+
+    header.numberOfStates = numberOfStates;
+    header.overwrittenStates = overwrittenStates;
+
+    if (writer(reinterpret_cast<const uint8_t*>(&header), sizeof(header), context) != sizeof(header))
+        return 0;
+
+    // The records are removed after being written, a failed write keeps them for the next export.
+    // The ring only shrinks with the exports, unless it is cleared meanwhile there are enough records.
+    size_t exported = 0;
+    LM_State state;
+    uint32_t id;
+
+    while (exported < numberOfStates && peekState(state, id)) {
+        if (writer(reinterpret_cast<const uint8_t*>(&state), sizeof(state), context) != sizeof(state))
+            break;
+
+        removeState(id);
+        exported++;
+    }
+
+    if (exported < numberOfStates)
+        ESP_LOGW(LM_TAG, "Simulator states export stopped after %d of %d records", (int) exported, (int) numberOfStates);
+
+    return exported;
+}
+
+bool SimulatorService::peekState(LM_State& state, uint32_t& id) {
+    portENTER_CRITICAL(&statesMux);
+
+    bool found = head != tail;
+    if (found) {
+        id = tail;
+        state = states[tail % capacity];
+    }
+
+    portEXIT_CRITICAL(&statesMux);
+
+    return found;
+}
+
+void SimulatorService::removeState(uint32_t id) {
+    portENTER_CRITICAL(&statesMux);
+
+    // The record could have been overwritten meanwhile
+    if (tail == id)
+        tail++;
+
+    portEXIT_CRITICAL(&statesMux);
 }
@@ -4,28 +4,110 @@
 #include "entities/packets/ControlPacket.h"
 #include "entities/packets/Packet.h"
 #include "services/PacketService.h"
-#include "utilities/LinkedQueue.hpp"
+#include "services/WiFiService.h"
 
 #include "BuildOptions.h"
 
+/**
+ * @brief Function that writes the exported states, e.g. to the Serial, a socket or a file
+ *
+ * @param data Bytes to write
+ * @param length Number of bytes
+ * @param context Context given to the export
+ * @return size_t Number of bytes written, the export stops if they are not all of them
+ */
+typedef size_t (*LM_StateWriter)(const uint8_t* data, size_t length, void* context);
+
+/**
+ * @brief Records the state of the node on every packet received and sent and on the managers. The records are stored
+ * in a ring allocated when the service is created, adding a state does not allocate. When the ring is full the oldest
+ * records are overwritten.
+ *
+ * The records are exported in a binary stream read by utilities/analyzeMonitor.py: every export writes a
+ * LM_StateExportHeader followed by numberOfStates LM_State records, packed and little endian.
+ *
+ */
 class SimulatorService {
 public:
-    SimulatorService();
+    /**
+     * @brief Construct a new Simulator Service object
+     *
+     * @param capacity Number of records of the ring
+     */
+    SimulatorService(size_t capacity = LM_SIMULATOR_STATES);
     ~SimulatorService();
 
     void addState(size_t receivedQueueSize, size_t sentQueueSize, size_t receivedUserQueueSize,
-        size_t routingTableSize, size_t q_WRPSize, size_t q_WSPSize, LM_StateType type, Packet<uint8_t>* packet);
+        size_t routingTableSize, size_t q_WRPSize, size_t q_WSPSize, LM_StateType type, Packet<uint8_t>* packet,
+        const PacketView* view);
 
     void startSimulation();
 
     void stopSimulation();
 
+    /**
+     * @brief Remove all the records of the ring
+     *
+     */
     void clearStates();
 
-    LM_LinkedList<LM_State>* statesList = new LM_LinkedList<LM_State>();
+    /**
+     * @brief Get the number of records inside the ring
+     *
+     */
+    size_t getNumberOfStates();
+
+    /**
+     * @brief Get the number of records overwritten before being read or exported
+     *
+     */
+    uint32_t getOverwrittenStates() { return overwrittenStates; }
+
+    /**
+     * @brief Remove the oldest record of the ring
+     *
+     * @param state Copy of the record
+     * @return true If there was a record
+     */
+    bool popState(LM_State& state);
+
+    /**
+     * @brief Export the records of the ring, they are removed when written
+     *
+     * @param writer Function that writes the bytes
+     * @param context Context given to the writer
+     * @param maxStates Maximum number of records to export
+     * @return size_t Number of records exported
+     */
+    size_t exportStates(LM_StateWriter writer, void* context = nullptr, size_t maxStates = SIZE_MAX);
 
 private:
     bool isSimulating = false;
 
-    size_t numberStates = 0;
-};
\ No newline at end of file
+    LM_State* states = nullptr;
+    size_t capacity = 0;
+
+    // Number of the next record and of the oldest record inside the ring
+    uint32_t head = 0;
+    uint32_t tail = 0;
+
+    uint32_t overwrittenStates = 0;
+
+    portMUX_TYPE statesMux = portMUX_INITIALIZER_UNLOCKED;
+
+    /**
+     * @brief Copy the oldest record without removing it
+     *
+     * @param state Copy of the record
+     * @param id Number of the record
+     * @return true If there was a record
+     */
+    bool peekState(LM_State& state, uint32_t& id);
+
+    /**
+     * @brief Remove the record if it is still the oldest one
+     *
+     * @param id Number of the record
+     */
+    void removeState(uint32_t id);
+};
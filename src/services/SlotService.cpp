@@ -0,0 +1,188 @@
+#include "SlotService.h"
+
+#include "WiFiService.h"
+#include "RoleService.h"
+#include "RoutingTableService.h"
+
+void SlotService::configure(bool enabled_) {
+    portENTER_CRITICAL(&slotMux);
+
+    enabled = enabled_;
+    reference = 0;
+    numOfSlots = 0;
+    slot = 0;
+
+    portEXIT_CRITICAL(&slotMux);
+
+    if (enabled_)
+        ESP_LOGI(LM_TAG, "Slotted access, the gateways send the beacons");
+}
+
+bool SlotService::isFollowing() {
+    return reference != 0 && reference != WiFiService::getLocalAddress() &&
+        millis() - lastBeacon < LM_SLOT_SYNC_TIMEOUT * 1000UL;
+}
+
+bool SlotService::isSynchronized() {
+    if (!enabled)
+        return false;
+
+    portENTER_CRITICAL(&slotMux);
+    bool synchronized = isFollowing() || (reference != 0 && reference == WiFiService::getLocalAddress());
+    portEXIT_CRITICAL(&slotMux);
+
+    return synchronized;
+}
+
+bool SlotService::isReference() {
+    if (!enabled || !RoleService::isGateway())
+        return false;
+
+    portENTER_CRITICAL(&slotMux);
+    bool following = isFollowing();
+    portEXIT_CRITICAL(&slotMux);
+
+    return !following;
+}
+
+size_t SlotService::getBeaconSlots(uint16_t slotLength_, uint16_t* owners, size_t maxSlots) {
+    uint16_t localAddress = WiFiService::getLocalAddress();
+
+    //The offset inside the frame is sent in 16 bits
+    size_t frameSlots = slotLength_ > 0 ? UINT16_MAX / slotLength_ : 0;
+    if (frameSlots < 2 || maxSlots == 0)
+        return 0;
+
+    if (maxSlots > frameSlots - 1)
+        maxSlots = frameSlots - 1;
+
+    owners[0] = localAddress;
+    size_t numOfOwners = 1;
+
+    //The neighbours with the lowest addresses, in order. The slot of a node only moves when a lower address joins
+    RoutingTableService::forEachNode([&](const RouteNode* node) {
+        uint16_t address = node->networkNode.address;
+        if (node->via != address)
+            return;
+
+        size_t i = numOfOwners;
+        if (numOfOwners == maxSlots) {
+            if (maxSlots == 1 || address >= owners[numOfOwners - 1])
+                return;
+            i--;
+        }
+        else
+            numOfOwners++;
+
+        for (; i > 1 && owners[i - 1] > address; i--)
+            owners[i] = owners[i - 1];
+
+        owners[i] = address;
+    });
+
+    portENTER_CRITICAL(&slotMux);
+
+    //The frame continues from the one followed before, if any
+    if (reference == 0)
+        frameStart = millis();
+
+    reference = localAddress;
+    slotLength = slotLength_;
+    numOfSlots = numOfOwners;
+    slot = 0;
+
+    portEXIT_CRITICAL(&slotMux);
+
+    return numOfOwners;
+}
+
+uint16_t SlotService::getFrameOffset() {
+    portENTER_CRITICAL(&slotMux);
+    uint32_t frameLength = (numOfSlots + 1) * slotLength;
+    uint16_t offset = frameLength > 0 ? (millis() - frameStart) % frameLength : 0;
+    portEXIT_CRITICAL(&slotMux);
+
+    return offset;
+}
+
+void SlotService::processBeacon(uint16_t src, unsigned long txStart, uint16_t offset, uint16_t slotLength_, const uint16_t* owners,
+    size_t numOfSlots_) {
+    uint16_t localAddress = WiFiService::getLocalAddress();
+    if (!enabled || slotLength_ == 0 || src == localAddress)
+        return;
+
+    //A gateway with a lower address is the reference of the other one
+    if (RoleService::isGateway() && localAddress < src)
+        return;
+
+    uint16_t ownSlot = numOfSlots_;
+    for (size_t i = 0; i < numOfSlots_; i++) {
+        if (owners[i] == localAddress) {
+            ownSlot = i;
+            break;
+        }
+    }
+
+    portENTER_CRITICAL(&slotMux);
+
+    bool adopt = !isFollowing() || src <= reference;
+    bool changed = adopt && reference != src;
+    if (adopt) {
+        reference = src;
+        lastBeacon = millis();
+        frameStart = txStart - offset;
+        slotLength = slotLength_;
+        numOfSlots = numOfSlots_;
+        slot = ownSlot;
+    }
+
+    portEXIT_CRITICAL(&slotMux);
+
+    if (changed)
+        ESP_LOGI(LM_TAG, "Following the slots of %X, slot %d of %d", src, ownSlot, numOfSlots_ + 1);
+}
+
+uint32_t SlotService::getWaitTime(uint32_t airtime) {
+    portENTER_CRITICAL(&slotMux);
+    uint32_t length = slotLength;
+    uint32_t frameLength = (numOfSlots + 1) * length;
+    uint32_t position = frameLength > 0 ? (millis() - frameStart) % frameLength : 0;
+    bool contention = slot == numOfSlots;
+    uint32_t slotStart = slot * length;
+    portEXIT_CRITICAL(&slotMux);
+
+    if (frameLength == 0)
+        return 0;
+
+    //A packet longer than the slot is sent at its start
+    uint32_t windowStart = slotStart + LM_SLOT_GUARD_TIME / 2;
+    uint32_t windowEnd = slotStart + length > windowStart + airtime + LM_SLOT_GUARD_TIME / 2 ?
+        slotStart + length - airtime - LM_SLOT_GUARD_TIME / 2 : windowStart;
+
+    if (position >= windowStart && position <= windowEnd)
+        return contention ? random(0, windowEnd - position + 1) : 0;
+
+    uint32_t wait = position < windowStart ? windowStart - position : frameLength - position + windowStart;
+
+    //The nodes without a slot do not start at the same time
+    if (contention)
+        wait += random(0, windowEnd - windowStart + 1);
+
+    return wait;
+}
+
+bool SlotService::enabled = false;
+
+uint16_t SlotService::reference = 0;
+
+unsigned long SlotService::lastBeacon = 0;
+
+unsigned long SlotService::frameStart = 0;
+
+uint16_t SlotService::slotLength = 0;
+
+uint16_t SlotService::numOfSlots = 0;
+
+uint16_t SlotService::slot = 0;
+
+portMUX_TYPE SlotService::slotMux = portMUX_INITIALIZER_UNLOCKED;
@@ -0,0 +1,123 @@
+#ifndef _LORAMESHER_SLOT_SERVICE_H
+#define _LORAMESHER_SLOT_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Slots of the slotted access. The gateway with the lowest address in range is the time reference, its
+ * HELLO packets carry a beacon with the offset inside the frame at which they are sent, the length of the slots and
+ * the owner of each slot: the gateway first and then its neighbours by address. The frame ends with a contention slot
+ * used by the nodes without a slot. The nodes that receive the beacon send in the control channel only inside their
+ * slot, the nodes without beacon during LM_SLOT_SYNC_TIMEOUT seconds keep the random access.
+ *
+ */
+class SlotService {
+public:
+    /**
+     * @brief Configure the slotted access
+     *
+     * @param enabled If false the nodes do not send nor follow the beacons
+     */
+    static void configure(bool enabled);
+
+    /**
+     * @brief Get if the slotted access is enabled
+     *
+     */
+    static bool isEnabled() { return enabled; }
+
+    /**
+     * @brief Get if the node follows a frame, its own one or the one of a beacon received less than LM_SLOT_SYNC_TIMEOUT seconds ago
+     *
+     */
+    static bool isSynchronized();
+
+    /**
+     * @brief Get if the node is the time reference, a gateway that does not follow the beacon of a gateway with a lower address
+     *
+     */
+    static bool isReference();
+
+    /**
+     * @brief Get the owners of the slots of the beacon of this node and start its frame the first time
+     *
+     * @param slotLength Length of a slot in ms
+     * @param owners Array where the owners are written
+     * @param maxSlots Size of the array
+     * @return size_t Number of owners written, this node is the first one
+     */
+    static size_t getBeaconSlots(uint16_t slotLength, uint16_t* owners, size_t maxSlots);
+
+    /**
+     * @brief Get the ms since the start of the current frame
+     *
+     */
+    static uint16_t getFrameOffset();
+
+    /**
+     * @brief Follow the frame of a beacon, if it comes from the time reference or from a gateway with a lower address
+     *
+     * @param src Address of the gateway that sent the beacon
+     * @param txStart millis() of this node at which the beacon started to be sent
+     * @param offset Offset inside the frame at which it was sent in ms
+     * @param slotLength Length of a slot in ms
+     * @param owners Owners of the slots
+     * @param numOfSlots Number of owners
+     */
+    static void processBeacon(uint16_t src, unsigned long txStart, uint16_t offset, uint16_t slotLength, const uint16_t* owners,
+        size_t numOfSlots);
+
+    /**
+     * @brief Get the ms to wait until a packet can be sent inside the slot of this node. The guard time is split
+     * at both ends of the slot. Inside the contention slot the packet is sent at a random time.
+     *
+     * @param airtime Time on air of the packet in ms
+     * @return uint32_t Time to wait in ms, 0 if it can be sent now
+     */
+    static uint32_t getWaitTime(uint32_t airtime);
+
+private:
+    /**
+     * @brief Get if the node follows the beacon of another node
+     *
+     */
+    static bool isFollowing();
+
+    static bool enabled;
+
+    /**
+     * @brief Address of the time reference, 0 if there is none
+     *
+     */
+    static uint16_t reference;
+
+    /**
+     * @brief millis() of the last beacon received
+     *
+     */
+    static unsigned long lastBeacon;
+
+    /**
+     * @brief millis() at which the first frame of the reference started, in the time of this node
+     *
+     */
+    static unsigned long frameStart;
+
+    static uint16_t slotLength;
+
+    /**
+     * @brief Number of slots with an owner, the frame has one more for the contention
+     *
+     */
+    static uint16_t numOfSlots;
+
+    /**
+     * @brief Slot of this node, numOfSlots if it is the contention slot
+     *
+     */
+    static uint16_t slot;
+
+    static portMUX_TYPE slotMux;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "TraceService.h"
+
+#include "RoutingTableService.h"
+
+void TraceService::record(TraceEvent event, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    TraceRecord traceRecord = {(uint32_t) millis(), event, {arg0, arg1, arg2, arg3}};
+
+    if (!ring.push(traceRecord))
+        droppedRecords.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool TraceService::pop(TraceRecord& traceRecord) {
+    return ring.pop(traceRecord);
+}
+
+size_t TraceService::drain(size_t maxRecords) {
+    uint32_t dropped = getDroppedRecords();
+    if (dropped != reportedDropped) {
+        ESP_LOGW(LM_TAG, "%u trace records dropped, the trace ring is full", (unsigned) (dropped - reportedDropped));
+        reportedDropped = dropped;
+    }
+
+    size_t numberOfRecords = 0;
+    TraceRecord traceRecord;
+
+    while (numberOfRecords < maxRecords && ring.pop(traceRecord)) {
+        print(traceRecord);
+        numberOfRecords++;
+    }
+
+    return numberOfRecords;
+}
+
+void TraceService::print(const TraceRecord& traceRecord) {
+    const uint32_t* args = traceRecord.args;
+    unsigned timestamp = traceRecord.timestamp;
+
+    switch (traceRecord.event) {
+        case TraceEvent::PACKET_RECEIVING:
+            ESP_LOGI(LM_TAG, "[%u] Receiving LoRa packet: Size: %d bytes RSSI: %d SNR: %d",
+                timestamp, (int) args[0], (int) (int32_t) args[1], (int) (int32_t) args[2]);
+            break;
+        case TraceEvent::PACKET_RECEIVED:
+        case TraceEvent::PACKET_SENT:
+            ESP_LOGI(LM_TAG, "[%u] Packet %s -- Size: %d Src: %X Dst: %X Id: %d Type: %d Via: %X Seq_Id: %d Num: %d",
+                timestamp,
+                traceRecord.event == TraceEvent::PACKET_SENT ? "send" : "received",
+                (int) (args[0] & 0xFF),
+                (unsigned) (args[1] & 0xFFFF),
+                (unsigned) (args[1] >> 16),
+                (int) ((args[0] >> 8) & 0xFF),
+                (int) ((args[0] >> 16) & 0xFF),
+                (unsigned) (args[2] & 0xFFFF),
+                (int) (args[2] >> 16),
+                (int) args[3]);
+            break;
+        case TraceEvent::SEND_QUEUE_SIZE:
+            ESP_LOGI(LM_TAG, "[%u] Size of Send Packets Queue: %d", timestamp, (int) args[0]);
+            break;
+        case TraceEvent::AIRTIME_WAIT:
+            ESP_LOGI(LM_TAG, "[%u] Airtime budget exhausted, waiting %d ms", timestamp, (int) args[0]);
+            break;
+        case TraceEvent::PACKETS_AGGREGATED:
+            ESP_LOGI(LM_TAG, "[%u] Aggregated %d data packets via %X, %d bytes", timestamp,
+                (int) args[0], (unsigned) args[1], (int) args[2]);
+            break;
+        case TraceEvent::DATA_PACKET:
+            ESP_LOGI(LM_TAG, "[%u] Data packet from %X, destination %X, via %X", timestamp,
+                (unsigned) args[0], (unsigned) args[1], (unsigned) args[2]);
+            break;
+        case TraceEvent::SEND_QUEUE_ADDED:
+            ESP_LOGI(LM_TAG, "[%u] Added packet to Q_SP, notifying sender task", timestamp);
+            break;
+        case TraceEvent::PACKET_CREATED:
+            ESP_LOGI(LM_TAG, "[%u] Packet created with %u bytes", timestamp, (unsigned) args[0]);
+            break;
+        case TraceEvent::ROUTING_TABLE_CHANGED:
+            ESP_LOGI(LM_TAG, "[%u] Routing table changed, %d routes", timestamp, (int) args[0]);
+            RoutingTableService::printRoutingTable();
+            break;
+        default:
+            ESP_LOGW(LM_TAG, "[%u] Unknown trace event %d", timestamp, (int) traceRecord.event);
+            break;
+    }
+}
+
+LM_MPSCRing<TraceRecord, LM_TRACE_RECORDS> TraceService::ring;
+
+std::atomic<uint32_t> TraceService::droppedRecords(0);
+
+uint32_t TraceService::reportedDropped = 0;
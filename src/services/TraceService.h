@@ -0,0 +1,103 @@
+#ifndef _LORAMESHER_TRACE_SERVICE_H
+#define _LORAMESHER_TRACE_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "utilities/MPSCRing.hpp"
+
+/**
+ * @brief Events of the trace, the arguments of every event are described next to it
+ *
+ */
+enum class TraceEvent : uint8_t {
+    PACKET_RECEIVING = 0,   // Size, RSSI, SNR
+    PACKET_RECEIVED,        // Header of a received packet: size | id << 8 | type << 16, src | dst << 16, via | seq_id << 16, number
+    PACKET_SENT,            // Header of a sent packet, the same arguments as PACKET_RECEIVED
+    SEND_QUEUE_SIZE,        // Packets inside the send queue
+    AIRTIME_WAIT,           // Milliseconds waiting for the airtime budget
+    PACKETS_AGGREGATED,     // Data packets, next hop, bytes
+    DATA_PACKET,            // Source, destination, via
+    SEND_QUEUE_ADDED,       // No arguments
+    PACKET_CREATED,         // Bytes
+    ROUTING_TABLE_CHANGED,  // Routing table size, the routing table is printed when the record is drained
+    NUM_EVENTS
+};
+
+/**
+ * @brief Trace record, 24 bytes in memory order
+ *
+ */
+struct TraceRecord {
+    uint32_t timestamp;     // millis() when the event was recorded
+    TraceEvent event;
+    uint32_t args[4];
+};
+
+static_assert(sizeof(TraceRecord) == 24, "The trace records are exported as they are in memory");
+
+// The trace calls of the levels above LM_TRACE_LEVEL are removed at compile time, the arguments are not evaluated
+#if LM_TRACE_LEVEL >= 3
+#define LM_TRACE_I(event, ...) TraceService::record(event, ##__VA_ARGS__)
+#else
+#define LM_TRACE_I(event, ...) ((void) 0)
+#endif
+
+#if LM_TRACE_LEVEL >= 4
+#define LM_TRACE_D(event, ...) TraceService::record(event, ##__VA_ARGS__)
+#else
+#define LM_TRACE_D(event, ...) ((void) 0)
+#endif
+
+/**
+ * @brief Deferred trace of the receive and send paths. Recording an event only copies its id and arguments into a
+ * lock free ring, the strings are formatted and printed later by drain(), called from a low priority task. A host
+ * tool can take the binary records with pop() instead. When the ring is full the new records are dropped and counted.
+ *
+ */
+class TraceService {
+public:
+    /**
+     * @brief Record an event. It can be called from any task, it does not block nor allocate.
+     *
+     * @param event Event
+     */
+    static void record(TraceEvent event, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0, uint32_t arg3 = 0);
+
+    /**
+     * @brief Remove the oldest record. Only one task can take the records, with pop or drain.
+     *
+     * @param traceRecord Copy of the record
+     * @return true If there was a record
+     */
+    static bool pop(TraceRecord& traceRecord);
+
+    /**
+     * @brief Print the records with ESP_LOGI. Only one task can take the records, with pop or drain.
+     *
+     * @param maxRecords Maximum number of records printed
+     * @return size_t Number of records printed
+     */
+    static size_t drain(size_t maxRecords = SIZE_MAX);
+
+    /**
+     * @brief Get the number of records dropped because the ring was full
+     *
+     */
+    static uint32_t getDroppedRecords() { return droppedRecords.load(std::memory_order_relaxed); }
+
+private:
+    static LM_MPSCRing<TraceRecord, LM_TRACE_RECORDS> ring;
+
+    static std::atomic<uint32_t> droppedRecords;
+
+    // Dropped records already reported by drain
+    static uint32_t reportedDropped;
+
+    /**
+     * @brief Print a record
+     *
+     */
+    static void print(const TraceRecord& traceRecord);
+};
+
+#endif
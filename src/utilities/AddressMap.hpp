@@ -0,0 +1,155 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Fixed capacity hash map keyed by a 16 bits address.
+ * All the slots are preallocated when the map is created, adding, finding and removing elements never allocates memory.
+ * It uses open addressing with linear probing and backward shift deletion, so there are no tombstones
+ * and lookups stay O(1) while the map is at most half full.
+ *
+ * @tparam T Type of the elements, the map only stores pointers to them
+ * @tparam Capacity Maximum number of elements inside the map
+ */
+template <class T, size_t Capacity>
+class LM_AddressMap {
+public:
+    LM_AddressMap();
+    T* Find(uint16_t address) const;
+    bool Add(uint16_t address, T* element);
+    bool Remove(uint16_t address);
+    void Clear();
+    size_t getLength() const { return length; }
+    size_t getCapacity() const { return Capacity; }
+
+private:
+    static constexpr size_t bitsFor(size_t n) {
+        size_t bits = 1;
+        while (((size_t) 1 << bits) < n)
+            bits++;
+        return bits;
+    }
+
+    // Keep the load factor at 0.5 or below
+    static constexpr size_t hashBits = bitsFor(Capacity * 2);
+    static constexpr size_t numSlots = (size_t) 1 << hashBits;
+    static constexpr size_t mask = numSlots - 1;
+
+    struct Slot {
+        uint16_t address;
+        T* element;
+    };
+
+    Slot slots[numSlots];
+    size_t length;
+
+    /**
+     * @brief Fibonacci hashing, the addresses are derived from the MAC, so the low bits are not uniform
+     *
+     * @param address Address to be hashed
+     * @return size_t Home slot of the address
+     */
+    static size_t hash(uint16_t address) {
+        return (size_t) ((uint32_t) ((uint32_t) address * 2654435769U) >> (32 - hashBits));
+    }
+
+    /**
+     * @brief Find the slot of the address
+     *
+     * @param address Address to be found
+     * @return size_t Slot index or numSlots if not found
+     */
+    size_t findSlot(uint16_t address) const;
+};
+
+template <class T, size_t Capacity>
+LM_AddressMap<T, Capacity>::LM_AddressMap() {
+    Clear();
+}
+
+template <class T, size_t Capacity>
+size_t LM_AddressMap<T, Capacity>::findSlot(uint16_t address) const {
+    size_t i = hash(address);
+
+    while (slots[i].element != nullptr) {
+        if (slots[i].address == address)
+            return i;
+
+        i = (i + 1) & mask;
+    }
+
+    return numSlots;
+}
+
+template <class T, size_t Capacity>
+T* LM_AddressMap<T, Capacity>::Find(uint16_t address) const {
+    size_t i = findSlot(address);
+    return i == numSlots ? nullptr : slots[i].element;
+}
+
+template <class T, size_t Capacity>
+bool LM_AddressMap<T, Capacity>::Add(uint16_t address, T* element) {
+    if (element == nullptr)
+        return false;
+
+    size_t i = hash(address);
+
+    while (slots[i].element != nullptr) {
+        if (slots[i].address == address) {
+            slots[i].element = element;
+            return true;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    if (length >= Capacity) {
+        ESP_LOGW(LM_TAG, "Address map full, not adding %X", address);
+        return false;
+    }
+
+    slots[i].address = address;
+    slots[i].element = element;
+    length++;
+
+    return true;
+}
+
+template <class T, size_t Capacity>
+bool LM_AddressMap<T, Capacity>::Remove(uint16_t address) {
+    size_t i = findSlot(address);
+    if (i == numSlots)
+        return false;
+
+    // Backward shift deletion, move back the elements of the cluster that cannot be found anymore
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (slots[j].element == nullptr)
+            break;
+
+        size_t home = hash(slots[j].address);
+
+        // If the home slot is cyclically inside (i, j] the element is still reachable
+        bool reachable = (i <= j) ? (home > i && home <= j) : (home > i || home <= j);
+        if (!reachable) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i].element = nullptr;
+    length--;
+
+    return true;
+}
+
+template <class T, size_t Capacity>
+void LM_AddressMap<T, Capacity>::Clear() {
+    for (size_t i = 0; i < numSlots; i++) {
+        slots[i].address = 0;
+        slots[i].element = nullptr;
+    }
+
+    length = 0;
+}
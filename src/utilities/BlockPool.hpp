@@ -0,0 +1,253 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Heap allocations that keep their size before the memory, so the bytes in use can be counted
+ *
+ */
+class LM_CountedHeap {
+public:
+    /**
+     * @brief Allocate size bytes from the heap
+     *
+     * @param size Size in bytes
+     * @return void* Pointer to the memory or nullptr if it could not be allocated
+     */
+    void* allocate(size_t size) {
+        Header* header = static_cast<Header*>(pvPortMalloc(sizeof(Header) + size));
+        if (header == nullptr)
+            return nullptr;
+
+        header->size = size;
+
+        portENTER_CRITICAL(&mux);
+        inUse += size;
+        portEXIT_CRITICAL(&mux);
+
+        return header + 1;
+    }
+
+    /**
+     * @brief Free memory allocated with allocate
+     *
+     * @param p Pointer to be freed, it can be nullptr
+     */
+    void release(void* p) {
+        if (p == nullptr)
+            return;
+
+        Header* header = static_cast<Header*>(p) - 1;
+
+        portENTER_CRITICAL(&mux);
+        inUse -= header->size;
+        portEXIT_CRITICAL(&mux);
+
+        vPortFree(header);
+    }
+
+    /**
+     * @brief Bytes allocated and not freed, without the headers
+     *
+     */
+    size_t getInUse() const { return inUse; }
+
+private:
+    // Keep the memory aligned as a heap allocation would be
+    union alignas(alignof(max_align_t)) Header {
+        size_t size;
+        max_align_t align;
+    };
+
+    size_t inUse = 0;
+
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+/**
+ * @brief Fixed block allocator. All the blocks are reserved when the pool is created and they are handed out
+ * from a free list, so allocating and freeing never touches the heap nor fragments it.
+ * When the pool is exhausted, or the requested size does not fit inside a block, it falls back to the heap.
+ * The blocks of the pool are reference counted, a block can be shared with retain and it is only freed
+ * when every owner has released it.
+ *
+ * @tparam BlockSize Size in bytes of every block
+ * @tparam NumBlocks Number of blocks of the pool
+ */
+template <size_t BlockSize, size_t NumBlocks>
+class LM_BlockPool {
+public:
+    LM_BlockPool();
+
+    /**
+     * @brief Allocate a block of at least size bytes
+     *
+     * @param size Size in bytes
+     * @return void* Pointer to the memory or nullptr if it could not be allocated
+     */
+    void* allocate(size_t size);
+
+    /**
+     * @brief Release a block allocated with allocate, the block is freed when there are no more references.
+     * Pointers outside the pool are freed from the heap.
+     *
+     * @param p Pointer to be freed, it can be nullptr
+     */
+    void release(void* p);
+
+    /**
+     * @brief Add a reference to a block of the pool
+     *
+     * @param p Pointer to the block
+     * @return true If the reference has been added
+     * @return false If the pointer is not a block of the pool (heap memory cannot be shared) or it has too many references
+     */
+    bool retain(void* p);
+
+    /**
+     * @brief Returns if the pointer belongs to the pool
+     *
+     * @param p Pointer
+     * @return true If it is a block of the pool
+     * @return false If it is not
+     */
+    bool contains(const void* p) const {
+        const uint8_t* ptr = static_cast<const uint8_t*>(p);
+        return ptr >= blocks[0].data && ptr < blocks[NumBlocks].data;
+    }
+
+    size_t getBlockSize() const { return BlockSize; }
+    size_t getNumBlocks() const { return NumBlocks; }
+    size_t getInUse() const { return inUse; }
+    size_t getHighWaterMark() const { return highWaterMark; }
+    uint32_t getHeapFallbacks() const { return heapFallbacks; }
+
+    /**
+     * @brief Bytes of the heap fallbacks not released yet
+     *
+     */
+    size_t getHeapInUse() const { return heap.getInUse(); }
+
+private:
+    union Block {
+        Block* next;
+        // Keep the blocks aligned as a heap allocation would be
+        alignas(alignof(max_align_t)) uint8_t data[BlockSize];
+    };
+
+    // One extra block to be able to get the end of the pool, it is never handed out
+    Block blocks[NumBlocks + 1];
+    Block* freeList;
+
+    // Number of owners of every block
+    uint8_t refCount[NumBlocks];
+
+    size_t inUse;
+    size_t highWaterMark;
+    uint32_t heapFallbacks;
+
+    LM_CountedHeap heap;
+
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+    size_t indexOf(const void* p) const {
+        return reinterpret_cast<const Block*>(p) - blocks;
+    }
+};
+
+template <size_t BlockSize, size_t NumBlocks>
+LM_BlockPool<BlockSize, NumBlocks>::LM_BlockPool() {
+    freeList = nullptr;
+    for (size_t i = NumBlocks; i > 0; i--) {
+        blocks[i - 1].next = freeList;
+        freeList = &blocks[i - 1];
+        refCount[i - 1] = 0;
+    }
+
+    inUse = 0;
+    highWaterMark = 0;
+    heapFallbacks = 0;
+}
+
+template <size_t BlockSize, size_t NumBlocks>
+void* LM_BlockPool<BlockSize, NumBlocks>::allocate(size_t size) {
+    Block* block = nullptr;
+
+    if (size <= BlockSize) {
+        portENTER_CRITICAL(&mux);
+
+        block = freeList;
+        if (block != nullptr) {
+            freeList = block->next;
+            refCount[indexOf(block)] = 1;
+            inUse++;
+            if (inUse > highWaterMark)
+                highWaterMark = inUse;
+        }
+        else {
+            heapFallbacks++;
+        }
+
+        portEXIT_CRITICAL(&mux);
+    }
+    else {
+        portENTER_CRITICAL(&mux);
+        heapFallbacks++;
+        portEXIT_CRITICAL(&mux);
+    }
+
+    if (block != nullptr)
+        return block->data;
+
+    ESP_LOGV(LM_TAG, "Block pool fallback to heap with %d bytes", size);
+    return heap.allocate(size);
+}
+
+template <size_t BlockSize, size_t NumBlocks>
+void LM_BlockPool<BlockSize, NumBlocks>::release(void* p) {
+    if (p == nullptr)
+        return;
+
+    if (!contains(p)) {
+        heap.release(p);
+        return;
+    }
+
+    Block* block = reinterpret_cast<Block*>(p);
+    size_t index = indexOf(block);
+
+    portENTER_CRITICAL(&mux);
+
+    if (refCount[index] > 1) {
+        refCount[index]--;
+        portEXIT_CRITICAL(&mux);
+        return;
+    }
+
+    refCount[index] = 0;
+    block->next = freeList;
+    freeList = block;
+    inUse--;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+template <size_t BlockSize, size_t NumBlocks>
+bool LM_BlockPool<BlockSize, NumBlocks>::retain(void* p) {
+    if (p == nullptr || !contains(p))
+        return false;
+
+    size_t index = indexOf(p);
+    bool retained = false;
+
+    portENTER_CRITICAL(&mux);
+
+    if (refCount[index] > 0 && refCount[index] < UINT8_MAX) {
+        refCount[index]++;
+        retained = true;
+    }
+
+    portEXIT_CRITICAL(&mux);
+
+    return retained;
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Binary min-heap of deadlines (T must have `unsigned long timeout` and `int16_t timerIndex` members).
+ * The element stores its own position inside the heap, so updating or removing an element is O(log n)
+ * and the earliest deadline is always the first element. The deadlines are compared with millis() wrap around.
+ * The storage grows when needed. All the functions take the internal lock.
+ *
+ * @tparam T Type of the elements
+ */
+template <class T>
+class LM_DeadlineHeap {
+public:
+    LM_DeadlineHeap();
+    ~LM_DeadlineHeap();
+
+    /**
+     * @brief Add the element or move it to the position of its current timeout
+     *
+     * @param element Element to be scheduled
+     * @return true If the element is the first deadline
+     * @return false If not, or if it could not be added
+     */
+    bool update(T* element);
+
+    /**
+     * @brief Remove the element, it does nothing if it is not inside the heap
+     *
+     * @param element Element to be removed
+     */
+    void remove(T* element);
+
+    /**
+     * @brief Remove and return the element with the earliest deadline if it has expired
+     *
+     * @param now Current time in milliseconds
+     * @return T* Element or nullptr if there are no expired elements
+     */
+    T* popExpired(unsigned long now);
+
+    /**
+     * @brief Get the milliseconds until the earliest deadline
+     *
+     * @param now Current time in milliseconds
+     * @param maxWait Value returned if it is empty or the deadline is after it
+     * @return unsigned long Milliseconds, 0 if it has expired
+     */
+    unsigned long getTimeUntilFirst(unsigned long now, unsigned long maxWait);
+
+    size_t getLength() { return length; }
+
+    /**
+     * @brief Remove all the elements
+     *
+     */
+    void Clear();
+
+private:
+    T** elements;
+    size_t length;
+    size_t capacity;
+
+    SemaphoreHandle_t xSemaphore;
+
+    static bool isBefore(const T* a, const T* b) {
+        return (long) (a->timeout - b->timeout) < 0;
+    }
+
+    void set(size_t index, T* element) {
+        elements[index] = element;
+        element->timerIndex = index;
+    }
+
+    bool grow();
+    void removeAt(size_t index);
+    void siftUp(size_t index);
+    void siftDown(size_t index);
+};
+
+template <class T>
+LM_DeadlineHeap<T>::LM_DeadlineHeap() {
+    elements = nullptr;
+    length = 0;
+    capacity = 0;
+
+    xSemaphore = xSemaphoreCreateMutex();
+
+    if (xSemaphore == NULL) {
+        ESP_LOGE(LM_TAG, "Semaphore in Deadline Heap not created");
+    }
+}
+
+template <class T>
+LM_DeadlineHeap<T>::~LM_DeadlineHeap() {
+    Clear();
+    vPortFree(elements);
+    vSemaphoreDelete(xSemaphore);
+}
+
+template <class T>
+bool LM_DeadlineHeap<T>::update(T* element) {
+    xSemaphoreTake(xSemaphore, portMAX_DELAY);
+
+    if (element->timerIndex < 0) {
+        if (length == capacity && !grow()) {
+            xSemaphoreGive(xSemaphore);
+            ESP_LOGE(LM_TAG, "Deadline heap could not grow");
+            return false;
+        }
+
+        set(length, element);
+        length++;
+        siftUp(length - 1);
+    }
+    else {
+        siftUp(element->timerIndex);
+        siftDown(element->timerIndex);
+    }
+
+    bool first = elements[0] == element;
+
+    xSemaphoreGive(xSemaphore);
+
+    return first;
+}
+
+template <class T>
+void LM_DeadlineHeap<T>::remove(T* element) {
+    xSemaphoreTake(xSemaphore, portMAX_DELAY);
+
+    if (element->timerIndex >= 0 && (size_t) element->timerIndex < length && elements[element->timerIndex] == element)
+        removeAt(element->timerIndex);
+
+    xSemaphoreGive(xSemaphore);
+}
+
+template <class T>
+T* LM_DeadlineHeap<T>::popExpired(unsigned long now) {
+    xSemaphoreTake(xSemaphore, portMAX_DELAY);
+
+    T* element = nullptr;
+    if (length > 0 && (long) (elements[0]->timeout - now) <= 0) {
+        element = elements[0];
+        removeAt(0);
+    }
+
+    xSemaphoreGive(xSemaphore);
+
+    return element;
+}
+
+template <class T>
+unsigned long LM_DeadlineHeap<T>::getTimeUntilFirst(unsigned long now, unsigned long maxWait) {
+    xSemaphoreTake(xSemaphore, portMAX_DELAY);
+
+    unsigned long wait = maxWait;
+    if (length > 0) {
+        long remaining = (long) (elements[0]->timeout - now);
+        if (remaining <= 0)
+            wait = 0;
+        else if ((unsigned long) remaining < maxWait)
+            wait = remaining;
+    }
+
+    xSemaphoreGive(xSemaphore);
+
+    return wait;
+}
+
+template <class T>
+void LM_DeadlineHeap<T>::Clear() {
+    xSemaphoreTake(xSemaphore, portMAX_DELAY);
+
+    for (size_t i = 0; i < length; i++)
+        elements[i]->timerIndex = -1;
+
+    length = 0;
+
+    xSemaphoreGive(xSemaphore);
+}
+
+template <class T>
+bool LM_DeadlineHeap<T>::grow() {
+    size_t newCapacity = capacity == 0 ? 8 : capacity * 2;
+    if (newCapacity > INT16_MAX)
+        return false;
+
+    T** newElements = static_cast<T**>(pvPortMalloc(newCapacity * sizeof(T*)));
+    if (newElements == nullptr)
+        return false;
+
+    if (elements != nullptr) {
+        memcpy(newElements, elements, length * sizeof(T*));
+        vPortFree(elements);
+    }
+
+    elements = newElements;
+    capacity = newCapacity;
+    return true;
+}
+
+template <class T>
+void LM_DeadlineHeap<T>::removeAt(size_t index) {
+    elements[index]->timerIndex = -1;
+    length--;
+
+    if (index == length)
+        return;
+
+    set(index, elements[length]);
+    siftUp(index);
+    siftDown(index);
+}
+
+template <class T>
+void LM_DeadlineHeap<T>::siftUp(size_t index) {
+    T* element = elements[index];
+
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!isBefore(element, elements[parent]))
+            break;
+
+        set(index, elements[parent]);
+        index = parent;
+    }
+
+    set(index, element);
+}
+
+template <class T>
+void LM_DeadlineHeap<T>::siftDown(size_t index) {
+    T* element = elements[index];
+
+    for (;;) {
+        size_t child = 2 * index + 1;
+        if (child >= length)
+            break;
+
+        if (child + 1 < length && isBefore(elements[child + 1], elements[child]))
+            child++;
+
+        if (!isBefore(elements[child], element))
+            break;
+
+        set(index, elements[child]);
+        index = child;
+    }
+
+    set(index, element);
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Hash functions used to identify the packets
+ *
+ */
+class LM_Hash {
+public:
+    /**
+     * @brief FNV-1a hash, it can be chained using the previous result as hash
+     *
+     * @param data Data to be hashed
+     * @param size Size of the data in bytes
+     * @param hash Initial hash
+     * @return uint32_t Hash of the data
+     */
+    static uint32_t fnv1a(const void* data, size_t size, uint32_t hash = 2166136261U) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 16777619U;
+        }
+
+        return hash;
+    }
+};
+
+/**
+ * @brief Fixed size cache of recently seen packets. Every packet is identified by a 32 bits key (a hash of its fields)
+ * and every entry expires after a timeout, or stays until it is removed with a timeout of 0. It is a set associative
+ * cache, each key can only be stored in the Ways entries of its set, so adding, finding and removing are O(Ways).
+ * When a set is full the entry closest to expire is replaced, the entries without timeout are the last ones, oldest first.
+ *
+ * @tparam Capacity Number of entries, it must be a multiple of Ways and the number of sets a power of two
+ * @tparam Ways Number of entries per set
+ */
+template <size_t Capacity, size_t Ways = 4>
+class LM_DuplicateCache {
+    static_assert(Capacity % Ways == 0, "LM_DuplicateCache capacity must be a multiple of the ways");
+    static_assert(((Capacity / Ways) & ((Capacity / Ways) - 1)) == 0, "LM_DuplicateCache number of sets must be a power of two");
+
+public:
+    LM_DuplicateCache() { Clear(); }
+
+    /**
+     * @brief Add the key if it is not inside the cache
+     *
+     * @param key Key of the packet
+     * @param timeout Time in milliseconds until the entry expires, 0 if it does not expire
+     * @return true If the key has been added
+     * @return false If the key was already inside the cache and has not expired, the packet is a duplicate
+     */
+    bool add(uint32_t key, uint32_t timeout);
+
+    /**
+     * @brief Returns if the key is inside the cache and has not expired
+     *
+     * @param key Key of the packet
+     * @return true If the packet is a duplicate
+     * @return false If not
+     */
+    bool contains(uint32_t key);
+
+    /**
+     * @brief Remove the key from the cache
+     *
+     * @param key Key of the packet
+     */
+    void remove(uint32_t key);
+
+    /**
+     * @brief Remove all the entries
+     *
+     */
+    void Clear();
+
+private:
+    static constexpr size_t numSets = Capacity / Ways;
+
+    struct Entry {
+        uint32_t key;
+        // millis() at which it expires, or at which it was added if it does not expire
+        uint32_t expiration;
+        bool used;
+        bool expires;
+    };
+
+    Entry entries[Capacity];
+
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+    static bool isExpired(const Entry& entry, uint32_t now) {
+        return !entry.used || (entry.expires && (int32_t) (entry.expiration - now) <= 0);
+    }
+
+    static bool isReplacedBefore(const Entry& entry, const Entry& other) {
+        if (entry.expires != other.expires)
+            return entry.expires;
+
+        return (int32_t) (entry.expiration - other.expiration) < 0;
+    }
+
+    Entry* getSet(uint32_t key) {
+        // Mix the high bits, the keys are FNV-1a hashes
+        return &entries[((key ^ (key >> 16)) & (numSets - 1)) * Ways];
+    }
+};
+
+template <size_t Capacity, size_t Ways>
+bool LM_DuplicateCache<Capacity, Ways>::add(uint32_t key, uint32_t timeout) {
+    uint32_t now = millis();
+    Entry* set = getSet(key);
+    Entry* replace = nullptr;
+
+    portENTER_CRITICAL(&mux);
+
+    for (size_t i = 0; i < Ways; i++) {
+        Entry& entry = set[i];
+
+        if (isExpired(entry, now)) {
+            if (replace == nullptr || !isExpired(*replace, now))
+                replace = &entry;
+            continue;
+        }
+
+        if (entry.key == key) {
+            portEXIT_CRITICAL(&mux);
+            return false;
+        }
+
+        if (replace == nullptr || (!isExpired(*replace, now) && isReplacedBefore(entry, *replace)))
+            replace = &entry;
+    }
+
+    replace->key = key;
+    replace->expiration = now + timeout;
+    replace->used = true;
+    replace->expires = timeout > 0;
+
+    portEXIT_CRITICAL(&mux);
+
+    return true;
+}
+
+template <size_t Capacity, size_t Ways>
+bool LM_DuplicateCache<Capacity, Ways>::contains(uint32_t key) {
+    uint32_t now = millis();
+    Entry* set = getSet(key);
+    bool found = false;
+
+    portENTER_CRITICAL(&mux);
+
+    for (size_t i = 0; i < Ways; i++) {
+        if (!isExpired(set[i], now) && set[i].key == key) {
+            found = true;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&mux);
+
+    return found;
+}
+
+template <size_t Capacity, size_t Ways>
+void LM_DuplicateCache<Capacity, Ways>::remove(uint32_t key) {
+    Entry* set = getSet(key);
+
+    portENTER_CRITICAL(&mux);
+
+    for (size_t i = 0; i < Ways; i++) {
+        if (set[i].used && set[i].key == key) {
+            set[i].used = false;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&mux);
+}
+
+template <size_t Capacity, size_t Ways>
+void LM_DuplicateCache<Capacity, Ways>::Clear() {
+    for (size_t i = 0; i < Capacity; i++) {
+        entries[i].key = 0;
+        entries[i].expiration = 0;
+        entries[i].used = false;
+        entries[i].expires = false;
+    }
+}
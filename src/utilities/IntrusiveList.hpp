@@ -0,0 +1,228 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Intrusive singly linked list. The link lives inside the element (T must have a `T* next` member),
+ * so adding and removing elements never allocates memory.
+ * It has the same interface as LM_LinkedList, an element can only be inside one LM_IntrusiveList at a time.
+ *
+ * @tparam T Type of the elements
+ */
+template <class T>
+class LM_IntrusiveList {
+private:
+    size_t length;
+    T* head;
+    T* tail;
+    T* curr;
+    // Element before curr, nullptr when curr is the head
+    T* currPrev;
+    SemaphoreHandle_t xSemaphore;
+
+    /**
+     * @brief Find the element before the given one
+     *
+     * @param element Element inside the list
+     * @return T* Previous element or nullptr if it is the head
+     */
+    T* findPrevious(T* element);
+
+public:
+    LM_IntrusiveList();
+    ~LM_IntrusiveList();
+    T* getCurrent();
+    T* First() const;
+    T* Last() const;
+    size_t getLength();
+    void Append(T*);
+    T* Pop();
+    void addCurrent(T*);
+    bool Search(T*);
+    void DeleteCurrent();
+    bool next();
+    bool moveToStart();
+    void Clear();
+    void setInUse();
+    void releaseInUse();
+};
+
+template <class T>
+LM_IntrusiveList<T>::LM_IntrusiveList() {
+    length = 0;
+    head = nullptr;
+    tail = nullptr;
+    curr = nullptr;
+    currPrev = nullptr;
+
+    /* Attempt to create a semaphore. */
+    xSemaphore = xSemaphoreCreateMutex();
+
+    if (xSemaphore == NULL) {
+        ESP_LOGE(LM_TAG, "Semaphore in Intrusive List not created");
+    }
+}
+
+template <class T>
+LM_IntrusiveList<T>::~LM_IntrusiveList() {
+    Clear();
+    vSemaphoreDelete(xSemaphore);
+}
+
+template <class T>
+T* LM_IntrusiveList<T>::findPrevious(T* element) {
+    if (element == head)
+        return nullptr;
+
+    T* prev = head;
+    while (prev != nullptr && prev->next != element)
+        prev = prev->next;
+
+    return prev;
+}
+
+template <class T>
+T* LM_IntrusiveList<T>::getCurrent() {
+    return curr;
+}
+
+template <class T>
+T* LM_IntrusiveList<T>::First() const {
+    return head;
+}
+
+template <class T>
+T* LM_IntrusiveList<T>::Last() const {
+    return tail;
+}
+
+template <class T>
+size_t LM_IntrusiveList<T>::getLength() {
+    return length;
+}
+
+template <class T>
+void LM_IntrusiveList<T>::Append(T* element) {
+    element->next = nullptr;
+
+    if (length == 0) {
+        curr = tail = head = element;
+        currPrev = nullptr;
+    }
+    else {
+        tail->next = element;
+        tail = element;
+    }
+
+    length++;
+}
+
+template <class T>
+void LM_IntrusiveList<T>::addCurrent(T* element) {
+    if (length == 0) {
+        Append(element);
+        return;
+    }
+
+    element->next = curr;
+
+    if (currPrev != nullptr)
+        currPrev->next = element;
+    else
+        head = element;
+
+    currPrev = element;
+
+    length++;
+}
+
+template <class T>
+T* LM_IntrusiveList<T>::Pop() {
+    moveToStart();
+    T* element = getCurrent();
+    DeleteCurrent();
+    return element;
+}
+
+template <class T>
+bool LM_IntrusiveList<T>::Search(T* elem) {
+    if (moveToStart()) {
+        do {
+            if (curr == elem)
+                return true;
+        } while (next());
+    }
+
+    return false;
+}
+
+template <class T>
+bool LM_IntrusiveList<T>::next() {
+    if (length == 0 || curr == nullptr)
+        return false;
+
+    if (curr->next == nullptr)
+        return false;
+
+    currPrev = curr;
+    curr = curr->next;
+    return true;
+}
+
+template <class T>
+bool LM_IntrusiveList<T>::moveToStart() {
+    curr = head;
+    currPrev = nullptr;
+    return length != 0;
+}
+
+template <class T>
+void LM_IntrusiveList<T>::DeleteCurrent() {
+    if (length == 0 || curr == nullptr)
+        return;
+
+    length--;
+    T* temp = curr;
+
+    if (currPrev != nullptr)
+        currPrev->next = temp->next;
+    else
+        head = temp->next;
+
+    if (length == 0) {
+        head = curr = tail = currPrev = nullptr;
+    }
+    else if (temp == tail) {
+        // As in LM_LinkedList, when deleting the tail the current element is the new tail
+        curr = tail = currPrev;
+        currPrev = findPrevious(curr);
+    }
+    else {
+        curr = temp->next;
+    }
+
+    temp->next = nullptr;
+}
+
+template <class T>
+void LM_IntrusiveList<T>::Clear() {
+    while (head != nullptr) {
+        T* temp = head;
+        head = head->next;
+        temp->next = nullptr;
+    }
+
+    head = curr = tail = currPrev = nullptr;
+
+    length = 0;
+}
+
+template <class T>
+void LM_IntrusiveList<T>::setInUse() {
+    xSemaphoreTake(xSemaphore, portMAX_DELAY);
+}
+
+template <class T>
+void LM_IntrusiveList<T>::releaseInUse() {
+    xSemaphoreGive(xSemaphore);
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief LZSS compression with a bounded window, small enough to compress the payloads on the node.
+ * The compressed data starts with the original size as a varint, followed by groups of a flags byte and 8 tokens.
+ * Every token is a literal byte (flag 0) or a match of 2 bytes (flag 1) with a 12 bit distance and a 4 bit length.
+ * The compressor only keeps a hash table of the last positions, the decompressor does not need any memory apart
+ * from the output.
+ *
+ */
+class LM_Lzss {
+public:
+    static constexpr size_t MIN_MATCH = 3;
+    static constexpr size_t MAX_MATCH = MIN_MATCH + 15;
+    static constexpr size_t MAX_DISTANCE = LM_COMPRESSION_WINDOW;
+
+    static_assert(LM_COMPRESSION_WINDOW <= 4096, "The compression window must fit in 12 bits");
+
+    /**
+     * @brief Compress the data
+     *
+     * @param in Data to be compressed
+     * @param inSize Size of the data
+     * @param out Output buffer
+     * @param outCapacity Size of the output buffer, the data is only compressed if it is smaller than it
+     * @return size_t Size of the compressed data, 0 if it does not fit inside the output buffer or there is no memory
+     */
+    static size_t compress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outCapacity) {
+        uint32_t* head = static_cast<uint32_t*>(pvPortMalloc(HASH_SIZE * sizeof(uint32_t)));
+        if (head == nullptr)
+            return 0;
+
+        // Positions are stored plus one, 0 is empty
+        memset(head, 0, HASH_SIZE * sizeof(uint32_t));
+
+        size_t outPos = writeVarint(inSize, out, outCapacity);
+        size_t inPos = 0;
+
+        while (outPos != 0 && inPos < inSize) {
+            if (outPos >= outCapacity) {
+                outPos = 0;
+                break;
+            }
+
+            uint8_t* flags = &out[outPos++];
+            *flags = 0;
+
+            for (uint8_t token = 0; token < 8 && inPos < inSize; token++) {
+                size_t matchLength = 0;
+                size_t distance = 0;
+
+                if (inPos + MIN_MATCH <= inSize) {
+                    uint16_t h = hash(&in[inPos]);
+                    uint32_t candidate = head[h];
+                    head[h] = inPos + 1;
+
+                    if (candidate != 0 && inPos - (candidate - 1) <= MAX_DISTANCE) {
+                        size_t start = candidate - 1;
+                        size_t maxLength = inSize - inPos < MAX_MATCH ? inSize - inPos : MAX_MATCH;
+
+                        while (matchLength < maxLength && in[start + matchLength] == in[inPos + matchLength])
+                            matchLength++;
+
+                        distance = inPos - start;
+                    }
+                }
+
+                if (matchLength >= MIN_MATCH) {
+                    if (outPos + 2 > outCapacity) {
+                        outPos = 0;
+                        break;
+                    }
+
+                    uint16_t code = ((distance - 1) << 4) | (matchLength - MIN_MATCH);
+                    out[outPos++] = code >> 8;
+                    out[outPos++] = code & 0xFF;
+                    *flags |= 1 << token;
+
+                    // Index the positions inside the match
+                    for (size_t i = 1; i < matchLength && inPos + i + MIN_MATCH <= inSize; i++)
+                        head[hash(&in[inPos + i])] = inPos + i + 1;
+
+                    inPos += matchLength;
+                }
+                else {
+                    if (outPos + 1 > outCapacity) {
+                        outPos = 0;
+                        break;
+                    }
+
+                    out[outPos++] = in[inPos++];
+                }
+            }
+        }
+
+        vPortFree(head);
+
+        return outPos;
+    }
+
+    /**
+     * @brief Get the size of the original data
+     *
+     * @param in Compressed data
+     * @param inSize Size of the compressed data
+     * @param size Size of the original data
+     * @return true If the size is valid
+     * @return false If the data is malformed or the size cannot be reached with the compressed data
+     */
+    static bool getDecompressedSize(const uint8_t* in, size_t inSize, uint32_t& size) {
+        // Every match of 2 bytes expands up to MAX_MATCH bytes
+        return readVarint(in, inSize, size) != 0 && size <= inSize * (MAX_MATCH / 2);
+    }
+
+    /**
+     * @brief Decompress the data
+     *
+     * @param in Compressed data
+     * @param inSize Size of the compressed data
+     * @param out Output buffer, at least of the size given by getDecompressedSize
+     * @param outCapacity Size of the output buffer
+     * @return size_t Size of the original data, 0 if the data is malformed or it does not fit
+     */
+    static size_t decompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outCapacity) {
+        uint32_t size;
+        size_t inPos = readVarint(in, inSize, size);
+        if (inPos == 0 || size > outCapacity)
+            return 0;
+
+        size_t outPos = 0;
+
+        while (outPos < size) {
+            if (inPos >= inSize)
+                return 0;
+
+            uint8_t flags = in[inPos++];
+
+            for (uint8_t token = 0; token < 8 && outPos < size; token++) {
+                if ((flags & (1 << token)) == 0) {
+                    if (inPos >= inSize)
+                        return 0;
+
+                    out[outPos++] = in[inPos++];
+                    continue;
+                }
+
+                if (inPos + 2 > inSize)
+                    return 0;
+
+                uint16_t code = (in[inPos] << 8) | in[inPos + 1];
+                inPos += 2;
+
+                size_t distance = (code >> 4) + 1;
+                size_t length = (code & 0x0F) + MIN_MATCH;
+
+                if (distance > outPos || outPos + length > size)
+                    return 0;
+
+                // Byte by byte, the match can overlap the output
+                for (size_t i = 0; i < length; i++, outPos++)
+                    out[outPos] = out[outPos - distance];
+            }
+        }
+
+        return inPos == inSize ? size : 0;
+    }
+
+private:
+    static constexpr size_t HASH_BITS = 9;
+    static constexpr size_t HASH_SIZE = 1 << HASH_BITS;
+
+    static uint16_t hash(const uint8_t* p) {
+        uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    static size_t writeVarint(uint32_t value, uint8_t* out, size_t outCapacity) {
+        size_t pos = 0;
+
+        do {
+            if (pos >= outCapacity)
+                return 0;
+
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            out[pos++] = value != 0 ? byte | 0x80 : byte;
+        } while (value != 0);
+
+        return pos;
+    }
+
+    static size_t readVarint(const uint8_t* in, size_t inSize, uint32_t& value) {
+        value = 0;
+
+        for (size_t pos = 0; pos < inSize && pos < 5; pos++) {
+            value |= (uint32_t) (in[pos] & 0x7F) << (7 * pos);
+
+            if ((in[pos] & 0x80) == 0)
+                return pos + 1;
+        }
+
+        return 0;
+    }
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+#include <atomic>
+
+/**
+ * @brief Lock free multiple producer single consumer ring buffer of values. Every slot has a sequence number that
+ * tells the producers and the consumer if it is free or written, the producers take a slot with a compare and swap.
+ * Any task can push, only one task can pop. A producer preempted while writing its slot delays the consumer until it
+ * finishes, the elements are never lost nor read half written.
+ *
+ * @tparam T Type of the elements, they are copied inside the ring
+ * @tparam Capacity Maximum number of elements, it must be a power of two
+ */
+template <class T, size_t Capacity>
+class LM_MPSCRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "LM_MPSCRing capacity must be a power of two");
+
+public:
+    LM_MPSCRing() : tail(0), head(0) {
+        for (size_t i = 0; i < Capacity; i++)
+            buffer[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Add an element at the end of the ring. Called by any producer.
+     *
+     * @param element Element to be added
+     * @return true If it has been added
+     * @return false If the ring is full
+     */
+    bool push(const T& element) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+
+        for (;;) {
+            slot = &buffer[t & (Capacity - 1)];
+            intptr_t diff = (intptr_t) slot->sequence.load(std::memory_order_acquire) - (intptr_t) t;
+
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                t = tail.load(std::memory_order_relaxed);
+        }
+
+        slot->element = element;
+        slot->sequence.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the first element of the ring. Only called by the consumer.
+     *
+     * @param element Copy of the first element
+     * @return true If there was an element
+     * @return false If the ring is empty or the first element is still being written
+     */
+    bool pop(T& element) {
+        Slot& slot = buffer[head & (Capacity - 1)];
+        if ((intptr_t) slot.sequence.load(std::memory_order_acquire) - (intptr_t) (head + 1) < 0)
+            return false;
+
+        element = slot.element;
+        slot.sequence.store(head + Capacity, std::memory_order_release);
+        head++;
+        return true;
+    }
+
+    size_t getCapacity() const { return Capacity; }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T element;
+    };
+
+    Slot buffer[Capacity];
+
+    // Free running counters, the index is the counter modulo Capacity
+    std::atomic<size_t> tail;
+    size_t head;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief XOR parity of a block of packets. The payloads shorter than the parity are taken as padded with zeros.
+ * The XOR of the parity with all the packets of the block but one is the payload of the missing packet.
+ *
+ */
+class LM_Parity {
+public:
+    /**
+     * @brief Add the payload of a packet to the parity
+     *
+     * @param parity Parity, at least of payloadSize bytes
+     * @param payload Payload of the packet
+     * @param payloadSize Size of the payload
+     */
+    static void add(uint8_t* parity, const uint8_t* payload, size_t payloadSize) {
+        for (size_t i = 0; i < payloadSize; i++)
+            parity[i] ^= payload[i];
+    }
+};
@@ -0,0 +1,300 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Priority queue with one intrusive FIFO bucket per priority level (T must have `uint8_t priority`
+ * and `T* next` members). Adding and popping are O(1): a bitmap marks the non-empty buckets and
+ * the highest priority is found with a count leading zeros.
+ * Elements with higher priority are popped first, elements with the same priority keep the FIFO order.
+ * The iteration functions (moveToStart, next, getCurrent) go through the elements in the pop order.
+ *
+ * @tparam T Type of the elements
+ * @tparam MaxPriority Maximum priority, greater priorities are stored as MaxPriority
+ */
+template <class T, uint8_t MaxPriority>
+class LM_PriorityQueue {
+    static_assert(MaxPriority < 64, "LM_PriorityQueue supports priorities between 0 and 63");
+
+public:
+    LM_PriorityQueue();
+    ~LM_PriorityQueue();
+    T* getCurrent();
+    T* First();
+    size_t getLength();
+    void Append(T*);
+    T* Pop();
+    T* Lowest();
+    T* PopLowest();
+    template <class Predicate> T* Extract(Predicate match);
+    bool next();
+    bool moveToStart();
+    void Clear();
+    void setInUse();
+    void releaseInUse();
+
+private:
+    struct Bucket {
+        T* head;
+        T* tail;
+    };
+
+    Bucket buckets[MaxPriority + 1];
+    uint64_t nonEmpty;
+    size_t length;
+
+    T* curr;
+    uint8_t currBucket;
+
+    SemaphoreHandle_t xSemaphore;
+
+    static uint8_t bucketOf(uint8_t priority) {
+        return priority > MaxPriority ? MaxPriority : priority;
+    }
+
+    /**
+     * @brief Get the highest non empty bucket with a priority lower or equal than maxBucket
+     *
+     * @param maxBucket Highest bucket to check
+     * @return int Bucket or -1 if all of them are empty
+     */
+    int highestBucket(uint8_t maxBucket) const {
+        uint64_t mask = maxBucket >= 63 ? ~(uint64_t) 0 : (((uint64_t) 1 << (maxBucket + 1)) - 1);
+        uint64_t candidates = nonEmpty & mask;
+        if (candidates == 0)
+            return -1;
+
+        return 63 - __builtin_clzll(candidates);
+    }
+};
+
+template <class T, uint8_t MaxPriority>
+LM_PriorityQueue<T, MaxPriority>::LM_PriorityQueue() {
+    for (size_t i = 0; i <= MaxPriority; i++) {
+        buckets[i].head = nullptr;
+        buckets[i].tail = nullptr;
+    }
+
+    nonEmpty = 0;
+    length = 0;
+    curr = nullptr;
+    currBucket = 0;
+
+    /* Attempt to create a semaphore. */
+    xSemaphore = xSemaphoreCreateMutex();
+
+    if (xSemaphore == NULL) {
+        ESP_LOGE(LM_TAG, "Semaphore in Priority Queue not created");
+    }
+}
+
+template <class T, uint8_t MaxPriority>
+LM_PriorityQueue<T, MaxPriority>::~LM_PriorityQueue() {
+    Clear();
+    vSemaphoreDelete(xSemaphore);
+}
+
+template <class T, uint8_t MaxPriority>
+T* LM_PriorityQueue<T, MaxPriority>::getCurrent() {
+    return curr;
+}
+
+template <class T, uint8_t MaxPriority>
+T* LM_PriorityQueue<T, MaxPriority>::First() {
+    int bucket = highestBucket(MaxPriority);
+    return bucket < 0 ? nullptr : buckets[bucket].head;
+}
+
+template <class T, uint8_t MaxPriority>
+size_t LM_PriorityQueue<T, MaxPriority>::getLength() {
+    return length;
+}
+
+template <class T, uint8_t MaxPriority>
+void LM_PriorityQueue<T, MaxPriority>::Append(T* element) {
+    uint8_t bucket = bucketOf(element->priority);
+    Bucket& b = buckets[bucket];
+
+    element->next = nullptr;
+
+    if (b.tail == nullptr)
+        b.head = element;
+    else
+        b.tail->next = element;
+
+    b.tail = element;
+    nonEmpty |= (uint64_t) 1 << bucket;
+
+    length++;
+}
+
+template <class T, uint8_t MaxPriority>
+T* LM_PriorityQueue<T, MaxPriority>::Pop() {
+    int bucket = highestBucket(MaxPriority);
+    if (bucket < 0)
+        return nullptr;
+
+    Bucket& b = buckets[bucket];
+    T* element = b.head;
+
+    b.head = element->next;
+    if (b.head == nullptr) {
+        b.tail = nullptr;
+        nonEmpty &= ~((uint64_t) 1 << bucket);
+    }
+
+    if (curr == element)
+        curr = nullptr;
+
+    element->next = nullptr;
+    length--;
+
+    return element;
+}
+
+/**
+ * @brief Get the first element of the lowest priority, the last one to be popped of that priority
+ *
+ * @return T* Element or nullptr if it is empty
+ */
+template <class T, uint8_t MaxPriority>
+T* LM_PriorityQueue<T, MaxPriority>::Lowest() {
+    if (nonEmpty == 0)
+        return nullptr;
+
+    return buckets[__builtin_ctzll(nonEmpty)].head;
+}
+
+/**
+ * @brief Remove and return the first element of the lowest priority
+ *
+ * @return T* Element or nullptr if it is empty
+ */
+template <class T, uint8_t MaxPriority>
+T* LM_PriorityQueue<T, MaxPriority>::PopLowest() {
+    if (nonEmpty == 0)
+        return nullptr;
+
+    uint8_t bucket = __builtin_ctzll(nonEmpty);
+    Bucket& b = buckets[bucket];
+    T* element = b.head;
+
+    b.head = element->next;
+    if (b.head == nullptr) {
+        b.tail = nullptr;
+        nonEmpty &= ~((uint64_t) 1 << bucket);
+    }
+
+    if (curr == element)
+        curr = nullptr;
+
+    element->next = nullptr;
+    length--;
+
+    return element;
+}
+
+/**
+ * @brief Remove and return the first element, in the pop order, that matches the predicate. It is O(n).
+ *
+ * @param match Function that returns true for the element to be removed
+ * @return T* Element or nullptr if no element matches
+ */
+template <class T, uint8_t MaxPriority>
+template <class Predicate>
+T* LM_PriorityQueue<T, MaxPriority>::Extract(Predicate match) {
+    for (int bucket = highestBucket(MaxPriority); bucket >= 0; bucket = bucket == 0 ? -1 : highestBucket(bucket - 1)) {
+        Bucket& b = buckets[bucket];
+        T* prev = nullptr;
+
+        for (T* element = b.head; element != nullptr; prev = element, element = element->next) {
+            if (!match(element))
+                continue;
+
+            if (prev == nullptr)
+                b.head = element->next;
+            else
+                prev->next = element->next;
+
+            if (b.tail == element)
+                b.tail = prev;
+
+            if (b.head == nullptr)
+                nonEmpty &= ~((uint64_t) 1 << bucket);
+
+            if (curr == element)
+                curr = nullptr;
+
+            element->next = nullptr;
+            length--;
+
+            return element;
+        }
+    }
+
+    return nullptr;
+}
+
+template <class T, uint8_t MaxPriority>
+bool LM_PriorityQueue<T, MaxPriority>::moveToStart() {
+    int bucket = highestBucket(MaxPriority);
+    if (bucket < 0) {
+        curr = nullptr;
+        return false;
+    }
+
+    currBucket = bucket;
+    curr = buckets[bucket].head;
+    return true;
+}
+
+template <class T, uint8_t MaxPriority>
+bool LM_PriorityQueue<T, MaxPriority>::next() {
+    if (curr == nullptr)
+        return false;
+
+    if (curr->next != nullptr) {
+        curr = curr->next;
+        return true;
+    }
+
+    if (currBucket == 0)
+        return false;
+
+    int bucket = highestBucket(currBucket - 1);
+    if (bucket < 0)
+        return false;
+
+    currBucket = bucket;
+    curr = buckets[bucket].head;
+    return true;
+}
+
+template <class T, uint8_t MaxPriority>
+void LM_PriorityQueue<T, MaxPriority>::Clear() {
+    for (size_t i = 0; i <= MaxPriority; i++) {
+        T* element = buckets[i].head;
+        while (element != nullptr) {
+            T* temp = element;
+            element = element->next;
+            temp->next = nullptr;
+        }
+
+        buckets[i].head = nullptr;
+        buckets[i].tail = nullptr;
+    }
+
+    nonEmpty = 0;
+    length = 0;
+    curr = nullptr;
+}
+
+template <class T, uint8_t MaxPriority>
+void LM_PriorityQueue<T, MaxPriority>::setInUse() {
+    xSemaphoreTake(xSemaphore, portMAX_DELAY);
+}
+
+template <class T, uint8_t MaxPriority>
+void LM_PriorityQueue<T, MaxPriority>::releaseInUse() {
+    xSemaphoreGive(xSemaphore);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+#include <atomic>
+
+/**
+ * @brief Lock free single producer single consumer ring buffer of pointers.
+ * Only one task can push and only one task can pop, then no semaphore is needed between them.
+ *
+ * @tparam T Type of the elements, the ring only stores pointers to them
+ * @tparam Capacity Maximum number of elements, it must be a power of two
+ */
+template <class T, size_t Capacity>
+class LM_SPSCRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "LM_SPSCRing capacity must be a power of two");
+
+public:
+    LM_SPSCRing() : head(0), tail(0) {}
+
+    /**
+     * @brief Add an element at the end of the ring. Only called by the producer.
+     *
+     * @param element Element to be added
+     * @return true If it has been added
+     * @return false If the ring is full
+     */
+    bool push(T* element) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= Capacity)
+            return false;
+
+        buffer[t & (Capacity - 1)] = element;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the first element of the ring. Only called by the consumer.
+     *
+     * @return T* First element or nullptr if the ring is empty
+     */
+    T* pop() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return nullptr;
+
+        T* element = buffer[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return element;
+    }
+
+    /**
+     * @brief Get the number of elements inside the ring. From a task that is not the producer nor the consumer
+     * it is only an approximation.
+     *
+     * @return size_t Number of elements
+     */
+    size_t getLength() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t getCapacity() const { return Capacity; }
+
+private:
+    T* buffer[Capacity];
+
+    // Free running counters, the index is the counter modulo Capacity
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
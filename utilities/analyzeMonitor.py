@@ -11,6 +11,7 @@ from datetime import datetime
 import pandas as pd
 import numpy as np
 import itertools
+import struct
 
 headerPacketSize = 6
 dataPacketSize = 2
@@ -18,6 +19,13 @@ dataControlPacketSize = 3
 
 nodes = list()
 
+# Binary states exported by SimulatorService::exportStates, see src/entities/state/LM_State.h
+stateExportMagic = 0x54534D4C
+stateRecordVersion = 1
+stateExportHeaderFormat = "<IBBHIH"
+stateTypeReceived = 0
+stateTypeSent = 1
+
 
 def extraHeaderSize(type) -> int:
     extraSize = headerPacketSize
@@ -233,6 +241,87 @@ class Node:
                 packetQueueOrder += 1
 
 
+class BinaryNode(Node):
+    """Node read from the binary states exported by the SimulatorService (.lms files)"""
+
+    def getInformation(self):
+        self.getStates()
+        self.setJSON()
+
+    def getStates(self):
+        with open(self.fileName, "rb") as file:
+            data = file.read()
+
+        headerSize = struct.calcsize(stateExportHeaderFormat)
+        offset = 0
+        packetQueueOrder = 0
+
+        while offset + headerSize <= len(data):
+            magic, version, recordSize, address, overwritten, numberOfStates = struct.unpack_from(
+                stateExportHeaderFormat, data, offset)
+
+            # A truncated export, search the next header
+            if magic != stateExportMagic:
+                next = data.find(struct.pack("<I", stateExportMagic), offset + 1)
+                if next == -1:
+                    break
+                offset = next
+                continue
+
+            if version != stateRecordVersion:
+                print(F"Unknown states version {version} at file {self.fileName}, offset {offset}")
+                break
+
+            self.address = F"{address:X}"
+            recordFormat = stateRecordFormat(recordSize)
+            offset += headerSize
+
+            for _ in range(numberOfStates):
+                if offset + recordSize > len(data) or data.startswith(struct.pack("<I", stateExportMagic), offset):
+                    break
+
+                self.addState(struct.unpack_from(recordFormat, data, offset), packetQueueOrder)
+                packetQueueOrder += 1
+                offset += recordSize
+
+    def addState(self, state, packetQueueOrder):
+        (id, timestamp, stateType, receivedQueueSize, sentQueueSize, receivedUserQueueSize, q_WRPSize, q_WSPSize,
+         routingTableSize, freeMemory, dst, src, typeP, packetId, size, via, seq_id, num) = state
+
+        date = formatMillis(timestamp)
+        self.packetQueueLength.append(PacketList(packetQueueOrder, date, sentQueueSize))
+
+        if stateType not in (stateTypeReceived, stateTypeSent):
+            return
+
+        self.allPacketsNum += 1
+        isSend = stateType == stateTypeSent
+
+        packet = Packet(packetId, self.address, date, typeP, hex(src), hex(dst),
+                        size - extraHeaderSize(typeP), size, str(isSend))
+
+        if isDataPacket(typeP):
+            packet.addVia(hex(via))
+
+        if isControlPacket(typeP):
+            packet.addSeq_IdAndNum(seq_id, num)
+
+        self.addPacketToLists(packet, isSend)
+
+
+def stateRecordFormat(recordSize) -> str:
+    # The sequence id is 8 or 16 bits, LM_SEQUENCE_ID_16BIT
+    seqIdFormat = "B" if recordSize == 37 else "H"
+    return "<IIBHHHHHHI" + "HHBBBH" + seqIdFormat + "H"
+
+
+def formatMillis(millis) -> str:
+    seconds, millis = divmod(millis, 1000)
+    minutes, seconds = divmod(seconds, 60)
+    hours, minutes = divmod(minutes, 60)
+    return F"{hours % 24:02}:{minutes:02}:{seconds:02}.{millis:03}"
+
+
 def printError(fileName, lineNum):
     print(F"Try parse failed at file {fileName}, line {lineNum}")
 
@@ -357,6 +446,8 @@ def init():
             for filename in files:
                 if (filename.__contains__("monitor") and filename.__contains__(".txt") and filename.__contains__("COM")):
                     nodes.append(Node(filename))
+                elif filename.endswith(".lms"):
+                    nodes.append(BinaryNode(filename))
 
 
 threads = list()